@@ -0,0 +1,139 @@
+#pragma once
+/**
+ * Minimal microbenchmark harness: warmup, repeated samples, median/p99 and JSON report.
+ * */
+#include "core/lazy_utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fmt/format.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+/**
+ * Keeps the compiler from optimizing away a computed value.
+ * @param value value to keep.
+ * */
+template<class T>
+void do_not_optimize(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/**
+ * Statistics of a single benchmark, all times are in ns per operation.
+ * */
+struct result {
+    std::string name;      /**< Name of a benchmark */
+    std::size_t batch = 0; /**< Operations per sample */
+    double median     = 0; /**< Median of samples */
+    double p99        = 0; /**< 99th percentile of samples */
+    double min        = 0; /**< Fastest sample */
+    double mean       = 0; /**< Mean of samples */
+};
+
+/**
+ * Set of benchmarks sharing warmup and repetitions settings.
+ * */
+class suite {
+public:
+    /**
+     * Constructor.
+     * @param warmup samples to run and discard before measuring.
+     * @param repetitions samples to measure.
+     * @param seed seed used by benchmarks, written to the report.
+     * */
+    suite(std::size_t warmup, std::size_t repetitions, std::uint32_t seed);
+
+    /**
+     * Runs a benchmark. Each sample calls setup once outside of timing, then op batch times.
+     * @param name name of a benchmark.
+     * @param batch calls of op per sample.
+     * @param setup callable preparing state for a sample.
+     * @param op measured callable, gets index of a call within the sample.
+     * */
+    template<class Setup, class Op>
+    void run(const std::string& name, std::size_t batch, Setup&& setup, Op&& op);
+    /**
+     * Runs a benchmark without per-sample setup.
+     * @param name name of a benchmark.
+     * @param batch calls of op per sample.
+     * @param op measured callable, gets index of a call within the sample.
+     * */
+    template<class Op>
+    void run(const std::string& name, std::size_t batch, Op&& op);
+
+    /**
+     * Renders results as JSON, suitable for comparing runs across commits.
+     * */
+    auto to_json() const -> std::string;
+
+    auto results() const -> const std::vector<result>& { return m_results; }
+    auto seed() const -> std::uint32_t { return m_seed; }
+
+protected:
+    std::size_t m_warmup;          /**< Discarded samples */
+    std::size_t m_repetitions;     /**< Measured samples */
+    std::uint32_t m_seed;          /**< Seed of benchmarks' generators */
+    std::vector<result> m_results; /**< Results of finished benchmarks */
+};
+
+suite::suite(std::size_t warmup, std::size_t repetitions, std::uint32_t seed):
+    m_warmup(warmup), m_repetitions(std::max<std::size_t>(repetitions, 1)), m_seed(seed) { }
+
+template<class Setup, class Op>
+void suite::run(const std::string& name, std::size_t batch, Setup&& setup, Op&& op) {
+    auto sample = [&] {
+        setup();
+        auto time = bot::utils::measure<std::chrono::nanoseconds>([&] {
+            for(std::size_t i = 0; i < batch; i++) {
+                op(i);
+            }
+        });
+        return time.count() * 1.0 / batch;
+    };
+    for(std::size_t i = 0; i < m_warmup; i++) {
+        sample();
+    }
+    std::vector<double> samples(m_repetitions);
+    for(auto& s: samples) {
+        s = sample();
+    }
+    std::sort(samples.begin(), samples.end());
+
+    result res;
+    res.name   = name;
+    res.batch  = batch;
+    res.median = samples[samples.size() / 2];
+    res.p99    = samples[static_cast<std::size_t>(std::ceil(samples.size() * 0.99)) - 1];
+    res.min    = samples.front();
+    for(auto s: samples) {
+        res.mean += s / samples.size();
+    }
+    fmt::print(stderr, "{:<40} median {:>12.1f} ns  p99 {:>12.1f} ns\n", name, res.median, res.p99);
+    m_results.emplace_back(std::move(res));
+}
+
+template<class Op>
+void suite::run(const std::string& name, std::size_t batch, Op&& op) {
+    run(name, batch, [] {}, std::forward<Op>(op));
+}
+
+auto suite::to_json() const -> std::string {
+    auto json = fmt::format("{{\n  \"seed\": {},\n  \"warmup\": {},\n  \"repetitions\": {},\n  \"benchmarks\": [",
+                            m_seed, m_warmup, m_repetitions);
+    for(std::size_t i = 0; i < m_results.size(); i++) {
+        auto& r = m_results[i];
+        json += fmt::format("{}\n    {{\"name\": \"{}\", \"batch\": {}, \"unit\": \"ns/op\", \"median\": {:.2f}, "
+                            "\"p99\": {:.2f}, \"min\": {:.2f}, \"mean\": {:.2f}}}",
+                            i ? "," : "", r.name, r.batch, r.median, r.p99, r.min, r.mean);
+    }
+    json += "\n  ]\n}\n";
+    return json;
+}
+
+} // namespace bench
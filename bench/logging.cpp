@@ -0,0 +1,59 @@
+/**
+ * Benchmark of room_bot::p_on_any on the chat relay path.
+ * Built twice: with every log level compiled in and, with BENCH_LOG_GATED, with SPDLOG_ACTIVE_LEVEL=info,
+ * runtime level is info in both, so difference shows the cost of disabled debug calls.
+ * The level is set here rather than by the build, so it doesn't depend on the build type.
+ * */
+#undef SPDLOG_ACTIVE_LEVEL
+#ifdef BENCH_LOG_GATED
+#define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_INFO
+#else
+#define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+#endif
+#include "components/logger.hpp"
+#include "core/bot.h"
+
+#include <chrono>
+#include <iostream>
+
+class bench_bot: public bot::room_bot {
+public:
+    bench_bot(): bot::room_bot("0:bench") { }
+
+    auto add_user(std::int64_t id) {
+        auto user    = bot::make_entity<bot::user>(id);
+        user->name() = "bench";
+        s->lobby()->add_user(user);
+        user->current_room() = s->lobby();
+        s->on_user_connect(user);
+    }
+    void on_any(bot::mes_ptr mes) { p_on_any(mes); }
+};
+
+int main() {
+    auto lgr = initialization_logger();
+    lgr.set_level(logger::level::info);
+
+    const std::int64_t id = 1;
+    bench_bot b;
+    b.add_user(id);
+
+    auto mes             = std::make_shared<TgBot::Message>();
+    mes->chat            = std::make_shared<TgBot::Chat>();
+    mes->chat->id        = id;
+    mes->chat->firstName = "bench";
+    mes->text            = "hello everyone, how is it going?";
+
+    const std::size_t warmup = 10000, repeats = 1000000;
+    for(std::size_t i = 0; i < warmup; i++) {
+        b.on_any(mes);
+    }
+    auto time = bot::utils::measure<std::chrono::nanoseconds>([&] {
+        for(std::size_t i = 0; i < repeats; i++) {
+            b.on_any(mes);
+        }
+    });
+    std::cout << "p_on_any, SPDLOG_ACTIVE_LEVEL=" << SPDLOG_ACTIVE_LEVEL << ": " << time.count() * 1.0 / repeats
+              << " ns/op\n";
+    return 0;
+}
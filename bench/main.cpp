@@ -0,0 +1,240 @@
+/**
+ * Microbenchmark suite of hot paths: deck, bank, hand ranking, server lookups,
+ * command routing, game state rendering, turn timers, ICM and room history. \n
+ * Usage: bench [output.json] [repetitions]. Results are printed to stderr and written as JSON
+ * to the file (stdout by default), so runs can be compared across commits.
+ * */
+#include "bench/bench.h"
+#include "components/logger.hpp"
+#include "core/history.h"
+#include "core/timer_wheel.h"
+#include "poker/bank.h"
+#include "poker/bot.h"
+#include "poker/deck.h"
+#include "poker/game.h"
+#include "poker/icm.h"
+#include "poker/ranking.h"
+#include "poker/server.h"
+
+#include <fstream>
+#include <iostream>
+#include <random>
+
+const std::uint32_t seed = 42;
+
+class bench_server: public poker::poker_server {
+public:
+    auto add_user(std::int64_t id) -> bot::user_ptr {
+        auto user    = bot::make_entity<bot::user>(id);
+        user->name() = "bench" + std::to_string(id);
+        lobby()->add_user(user);
+        user->current_room() = lobby();
+        on_user_connect(user);
+        return user;
+    }
+};
+
+class bench_bot: public poker::poker_bot {
+public:
+    bench_bot(): poker::poker_bot("0:bench") { }
+
+    auto add_user(std::int64_t id) -> bot::user_ptr {
+        auto user    = bot::make_entity<bot::user>(id);
+        user->name() = "bench";
+        s->lobby()->add_user(user);
+        user->current_room() = s->lobby();
+        s->on_user_connect(user);
+        return user;
+    }
+    auto route(const bot::mes_ptr& mes) { return p_process_cmd(mes); }
+};
+
+class bench_game: public poker::game_poker {
+public:
+    using poker::game_poker::game_poker;
+    auto render() const { return p_render_game_state(); }
+};
+
+void bench_deck(bench::suite& suite) {
+    poker::deck d;
+    d.seed(seed);
+    suite.run("deck::refill", 100, [&](auto) { d.refill(); });
+    suite.run("deck::shuffle", 100, [&](auto) { d.shuffle(); });
+    suite.run(
+        "deck::get_card", 52,
+        [&] {
+            d.refill();
+            d.shuffle();
+        },
+        [&](auto) { bench::do_not_optimize(d.get_card()); });
+}
+
+void bench_bank(bench::suite& suite) {
+    const std::size_t batch = 100, count = 10;
+    poker::bank b;
+    suite.run(
+        "bank::get_coins(10)", batch, [&] { b = poker::bank(batch * count); },
+        [&](auto) { bench::do_not_optimize(b.get_coins(count)); });
+
+    std::vector<poker::bank::coins_t> chunks;
+    suite.run(
+        "bank::add_coins(10)", batch,
+        [&] {
+            b = poker::bank();
+            chunks.clear();
+            for(std::size_t i = 0; i < batch; i++) {
+                chunks.emplace_back(std::move(poker::bank(count).coins()));
+            }
+        },
+        [&](auto i) { b.add_coins(chunks[i]); });
+}
+
+void bench_ranking(bench::suite& suite) {
+    const std::size_t hands_count = 1000;
+    poker::deck d;
+    d.seed(seed);
+    std::vector<std::vector<poker::card>> hands;
+    for(std::size_t i = 0; i < hands_count; i++) {
+        d.refill();
+        d.shuffle();
+        auto& hand = hands.emplace_back();
+        for(int j = 0; j < 5; j++) {
+            hand.emplace_back(d.get_card());
+        }
+    }
+    suite.run("ranking_string", hands_count, [&](auto i) { bench::do_not_optimize(poker::ranking_string(hands[i])); });
+}
+
+void bench_server_lookups(bench::suite& suite) {
+    const std::size_t users_count = 10000, rooms_count = 1000, batch = 1000;
+    bench_server s;
+    std::vector<std::string> tokens;
+    for(std::size_t i = 0; i < users_count; i++) {
+        auto user = s.add_user(i + 1);
+        if(i < rooms_count) {
+            tokens.emplace_back(s.create_room(user)->token());
+        }
+    }
+    std::mt19937 gen(seed);
+    std::vector<std::size_t> order(batch);
+    for(auto& i: order) {
+        i = gen();
+    }
+    suite.run("server::get_user", batch,
+              [&](auto i) { bench::do_not_optimize(s.get_user(order[i] % users_count + 1)); });
+    suite.run("server::get_room", batch,
+              [&](auto i) { bench::do_not_optimize(s.get_room(tokens[order[i] % rooms_count])); });
+}
+
+void bench_routing(bench::suite& suite) {
+    const std::int64_t id = 1;
+    bench_bot b;
+    b.add_user(id);
+
+    const std::vector<std::string> texts {"/list", "/join abcdefgh", "/poker_bet 10", "/stats", "/unsub", "/kick qwerty"};
+    std::vector<bot::mes_ptr> messages;
+    for(auto& text: texts) {
+        auto mes             = std::make_shared<TgBot::Message>();
+        mes->chat            = std::make_shared<TgBot::Chat>();
+        mes->chat->id        = id;
+        mes->chat->firstName = "bench";
+        mes->text            = text;
+        messages.emplace_back(std::move(mes));
+    }
+    suite.run("room_bot::p_process_cmd", 600,
+              [&](auto i) { bench::do_not_optimize(b.route(messages[i % messages.size()])); });
+}
+
+void bench_render(bench::suite& suite) {
+    const std::size_t players_count = 6;
+    std::vector<bot::user_ptr> users;
+    for(std::size_t i = 0; i < players_count; i++) {
+        auto user    = bot::make_entity<bot::user>(i + 1);
+        user->name() = "bench" + std::to_string(i);
+        users.emplace_back(user);
+    }
+    {
+        bench_game game(users, 10);
+        game.cards().seed(seed);
+        game.init_game();
+        suite.run("game_poker::p_render_game_state", 100, [&](auto) { bench::do_not_optimize(game.render()); });
+    }
+    for(auto& user: users) {
+        bot::destroy_entity(user);
+    }
+}
+
+void bench_timers(bench::suite& suite) {
+    const std::size_t pending = 200000, batch = 1000;
+    using wheel_t = bot::timing_wheel<std::size_t>;
+    auto start    = wheel_t::clock::now();
+    wheel_t wheel(std::chrono::milliseconds(100), start);
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> turn(1, 120000);
+    for(std::size_t i = 0; i < pending; i++) {
+        wheel.schedule(start + std::chrono::milliseconds(turn(gen)), i);
+    }
+    suite.run("timing_wheel::schedule+cancel", batch, [&](auto i) {
+        auto h = wheel.schedule(start + std::chrono::milliseconds(turn(gen)), i);
+        bench::do_not_optimize(wheel.cancel(h));
+    });
+}
+
+void bench_icm(bench::suite& suite) {
+    std::vector<std::size_t> final_table, bubble;
+    for(std::size_t i = 0; i < 9; i++) {
+        final_table.emplace_back(1000 + i * 731);
+    }
+    for(std::size_t i = 0; i < 50; i++) {
+        bubble.emplace_back(500 + i * 97);
+    }
+    const std::vector<double> payouts {30, 20, 14, 10, 8, 6, 5, 4, 3};
+    std::mt19937 gen(seed);
+    suite.run("icm::exact 9 players", 1,
+              [&](auto) { bench::do_not_optimize(poker::icm::exact(final_table, payouts)); });
+    suite.run("icm::monte_carlo 50 players 1ms", 1, [&](auto) {
+        bench::do_not_optimize(poker::icm::monte_carlo(bubble, payouts, std::chrono::milliseconds(1), gen));
+    });
+}
+
+void bench_history(bench::suite& suite) {
+    const std::size_t batch = 1000;
+    bot::history_limits limits;
+    bot::message_history history;
+    std::vector<std::string> texts;
+    for(std::size_t i = 0; i < 64; i++) {
+        texts.emplace_back("user" + std::to_string(i) + ":" + std::string(20 + i * 3, 'a' + i % 26));
+    }
+    for(auto& t: texts) {
+        history.push(t, limits);
+    }
+    suite.run("message_history::push", batch,
+              [&](auto i) { history.push(texts[i % texts.size()], limits); });
+    suite.run("message_history::last 20", 1, [&](auto) { bench::do_not_optimize(history.last(20, 4096)); });
+}
+
+int main(int argc, char** argv) {
+    auto lgr = initialization_logger();
+    lgr.set_level(logger::level::warn);
+
+    std::string out_path    = argc > 1 ? argv[1] : "";
+    std::size_t repetitions = argc > 2 ? std::stoul(argv[2]) : 200;
+    bench::suite suite(repetitions / 10, repetitions, seed);
+
+    bench_deck(suite);
+    bench_bank(suite);
+    bench_ranking(suite);
+    bench_server_lookups(suite);
+    bench_routing(suite);
+    bench_render(suite);
+    bench_timers(suite);
+    bench_icm(suite);
+    bench_history(suite);
+
+    if(out_path.empty()) {
+        std::cout << suite.to_json();
+    } else {
+        std::ofstream(out_path) << suite.to_json();
+    }
+    return 0;
+}
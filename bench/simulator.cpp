@@ -0,0 +1,197 @@
+/**
+ * Headless table simulator: plays scripted hands through game_poker on all cores,
+ * checks chip conservation after every action and reports hands per second. \n
+ * With --entrants every thread plays whole multi-table tournaments instead of cash tables. \n
+ * Exits with non-zero code if any violation was found, so it can be used as a regression gate.
+ * Global operator new is replaced to count allocations of betting actions, with --check-allocs
+ * any allocation in a steady-state betting round is a violation too.
+ * */
+#include "components/logger.hpp"
+#include "core/lazy_utils.h"
+#include "poker/simulator.h"
+
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <thread>
+
+namespace po = boost::program_options;
+
+static thread_local std::size_t allocations = 0;
+
+//operator delete frees memory of the operator new below, gcc sees only the standard pairing once they're inlined
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void* operator new(std::size_t size) {
+    allocations++;
+    if(auto ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+void* operator new(std::size_t size, std::align_val_t align) {
+    allocations++;
+    auto alignment = static_cast<std::size_t>(align);
+    if(auto ptr = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+int main(int argc, char** argv) {
+    po::options_description desc("Allowed options");
+    desc.add_options()("help", "produce help message");
+    desc.add_options()("threads", po::value<std::size_t>()->default_value(std::thread::hardware_concurrency()),
+                       "worker threads, each runs its own tables");
+    desc.add_options()("tables", po::value<std::size_t>()->default_value(8), "tables per thread");
+    desc.add_options()("hands", po::value<std::size_t>()->default_value(10000), "hands per table");
+    desc.add_options()("seats", po::value<std::size_t>()->default_value(6), "players per table");
+    desc.add_options()("strategy", po::value<std::string>()->default_value("mixed"),
+                       "call|random|equity|mixed, mixed seats them in turn");
+    desc.add_options()("seed", po::value<std::uint32_t>()->default_value(42), "seed of the first table");
+    desc.add_options()("entrants", po::value<std::size_t>()->default_value(0),
+                       "entrants of a tournament, 0 plays cash tables, seats are seats per tournament table");
+    desc.add_options()("tournaments", po::value<std::size_t>()->default_value(1), "tournaments per thread");
+    desc.add_options()("check-allocs", "fail if steady-state betting actions allocate from the global heap");
+    desc.add_options()("hand-history", po::value<std::string>(),
+                       "directory to write hands of cash tables to, every thread writes its own files");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+    if(vm.count("help")) {
+        std::cout << desc << "\n";
+        return 0;
+    }
+    auto threads  = std::max<std::size_t>(vm["threads"].as<std::size_t>(), 1);
+    auto tables   = vm["tables"].as<std::size_t>();
+    auto hands    = vm["hands"].as<std::size_t>();
+    auto seats    = vm["seats"].as<std::size_t>();
+    auto strategy = vm["strategy"].as<std::string>();
+    auto seed     = vm["seed"].as<std::uint32_t>();
+    auto entrants = vm["entrants"].as<std::size_t>();
+
+    auto lgr = initialization_logger();
+    lgr.set_level(logger::level::warn);
+
+    const std::vector<std::string> mixed {"call", "random", "equity"};
+    auto make_strategies = [&](std::size_t count) {
+        std::vector<std::unique_ptr<poker::sim::strategy>> result;
+        for(std::size_t i = 0; i < count; i++) {
+            result.emplace_back(poker::sim::make_strategy(strategy == "mixed" ? mixed[i % mixed.size()] : strategy));
+        }
+        return result;
+    };
+    make_strategies(1); //validates strategy name before spawning threads
+    poker::sim::allocations = [] { return allocations; };
+
+    poker::sim::stats total;
+    std::mutex total_mutex;
+    auto worker = [&](std::size_t thread_index) {
+        poker::sim::stats local;
+        std::unique_ptr<poker::hand_history::writer> writer;
+        if(vm.count("hand-history")) {
+            poker::hand_history::writer_config conf;
+            conf.dir  = vm["hand-history"].as<std::string>();
+            conf.name = fmt::format("sim{}", thread_index);
+            writer    = std::make_unique<poker::hand_history::writer>(conf);
+        }
+        std::vector<std::unique_ptr<poker::sim::table>> local_tables;
+        for(std::size_t i = 0; i < tables; i++) {
+            auto id = thread_index * tables + i;
+            local_tables.emplace_back(std::make_unique<poker::sim::table>(id, make_strategies(seats), seed + id));
+            local_tables.back()->set_hand_history(writer.get());
+        }
+        for(std::size_t h = 0; h < hands; h++) {
+            for(auto& t: local_tables) {
+                try {
+                    t->play_hand();
+                } catch(const std::exception& e) {
+                    local.violations++;
+                    lgr.error("simulator thread {} exception: {}", thread_index, e.what());
+                }
+            }
+        }
+        for(auto& t: local_tables) {
+            local += t->get_stats();
+        }
+        local_tables.clear(); //tables' entities belong to this thread
+        std::lock_guard lock(total_mutex);
+        total += local;
+    };
+
+    auto tournament_worker = [&](std::size_t thread_index) {
+        poker::sim::stats local;
+        poker::tournament_config conf;
+        conf.seats = seats;
+        for(std::size_t i = 0; i < vm["tournaments"].as<std::size_t>(); i++) {
+            auto id = thread_index * vm["tournaments"].as<std::size_t>() + i;
+            try {
+                poker::sim::tournament_run run(id, make_strategies(entrants), conf, seed + id);
+                run.play();
+                local += run.get_stats();
+            } catch(const std::exception& e) {
+                local.violations++;
+                lgr.error("simulator thread {} exception: {}", thread_index, e.what());
+            }
+        }
+        std::lock_guard lock(total_mutex);
+        total += local;
+    };
+
+    auto time = bot::utils::measure<std::chrono::duration<double>>([&] {
+        std::vector<std::thread> pool;
+        for(std::size_t i = 0; i < threads; i++) {
+            if(entrants) {
+                pool.emplace_back(tournament_worker, i);
+                continue;
+            }
+            pool.emplace_back(worker, i);
+        }
+        for(auto& t: pool) {
+            t.join();
+        }
+    });
+
+    if(entrants) {
+        std::cout << fmt::format("threads:{} tournaments:{} entrants:{} seats:{} strategy:{} seed:{}\n", threads,
+                                 total.tournaments, entrants, seats, strategy, seed);
+        std::cout << fmt::format("hands:{} actions:{} rejected:{} moves:{} broken tables:{} max spread:{}\n",
+                                 total.hands, total.actions, total.rejected, total.moves, total.broken, total.spread);
+        std::cout << fmt::format("violations:{} time:{:.3f}s hands/sec:{:.0f}\n", total.violations, time.count(),
+                                 total.hands / time.count());
+        return total.violations ? 1 : 0;
+    }
+    std::cout << fmt::format("threads:{} tables:{} seats:{} strategy:{} seed:{}\n", threads, threads * tables, seats,
+                             strategy, seed);
+    std::cout << fmt::format("hands:{} actions:{} rejected:{} messages:{} restarts:{} violations:{}\n", total.hands,
+                             total.actions, total.rejected, total.messages, total.restarts, total.violations);
+    std::cout << fmt::format("steady actions:{} allocations:{}\n", total.steady, total.steady_allocs);
+    std::cout << fmt::format("memory per table:{}B\n", total.memory / std::max<std::size_t>(threads * tables, 1));
+    std::cout << fmt::format("time:{:.3f}s hands/sec:{:.0f}\n", time.count(), total.hands / time.count());
+    if(vm.count("check-allocs") && total.steady_allocs) {
+        std::cout << "steady-state betting rounds allocate from the global heap\n";
+        return 1;
+    }
+    return total.violations ? 1 : 0;
+}
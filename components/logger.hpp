@@ -1,5 +1,13 @@
 #pragma once
 
+/// Minimal level that is compiled in, calls below it are removed entirely.
+/// Set by cmake per build type, everything is compiled in by default.
+#ifndef SPDLOG_ACTIVE_LEVEL
+    #define SPDLOG_ACTIVE_LEVEL 0 // SPDLOG_LEVEL_TRACE
+#endif
+
+#include "core/alloc_profile.h"
+
 #include <boost/process/environment.hpp>
 #include <chrono>
 #include <iostream>
@@ -51,7 +59,9 @@ public:
 
     template<typename MSGBuilder>
     auto trace(MSGBuilder&& msg_builder) noexcept -> void {
-        logger_->trace(std::forward<MSGBuilder>(msg_builder));
+        if constexpr(SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_TRACE) {
+            logger_->trace(std::forward<MSGBuilder>(msg_builder));
+        }
     }
 
     template<typename MSGBuilder>
@@ -71,7 +81,9 @@ public:
 
     template<typename MSGBuilder>
     auto debug(MSGBuilder&& msg_builder) noexcept -> void {
-        logger_->debug(std::forward<MSGBuilder>(msg_builder));
+        if constexpr(SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_DEBUG) {
+            logger_->debug(std::forward<MSGBuilder>(msg_builder));
+        }
     }
 
     template<typename MSGBuilder>
@@ -81,43 +93,93 @@ public:
 
     template<typename S, typename... Args>
     auto trace(const S& format_str, Args&&... args) -> void {
-        logger_->trace(fmt::format(format_str, std::forward<Args>(args)...));
+        if constexpr(SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_TRACE) {
+            log_fmt(spdlog::level::trace, format_str, std::forward<Args>(args)...);
+        }
     }
 
     template<typename S, typename... Args>
     auto info(const S& format_str, Args&&... args) -> void {
-        logger_->info(fmt::format(format_str, std::forward<Args>(args)...));
+        if constexpr(SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_INFO) {
+            log_fmt(spdlog::level::info, format_str, std::forward<Args>(args)...);
+        }
     }
 
     template<typename S, typename... Args>
     auto debug(const S& format_str, Args&&... args) -> void {
-        logger_->debug(fmt::format(format_str, std::forward<Args>(args)...));
+        if constexpr(SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_DEBUG) {
+            log_fmt(spdlog::level::debug, format_str, std::forward<Args>(args)...);
+        }
     }
 
     template<typename S, typename... Args>
     auto warn(const S& format_str, Args&&... args) -> void {
-        logger_->warn(fmt::format(format_str, std::forward<Args>(args)...));
+        if constexpr(SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_WARN) {
+            log_fmt(spdlog::level::warn, format_str, std::forward<Args>(args)...);
+        }
     }
 
     template<typename S, typename... Args>
     auto error(const S& format_str, Args&&... args) -> void {
-        logger_->error(fmt::format(format_str, std::forward<Args>(args)...));
+        if constexpr(SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_ERROR) {
+            log_fmt(spdlog::level::err, format_str, std::forward<Args>(args)...);
+        }
     }
 
     template<typename S, typename... Args>
     auto critical(const S& format_str, Args&&... args) -> void {
-        logger_->critical(fmt::format(format_str, std::forward<Args>(args)...));
+        if constexpr(SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_CRITICAL) {
+            log_fmt(spdlog::level::critical, format_str, std::forward<Args>(args)...);
+        }
+    }
+
+    /// Checks runtime level first, then formats straight into spdlog's buffer.
+    template<typename S, typename... Args>
+    auto log_fmt(spdlog::level::level_enum lvl, const S& format_str, Args&&... args) -> void {
+        if(!logger_->should_log(lvl)) {
+            return;
+        }
+        bot::alloc::scope alloc_scope(bot::alloc::tag::logging);
+#if FMT_VERSION >= 80000
+        logger_->log(lvl, fmt::runtime(format_str), std::forward<Args>(args)...);
+#else
+        logger_->log(lvl, format_str, std::forward<Args>(args)...);
+#endif
     }
 
+    auto should_log(level l) const -> bool { return logger_->should_log(static_cast<spdlog::level::level_enum>(l)); }
+
 private:
     std::shared_ptr<spdlog::logger> logger_;
     level lvl_ = level::info;
 };
 
+/// Logging pipeline settings, filled from command line options in main.cpp
+struct logger_config {
+    enum class overflow { block, overrun_oldest };
+
+    std::string prefix         = "logs/";         ///< directory for log files, with trailing slash
+    bool async                 = false;           ///< write logs from a dedicated thread pool
+    std::size_t queue_size     = 8192;            ///< async queue size, in messages
+    std::size_t threads        = 1;               ///< async thread pool size
+    overflow overflow_policy   = overflow::block; ///< what to do when async queue is full
+    std::size_t file_max_size  = 0;               ///< rotate log file after that many bytes, 0 - never rotate
+    std::size_t file_max_count = 3;               ///< amount of rotated files to keep
+};
+
+/// Operational counters of the logging pipeline
+struct logger_stats {
+    bool async                 = false;
+    std::size_t queue_capacity = 0; ///< async queue size, in messages
+    std::size_t dropped        = 0; ///< messages discarded by overrun_oldest policy
+};
+
 auto get_logger(const std::string&) -> logger;
 auto get_logger() -> logger;
+auto get_logger_stats() -> logger_stats;
 auto initialization_logger(std::shared_ptr<spdlog::logger>) -> void;
 auto initialization_logger(const std::string& prefix = "logs/") -> logger;
+auto initialization_logger(const logger_config& config) -> logger;
 
 logger::logger(std::shared_ptr<spdlog::async_logger> logger): logger_(std::move(logger)) { }
 
@@ -147,24 +209,62 @@ auto logger::get_internal_logger() -> std::shared_ptr<spdlog::logger>{
     return this->logger_;
 }
 
+namespace detail {
+inline logger_config logger_cfg; ///< config the default logger was created with
+} // namespace detail
+
 auto initialization_logger(const std::string& prefix) -> logger {
+    logger_config config;
+    config.prefix = prefix;
+    return initialization_logger(config);
+}
+
+auto initialization_logger(const logger_config& config) -> logger {
     //prefix == "logs/", no need for slash here
-    auto name = fmt::format(prefix + "{0}.txt", boost::this_process::get_id());
-    ///spdlog::init_thread_pool(8192, 1);
+    auto name        = fmt::format(config.prefix + "{0}.txt", boost::this_process::get_id());
     auto stdout_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
-    auto file_sink   = std::make_shared<spdlog::sinks::basic_file_sink_mt>(name, true);
+    spdlog::sink_ptr file_sink;
+    if(config.file_max_size) {
+        file_sink = std::make_shared<spdlog::sinks::rotating_file_sink_mt>(name, config.file_max_size,
+                                                                           config.file_max_count);
+    } else {
+        file_sink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(name, true);
+    }
     std::vector<spdlog::sink_ptr> sinks {stdout_sink, file_sink};
-    auto logger = std::make_shared<spdlog::logger>( ///async_logger
-        "default", sinks.begin(), sinks.end()       //,
-        /*spdlog::thread_pool(),*/
-        /*spdlog::async_overflow_policy::block*/);
 
-    spdlog::flush_every(std::chrono::seconds(1)); //todo: hack
+    std::shared_ptr<spdlog::logger> logger;
+    if(config.async) {
+        spdlog::init_thread_pool(config.queue_size, config.threads,
+                                 [] { bot::alloc::set_thread_tag(bot::alloc::tag::logging); });
+        auto policy = config.overflow_policy == logger_config::overflow::block ?
+                          spdlog::async_overflow_policy::block :
+                          spdlog::async_overflow_policy::overrun_oldest;
+        logger = std::make_shared<spdlog::async_logger>("default", sinks.begin(), sinks.end(), spdlog::thread_pool(),
+                                                        policy);
+    } else {
+        logger = std::make_shared<spdlog::logger>("default", sinks.begin(), sinks.end());
+    }
+    detail::logger_cfg = config;
+
+    logger->flush_on(spdlog::level::warn);
+    spdlog::flush_every(std::chrono::seconds(1)); //periodic flush of lower levels
     logger->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%n] [%l] [pid %P tid %t] %v");
     spdlog::set_default_logger(logger); /// spdlog::register_logger(logger);
     return logger;
 }
 
+auto get_logger_stats() -> logger_stats {
+    logger_stats stats;
+    stats.async = detail::logger_cfg.async;
+    if(stats.async) {
+        stats.queue_capacity = detail::logger_cfg.queue_size;
+        if(auto pool = spdlog::thread_pool()) {
+            stats.dropped = pool->overrun_counter();
+        }
+    }
+    return stats;
+}
+
 auto get_logger(const std::string& name) -> logger {
     return spdlog::get(name);
 }
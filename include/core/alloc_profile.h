@@ -0,0 +1,252 @@
+#pragma once
+/**
+ * Allocation profiling mode. \n
+ * With BOT_ALLOC_PROFILE defined (cmake -DALLOC_PROFILE=ON) global operator new/delete are replaced,
+ * every allocation is attributed to a subsystem tag set by alloc::scope of the calling thread.
+ * Without it scopes are empty and nothing is replaced, so the mode costs nothing when disabled. \n
+ * Replacement operators are defined right here, so with the macro this header must end up in a single
+ * translation unit of an executable, which is the case for all targets of this repo.
+ * */
+#include "core/metrics.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fmt/format.h>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace bot {
+namespace alloc {
+
+/**
+ * Subsystems allocations are attributed to.
+ * */
+enum class tag : std::uint8_t { other, routing, game, render, logging, network, count };
+
+constexpr std::size_t tags_count = static_cast<std::size_t>(tag::count); /**< Amount of real tags */
+
+/**
+ * Returns printable name of a tag.
+ * */
+constexpr auto tag_name(tag t) -> const char* {
+    constexpr const char* names[] = {"other", "routing", "game", "render", "logging", "network"};
+    return names[static_cast<std::size_t>(t)];
+}
+
+/**
+ * Counters of a single tag.
+ * */
+struct tag_stats {
+    tag t;                   /**< Subsystem */
+    std::uint64_t calls = 0; /**< Allocations made under the tag */
+    std::uint64_t bytes = 0; /**< Bytes requested under the tag */
+    std::uint64_t frees = 0; /**< Deallocations of memory allocated under the tag */
+    std::uint64_t live  = 0; /**< Bytes allocated under the tag and not freed yet */
+};
+
+#ifdef BOT_ALLOC_PROFILE
+constexpr bool enabled = true;
+
+namespace detail {
+/** Per-shard counters of a tag, see metrics::shard_index. */
+struct alignas(64) counters {
+    std::atomic<std::uint64_t> calls {0};
+    std::atomic<std::uint64_t> bytes {0};
+    std::atomic<std::uint64_t> frees {0};
+    std::atomic<std::uint64_t> freed {0};
+};
+inline std::array<std::array<counters, tags_count>, metrics::shards_count> shards;
+inline thread_local tag current = tag::other;
+
+/** Header placed before every block to attribute its deallocation. */
+struct header {
+    std::size_t size;
+    tag t;
+};
+constexpr std::size_t header_size = alignof(std::max_align_t);
+static_assert(sizeof(header) <= header_size);
+
+inline auto block_header(void* ptr) noexcept -> header* {
+    return reinterpret_cast<header*>(static_cast<std::byte*>(ptr) - header_size);
+}
+
+/**
+ * Allocates a block with a header and records it.
+ * @param size requested size.
+ * @param align alignment of the block, header takes at least that much.
+ * @returns pointer to the user's part or nullptr.
+ * */
+inline auto allocate(std::size_t size, std::size_t align) noexcept -> void* {
+    auto offset = std::max(header_size, align);
+    auto total  = (offset + size + align - 1) / align * align;
+    auto raw    = align > header_size ? std::aligned_alloc(align, total) : std::malloc(total);
+    if(!raw) {
+        return nullptr;
+    }
+    auto ptr = static_cast<std::byte*>(raw) + offset;
+    auto t   = current;
+    *block_header(ptr) = header {size, t};
+    auto& c = shards[metrics::shard_index()][static_cast<std::size_t>(t)];
+    c.calls.fetch_add(1, std::memory_order_relaxed);
+    c.bytes.fetch_add(size, std::memory_order_relaxed);
+    return ptr;
+}
+
+/**
+ * Records deallocation of a block and frees it.
+ * @param ptr pointer returned by allocate.
+ * @param align alignment the block was allocated with.
+ * */
+inline void deallocate(void* ptr, std::size_t align) noexcept {
+    if(!ptr) {
+        return;
+    }
+    auto h  = *block_header(ptr);
+    auto& c = shards[metrics::shard_index()][static_cast<std::size_t>(h.t)];
+    c.frees.fetch_add(1, std::memory_order_relaxed);
+    c.freed.fetch_add(h.size, std::memory_order_relaxed);
+    std::free(static_cast<std::byte*>(ptr) - std::max(header_size, align));
+}
+
+inline auto allocate_or_throw(std::size_t size, std::size_t align) -> void* {
+    if(auto ptr = allocate(size, align)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+} // namespace detail
+
+/**
+ * RAII scope attributing allocations of the calling thread to a subsystem, restores previous tag on exit.
+ * */
+class scope {
+public:
+    explicit scope(tag t) noexcept: m_prev(detail::current) { detail::current = t; }
+    ~scope() { detail::current = m_prev; }
+    scope(const scope&) = delete;
+    scope& operator=(const scope&) = delete;
+
+protected:
+    tag m_prev; /**< Tag to restore */
+};
+
+/**
+ * Attributes all further allocations of the calling thread to a subsystem, e.g. for logging threads.
+ * */
+inline void set_thread_tag(tag t) noexcept {
+    detail::current = t;
+}
+
+/**
+ * Merges all shards.
+ * @returns counters of every tag, ordered by requested bytes, biggest first.
+ * */
+inline auto snapshot() -> std::vector<tag_stats> {
+    std::vector<tag_stats> result;
+    for(std::size_t i = 0; i < tags_count; i++) {
+        tag_stats s {static_cast<tag>(i)};
+        std::uint64_t freed = 0;
+        for(auto& shard: detail::shards) {
+            s.calls += shard[i].calls.load(std::memory_order_relaxed);
+            s.bytes += shard[i].bytes.load(std::memory_order_relaxed);
+            s.frees += shard[i].frees.load(std::memory_order_relaxed);
+            freed += shard[i].freed.load(std::memory_order_relaxed);
+        }
+        s.live = s.bytes > freed ? s.bytes - freed : 0;
+        result.emplace_back(s);
+    }
+    std::sort(result.begin(), result.end(), [](auto& lhs, auto& rhs) { return lhs.bytes > rhs.bytes; });
+    return result;
+}
+#else
+constexpr bool enabled = false;
+
+class scope {
+public:
+    explicit scope(tag) noexcept { }
+    scope(const scope&) = delete;
+    scope& operator=(const scope&) = delete;
+};
+
+inline void set_thread_tag(tag) noexcept { }
+
+inline auto snapshot() -> std::vector<tag_stats> {
+    return {};
+}
+#endif
+
+/**
+ * Renders top allocating subsystems, one per line.
+ * @param top maximal amount of lines.
+ * @returns report, empty if profiling is compiled out.
+ * */
+inline auto report(std::size_t top = tags_count) -> std::string {
+    std::string result;
+    for(auto& s: snapshot()) {
+        if(top-- == 0 || s.calls == 0) {
+            break;
+        }
+        result += fmt::format("alloc {}: {} calls, {} bytes, {} frees, {} live bytes\n", tag_name(s.t), s.calls,
+                              s.bytes, s.frees, s.live);
+    }
+    return result;
+}
+
+} // namespace alloc
+} // namespace bot
+
+#ifdef BOT_ALLOC_PROFILE
+void* operator new(std::size_t size) {
+    return bot::alloc::detail::allocate_or_throw(size, bot::alloc::detail::header_size);
+}
+void* operator new[](std::size_t size) {
+    return bot::alloc::detail::allocate_or_throw(size, bot::alloc::detail::header_size);
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return bot::alloc::detail::allocate(size, bot::alloc::detail::header_size);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return bot::alloc::detail::allocate(size, bot::alloc::detail::header_size);
+}
+void* operator new(std::size_t size, std::align_val_t align) {
+    return bot::alloc::detail::allocate_or_throw(size, static_cast<std::size_t>(align));
+}
+void* operator new[](std::size_t size, std::align_val_t align) {
+    return bot::alloc::detail::allocate_or_throw(size, static_cast<std::size_t>(align));
+}
+void operator delete(void* ptr) noexcept {
+    bot::alloc::detail::deallocate(ptr, bot::alloc::detail::header_size);
+}
+void operator delete[](void* ptr) noexcept {
+    bot::alloc::detail::deallocate(ptr, bot::alloc::detail::header_size);
+}
+void operator delete(void* ptr, std::size_t) noexcept {
+    bot::alloc::detail::deallocate(ptr, bot::alloc::detail::header_size);
+}
+void operator delete[](void* ptr, std::size_t) noexcept {
+    bot::alloc::detail::deallocate(ptr, bot::alloc::detail::header_size);
+}
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    bot::alloc::detail::deallocate(ptr, bot::alloc::detail::header_size);
+}
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    bot::alloc::detail::deallocate(ptr, bot::alloc::detail::header_size);
+}
+void operator delete(void* ptr, std::align_val_t align) noexcept {
+    bot::alloc::detail::deallocate(ptr, static_cast<std::size_t>(align));
+}
+void operator delete[](void* ptr, std::align_val_t align) noexcept {
+    bot::alloc::detail::deallocate(ptr, static_cast<std::size_t>(align));
+}
+void operator delete(void* ptr, std::size_t, std::align_val_t align) noexcept {
+    bot::alloc::detail::deallocate(ptr, static_cast<std::size_t>(align));
+}
+void operator delete[](void* ptr, std::size_t, std::align_val_t align) noexcept {
+    bot::alloc::detail::deallocate(ptr, static_cast<std::size_t>(align));
+}
+#endif
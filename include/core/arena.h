@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+namespace bot {
+
+/**
+ * Monotonic arena for data with a common lifetime, e.g. a poker hand. \n
+ * Allocation is a pointer bump, deallocation is a no-op and reset() frees everything at once.
+ * If a cycle didn't fit into the buffer, the buffer grows on the next reset, so in a steady state
+ * the arena doesn't touch the heap at all.
+ * */
+class arena: public std::pmr::memory_resource {
+public:
+    /**
+     * Constructor.
+     * @param initial_size size of the buffer in bytes.
+     * */
+    arena(std::size_t initial_size = 16 * 1024);
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    /**
+     * Frees everything allocated since the last reset and grows the buffer if it overflowed. \n
+     * Containers that use the arena must be emptied before, their old memory becomes invalid.
+     * */
+    void reset();
+    /**
+     * Returns size of the buffer in bytes.
+     * */
+    auto capacity() const -> std::size_t { return m_buffer.size(); }
+    /**
+     * Returns amount of resets that had to grow the buffer.
+     * */
+    auto overflows() const -> std::size_t { return m_overflows; }
+    /**
+     * Returns bytes occupied by the arena: the buffer and memory taken from the heap since last reset.
+     * */
+    auto memory_usage() const -> std::size_t { return sizeof(arena) + m_buffer.size() + m_upstream.bytes; }
+
+protected:
+    /**
+     * Heap resource that remembers how much the arena took from it since last reset.
+     * */
+    class upstream: public std::pmr::memory_resource {
+    public:
+        std::size_t bytes = 0; /**< Bytes allocated since last reset */
+
+    protected:
+        void* do_allocate(std::size_t size, std::size_t align) override {
+            bytes += size;
+            return std::pmr::new_delete_resource()->allocate(size, align);
+        }
+        void do_deallocate(void* p, std::size_t size, std::size_t align) override {
+            std::pmr::new_delete_resource()->deallocate(p, size, align);
+        }
+        bool do_is_equal(const memory_resource& rhs) const noexcept override { return this == &rhs; }
+    };
+
+    std::vector<std::byte> m_buffer;                             /**< Initial buffer of the monotonic resource */
+    upstream m_upstream;                                         /**< Source of memory when buffer is exhausted */
+    std::optional<std::pmr::monotonic_buffer_resource> m_memory; /**< Current cycle's resource */
+    std::size_t m_overflows = 0;                                 /**< Resets that grew the buffer */
+
+    void* do_allocate(std::size_t size, std::size_t align) override { return m_memory->allocate(size, align); }
+    void do_deallocate(void*, std::size_t, std::size_t) override { }
+    bool do_is_equal(const memory_resource& rhs) const noexcept override { return this == &rhs; }
+};
+
+arena::arena(std::size_t initial_size): m_buffer(initial_size) {
+    m_memory.emplace(m_buffer.data(), m_buffer.size(), &m_upstream);
+}
+
+void arena::reset() {
+    m_memory.reset();
+    if(m_upstream.bytes) {
+        m_buffer.resize(std::max(m_buffer.size() * 2, m_buffer.size() + m_upstream.bytes));
+        m_upstream.bytes = 0;
+        m_overflows++;
+    }
+    m_memory.emplace(m_buffer.data(), m_buffer.size(), &m_upstream);
+}
+
+} // namespace bot
@@ -1,19 +1,29 @@
 #pragma once
 #include "components/logger.hpp"
+#include "core/alloc_profile.h"
+#include "core/bounded_queue.h"
 #include "core/command.h"
 #include "core/datatypes.h"
+#include "core/http_pool.h"
 #include "core/logging_obj.h"
+#include "core/metrics.h"
+#include "core/outbox.h"
 #include "core/room.h"
 #include "core/server.h"
+#include "core/snapshot.h"
+#include "core/tracing.h"
+#include "core/update_log.h"
 #include "core/user.h"
 #include "core/utils.h"
 
 #include <algorithm>
+#include <atomic>
 #include <fmt/ranges.h>
 #include <memory>
 #include <optional>
 #include <string>
 #include <tgbot/tgbot.h>
+#include <thread>
 #include <tuple>
 #include <utility>
 #include <vector>
@@ -24,9 +34,30 @@ namespace bot {
  * */
 class room_bot: public logging_obj {
 protected:
-    TgBot::Bot m_bot;          /**< Object to interact with Tg's api */
-    std::unique_ptr<server> s; /**< Server ptr */
-    const TgBot::Api& api;     /**< Reference to the api, just for convenient access from within the class */
+    std::unique_ptr<http_pool> m_http; /**< Keep-alive connections of the api, outlives m_bot that refers to it */
+    TgBot::Bot m_bot;                  /**< Object to interact with Tg's api */
+    std::unique_ptr<server> s;         /**< Server ptr */
+    const TgBot::Api& api;             /**< Reference to the api, just for convenient access from within the class */
+    std::atomic<bool> m_stop {false};  /**< Flag to finish start() */
+
+    static constexpr std::int32_t long_poll_timeout = 10;   /**< getUpdates timeout in seconds */
+    static constexpr std::size_t update_queue_size  = 1000; /**< Most received updates waiting to be handled */
+    static constexpr std::size_t broadcast_parallel = 8;    /**< Most messages of a broadcast in flight */
+
+    /**
+     * Update taken by the ingest thread.
+     * */
+    struct received_update {
+        TgBot::Update::Ptr update;                  /**< Update */
+        std::chrono::steady_clock::time_point time; /**< Time getUpdates returned it */
+    };
+
+    std::unique_ptr<snapshot::writer> m_snapshots; /**< Background writer of snapshots, null if disabled */
+    std::chrono::seconds m_snapshot_interval {0};  /**< Interval between snapshots */
+    std::unique_ptr<update_log> m_update_log;      /**< Journal of applied updates, null if disabled */
+    std::int32_t m_applied_offset = 0;             /**< Offset past the last update in server's state, 0 if unknown */
+    mutable outbox m_outbox;                       /**< Paces messages and defers rate limited ones */
+    std::vector<identifyable::id_t> m_admins;      /**< Users allowed to use admin commands */
 
     /**
      * Function to react to start command \n
@@ -77,6 +108,12 @@ protected:
      * @param mes ptr to message from user
      * */
     void p_on_room_list_request(mes_ptr mes);
+    /**
+     * Function to react to history request \n
+     * Sends last n relayed messages of request sender's current room as one message, all kept ones if n is omitted.
+     * @param mes ptr to message from user
+     * */
+    void p_on_room_history_request(mes_ptr mes);
     /**
      * Function to react to room sunscribe request \n
      * Subscribes request sender to their current room's messages. User will recieve other users' messages.
@@ -127,6 +164,17 @@ protected:
      * @param mes ptr to message from user
      * */
     void p_on_room_kick_request(mes_ptr mes);
+    /**
+     * Function to react to stats request \n
+     * Sends operational stats of the bot to the request sender, admins only.
+     * @param mes ptr to message from user
+     * */
+    void p_on_stats_request(mes_ptr mes);
+    /**
+     * Renders operational stats, derived bots may append their own.
+     * @returns stats, one per line
+     * */
+    virtual auto p_render_stats() const -> std::string;
 
     std::vector<command>
         m_commands; /**< Commands storage. Useful to distinct command from regular message and to process it correctly */
@@ -139,36 +187,160 @@ protected:
      * */
     auto p_process_cmd(const mes_ptr& mes) -> std::tuple<user_ptr, std::optional<command>>;
 
-    bool p_check_user(const user_ptr& user, const std::string& prefix);
+    template<class Prefix>
+    bool p_check_user(const user_ptr& user, const Prefix& prefix);
+
+    /**
+     * Calls TgBot::Api::sendMessage, every outbound message goes through here. \n
+     * Counts sent and failed messages and records send latency, thread-safe.
+     * @param chat_id id of a chat.
+     * @param text text of a message.
+     * @param args rest of TgBot::Api::sendMessage arguments.
+     * @returns sent message.
+     * */
+    template<class... Args>
+    auto p_api_send(std::int64_t chat_id, const std::string& text, const Args&... args) const -> mes_ptr;
+    /**
+     * Sends message to a chat through the outbox, which defers it if the chat is rate limited.
+     * @param chat_id id of a chat.
+     * @param text text of a message.
+     * @param args rest of TgBot::Api::sendMessage arguments.
+     * @returns sent message, nullptr if it was deferred.
+     * */
+    template<class... Args>
+    auto p_send_message(std::int64_t chat_id, const std::string& text, Args&&... args) const -> mes_ptr;
+    /**
+     * Sends message to every user of a room but the sender and users that unsubscribed from the room,
+     * to nobody if the sender is muted. Messages are sent concurrently, see outbox::send_many.
+     * @param room room to broadcast to.
+     * @param text text of a message.
+     * @param sender user the message comes from, may be null.
+     * @returns amount of recipients.
+     * */
+    auto p_broadcast(const room_ptr& room, const std::string& text, const user_ptr& sender) const -> std::size_t;
+    /**
+     * Sends the same message to many chats concurrently, the text is shared by all of them.
+     * @param chat_ids ids of chats.
+     * @param text text of a message.
+     * */
+    void p_send_many(const std::vector<std::int64_t>& chat_ids, const std::string& text) const;
+    /**
+     * Registers commands from m_commands in TG API events. \n
+     * Every command handler is wrapped to record it's latency.
+     * */
+    void p_register_commands();
+    /**
+     * Wakes up sender's current room if it's hibernated, called before every handler.
+     * @param mes ptr to message from user
+     * */
+    void p_touch_room(const mes_ptr& mes);
+    /**
+     * Copies server's state on the handling thread and hands it over to the snapshot writer.
+     * */
+    void p_save_snapshot();
+    /**
+     * Ingest loop: keeps a getUpdates request in flight and queues received updates, confirming them
+     * with the next request's offset right away, so up to update_queue_size of them are lost if the process dies.
+     * The last batch is confirmed by start() once it's handled. Runs until stop() and closes the queue then.
+     * @param queue queue of the handling thread, blocks ingest when it's full.
+     * @param offset offset of the first getUpdates.
+     * */
+    void p_ingest(bounded_queue<received_update>& queue, std::int32_t offset);
+    /**
+     * Called after server's state was loaded from a snapshot, derived bots may notify restored users.
+     * */
+    virtual void p_on_snapshot_loaded() { }
+    /**
+     * Called on the handling thread after every batch of updates and when waiting for updates times out,
+     * derived bots may handle their own events here, e.g. expired timers.
+     * */
+    virtual void p_on_poll() { }
+    /**
+     * Called after a user left a room by any command, before the room is closed if it's left empty,
+     * derived bots may handle what the leave changed in the room's game.
+     * @param room room the user left.
+     * */
+    virtual void p_on_user_left([[maybe_unused]] const room_ptr& room) { }
+    /**
+     * Returns how long the handling thread waits for updates before calling p_on_poll anyway, in seconds.
+     * Derived bots with pending timers may ask for shorter waits.
+     * */
+    virtual auto p_poll_timeout() const -> std::int32_t { return 10; }
 
 public:
     /**
      * Room bot's constructor \n
      * Inits TG API and default room-related commands.
      * @param token TG API token
+     * @param http settings of api's connection pool
+     * */
+    room_bot(const std::string& token, const http_pool_config& http = {});
+    /**
+     * Destructor, waits for the last snapshot to be written.
+     * */
+    virtual ~room_bot() = default;
+
+    /**
+     * Loads server's state from a snapshot if it exists and enables periodic snapshots to the same file. \n
+     * Snapshots are copied by start() between updates and written by a background thread,
+     * the last one is taken when start() returns.
+     * @param path path of a snapshot.
+     * @param interval interval between snapshots.
+     * */
+    void enable_snapshots(const std::string& path, std::chrono::seconds interval);
+    /**
+     * Enables hibernation of games in rooms that got no messages for a given period,
+     * has to be called before enable_snapshots to track rooms loaded from a snapshot.
+     * @param dir directory for records of hibernated games.
+     * @param idle period of inactivity.
      * */
-    room_bot(const std::string& token);
+    void enable_hibernation(const std::string& dir, std::chrono::seconds idle);
+    /**
+     * Enables the journal of applied updates: start() resumes long polling after the last applied update
+     * and skips updates that were applied before a restart. \n
+     * With snapshots, polling resumes after the last update in the loaded snapshot instead,
+     * updates applied after it are lost with the rest of the state and applied again if Telegram still has them.
+     * @param path path of the journal.
+     * */
+    void enable_update_log(const std::string& path);
+    /**
+     * Sets limits of every room's message history, rooms drop what they keep when the limits change.
+     * @param limits limits of a history.
+     * */
+    void set_history_limits(const history_limits& limits) { s->history_limit() = limits; }
+    /**
+     * Sets users allowed to use admin commands, e.g. /stats.
+     * @param admins telegram ids of users.
+     * */
+    void set_admins(std::vector<identifyable::id_t> admins) { m_admins = std::move(admins); }
 
     /**
      * Starts bot \n
-     * Warning: takes current thread, don't expect this function to finish.
+     * Updates are received by an ingest thread and handled on the current one in the order they came,
+     * so polling overlaps handling. \n
+     * Warning: takes current thread until stop() is called.
      * */
     void start();
+    /**
+     * Asks start() to return after current long poll and handling of updates received so far.
+     * Safe to call from a signal handler.
+     * */
+    void stop();
 };
 
 void room_bot::p_on_start(mes_ptr mes) {
     auto id     = mes->chat->id;
-    auto prefix = fmt::format("room_bot::on_start {}", desc(mes));
+    auto prefix = log_prefix("room_bot::on_start", mes);
 
     m_lgr.info("{} start", prefix);
-    api.sendMessage(id, "Hi!");
+    p_send_message(id, "Hi!");
     auto& s       = *this->s.get();
     auto srv_user = s.get_user(id);
     if(srv_user) {
         m_lgr.debug("{} user already exists, skip adding", prefix);
         return;
     } //prevent double joining
-    auto user    = std::make_shared<class user>(id);
+    auto user    = make_entity<class user>(id);
     user->name() = mes->chat->firstName;
     if(!mes->chat->lastName.empty()) {
         user->name() += " " + mes->chat->lastName;
@@ -183,29 +355,34 @@ void room_bot::p_on_stop(mes_ptr mes) {
     auto id     = mes->chat->id;
     auto& s     = *this->s.get();
     auto user   = s.get_user(id);
-    auto prefix = fmt::format("room_bot::on_stop {}", desc(mes));
+    auto prefix = log_prefix("room_bot::on_stop", mes);
     if(!p_check_user(user, prefix)) {
         return;
     }
 
     m_lgr.info("{} stop ", prefix);
-    user->current_room()->del_user(user);
-    {
-        auto& serv_users = s.users();
-        serv_users.erase(id);
+    auto room = user->current_room();
+    room->del_user(user);
+    p_on_user_left(room);
+    if(room != s.lobby() && room->users().empty()) {
+        s.on_room_empty(room);
     }
+    s.on_user_disconnect(user);
 }
 
 void room_bot::p_on_any(mes_ptr mes) {
     auto id     = mes->chat->id;
     auto& s     = *this->s.get();
-    auto prefix = fmt::format("room_bot::on_any {}", desc(mes));
+    auto prefix = log_prefix("room_bot::on_any", mes);
 
-    for(auto& cmd: m_commands) {
-        if(StringTools::startsWith(mes->text, "/" + cmd.cmd_word())) {
-            m_lgr.debug("{}: msg {} seems like a command, skipping on_any()", prefix, mes->text);
-            return;
-        } //skip if we got a command
+    const auto& text = mes->text;
+    if(!text.empty() && text.front() == '/') {
+        for(auto& cmd: m_commands) {
+            if(text.compare(1, cmd.cmd_word().size(), cmd.cmd_word()) == 0) {
+                m_lgr.debug("{}: msg {} seems like a command, skipping on_any()", prefix, text);
+                return;
+            } //skip if we got a command
+        }
     }
     auto user = s.get_user(id);
     if(!p_check_user(user, prefix)) {
@@ -220,14 +397,9 @@ void room_bot::p_on_any(mes_ptr mes) {
     }
 
     std::string relay_mes = user->name() + ":" + mes->text;
-    auto& users           = user->current_room()->users();
+    room->history().push(relay_mes, s.history_limit());
     m_lgr.debug("{} broadcasting msg", prefix);
-    for(const auto& u: users) {
-        if(u == user) {
-            continue;
-        }
-        api.sendMessage(u->id, relay_mes);
-    }
+    p_broadcast(room, relay_mes, user);
 }
 
 void room_bot::p_on_room_create_request(mes_ptr mes) {
@@ -235,7 +407,7 @@ void room_bot::p_on_room_create_request(mes_ptr mes) {
     [[maybe_unused]] auto& s   = *(this->s.get());
     [[maybe_unused]] auto user = std::get<0>(p_process_cmd(mes));
     [[maybe_unused]] auto cmd  = std::get<1>(p_process_cmd(mes));
-    auto prefix                = fmt::format("room_bot::on_room_create {}", desc(mes));
+    auto prefix                = log_prefix("room_bot::on_room_create", mes);
     if(!p_check_user(user, prefix)) {
         return;
     }
@@ -245,9 +417,9 @@ void room_bot::p_on_room_create_request(mes_ptr mes) {
 
     std::string response = "Welcome to new room,\n"
                            "Send this token to your friends so they could join you:";
-    api.sendMessage(id, response);
+    p_send_message(id, response);
     response = fmt::format("`{}`", room->token());
-    auto ptr = api.sendMessage(id, response, false, 0, std::make_shared<TgBot::GenericReply>(), "Markdown");
+    auto ptr = p_send_message(id, response, false, 0, std::make_shared<TgBot::GenericReply>(), "Markdown");
 }
 
 void room_bot::p_on_room_close_request(mes_ptr mes) {
@@ -255,7 +427,7 @@ void room_bot::p_on_room_close_request(mes_ptr mes) {
     [[maybe_unused]] auto& s   = *(this->s.get());
     [[maybe_unused]] auto user = std::get<0>(p_process_cmd(mes));
     [[maybe_unused]] auto cmd  = std::get<1>(p_process_cmd(mes));
-    auto prefix                = fmt::format("room_bot::on_room_close {}", desc(mes));
+    auto prefix                = log_prefix("room_bot::on_room_close", mes);
     if(!p_check_user(user, prefix)) {
         return;
     }
@@ -270,13 +442,14 @@ void room_bot::p_on_room_close_request(mes_ptr mes) {
         return;
     } //don't delete null room or lobby
     room->del_user(user);
+    p_on_user_left(room);
     if(room->users().empty()) {
         s.on_room_empty(room);
     }
 
     s.lobby()->add_user(user);
     user->current_room() = s.lobby();
-    api.sendMessage(id, "Welcome to lobby!");
+    p_send_message(id, "Welcome to lobby!");
 }
 
 void room_bot::p_on_room_join_request(mes_ptr mes) {
@@ -284,7 +457,7 @@ void room_bot::p_on_room_join_request(mes_ptr mes) {
     [[maybe_unused]] auto& s   = *(this->s.get());
     [[maybe_unused]] auto user = std::get<0>(p_process_cmd(mes));
     [[maybe_unused]] auto cmd  = std::get<1>(p_process_cmd(mes));
-    auto prefix                = fmt::format("room_bot::on_room_join {}", desc(mes));
+    auto prefix                = log_prefix("room_bot::on_room_join", mes);
     if(!p_check_user(user, prefix)) {
         return;
     }
@@ -301,27 +474,27 @@ void room_bot::p_on_room_join_request(mes_ptr mes) {
         m_lgr.info("{} attempt to join room {} that banned user", prefix, token);
     } else {
         response = fmt::format("Welcome to room {}", room->desc());
+        if(auto kept = room->history().size()) {
+            response += fmt::format("\nSend /history to see {} recent messages", kept);
+        }
         m_lgr.info("{} joined room {}", prefix, token);
-        user->current_room()->del_user(user); //delete from previous room
-        room->add_user(user);                 //place in joined room
-        user->current_room() = room;          //save joined room in user too
+        auto left = user->current_room();
+        left->del_user(user);        //delete from previous room
+        p_on_user_left(left);
+        room->add_user(user);        //place in joined room
+        user->current_room() = room; //save joined room in user too
 
         std::string broadcast_mes = fmt::format("User {} joined", user->desc());
-        for(auto& u: room->users()) {
-            if(u == user) {
-                continue;
-            }
-            api.sendMessage(u->id(), broadcast_mes);
-        }
+        p_broadcast(room, broadcast_mes, user);
     }
-    api.sendMessage(user->id(), response);
+    p_send_message(user->id(), response);
 }
 void room_bot::p_on_room_list_request(mes_ptr mes) {
     [[maybe_unused]] auto id   = mes->chat->id;
     [[maybe_unused]] auto& s   = *(this->s.get());
     [[maybe_unused]] auto user = std::get<0>(p_process_cmd(mes));
     [[maybe_unused]] auto cmd  = std::get<1>(p_process_cmd(mes));
-    auto prefix                = fmt::format("room_bot::on_room_list_request {}", desc(mes));
+    auto prefix                = log_prefix("room_bot::on_room_list_request", mes);
     if(!p_check_user(user, prefix)) {
         return;
     }
@@ -335,14 +508,40 @@ void room_bot::p_on_room_list_request(mes_ptr mes) {
         }
         response += std::move(user_status) + "\n";
     }
-    api.sendMessage(id, response);
+    p_send_message(id, response);
+}
+void room_bot::p_on_room_history_request(mes_ptr mes) {
+    auto id          = mes->chat->id;
+    auto [user, cmd] = p_process_cmd(mes);
+    auto prefix      = log_prefix("room_bot::on_room_history_request", mes);
+    if(!p_check_user(user, prefix) || !cmd) {
+        return;
+    }
+    constexpr std::size_t max_message = 4096; //TG's limit, bytes of UTF-8 are never less than its characters
+
+    auto words    = StringTools::split(mes->text, ' ');
+    auto& history = user->current_room()->history();
+    auto n        = history.size();
+    if(words.size() > 1) {
+        try {
+            n = std::stoul(words[1]);
+        } catch(const std::exception&) {
+            p_send_message(id, "History length has to be a number");
+            return;
+        }
+    }
+    if(history.size() == 0 || n == 0) {
+        p_send_message(id, "No messages to show");
+        return;
+    }
+    p_send_message(id, history.last(n, max_message));
 }
 void room_bot::p_on_room_kick_request(mes_ptr mes) {
     [[maybe_unused]] auto id   = mes->chat->id;
     [[maybe_unused]] auto& s   = *(this->s.get());
     [[maybe_unused]] auto user = std::get<0>(p_process_cmd(mes));
     [[maybe_unused]] auto cmd  = std::get<1>(p_process_cmd(mes));
-    auto prefix                = fmt::format("room_bot::on_room_kick {}", desc(mes));
+    auto prefix                = log_prefix("room_bot::on_room_kick", mes);
     if(!p_check_user(user, prefix)) {
         return;
     }
@@ -367,29 +566,25 @@ void room_bot::p_on_room_kick_request(mes_ptr mes) {
         } else {
             m_lgr.info("{} kicked {}", prefix, token);
             room->del_user(user_kicked);             //remove user from kicked room
+            p_on_user_left(room);
             s.lobby()->add_user(user_kicked);        //place kicked user in lobby
             user_kicked->current_room() = s.lobby(); //save lobby as user's new room
 
             auto user_mes = fmt::format("You were kicked from room {} by {} ", room->desc(), user->desc());
-            api.sendMessage(user_kicked->id, user_mes);
+            p_send_message(user_kicked->id, user_mes);
             response = fmt::format("{} was kicked from this room", user_kicked->desc());
             m_lgr.debug("{} broadcasting kick message", prefix);
-            for(auto& u: room->users()) {
-                if(u == user) {
-                    continue;
-                }
-                api.sendMessage(u->id, response);
-            }
+            p_broadcast(room, response, user);
         }
     }
-    api.sendMessage(id, response);
+    p_send_message(id, response);
 }
 void room_bot::p_on_room_subscribe_request(mes_ptr mes) {
     [[maybe_unused]] auto id   = mes->chat->id;
     [[maybe_unused]] auto& s   = *(this->s.get());
     [[maybe_unused]] auto user = std::get<0>(p_process_cmd(mes));
     [[maybe_unused]] auto cmd  = std::get<1>(p_process_cmd(mes));
-    auto prefix                = fmt::format("room_bot::on_room_subscribe {}", desc(mes));
+    auto prefix                = log_prefix("room_bot::on_room_subscribe", mes);
     if(!p_check_user(user, prefix)) {
         return;
     }
@@ -405,14 +600,14 @@ void room_bot::p_on_room_subscribe_request(mes_ptr mes) {
     room->unsubscribed().erase(user);
     response = "You've successfuly subscribed to room " + room->desc();
     m_lgr.info("{} subscribed to room {}", prefix, room->desc());
-    api.sendMessage(id, response);
+    p_send_message(id, response);
 }
 void room_bot::p_on_room_unsubscribe_request(mes_ptr mes) {
     [[maybe_unused]] auto id   = mes->chat->id;
     [[maybe_unused]] auto& s   = *(this->s.get());
     [[maybe_unused]] auto user = std::get<0>(p_process_cmd(mes));
     [[maybe_unused]] auto cmd  = std::get<1>(p_process_cmd(mes));
-    auto prefix                = fmt::format("room_bot::on_room_unsubscribe {}", desc(mes));
+    auto prefix                = log_prefix("room_bot::on_room_unsubscribe", mes);
     if(!p_check_user(user, prefix)) {
         return;
     }
@@ -428,14 +623,14 @@ void room_bot::p_on_room_unsubscribe_request(mes_ptr mes) {
     response = "You've successfuly unsubscribed from room " + room->desc() +
                "\n"
                "To subscribe back, use /sub command";
-    api.sendMessage(id, response);
+    p_send_message(id, response);
 }
 void room_bot::p_on_room_mute_request(mes_ptr mes) {
     [[maybe_unused]] auto id   = mes->chat->id;
     [[maybe_unused]] auto& s   = *(this->s.get());
     [[maybe_unused]] auto user = std::get<0>(p_process_cmd(mes));
     [[maybe_unused]] auto cmd  = std::get<1>(p_process_cmd(mes));
-    auto prefix                = fmt::format("room_bot::on_room_mute {}", desc(mes));
+    auto prefix                = log_prefix("room_bot::on_room_mute", mes);
     if(!p_check_user(user, prefix)) {
         return;
     }
@@ -461,25 +656,20 @@ void room_bot::p_on_room_mute_request(mes_ptr mes) {
             room->muted().emplace(user_muted);
 
             auto mes = fmt::format("muted in room {} by {}", room->desc(), user->desc());
-            api.sendMessage(user_muted->id, fmt::format("You were {}", mes));
+            p_send_message(user_muted->id, fmt::format("You were {}", mes));
             response = fmt::format("{} was {}", user_muted->desc(), mes);
             m_lgr.info("{} {}", prefix, response);
-            for(auto& u: room->users()) {
-                if(u == user) {
-                    continue;
-                }
-                api.sendMessage(u->id, response);
-            }
+            p_broadcast(room, response, user);
         }
     }
-    api.sendMessage(id, response);
+    p_send_message(id, response);
 }
 void room_bot::p_on_room_unmute_request(mes_ptr mes) {
     [[maybe_unused]] auto id   = mes->chat->id;
     [[maybe_unused]] auto& s   = *(this->s.get());
     [[maybe_unused]] auto user = std::get<0>(p_process_cmd(mes));
     [[maybe_unused]] auto cmd  = std::get<1>(p_process_cmd(mes));
-    auto prefix                = fmt::format("room_bot::on_room_unmute {}", desc(mes));
+    auto prefix                = log_prefix("room_bot::on_room_unmute", mes);
     if(!p_check_user(user, prefix)) {
         return;
     }
@@ -493,7 +683,7 @@ void room_bot::p_on_room_unmute_request(mes_ptr mes) {
         response = "You are not allowed to do this";
     } else {
         auto token           = words.at(1);
-        auto pred            = [&token](auto u) { return u->token() == token; };
+        auto pred            = [&token](auto u) { return u && u->token() == token; };
         auto user_unmuted_it = utils::find_if(room->muted(), pred);
         if(user_unmuted_it == room->muted().end()) {
             auto mes = fmt::format("No user with token {} in this room to unmute", token);
@@ -504,25 +694,20 @@ void room_bot::p_on_room_unmute_request(mes_ptr mes) {
             room->muted().erase(user_unmuted);
 
             auto mes = fmt::format("muted in room {} by {}", room->desc(), user->desc());
-            api.sendMessage(user_unmuted->id, fmt::format("You were {}", mes));
+            p_send_message(user_unmuted->id, fmt::format("You were {}", mes));
             response = fmt::format("{} was {}", user_unmuted->desc(), mes);
             m_lgr.info("{} {}", prefix, response);
-            for(auto& u: room->users()) {
-                if(u == user) {
-                    continue;
-                }
-                api.sendMessage(u->id, response);
-            }
+            p_broadcast(room, response, user);
         }
     }
-    api.sendMessage(id, response);
+    p_send_message(id, response);
 }
 void room_bot::p_on_room_ban_request(mes_ptr mes) {
     [[maybe_unused]] auto id   = mes->chat->id;
     [[maybe_unused]] auto& s   = *(this->s.get());
     [[maybe_unused]] auto user = std::get<0>(p_process_cmd(mes));
     [[maybe_unused]] auto cmd  = std::get<1>(p_process_cmd(mes));
-    auto prefix                = fmt::format("room_bot::on_room_ban {}", desc(mes));
+    auto prefix                = log_prefix("room_bot::on_room_ban", mes);
     if(!p_check_user(user, prefix)) {
         return;
     }
@@ -548,29 +733,25 @@ void room_bot::p_on_room_ban_request(mes_ptr mes) {
         } else {
             room->banned().emplace(user_banned);
             room->del_user(user_banned);             //remove user from room
+            p_on_user_left(room);
             s.lobby()->add_user(user_banned);        //place user in lobby
             user_banned->current_room() = s.lobby(); //save lobby as user's new room
 
             auto mes = fmt::format("banned in room {} by {}", room->desc(), user->desc());
-            api.sendMessage(user_banned->id, fmt::format("You were {}", mes));
+            p_send_message(user_banned->id, fmt::format("You were {}", mes));
             response = fmt::format("{} was {}", user_banned->desc(), mes);
             m_lgr.info("{} {}", prefix, response);
-            for(auto& u: room->users()) {
-                if(u == user) {
-                    continue;
-                }
-                api.sendMessage(u->id, response);
-            }
+            p_broadcast(room, response, user);
         }
     }
-    api.sendMessage(id, response);
+    p_send_message(id, response);
 }
 void room_bot::p_on_room_unban_request(mes_ptr mes) {
     [[maybe_unused]] auto id   = mes->chat->id;
     [[maybe_unused]] auto& s   = *(this->s.get());
     [[maybe_unused]] auto user = std::get<0>(p_process_cmd(mes));
     [[maybe_unused]] auto cmd  = std::get<1>(p_process_cmd(mes));
-    auto prefix                = fmt::format("room_bot::on_room_unban {}", desc(mes));
+    auto prefix                = log_prefix("room_bot::on_room_unban", mes);
     if(!p_check_user(user, prefix)) {
         return;
     }
@@ -584,7 +765,7 @@ void room_bot::p_on_room_unban_request(mes_ptr mes) {
         response = "You are not allowed to do this";
     } else {
         auto token            = words.at(1);
-        auto pred             = [&token](auto u) { return u->token() == token; };
+        auto pred             = [&token](auto u) { return u && u->token() == token; };
         auto user_unbanned_it = utils::find_if(room->banned(), pred);
         if(user_unbanned_it == room->banned().end()) {
             auto mes = fmt::format("No user with token {} in this room to unban", token);
@@ -595,21 +776,51 @@ void room_bot::p_on_room_unban_request(mes_ptr mes) {
             room->banned().erase(user_unbanned);
 
             auto mes = fmt::format("unbanned in room {} by {}", room->desc(), user->desc());
-            api.sendMessage(user_unbanned->id, fmt::format("You were {} ", mes));
+            p_send_message(user_unbanned->id, fmt::format("You were {} ", mes));
             response = fmt::format("{} was {}", user_unbanned->desc(), mes);
             m_lgr.info("{} {}", prefix, response);
-            for(auto& u: room->users()) {
-                if(u == user) {
-                    continue;
-                }
-                api.sendMessage(u->id, response);
-            }
+            p_broadcast(room, response, user);
         }
     }
-    api.sendMessage(id, response);
+    p_send_message(id, response);
 }
 
-room_bot::room_bot(const std::string& token): m_bot(token), api(m_bot.getApi()) {
+void room_bot::p_on_stats_request(mes_ptr mes) {
+    [[maybe_unused]] auto id   = mes->chat->id;
+    [[maybe_unused]] auto user = std::get<0>(p_process_cmd(mes));
+    auto prefix                = log_prefix("room_bot::on_stats", mes);
+    if(!p_check_user(user, prefix)) {
+        return;
+    }
+    if(!utils::contains(m_admins, user->id())) {
+        m_lgr.warn("{} not an admin", prefix);
+        p_send_message(id, "Only admins can see stats");
+        return;
+    }
+    m_lgr.info("{} requested stats", prefix);
+    p_send_message(id, p_render_stats());
+}
+
+auto room_bot::p_render_stats() const -> std::string {
+    auto log_stats = get_logger_stats();
+    std::string result;
+    result += fmt::format("users: {}\n", s->users().size());
+    result += fmt::format("rooms: {}\n", s->rooms().size());
+    result += fmt::format("rooms hibernated: {}\n", s->hibernated_rooms());
+    result += s->memory_usage().to_string();
+    result += fmt::format("log mode: {}\n", log_stats.async ? "async" : "sync");
+    if(log_stats.async) {
+        result += fmt::format("log queue capacity: {}\n", log_stats.queue_capacity);
+        result += fmt::format("log messages dropped: {}\n", log_stats.dropped);
+    }
+    if constexpr(alloc::enabled) {
+        result += alloc::report(5);
+    }
+    return result;
+}
+
+room_bot::room_bot(const std::string& token, const http_pool_config& http):
+    m_http(std::make_unique<http_pool>(http)), m_bot(token, *m_http, http.url), api(m_bot.getApi()) {
     this->s            = std::make_unique<server>();
     using args_t       = std::vector<std::string>;
     const auto no_args = args_t {};
@@ -621,6 +832,9 @@ room_bot::room_bot(const std::string& token): m_bot(token), api(m_bot.getApi())
                             [this](auto mes) { p_on_room_join_request(mes); });
     m_commands.emplace_back("list", "list users in the room", no_args,
                             [this](auto mes) { p_on_room_list_request(mes); });
+    m_commands.emplace_back(
+        "history", "show recent messages of the room", args_t {"n"},
+        [this](auto mes) { p_on_room_history_request(mes); }, 1);
     m_commands.emplace_back("kick", "kick user", args_t {"user_token"},
                             [this](auto mes) { p_on_room_kick_request(mes); });
     m_commands.emplace_back("mute", "mute user", args_t {"user_token"},
@@ -634,43 +848,128 @@ room_bot::room_bot(const std::string& token): m_bot(token), api(m_bot.getApi())
                             [this](auto mes) { p_on_room_subscribe_request(mes); });
     m_commands.emplace_back("unsub", "unsubscribe from room's messages", no_args,
                             [this](auto mes) { p_on_room_unsubscribe_request(mes); });
+    m_commands.emplace_back("stats", "show bot's operational stats", no_args,
+                            [this](auto mes) { p_on_stats_request(mes); });
+    p_register_commands();
+    auto& any_hist = metrics::get_histogram("bot_command_duration_seconds", "Command handler latency",
+                                            {{"command", "any"}});
+    m_bot.getEvents().onAnyMessage([this, &any_hist](mes_ptr mes) {
+        trace::root_span span("on_any", mes->chat->id, "any");
+        alloc::scope alloc_scope(alloc::tag::routing);
+        p_touch_room(mes);
+        any_hist.record(utils::measure<std::chrono::nanoseconds>([&] { p_on_any(mes); }));
+    });
+}
+
+void room_bot::p_register_commands() {
     auto& ev = m_bot.getEvents();
     for(auto& cmd: m_commands) {
-        ev.onCommand(cmd.cmd_word(), cmd.callback());
+        auto& hist = metrics::get_histogram("bot_command_duration_seconds", "Command handler latency",
+                                            {{"command", cmd.cmd_word()}});
+        ev.onCommand(cmd.cmd_word(), [this, &hist, word = cmd.cmd_word(), callback = cmd.callback()](mes_ptr mes) {
+            trace::root_span span("command", mes->chat->id, word.c_str());
+            alloc::scope alloc_scope(alloc::tag::routing);
+            p_touch_room(mes);
+            hist.record(utils::measure<std::chrono::nanoseconds>(callback, mes));
+        });
+    }
+}
+
+void room_bot::p_touch_room(const mes_ptr& mes) {
+    if(auto user = s->get_user(mes->chat->id)) {
+        s->touch_room(user->current_room());
+    }
+}
+
+template<class... Args>
+auto room_bot::p_api_send(std::int64_t chat_id, const std::string& text, const Args&... args) const -> mes_ptr {
+    static auto& sent    = metrics::get_counter("bot_messages_sent_total", "Messages sent to TG API");
+    static auto& failed  = metrics::get_counter("bot_messages_failed_total", "Messages that TG API failed to send");
+    static auto& latency = metrics::get_histogram("bot_send_message_duration_seconds", "sendMessage latency");
+    metrics::scoped_timer timer(latency);
+    trace::span span("sendMessage");
+    alloc::scope alloc_scope(alloc::tag::network);
+    try {
+        auto result = api.sendMessage(chat_id, text, args...);
+        sent.add();
+        return result;
+    } catch(...) {
+        failed.add();
+        throw;
+    }
+}
+
+template<class... Args>
+auto room_bot::p_send_message(std::int64_t chat_id, const std::string& text, Args&&... args) const -> mes_ptr {
+    return m_outbox.send(chat_id, [this, chat_id, text, args...] { return p_api_send(chat_id, text, args...); });
+}
+
+auto room_bot::p_broadcast(const room_ptr& room, const std::string& text, const user_ptr& sender) const
+    -> std::size_t {
+    if(sender && room->muted().count(sender)) {
+        return 0;
+    }
+    std::vector<std::int64_t> chat_ids;
+    for(auto& u: room->users()) {
+        if(u != sender && !room->unsubscribed().count(u)) {
+            chat_ids.emplace_back(u->id());
+        }
     }
-    ev.onAnyMessage([this](mes_ptr mes) { p_on_any(mes); });
+    p_send_many(chat_ids, text);
+    return chat_ids.size();
+}
+
+void room_bot::p_send_many(const std::vector<std::int64_t>& chat_ids, const std::string& text) const {
+    static auto& fanout = metrics::get_histogram("bot_broadcast_duration_seconds",
+                                                 "Time until every message of a room broadcast is sent or deferred");
+    if(chat_ids.empty()) {
+        return;
+    }
+    metrics::scoped_timer timer(fanout);
+    trace::span span("broadcast");
+    //shared by deferred copies of the sender instead of copying the text for each of them
+    auto shared = std::make_shared<const std::string>(text);
+    m_outbox.send_many(
+        chat_ids, [this, shared](std::int64_t chat_id) { p_api_send(chat_id, *shared); }, broadcast_parallel);
 }
 
 auto room_bot::p_process_cmd(const mes_ptr& mes) -> std::tuple<user_ptr, std::optional<command>> {
+    trace::span span("parse");
     auto id     = mes->chat->id;
     auto& s     = *this->s.get();
     auto user   = s.get_user(id);
-    auto prefix = fmt::format("room_bot::p_process_cmd id:{}", id);
+    auto prefix = lazy([&] { return fmt::format("room_bot::p_process_cmd id:{}", id); });
     if(!user) {
         m_lgr.error("{} no user", prefix);
         return std::make_tuple(user, std::nullopt);
     }
+    if(auto room = user->current_room()) {
+        trace::tag_room(room->token());
+    }
     auto words  = StringTools::split(mes->text, ' ');
     auto pred   = [&](auto cmd) { return "/" + cmd.cmd_word() == words.at(0); };
     auto cmd_it = utils::find_if(m_commands, pred);
     if(cmd_it == m_commands.end()) {
         m_lgr.error("{} unknown command, words:{}", prefix, words);
-        api.sendMessage(id, "Unknown command");
+        p_send_message(id, "Unknown command");
         return std::make_tuple(user, std::nullopt);
     }
     auto cmd = *cmd_it;
-    if(words.size() - 1 != cmd.args().size()) {
-        auto err_mes =
-            fmt::format("cmd {} requires {} args, provided: {}", cmd.cmd_word(), cmd.args().size(), words.size() - 1);
+    if(words.size() - 1 < cmd.min_args() || words.size() - 1 > cmd.args().size()) {
+        auto required = cmd.min_args() == cmd.args().size()
+                            ? std::to_string(cmd.args().size())
+                            : fmt::format("{} to {}", cmd.min_args(), cmd.args().size());
+        auto err_mes  = fmt::format("cmd {} requires {} args, provided: {}", cmd.cmd_word(), required, words.size() - 1);
         m_lgr.error("{} {}", prefix, err_mes);
-        api.sendMessage(id, err_mes);
-        api.sendMessage(id, cmd.usage());
+        p_send_message(id, err_mes);
+        p_send_message(id, cmd.usage());
         return std::make_tuple(user, std::nullopt);
     }
     return std::make_tuple(user, std::move(cmd));
 }
 
-bool room_bot::p_check_user(const user_ptr& user, const std::string& prefix) {
+template<class Prefix>
+bool room_bot::p_check_user(const user_ptr& user, const Prefix& prefix) {
     if(!user) {
         m_lgr.error("{} no user in bot, skipping", prefix);
         return false;
@@ -678,14 +977,144 @@ bool room_bot::p_check_user(const user_ptr& user, const std::string& prefix) {
     return true;
 }
 
+void room_bot::enable_snapshots(const std::string& path, std::chrono::seconds interval) {
+    auto prefix = "room_bot::enable_snapshots";
+    std::optional<snapshot::server_state> state;
+    auto read_time = utils::measure<std::chrono::milliseconds>([&] { state = snapshot::read(path); });
+    if(state) {
+        auto load_time = utils::measure<std::chrono::milliseconds>([&] { s->load_snapshot(*state); });
+        m_applied_offset = state->update_offset;
+        m_lgr.info("{} loaded {} in {}ms, read took {}ms", prefix, path, (read_time + load_time).count(),
+                   read_time.count());
+        p_on_snapshot_loaded();
+    } else {
+        m_lgr.info("{} no snapshot at {}, starting empty", prefix, path);
+    }
+    m_snapshots         = std::make_unique<snapshot::writer>(path);
+    m_snapshot_interval = interval;
+}
+
+void room_bot::enable_hibernation(const std::string& dir, std::chrono::seconds idle) {
+    s->enable_hibernation(dir, idle);
+}
+
+void room_bot::enable_update_log(const std::string& path) {
+    m_update_log = std::make_unique<update_log>(path);
+}
+
+void room_bot::p_save_snapshot() {
+    static auto& copy_hist = metrics::get_histogram("bot_snapshot_copy_duration_seconds",
+                                                    "Time the handling thread spends copying server's state");
+    trace::span span("snapshot");
+    snapshot::server_state state;
+    copy_hist.record(utils::measure<std::chrono::nanoseconds>([&] { state = s->make_snapshot(); }));
+    state.update_offset = m_applied_offset;
+    m_snapshots->submit(std::move(state));
+}
+
+void room_bot::p_ingest(bounded_queue<received_update>& queue, std::int32_t offset) {
+    auto prefix     = "room_bot::p_ingest";
+    auto& poll_hist = metrics::get_histogram("bot_long_poll_duration_seconds", "getUpdates round trip");
+    while(!m_stop) {
+        std::vector<TgBot::Update::Ptr> updates;
+        try {
+            auto time0 = std::chrono::steady_clock::now();
+            trace::root_span span("getUpdates", 0, nullptr);
+            alloc::scope alloc_scope(alloc::tag::network);
+            updates = api.getUpdates(offset, 100, long_poll_timeout);
+            poll_hist.record(std::chrono::steady_clock::now() - time0);
+        } catch(const std::exception& e) {
+            m_lgr.error("{} getUpdates failed: {}", prefix, e.what());
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            continue;
+        }
+        auto now = std::chrono::steady_clock::now();
+        for(auto& update: updates) {
+            offset = std::max(offset, update->updateId + 1);
+            if(!queue.push({std::move(update), now})) {
+                break;
+            }
+        }
+    }
+    queue.close();
+}
+
 void room_bot::start() {
     auto me     = m_bot.getApi().getMe();
-    auto prefix = fmt::format("room_bot::start");
+    auto prefix = "room_bot::start";
     m_lgr.info("{} bot username: {} id: {}", prefix, me->username, me->id);
-    TgBot::TgLongPoll longPoll(m_bot);
-    while(true) {
-        longPoll.start();
+    auto& wait_hist   = metrics::get_histogram("bot_update_queue_wait_seconds",
+                                               "Time an update waits between getUpdates and its handling");
+    auto& depth_gauge = metrics::get_gauge("bot_update_queue_depth", "Received updates waiting to be handled");
+    auto& skipped     = metrics::get_counter("bot_updates_skipped_total",
+                                             "Updates delivered again after a restart and skipped as already applied");
+    const auto& handler = m_bot.getEventHandler();
+    auto last_snapshot  = std::chrono::steady_clock::now();
+    bounded_queue<received_update> queue(update_queue_size);
+    auto offset = m_update_log ? m_update_log->offset() : 0;
+    if(offset && m_applied_offset && m_applied_offset < offset) { //journaled updates newer than the snapshot
+        m_lgr.warn("{} updates from {} to {} aren't in the snapshot, applying those Telegram still has again", prefix,
+                   m_applied_offset, offset - 1);
+        offset = m_applied_offset;
+    }
+    auto synced = offset; //past the last handled update
+    std::thread ingest([this, &queue, offset] { p_ingest(queue, offset); });
+    std::vector<received_update> batch;
+    std::chrono::steady_clock::duration wait = std::chrono::seconds(p_poll_timeout());
+    //handled until the ingest thread closes the queue on stop() and it's drained
+    while(queue.pop_all(batch, wait)) {
+        depth_gauge.set(queue.size());
+        for(auto& received: batch) {
+            auto id = received.update->updateId;
+            synced  = std::max(synced, id + 1);
+            wait_hist.record(std::chrono::steady_clock::now() - received.time);
+            //only redeliveries that made it into server's state are skipped, if it's known
+            if(m_update_log && m_update_log->applied(id) && (!m_applied_offset || id < m_applied_offset)) {
+                skipped.add();
+                continue;
+            }
+            handler.handleUpdate(received.update);
+            m_applied_offset = std::max(m_applied_offset, id + 1);
+            if(m_update_log) {
+                m_update_log->record(id);
+            }
+        }
+        if(m_update_log) {
+            m_update_log->sync(); //one fdatasync per batch
+        }
+        batch.clear();
+        p_on_poll();
+        auto now = std::chrono::steady_clock::now();
+        wait     = std::chrono::seconds(p_poll_timeout());
+        if(auto next = m_outbox.flush(now)) { //wake up when deferred messages may go
+            wait = std::clamp<std::chrono::steady_clock::duration>(*next - now, {}, wait);
+        }
+        s->hibernate_idle();
+        if(m_snapshots && std::chrono::steady_clock::now() - last_snapshot >= m_snapshot_interval) {
+            p_save_snapshot();
+            last_snapshot = std::chrono::steady_clock::now();
+        }
+    }
+    ingest.join();
+    if(synced != offset) { //ingest polled before the last batch was handled, so it's confirmed here
+        try {
+            api.getUpdates(synced, 1, 0);
+        } catch(const std::exception& e) {
+            m_lgr.warn("{} failed to confirm handled updates: {}", prefix, e.what());
+        }
     }
+    m_outbox.flush(std::chrono::steady_clock::now());
+    if(auto dropped = m_outbox.clear()) {
+        m_lgr.warn("{} dropped {} deferred messages", prefix, dropped);
+    }
+    if(m_snapshots) {
+        p_save_snapshot();
+    }
+    m_lgr.info("{} stopped", prefix);
+}
+
+void room_bot::stop() {
+    m_stop = true;
 }
 
 } // namespace bot
\ No newline at end of file
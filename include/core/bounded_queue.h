@@ -0,0 +1,103 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace bot {
+
+/**
+ * FIFO queue of a fixed capacity between producer and consumer threads. \n
+ * A full queue blocks producers, so a slow consumer slows the producer down instead of growing the queue.
+ * */
+template<class T>
+class bounded_queue {
+public:
+    /**
+     * Constructor.
+     * @param capacity most values in the queue, at least 1.
+     * */
+    bounded_queue(std::size_t capacity): m_capacity(capacity ? capacity : 1) { }
+    bounded_queue(const bounded_queue&) = delete;
+    bounded_queue& operator=(const bounded_queue&) = delete;
+
+    /**
+     * Appends a value, waits while the queue is full.
+     * @param value value to append.
+     * @returns false if the queue is closed, the value is dropped then.
+     * */
+    auto push(T value) -> bool;
+    /**
+     * Moves all values out of the queue, waits up to timeout for the first one.
+     * @param out vector to append values to.
+     * @param timeout time to wait for a value.
+     * @returns false if the queue is closed and there is nothing left in it.
+     * */
+    template<class Rep, class Period>
+    auto pop_all(std::vector<T>& out, std::chrono::duration<Rep, Period> timeout) -> bool;
+    /**
+     * Closes the queue: pushes fail, consumer takes what is left.
+     * */
+    void close();
+    auto size() const -> std::size_t;
+
+protected:
+    std::size_t m_capacity;           /**< Most values in the queue */
+    mutable std::mutex m_mutex;       /**< Guards values and the flag */
+    std::condition_variable m_pushed; /**< Wakes the consumer up */
+    std::condition_variable m_popped; /**< Wakes producers up */
+    std::deque<T> m_values;           /**< Values in the queue */
+    bool m_closed = false;            /**< No more values are accepted */
+};
+
+template<class T>
+auto bounded_queue<T>::push(T value) -> bool {
+    {
+        std::unique_lock lock(m_mutex);
+        m_popped.wait(lock, [this] { return m_closed || m_values.size() < m_capacity; });
+        if(m_closed) {
+            return false;
+        }
+        m_values.emplace_back(std::move(value));
+    }
+    m_pushed.notify_one();
+    return true;
+}
+
+template<class T>
+template<class Rep, class Period>
+auto bounded_queue<T>::pop_all(std::vector<T>& out, std::chrono::duration<Rep, Period> timeout) -> bool {
+    {
+        std::unique_lock lock(m_mutex);
+        m_pushed.wait_for(lock, timeout, [this] { return m_closed || !m_values.empty(); });
+        if(m_values.empty()) {
+            return !m_closed;
+        }
+        for(auto& value: m_values) {
+            out.emplace_back(std::move(value));
+        }
+        m_values.clear();
+    }
+    m_popped.notify_all();
+    return true;
+}
+
+template<class T>
+void bounded_queue<T>::close() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_closed = true;
+    }
+    m_pushed.notify_all();
+    m_popped.notify_all();
+}
+
+template<class T>
+auto bounded_queue<T>::size() const -> std::size_t {
+    std::lock_guard lock(m_mutex);
+    return m_values.size();
+}
+
+} // namespace bot
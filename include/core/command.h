@@ -1,6 +1,7 @@
 #pragma once
 #include "core/datatypes.h"
 
+#include <algorithm>
 #include <functional>
 #include <string>
 
@@ -20,9 +21,10 @@ public:
      * @param desc description of the command.
      * @param args vector for command's arguments names.
      * @param callback callback to be called when command is entered correctly.
+     * @param optional amount of trailing arguments that may be omitted.
      * */
     command(const name_t& name, const std::string& desc, const std::vector<std::string>& args,
-            const callback_t& callback);
+            const callback_t& callback, std::size_t optional = 0);
 
     /**
      * Returns info about using a command. Example: "/kick [user_token]".
@@ -44,6 +46,10 @@ public:
      * @returns vector of strings, representing command's arguments names.
      * */
     auto args() const -> const std::vector<std::string>&;
+    /**
+     * Returns least amount of arguments, trailing optional ones may be omitted.
+     * */
+    auto min_args() const -> std::size_t { return m_args.size() - m_optional; }
     /**
      * Returns callback of a command.
      * @returns callback of a command.
@@ -60,16 +66,17 @@ protected:
     const std::string m_desc;              /**< Description of a command. */
     const std::vector<std::string> m_args; /**< Command's args names. */
     const callback_t m_callback;           /**< Command's callback. */
+    const std::size_t m_optional;          /**< Amount of trailing optional args. */
 };
 
 command::command(const name_t& name, const std::string& desc, const std::vector<std::string>& args,
-                 const callback_t& callback):
+                 const callback_t& callback, std::size_t optional):
     m_cmd_word(name),
-    m_desc(desc), m_args(args), m_callback(callback) { }
+    m_desc(desc), m_args(args), m_callback(callback), m_optional(std::min(optional, args.size())) { }
 auto command::usage() const -> std::string {
     std::string usage = "Usage: /" + m_cmd_word;
-    for(auto& arg: m_args) {
-        usage += " [" + arg + "]";
+    for(std::size_t i = 0; i < m_args.size(); i++) {
+        usage += " [" + m_args[i] + (i < min_args() ? "]" : ", optional]");
     }
     return usage;
 }
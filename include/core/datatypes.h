@@ -1,4 +1,6 @@
 #pragma once
+#include "core/registry.h"
+
 #include <memory>
 #include <tgbot/tgbot.h>
 
@@ -7,8 +9,16 @@ namespace bot {
 class user;
 class room;
 
-using user_ptr = std::shared_ptr<user>;
-using room_ptr = std::shared_ptr<room>;
+/**
+ * Rooms have derived classes, so they are boxed in their registry.
+ * */
+template<>
+struct entity_traits<room> {
+    static constexpr bool boxed = true;
+};
+
+using user_ptr = entity_ptr<user>;
+using room_ptr = entity_ptr<room>;
 using mes_ptr  = TgBot::Message::Ptr;
 
 }; // namespace bot
\ No newline at end of file
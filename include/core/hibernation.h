@@ -0,0 +1,193 @@
+#pragma once
+#include "components/logger.hpp"
+#include "core/datatypes.h"
+#include "core/identifyable.h"
+#include "core/logging_obj.h"
+#include "core/metrics.h"
+#include "core/room.h"
+#include "core/snapshot.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace bot {
+
+/**
+ * Bookkeeping of idle rooms: LRU of resident rooms ordered by their last activity
+ * and on-disk records of hibernated ones, one file per room. \n
+ * Knows nothing about games, server decides what goes into a record and how to restore it.
+ * */
+class hibernation: public logging_obj {
+public:
+    using clock = std::chrono::steady_clock; /**< Clock of rooms' activity */
+    using id_t  = identifyable::id_t;        /**< Define for room's id */
+
+    /**
+     * Constructor, creates the directory and removes records and links left by a previous run,
+     * games of hibernated rooms are carried over by snapshots instead.
+     * @param dir directory for records.
+     * @param idle period of inactivity after which a room is hibernated.
+     * */
+    hibernation(const std::string& dir, std::chrono::seconds idle);
+
+    /**
+     * Marks room as active and moves it to the front of the LRU.
+     * @param room room that got something addressed to it.
+     * @param now current time.
+     * */
+    void touch(const room_ptr& room, clock::time_point now);
+    /**
+     * Takes the least recently active room out of the LRU if it's idle for too long.
+     * @param now current time.
+     * @returns idle room, nullptr if there are none
+     * */
+    auto pop_idle(clock::time_point now) -> room_ptr;
+    /**
+     * Writes room's record and marks it hibernated.
+     * Throws runtime exception if record can't be written.
+     * @param id id of a room.
+     * @param data record.
+     * */
+    void store(id_t id, const std::string& data);
+    /**
+     * Reads record of a hibernated room, throws runtime exception if it's missing.
+     * @param id id of a room.
+     * */
+    auto read(id_t id) const -> std::string;
+    /**
+     * Links record of a hibernated room under another name, the link keeps the record's data
+     * after the room is restored or hibernated again. Costs no reading of the record.
+     * Throws filesystem error if the link can't be made.
+     * @param id id of a room.
+     * @returns path of the link, it's up to the caller to remove it.
+     * */
+    auto link(id_t id) -> std::string;
+    /**
+     * Removes record of a room that was restored from it.
+     * @param id id of a room.
+     * */
+    void release(id_t id);
+    /**
+     * Forgets a room completely, e.g. when it's closed.
+     * @param id id of a room.
+     * */
+    void forget(id_t id);
+    auto is_hibernated(id_t id) const -> bool { return m_hibernated.count(id); }
+    auto hibernated() const -> std::size_t { return m_hibernated.size(); }
+    auto resident() const -> std::size_t { return m_lru.size(); }
+
+protected:
+    /**
+     * Entry of the LRU.
+     * */
+    struct entry {
+        room_ptr room;          /**< Resident room */
+        clock::time_point last; /**< Last activity */
+    };
+    using lru_t = std::list<entry>; /**< Define for the LRU, most recently active rooms go first */
+
+    std::filesystem::path m_dir;                           /**< Directory of records */
+    std::chrono::seconds m_idle;                           /**< Period of inactivity before hibernation */
+    lru_t m_lru;                                           /**< Resident rooms */
+    std::unordered_map<id_t, lru_t::iterator> m_positions; /**< Room's entry in the LRU */
+    std::unordered_set<id_t> m_hibernated;                 /**< Rooms that have records */
+    std::uint64_t m_links = 0;                             /**< Links made, to name the next one */
+    metrics::gauge& m_resident_gauge;                      /**< Amount of rooms in the LRU */
+    metrics::gauge& m_hibernated_gauge;                    /**< Amount of hibernated rooms */
+
+    auto p_path(id_t id) const -> std::string;
+    void p_update_gauges();
+};
+
+hibernation::hibernation(const std::string& dir, std::chrono::seconds idle):
+    m_dir(dir), m_idle(idle),
+    m_resident_gauge(metrics::get_gauge("bot_rooms_resident", "Rooms kept in memory and tracked for hibernation")),
+    m_hibernated_gauge(metrics::get_gauge("bot_rooms_hibernated", "Rooms whose games are hibernated to disk")) {
+    std::filesystem::create_directories(m_dir);
+    std::size_t stale = 0;
+    for(auto& file: std::filesystem::directory_iterator(m_dir)) {
+        if(file.path().extension() == ".room" || file.path().extension() == ".link") {
+            std::filesystem::remove(file.path());
+            stale++;
+        }
+    }
+    m_lgr.info("hibernation::hibernation dir:{} idle:{}s, removed {} stale records", dir, idle.count(), stale);
+}
+
+void hibernation::touch(const room_ptr& room, clock::time_point now) {
+    auto [it, inserted] = m_positions.try_emplace(room->id());
+    if(inserted) {
+        m_lru.push_front({room, now});
+        it->second = m_lru.begin();
+        p_update_gauges();
+        return;
+    }
+    it->second->last = now;
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+}
+
+auto hibernation::pop_idle(clock::time_point now) -> room_ptr {
+    if(m_lru.empty() || now - m_lru.back().last < m_idle) {
+        return nullptr;
+    }
+    auto room = m_lru.back().room;
+    m_positions.erase(room->id());
+    m_lru.pop_back();
+    p_update_gauges();
+    return room;
+}
+
+void hibernation::store(id_t id, const std::string& data) {
+    snapshot::write_file(p_path(id), data);
+    m_hibernated.emplace(id);
+    p_update_gauges();
+}
+
+auto hibernation::read(id_t id) const -> std::string {
+    auto data = snapshot::read_file(p_path(id));
+    if(!data) {
+        auto mes = fmt::format("hibernation::read no record of room {}", id);
+        m_lgr.error(mes);
+        throw std::runtime_error(mes);
+    }
+    return std::move(*data);
+}
+
+auto hibernation::link(id_t id) -> std::string {
+    //records are replaced by rename, so the link stays with the data it was made for
+    auto path = (m_dir / fmt::format("{}.{}.link", id, m_links++)).string();
+    std::filesystem::create_hard_link(p_path(id), path);
+    return path;
+}
+
+void hibernation::release(id_t id) {
+    if(m_hibernated.erase(id)) {
+        std::filesystem::remove(p_path(id));
+        p_update_gauges();
+    }
+}
+
+void hibernation::forget(id_t id) {
+    release(id);
+    if(auto it = m_positions.find(id); it != m_positions.end()) {
+        m_lru.erase(it->second);
+        m_positions.erase(it);
+        p_update_gauges();
+    }
+}
+
+auto hibernation::p_path(id_t id) const -> std::string {
+    return (m_dir / (std::to_string(id) + ".room")).string();
+}
+
+void hibernation::p_update_gauges() {
+    m_resident_gauge.set(m_lru.size());
+    m_hibernated_gauge.set(m_hibernated.size());
+}
+
+} // namespace bot
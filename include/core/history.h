@@ -0,0 +1,161 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bot {
+
+/**
+ * Limits of every room's message history.
+ * */
+struct history_limits {
+    std::size_t messages = 50;       /**< Most messages kept, 0 disables history */
+    std::size_t bytes    = 8 * 1024; /**< Most bytes of text kept, longer messages are truncated */
+
+    auto operator==(const history_limits& rhs) const -> bool { return messages == rhs.messages && bytes == rhs.bytes; }
+    auto operator!=(const history_limits& rhs) const -> bool { return !(*this == rhs); }
+};
+
+/**
+ * Ring of recent messages of a room. \n
+ * Texts are stored back to back in one circular buffer and located by offsets and lengths,
+ * the oldest messages are evicted when either limit is reached. Buffers are allocated on the first message,
+ * so a room that never talks costs nothing and a talking one doesn't allocate per message.
+ * */
+class message_history {
+public:
+    /**
+     * Appends a message, applies new limits first if they changed, dropping what is kept.
+     * @param text text of the message, truncated to the byte limit at a UTF-8 character boundary.
+     * @param limits limits of the history.
+     * */
+    void push(std::string_view text, const history_limits& limits);
+    /**
+     * Joins most recent messages with new lines, oldest first.
+     * @param n most messages to take.
+     * @param max_bytes most bytes of the result, older messages that don't fit are left out,
+     * the newest one is truncated if it doesn't fit alone.
+     * @returns joined messages.
+     * */
+    auto last(std::size_t n, std::size_t max_bytes) const -> std::string;
+    /**
+     * Returns amount of kept messages.
+     * */
+    auto size() const -> std::size_t { return m_count; }
+    /**
+     * Drops all messages and frees buffers.
+     * */
+    void clear();
+    /**
+     * Returns bytes occupied by buffers of the history.
+     * */
+    auto memory_usage() const -> std::size_t { return m_data.capacity() + m_entries.capacity() * sizeof(entry); }
+
+protected:
+    /**
+     * Location of a message in the buffer.
+     * */
+    struct entry {
+        std::uint32_t offset; /**< Offset of the first byte */
+        std::uint32_t length; /**< Length in bytes */
+    };
+
+    history_limits m_limits {0, 0}; /**< Limits buffers were made for */
+    std::vector<char> m_data;       /**< Circular buffer of texts */
+    std::vector<entry> m_entries;   /**< Circular buffer of locations */
+    std::size_t m_head  = 0;        /**< Index of the oldest entry */
+    std::size_t m_count = 0;        /**< Kept messages */
+    std::size_t m_used  = 0;        /**< Bytes taken by kept messages */
+
+    auto p_entry(std::size_t age) const -> const entry& {
+        return m_entries[(m_head + m_count - 1 - age) % m_entries.size()];
+    }
+};
+
+void message_history::push(std::string_view text, const history_limits& limits) {
+    if(limits != m_limits) {
+        clear();
+        m_limits = limits;
+    }
+    if(!m_limits.messages || !m_limits.bytes) {
+        return;
+    }
+    if(m_data.empty()) {
+        m_data.resize(m_limits.bytes);
+        m_entries.resize(m_limits.messages);
+    }
+    auto length = std::min(text.size(), m_data.size());
+    while(length && length < text.size() && (text[length] & 0xC0) == 0x80) {
+        length--; //don't split a multibyte character
+    }
+    while(m_count && (m_count == m_entries.size() || m_used + length > m_data.size())) {
+        m_used -= m_entries[m_head].length;
+        m_head = (m_head + 1) % m_entries.size();
+        m_count--;
+    }
+    std::size_t offset = 0;
+    if(m_count) {
+        auto& newest = p_entry(0);
+        offset       = (newest.offset + newest.length) % m_data.size();
+    } else {
+        m_head = 0;
+    }
+    auto first = std::min(length, m_data.size() - offset);
+    std::memcpy(m_data.data() + offset, text.data(), first);
+    std::memcpy(m_data.data(), text.data() + first, length - first);
+    m_entries[(m_head + m_count) % m_entries.size()] = {static_cast<std::uint32_t>(offset),
+                                                        static_cast<std::uint32_t>(length)};
+    m_count++;
+    m_used += length;
+}
+
+auto message_history::last(std::size_t n, std::size_t max_bytes) const -> std::string {
+    n = std::min(n, m_count);
+    std::size_t taken = 0, bytes = 0;
+    while(taken < n) {
+        auto more = p_entry(taken).length + (taken ? 1 : 0);
+        if(bytes + more > max_bytes) {
+            break;
+        }
+        bytes += more;
+        taken++;
+    }
+    std::string result;
+    if(!taken && n) { //the newest message alone doesn't fit, it's cut rather than left out
+        auto& e    = p_entry(0);
+        auto first = std::min<std::size_t>(e.length, m_data.size() - e.offset);
+        result.append(m_data.data() + e.offset, first);
+        result.append(m_data.data(), e.length - first);
+        auto length = max_bytes;
+        while(length && (result[length] & 0xC0) == 0x80) {
+            length--; //don't split a multibyte character
+        }
+        result.resize(length);
+        return result;
+    }
+    result.reserve(bytes);
+    for(auto age = taken; age-- > 0;) {
+        auto& e    = p_entry(age);
+        auto first = std::min<std::size_t>(e.length, m_data.size() - e.offset);
+        result.append(m_data.data() + e.offset, first);
+        result.append(m_data.data(), e.length - first);
+        if(age) {
+            result += '\n';
+        }
+    }
+    return result;
+}
+
+void message_history::clear() {
+    std::vector<char>().swap(m_data); //assigning {} would keep the capacity
+    std::vector<entry>().swap(m_entries);
+    m_head  = 0;
+    m_count = 0;
+    m_used  = 0;
+}
+
+} // namespace bot
@@ -0,0 +1,446 @@
+#pragma once
+#include "components/logger.hpp"
+#include "core/logging_obj.h"
+#include "core/metrics.h"
+
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http.hpp>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <tgbot/tgbot.h>
+#include <thread>
+#include <vector>
+
+namespace bot {
+
+/**
+ * Settings of http_pool.
+ * */
+struct http_pool_config {
+    std::string url = "https://api.telegram.org"; /**< Bot API server, a plain http:// one works too */
+    std::size_t connections = 4;                  /**< Most open connections per host */
+    std::size_t pipeline    = 4;                  /**< Most requests in flight on one connection */
+    std::chrono::seconds idle_timeout {50};       /**< Idle connections older than that are closed, not reused */
+    std::chrono::seconds request_timeout {30};    /**< Time to connect, send and get a response, on top of long poll */
+    bool verify_peer = true;                      /**< Verify server's certificate and host name */
+};
+
+/**
+ * Bot API client that keeps HTTP/1.1 connections alive and reuses them,
+ * so a request costs a TCP and a TLS handshake only when there is no open connection to take. \n
+ * Connections are driven by the pool's own thread, callers of makeRequest block on a future. \n
+ * A request goes to an idle connection, then to a new one while there are less than config.connections,
+ * otherwise it's pipelined behind requests of the least loaded connection. Long polls, requests with
+ * a positive timeout argument, only take a connection of their own, so nothing waits behind them. \n
+ * When a connection breaks, requests sent over it fail, the ones queued behind them go to another connection. \n
+ * Responses are returned whatever their status, Bot API describes errors in the body.
+ * */
+class http_pool: public TgBot::HttpClient, public logging_obj {
+public:
+    using clock = std::chrono::steady_clock; /**< Clock of timeouts */
+
+    /**
+     * Constructor, starts the thread.
+     * @param conf settings.
+     * */
+    http_pool(const http_pool_config& conf = {});
+    /**
+     * Destructor, closes connections and joins the thread, requests in flight fail.
+     * */
+    ~http_pool();
+    http_pool(const http_pool&) = delete;
+    http_pool& operator=(const http_pool&) = delete;
+
+    /**
+     * Sends a request and waits for the response, thread-safe.
+     * Throws runtime exception if there is no response in time or the connection breaks.
+     * @param url url of the method.
+     * @param args arguments, sent as a form, none make a GET request.
+     * @returns body of the response.
+     * */
+    auto makeRequest(const TgBot::Url& url, const std::vector<TgBot::HttpReqArg>& args) const -> std::string override;
+
+protected:
+    using tcp        = boost::asio::ip::tcp;
+    using work_t     = boost::asio::executor_work_guard<boost::asio::io_context::executor_type>;
+    using response_t = boost::beast::http::response<boost::beast::http::string_body>;
+
+    /**
+     * Request waiting for or being served by a connection.
+     * */
+    struct job {
+        std::string origin;               /**< Protocol and host the request goes to */
+        std::string request;              /**< Serialized request */
+        clock::duration timeout;          /**< Time to get the response once a connection takes the job */
+        bool exclusive = false;           /**< Long poll, takes a connection of its own */
+        bool retried   = false;           /**< Already resent once */
+        bool on_idle   = false;           /**< Went to a connection that was idle, may be closed by the server */
+        clock::time_point start;          /**< Time of makeRequest */
+        clock::time_point deadline;       /**< Time the connection is closed if there is no response */
+        std::promise<std::string> result; /**< Body of the response */
+    };
+    using job_ptr = std::shared_ptr<job>;
+
+    /**
+     * Keep-alive connection to a host, requests are written in order and responses are read in the same order.
+     * */
+    struct connection {
+        connection(boost::asio::io_context& io, boost::asio::ssl::context* ssl): timer(io) {
+            if(ssl) {
+                secure.emplace(io, *ssl);
+            } else {
+                plain.emplace(io);
+            }
+        }
+        auto socket() -> tcp::socket& { return secure ? secure->next_layer() : *plain; }
+
+        std::string origin;                                          /**< Protocol and host */
+        std::string host;                                            /**< Host name without port */
+        std::string port;                                            /**< Port or service name */
+        std::optional<tcp::socket> plain;                            /**< Socket of an http connection */
+        std::optional<boost::asio::ssl::stream<tcp::socket>> secure; /**< Stream of an https connection */
+        boost::asio::steady_timer timer;                             /**< Fires at the deadline of the oldest job */
+        boost::beast::flat_buffer buffer;                            /**< Bytes read past the last response */
+        response_t response;                                         /**< Response being read */
+        std::deque<job_ptr> to_write;                                /**< Jobs to send, the first one may be sending */
+        std::deque<job_ptr> in_flight;                               /**< Sent jobs waiting for responses */
+        bool open      = false;                                      /**< Connected and handshaked */
+        bool closed    = false;                                      /**< Failed or closed, dropped from the pool */
+        bool writing   = false;                                      /**< Write is pending */
+        bool reading   = false;                                      /**< Read is pending */
+        bool timed_out = false;                                      /**< Closed by the timer */
+        clock::time_point last_used;                                 /**< Time it became idle */
+
+        auto pending() const -> std::size_t { return to_write.size() + in_flight.size(); }
+        auto exclusive() const -> bool {
+            return (!to_write.empty() && to_write.front()->exclusive) ||
+                   (!in_flight.empty() && in_flight.front()->exclusive);
+        }
+    };
+    using connection_ptr = std::shared_ptr<connection>;
+
+    //the pool is driven by its thread, makeRequest only hands jobs over, hence mutable
+    http_pool_config m_conf;                           /**< Settings */
+    TgBot::HttpParser m_parser;                        /**< Serializes requests the same way tgbot does */
+    mutable boost::asio::io_context m_io;              /**< Context of the pool's thread */
+    mutable boost::asio::ssl::context m_ssl;           /**< TLS settings of https connections */
+    mutable tcp::resolver m_resolver;                  /**< Resolves hosts of new connections */
+    mutable std::vector<connection_ptr> m_connections; /**< Open and opening connections */
+    mutable std::deque<job_ptr> m_waiting;             /**< Jobs no connection can take yet */
+    std::optional<work_t> m_work;                      /**< Keeps the context running until destruction */
+    std::thread m_thread;                              /**< Thread running the context */
+
+    metrics::counter& m_opened;    /**< Connections opened */
+    metrics::counter& m_reused;    /**< Requests sent over an open connection */
+    metrics::counter& m_pipelined; /**< Requests sent before the previous response arrived */
+    metrics::counter& m_retries;   /**< Requests resent after a reused connection broke */
+    metrics::counter& m_errors;    /**< Requests failed */
+    metrics::gauge& m_open_gauge;  /**< Connections in the pool */
+    metrics::histogram& m_latency; /**< Time from makeRequest to the response */
+
+    void p_pump() const;
+    auto p_take(const job_ptr& j) const -> connection_ptr;
+    void p_assign(const connection_ptr& c, const job_ptr& j) const;
+    void p_connect(const connection_ptr& c) const;
+    void p_write(const connection_ptr& c) const;
+    void p_read(const connection_ptr& c) const;
+    void p_arm(const connection_ptr& c) const;
+    void p_close(const connection_ptr& c) const;
+    void p_fail(const connection_ptr& c, const std::string& what) const;
+    template<class Func>
+    static void p_visit(connection& c, Func&& f) {
+        if(c.secure) {
+            f(*c.secure);
+        } else {
+            f(*c.plain);
+        }
+    }
+};
+
+http_pool::http_pool(const http_pool_config& conf):
+    m_conf(conf), m_ssl(boost::asio::ssl::context::tls_client), m_resolver(m_io), m_work(m_io.get_executor()),
+    m_opened(metrics::get_counter("bot_http_connections_opened_total",
+                                  "Bot API connections opened, each costs a TCP and for https a TLS handshake")),
+    m_reused(metrics::get_counter("bot_http_handshakes_avoided_total",
+                                  "Bot API requests sent over an already open connection")),
+    m_pipelined(metrics::get_counter("bot_http_pipelined_total",
+                                     "Bot API requests sent before the previous response on their connection")),
+    m_retries(metrics::get_counter("bot_http_retries_total",
+                                   "Bot API requests resent after a reused idle connection broke")),
+    m_errors(metrics::get_counter("bot_http_errors_total", "Bot API requests failed without a response")),
+    m_open_gauge(metrics::get_gauge("bot_http_connections", "Open and opening Bot API connections")),
+    m_latency(metrics::get_histogram("bot_http_request_duration_seconds",
+                                     "Bot API request latency including waiting for a connection")) {
+    m_conf.connections = std::max<std::size_t>(m_conf.connections, 1);
+    m_conf.pipeline    = std::max<std::size_t>(m_conf.pipeline, 1);
+    if(m_conf.verify_peer) {
+        m_ssl.set_default_verify_paths();
+        m_ssl.set_verify_mode(boost::asio::ssl::verify_peer);
+    } else {
+        m_ssl.set_verify_mode(boost::asio::ssl::verify_none);
+    }
+    m_thread = std::thread([this] { m_io.run(); });
+    m_lgr.info("http_pool::http_pool url:{} connections:{} pipeline:{} idle timeout:{}s", m_conf.url,
+               m_conf.connections, m_conf.pipeline, m_conf.idle_timeout.count());
+}
+
+http_pool::~http_pool() {
+    boost::asio::post(m_io, [this] {
+        for(auto c: std::vector<connection_ptr>(m_connections)) {
+            p_close(c);
+        }
+        m_work.reset();
+    });
+    m_thread.join();
+}
+
+auto http_pool::makeRequest(const TgBot::Url& url, const std::vector<TgBot::HttpReqArg>& args) const -> std::string {
+    auto j      = std::make_shared<job>();
+    j->origin   = url.protocol + "://" + url.host;
+    j->request  = m_parser.generateRequest(url, args, true);
+    j->timeout  = m_conf.request_timeout;
+    j->start    = clock::now();
+    for(auto& arg: args) {
+        if(arg.name == "timeout" && !arg.value.empty() && arg.value != "0") {
+            j->exclusive = true;
+            j->timeout += std::chrono::seconds(std::stoul(arg.value));
+        }
+    }
+    auto result = j->result.get_future();
+    boost::asio::post(m_io, [this, j] {
+        m_waiting.emplace_back(j);
+        p_pump();
+    });
+    return result.get();
+}
+
+void http_pool::p_pump() const {
+    //jobs are taken in order, but a long poll waiting for a connection doesn't hold up the others
+    for(auto it = m_waiting.begin(); it != m_waiting.end();) {
+        if(auto c = p_take(*it)) {
+            p_assign(c, *it);
+            it = m_waiting.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+auto http_pool::p_take(const job_ptr& j) const -> connection_ptr {
+    auto now = clock::now();
+    connection_ptr idle, least;
+    std::size_t count = 0;
+    for(auto c: std::vector<connection_ptr>(m_connections)) {
+        if(c->origin != j->origin) {
+            continue;
+        }
+        if(c->open && c->pending() == 0) {
+            if(now - c->last_used > m_conf.idle_timeout) {
+                p_close(c); //server is likely to have closed it already
+                continue;
+            }
+            //the most recently used one is the least likely to be closed by the server
+            if(!idle || c->last_used > idle->last_used) {
+                idle = c;
+            }
+        } else if(!j->exclusive && !c->exclusive() && c->pending() < m_conf.pipeline &&
+                  (!least || c->pending() < least->pending())) {
+            least = c;
+        }
+        count++;
+    }
+    if(idle) {
+        j->on_idle = true;
+        return idle;
+    }
+    if(count < m_conf.connections) {
+        auto tls = j->origin.compare(0, 8, "https://") == 0;
+        auto c   = std::make_shared<connection>(m_io, tls ? &m_ssl : nullptr);
+        c->origin     = j->origin;
+        auto hostport = j->origin.substr(j->origin.find("://") + 3);
+        auto colon    = hostport.rfind(':');
+        c->host       = hostport.substr(0, colon);
+        c->port       = colon == std::string::npos ? (tls ? "443" : "80") : hostport.substr(colon + 1);
+        m_connections.emplace_back(c);
+        m_open_gauge.set(m_connections.size());
+        p_connect(c);
+        return c;
+    }
+    return least;
+}
+
+void http_pool::p_assign(const connection_ptr& c, const job_ptr& j) const {
+    if(c->open) {
+        m_reused.add();
+        if(c->pending()) {
+            m_pipelined.add();
+        }
+    }
+    j->deadline = clock::now() + j->timeout;
+    c->to_write.emplace_back(j);
+    if(c->pending() == 1) {
+        p_arm(c);
+    }
+    p_write(c);
+}
+
+void http_pool::p_connect(const connection_ptr& c) const {
+    m_opened.add();
+    m_lgr.debug("http_pool::p_connect {}", c->origin);
+    m_resolver.async_resolve(c->host, c->port, [this, c](auto ec, tcp::resolver::results_type hosts) {
+        if(ec) {
+            return p_fail(c, "resolve failed: " + ec.message());
+        }
+        boost::asio::async_connect(c->socket(), hosts, [this, c](auto ec, auto&&) {
+            if(ec) {
+                return p_fail(c, "connect failed: " + ec.message());
+            }
+            c->socket().set_option(tcp::no_delay(true));
+            if(!c->secure) {
+                c->open = true;
+                return p_write(c);
+            }
+            SSL_set_tlsext_host_name(c->secure->native_handle(), c->host.c_str()); //SNI
+            if(m_conf.verify_peer) {
+                c->secure->set_verify_callback(boost::asio::ssl::host_name_verification(c->host));
+            }
+            c->secure->async_handshake(boost::asio::ssl::stream_base::client, [this, c](auto ec) {
+                if(ec) {
+                    return p_fail(c, "handshake failed: " + ec.message());
+                }
+                c->open = true;
+                p_write(c);
+            });
+        });
+    });
+}
+
+void http_pool::p_write(const connection_ptr& c) const {
+    if(!c->open || c->closed || c->writing || c->to_write.empty()) {
+        return;
+    }
+    c->writing = true;
+    auto& data = c->to_write.front()->request;
+    p_visit(*c, [&](auto& stream) {
+        boost::asio::async_write(stream, boost::asio::buffer(data), [this, c](auto ec, std::size_t) {
+            if(c->closed) {
+                c->writing = false;
+                return;
+            }
+            if(ec) {
+                return p_fail(c, "write failed: " + ec.message()); //still writing, the request may be partly sent
+            }
+            c->writing = false;
+            c->in_flight.emplace_back(std::move(c->to_write.front()));
+            c->to_write.pop_front();
+            p_read(c);
+            p_write(c);
+        });
+    });
+}
+
+void http_pool::p_read(const connection_ptr& c) const {
+    if(c->closed || c->reading || c->in_flight.empty()) {
+        return;
+    }
+    c->reading  = true;
+    c->response = {};
+    p_visit(*c, [&](auto& stream) {
+        boost::beast::http::async_read(stream, c->buffer, c->response, [this, c](auto ec, std::size_t) {
+            c->reading = false;
+            if(c->closed) {
+                return;
+            }
+            if(ec) {
+                return p_fail(c, "read failed: " + ec.message());
+            }
+            auto j = std::move(c->in_flight.front());
+            c->in_flight.pop_front();
+            for(auto& rest: c->in_flight) {
+                rest->on_idle = false; //the connection is alive after all
+            }
+            m_latency.record(clock::now() - j->start);
+            j->result.set_value(std::move(c->response.body()));
+            c->last_used = clock::now();
+            if(!c->response.keep_alive()) {
+                //requests behind that one won't be answered
+                m_lgr.debug("http_pool::p_read {} closed by the server", c->origin);
+                return p_fail(c, "connection closed by the server");
+            }
+            p_arm(c);
+            p_read(c);
+            p_pump();
+        });
+    });
+}
+
+void http_pool::p_arm(const connection_ptr& c) const {
+    if(c->pending() == 0) {
+        c->timer.cancel();
+        return;
+    }
+    auto deadline = c->in_flight.empty() ? c->to_write.front()->deadline : c->in_flight.front()->deadline;
+    c->timer.expires_at(deadline);
+    c->timer.async_wait([this, c](auto ec) {
+        if(ec || c->closed) {
+            return; //rearmed or closed
+        }
+        c->timed_out = true;
+        p_fail(c, "timed out");
+    });
+}
+
+void http_pool::p_close(const connection_ptr& c) const {
+    if(c->closed) {
+        return;
+    }
+    c->closed = true;
+    boost::system::error_code ec;
+    c->socket().close(ec);
+    c->timer.cancel();
+    m_connections.erase(std::remove(m_connections.begin(), m_connections.end(), c), m_connections.end());
+    m_open_gauge.set(m_connections.size());
+}
+
+void http_pool::p_fail(const connection_ptr& c, const std::string& what) const {
+    p_close(c);
+    std::deque<job_ptr> jobs;
+    jobs.swap(c->in_flight);
+    if(c->writing || !c->open) {
+        //the one being written may have reached the server, and if it couldn't connect, the rest can't either
+        auto sent = c->open ? c->to_write.begin() + 1 : c->to_write.end();
+        jobs.insert(jobs.end(), c->to_write.begin(), sent);
+        c->to_write.erase(c->to_write.begin(), sent);
+    }
+    //jobs that were never sent go to another connection ahead of newer ones
+    for(auto& j: c->to_write) {
+        j->on_idle = false;
+    }
+    m_waiting.insert(m_waiting.begin(), c->to_write.begin(), c->to_write.end());
+    c->to_write.clear();
+    for(auto& j: jobs) {
+        //a reused idle connection may have been closed by the server before it got the request
+        if(j->on_idle && !j->retried && !c->timed_out) {
+            j->retried = true;
+            j->on_idle = false;
+            m_retries.add();
+            m_waiting.emplace_back(j);
+            continue;
+        }
+        m_errors.add();
+        auto mes = fmt::format("http_pool {} {}", c->origin, what);
+        m_lgr.warn(mes);
+        j->result.set_exception(std::make_exception_ptr(std::runtime_error(mes)));
+    }
+    p_pump();
+}
+
+} // namespace bot
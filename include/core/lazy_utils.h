@@ -1,7 +1,15 @@
 #pragma once
+#include "core/registry.h"
+
 #include <algorithm>
 #include <chrono>
+#include <cstddef>
 #include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace bot {
 namespace utils {
@@ -21,6 +29,11 @@ auto stat_cast(std::unique_ptr<Arg>& ptr) {
     return static_cast<T*>(ptr.get());
 }
 
+template<class T, class Arg>
+auto stat_cast(const entity_ptr<Arg>& ptr) {
+    return static_cast<T*>(ptr.get());
+}
+
 template<class T, class Arg>
 auto dyn_cast(std::shared_ptr<Arg> ptr) {
     return std::dynamic_pointer_cast<T>(ptr);
@@ -31,6 +44,11 @@ auto dyn_cast(std::unique_ptr<Arg>& ptr) {
     return dynamic_cast<T*>(ptr.get());
 }
 
+template<class T, class Arg>
+auto dyn_cast(const entity_ptr<Arg>& ptr) {
+    return dynamic_cast<T*>(ptr.get());
+}
+
 template<class T, class Val = typename T::value_type>
 auto find(const T& cont, const Val& val) {
     auto it = std::find(cont.begin(), cont.end(), val);
@@ -92,5 +110,47 @@ auto measure(Func f, Args&&... args) -> T {
     return std::chrono::duration_cast<T>(time1 - time0);
 }
 
+/**
+ * Heap bytes owned by a string, 0 if it fits into the string's inline buffer.
+ * Heap usage functions count requested bytes only, allocator's overhead is not included.
+ * */
+template<class Char, class Traits, class Alloc>
+auto heap_usage(const std::basic_string<Char, Traits, Alloc>& str) -> std::size_t {
+    auto data = reinterpret_cast<const std::byte*>(str.data());
+    auto self = reinterpret_cast<const std::byte*>(&str);
+    if(!std::less<>()(data, self) && std::less<>()(data, self + sizeof(str))) {
+        return 0;
+    }
+    return (str.capacity() + 1) * sizeof(Char);
+}
+/**
+ * Heap bytes of a vector's buffer, heap memory of the elements themselves is not included.
+ * */
+template<class T, class Alloc>
+auto heap_usage(const std::vector<T, Alloc>& vec) -> std::size_t {
+    return vec.capacity() * sizeof(T);
+}
+/**
+ * Heap bytes of a set's nodes, a node is a value and a red-black tree header.
+ * */
+template<class T, class Comp, class Alloc>
+auto heap_usage(const std::set<T, Comp, Alloc>& set) -> std::size_t {
+    return set.size() * (sizeof(T) + 4 * sizeof(void*));
+}
+/**
+ * Heap bytes of a map's nodes, a node is a pair and a red-black tree header.
+ * */
+template<class K, class V, class Comp, class Alloc>
+auto heap_usage(const std::map<K, V, Comp, Alloc>& map) -> std::size_t {
+    return map.size() * (sizeof(std::pair<const K, V>) + 4 * sizeof(void*));
+}
+/**
+ * Heap bytes of an unordered map's buckets and nodes, a node is a pair, a next pointer and a cached hash.
+ * */
+template<class K, class V, class Hash, class Eq, class Alloc>
+auto heap_usage(const std::unordered_map<K, V, Hash, Eq, Alloc>& map) -> std::size_t {
+    return map.bucket_count() * sizeof(void*) + map.size() * (sizeof(std::pair<const K, V>) + 2 * sizeof(void*));
+}
+
 } // namespace utils
 } // namespace bot
\ No newline at end of file
@@ -2,7 +2,29 @@
 
 #include "components/logger.hpp"
 
+#include <string>
+#include <type_traits>
+#include <utility>
+
 namespace bot {
+/**
+ * Part of a log message that is rendered only when the message is actually written.
+ * Use it for prefixes that would otherwise be formatted on every call.
+ * */
+template<class F>
+struct lazy_str {
+    F render; /**< Callable returning a string */
+};
+
+/**
+ * Wraps callable into lazy_str.
+ * @param render callable returning a string, may capture by reference.
+ * */
+template<class F>
+auto lazy(F&& render) -> lazy_str<std::decay_t<F>> {
+    return {std::forward<F>(render)};
+}
+
 /** class that likes to write logs
      * */
 class logging_obj {
@@ -15,13 +37,36 @@ public:
     logging_obj();
 
     template<class Mes>
-    auto desc(const Mes& mes) -> std::string;
+    auto desc(const Mes& mes) const -> std::string;
+
+    /**
+     * Lazy log prefix, consists of function name and sender's description.
+     * @param name name of a function.
+     * @param mes message, must outlive the prefix.
+     * */
+    template<class Mes>
+    auto log_prefix(const char* name, const Mes& mes) const;
 };
 
 logging_obj::logging_obj(): m_lgr(get_logger()) { }
 
 template<class Mes>
-auto logging_obj::desc(const Mes& mes) -> std::string {
+auto logging_obj::desc(const Mes& mes) const -> std::string {
     return fmt::format("{} {}[{}]", mes->chat->firstName, mes->chat->lastName, mes->chat->id);
 }
-} // namespace bot
\ No newline at end of file
+
+template<class Mes>
+auto logging_obj::log_prefix(const char* name, const Mes& mes) const {
+    return lazy([this, name, &mes] { return fmt::format("{} {}", name, desc(mes)); });
+}
+} // namespace bot
+
+namespace fmt {
+template<class F>
+struct formatter<bot::lazy_str<F>>: formatter<std::string> {
+    template<typename FormatContext>
+    auto format(const bot::lazy_str<F>& str, FormatContext& ctx) {
+        return formatter<std::string>::format(str.render(), ctx);
+    }
+};
+} // namespace fmt
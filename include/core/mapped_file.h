@@ -0,0 +1,97 @@
+#pragma once
+#include "components/logger.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace bot {
+
+/**
+ * Read-only memory mapping of a whole file. \n
+ * Pages are read by the kernel when they're touched and shared with the page cache,
+ * so opening a big file is cheap and only the parts that are used take memory.
+ * The mapping stays valid if the file is replaced by a rename.
+ * */
+class mapped_file {
+public:
+    /**
+     * Constructor, maps the file.
+     * Throws runtime exception if the file can't be opened or mapped.
+     * @param path path of a file.
+     * */
+    mapped_file(const std::string& path);
+    /**
+     * Destructor, unmaps the file.
+     * */
+    ~mapped_file();
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+    mapped_file(mapped_file&& other) noexcept;
+    mapped_file& operator=(mapped_file&& other) noexcept;
+
+    /**
+     * Returns the first byte of the file, nullptr if it's empty.
+     * */
+    auto data() const -> const char* { return m_data; }
+    /**
+     * Returns size of the file in bytes.
+     * */
+    auto size() const -> std::size_t { return m_size; }
+
+protected:
+    const char* m_data = nullptr; /**< Mapped bytes */
+    std::size_t m_size = 0;       /**< Length of the mapping */
+};
+
+mapped_file::mapped_file(const std::string& path) {
+    auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        throw std::runtime_error(fmt::format("can't open {}: {}", path, std::strerror(errno)));
+    }
+    struct stat st {};
+    if(::fstat(fd, &st) != 0) {
+        auto err = errno;
+        ::close(fd);
+        throw std::runtime_error(fmt::format("can't stat {}: {}", path, std::strerror(err)));
+    }
+    m_size = static_cast<std::size_t>(st.st_size);
+    if(m_size) {
+        auto* data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data == MAP_FAILED) {
+            auto err = errno;
+            ::close(fd);
+            throw std::runtime_error(fmt::format("can't map {}: {}", path, std::strerror(err)));
+        }
+        m_data = static_cast<const char*>(data);
+    }
+    ::close(fd); //the mapping holds the file
+}
+
+mapped_file::~mapped_file() {
+    if(m_data) {
+        ::munmap(const_cast<char*>(m_data), m_size);
+    }
+}
+
+mapped_file::mapped_file(mapped_file&& other) noexcept:
+    m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)) { }
+
+mapped_file& mapped_file::operator=(mapped_file&& other) noexcept {
+    if(this != &other) {
+        if(m_data) {
+            ::munmap(const_cast<char*>(m_data), m_size);
+        }
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+    }
+    return *this;
+}
+
+} // namespace bot
@@ -0,0 +1,365 @@
+#pragma once
+#include "patterns/singleton.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fmt/format.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bot {
+namespace metrics {
+
+constexpr std::size_t shards_count = 8; /**< Amount of per-thread shards of every metric */
+
+/**
+ * Returns shard index of the calling thread.
+ * Threads get their shards round-robin on the first call.
+ * */
+inline auto shard_index() noexcept -> std::size_t {
+    static std::atomic<std::size_t> next {0};
+    thread_local const std::size_t index = next.fetch_add(1, std::memory_order_relaxed) % shards_count;
+    return index;
+}
+
+/**
+ * Monotonic counter. Every thread increments it's own cache line, shards are summed on scrape.
+ * */
+class counter {
+public:
+    /**
+     * Increments the counter.
+     * @param value value to add.
+     * */
+    void add(std::uint64_t value = 1) noexcept {
+        m_shards[shard_index()].value.fetch_add(value, std::memory_order_relaxed);
+    }
+    /**
+     * Sums all shards.
+     * @returns current value.
+     * */
+    auto value() const noexcept -> std::uint64_t {
+        std::uint64_t result = 0;
+        for(auto& s: m_shards) {
+            result += s.value.load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+protected:
+    struct alignas(64) shard {
+        std::atomic<std::uint64_t> value {0};
+    };
+    std::array<shard, shards_count> m_shards; /**< Per-thread shards */
+};
+
+/**
+ * Gauge, a value that may go up and down.
+ * */
+class gauge {
+public:
+    void set(std::int64_t value) noexcept { m_value.store(value, std::memory_order_relaxed); }
+    void add(std::int64_t value = 1) noexcept { m_value.fetch_add(value, std::memory_order_relaxed); }
+    void sub(std::int64_t value = 1) noexcept { m_value.fetch_sub(value, std::memory_order_relaxed); }
+    auto value() const noexcept -> std::int64_t { return m_value.load(std::memory_order_relaxed); }
+
+protected:
+    std::atomic<std::int64_t> m_value {0}; /**< Current value */
+};
+
+/**
+ * Latency histogram with HDR-style log-linear buckets over nanoseconds. \n
+ * Every power of two is split into 4 sub-buckets, so relative error is below 25%.
+ * Values up to 2^40ns (~18 minutes) are distinguished, bigger ones go to the last bucket.
+ * */
+class histogram {
+public:
+    static constexpr std::size_t sub_bits      = 2;              /**< Bits of precision inside a power of two */
+    static constexpr std::size_t sub_count     = 1 << sub_bits;  /**< Sub-buckets per power of two */
+    static constexpr std::size_t buckets_count = sub_count * 40; /**< Amount of buckets */
+
+    /** Merged state of all shards. */
+    struct snapshot_t {
+        std::array<std::uint64_t, buckets_count> buckets {}; /**< Per-bucket counts, not cumulative */
+        std::uint64_t count = 0;                             /**< Amount of recorded values */
+        std::uint64_t sum   = 0;                             /**< Sum of recorded values, ns */
+
+        /**
+         * Estimates quantile by bucket's upper bound.
+         * @param q quantile in [0, 1].
+         * @returns value in ns.
+         * */
+        auto quantile(double q) const -> std::uint64_t;
+    };
+
+    /**
+     * Records a value.
+     * @param ns value in nanoseconds.
+     * */
+    void record(std::uint64_t ns) noexcept {
+        auto& s = m_shards[shard_index()];
+        s.buckets[bucket_index(ns)].fetch_add(1, std::memory_order_relaxed);
+        s.sum.fetch_add(ns, std::memory_order_relaxed);
+    }
+    /**
+     * Records a duration.
+     * @param d duration to record.
+     * */
+    template<class Rep, class Period>
+    void record(std::chrono::duration<Rep, Period> d) noexcept {
+        record(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()));
+    }
+    /**
+     * Merges all shards.
+     * */
+    auto snapshot() const -> snapshot_t;
+
+    /**
+     * Maps a value to it's bucket.
+     * @param v value in ns.
+     * */
+    static constexpr auto bucket_index(std::uint64_t v) noexcept -> std::size_t {
+        if(v < sub_count) {
+            return static_cast<std::size_t>(v);
+        }
+        std::size_t msb = 63 - __builtin_clzll(v);
+        auto index      = sub_count * (msb - sub_bits + 1) + ((v >> (msb - sub_bits)) & (sub_count - 1));
+        return index < buckets_count ? index : buckets_count - 1;
+    }
+    /**
+     * Exclusive upper bound of a bucket.
+     * @param index bucket's index.
+     * @returns value in ns.
+     * */
+    static constexpr auto bucket_upper(std::size_t index) noexcept -> std::uint64_t {
+        if(index < sub_count) {
+            return index + 1;
+        }
+        auto msb = index / sub_count + sub_bits - 1;
+        auto sub = index % sub_count;
+        return (sub_count + sub + 1) << (msb - sub_bits);
+    }
+
+protected:
+    struct alignas(64) shard {
+        std::array<std::atomic<std::uint64_t>, buckets_count> buckets {};
+        std::atomic<std::uint64_t> sum {0};
+    };
+    std::array<shard, shards_count> m_shards; /**< Per-thread shards */
+};
+
+auto histogram::snapshot() const -> snapshot_t {
+    snapshot_t result;
+    for(auto& s: m_shards) {
+        for(std::size_t i = 0; i < buckets_count; i++) {
+            auto count = s.buckets[i].load(std::memory_order_relaxed);
+            result.buckets[i] += count;
+            result.count += count;
+        }
+        result.sum += s.sum.load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+auto histogram::snapshot_t::quantile(double q) const -> std::uint64_t {
+    if(count == 0) {
+        return 0;
+    }
+    auto rank         = static_cast<std::uint64_t>(q * (count - 1)) + 1;
+    std::uint64_t acc = 0;
+    for(std::size_t i = 0; i < buckets_count; i++) {
+        acc += buckets[i];
+        if(acc >= rank) {
+            return bucket_upper(i) - 1;
+        }
+    }
+    return bucket_upper(buckets_count - 1) - 1;
+}
+
+/**
+ * RAII timer, records it's lifetime into a histogram.
+ * */
+class scoped_timer {
+public:
+    scoped_timer(histogram& hist): m_hist(hist), m_start(std::chrono::steady_clock::now()) { }
+    ~scoped_timer() { m_hist.record(std::chrono::steady_clock::now() - m_start); }
+
+protected:
+    histogram& m_hist;                             /**< Histogram to record into */
+    std::chrono::steady_clock::time_point m_start; /**< Start time */
+};
+
+/**
+ * Storage of all metrics. \n
+ * Creation takes a lock, so metrics are expected to be created once and cached by reference.
+ * Recording never locks.
+ * */
+class registry: public patterns::singleton<registry> {
+public:
+    using labels_t = std::vector<std::pair<std::string, std::string>>; /**< Labels define */
+
+    registry(singleton_token) { }
+
+    /**
+     * Returns counter, creates it if needed.
+     * @param name name of a metric.
+     * @param help description of a metric.
+     * @param labels labels of a series.
+     * */
+    auto get_counter(const std::string& name, const std::string& help, const labels_t& labels = {}) -> counter& {
+        return p_get(m_counters, name, help, labels);
+    }
+    /**
+     * Returns gauge, creates it if needed.
+     * @param name name of a metric.
+     * @param help description of a metric.
+     * @param labels labels of a series.
+     * */
+    auto get_gauge(const std::string& name, const std::string& help, const labels_t& labels = {}) -> gauge& {
+        return p_get(m_gauges, name, help, labels);
+    }
+    /**
+     * Returns histogram, creates it if needed.
+     * @param name name of a metric, values are exported in seconds.
+     * @param help description of a metric.
+     * @param labels labels of a series.
+     * */
+    auto get_histogram(const std::string& name, const std::string& help, const labels_t& labels = {})
+        -> histogram& {
+        return p_get(m_histograms, name, help, labels);
+    }
+    /**
+     * Renders all metrics in Prometheus text exposition format.
+     * */
+    auto render_prometheus() const -> std::string;
+
+protected:
+    template<class T>
+    struct family {
+        std::string help;
+        std::vector<std::pair<labels_t, std::unique_ptr<T>>> series;
+    };
+    template<class T>
+    using families_t = std::map<std::string, family<T>>;
+
+    mutable std::mutex m_mutex;         /**< Guards creation and scrape */
+    families_t<counter> m_counters;     /**< Counters by name */
+    families_t<gauge> m_gauges;         /**< Gauges by name */
+    families_t<histogram> m_histograms; /**< Histograms by name */
+
+    template<class T>
+    auto p_get(families_t<T>& families, const std::string& name, const std::string& help, const labels_t& labels)
+        -> T&;
+    static auto p_render_labels(const labels_t& labels, const std::string& extra = "") -> std::string;
+};
+
+template<class T>
+auto registry::p_get(families_t<T>& families, const std::string& name, const std::string& help,
+                     const labels_t& labels) -> T& {
+    std::lock_guard lock(m_mutex);
+    auto& fam = families[name];
+    if(fam.help.empty()) {
+        fam.help = help;
+    }
+    for(auto& [l, metric]: fam.series) {
+        if(l == labels) {
+            return *metric;
+        }
+    }
+    return *fam.series.emplace_back(labels, std::make_unique<T>()).second;
+}
+
+auto registry::p_render_labels(const labels_t& labels, const std::string& extra) -> std::string {
+    if(labels.empty() && extra.empty()) {
+        return "";
+    }
+    std::string result = "{";
+    for(auto& [key, value]: labels) {
+        result += key + "=\"";
+        for(auto c: value) {
+            if(c == '\\' || c == '"') {
+                result += '\\';
+                result += c;
+            } else if(c == '\n') {
+                result += "\\n";
+            } else {
+                result += c;
+            }
+        }
+        result += "\",";
+    }
+    result += extra;
+    if(result.back() == ',') {
+        result.pop_back();
+    }
+    return result + "}";
+}
+
+auto registry::render_prometheus() const -> std::string {
+    std::lock_guard lock(m_mutex);
+    std::string result;
+    for(auto& [name, fam]: m_counters) {
+        result += fmt::format("# HELP {} {}\n# TYPE {} counter\n", name, fam.help, name);
+        for(auto& [labels, c]: fam.series) {
+            result += fmt::format("{}{} {}\n", name, p_render_labels(labels), c->value());
+        }
+    }
+    for(auto& [name, fam]: m_gauges) {
+        result += fmt::format("# HELP {} {}\n# TYPE {} gauge\n", name, fam.help, name);
+        for(auto& [labels, g]: fam.series) {
+            result += fmt::format("{}{} {}\n", name, p_render_labels(labels), g->value());
+        }
+    }
+    for(auto& [name, fam]: m_histograms) {
+        result += fmt::format("# HELP {} {}\n# TYPE {} histogram\n", name, fam.help, name);
+        for(auto& [labels, h]: fam.series) {
+            auto snap             = h->snapshot();
+            std::uint64_t cumul   = 0;
+            const std::size_t min = histogram::bucket_index(1024) - 1; //~1us, smaller buckets are merged
+            for(std::size_t i = 0; i < histogram::buckets_count; i++) {
+                cumul += snap.buckets[i];
+                //export only powers of two, they are exact bucket bounds
+                if(i < min || (i + 1) % histogram::sub_count != 0 || i + 1 == histogram::buckets_count) {
+                    continue;
+                }
+                auto le = fmt::format("le=\"{:g}\"", histogram::bucket_upper(i) / 1e9);
+                result += fmt::format("{}_bucket{} {}\n", name, p_render_labels(labels, le), cumul);
+            }
+            result += fmt::format("{}_bucket{} {}\n", name, p_render_labels(labels, "le=\"+Inf\""), snap.count);
+            result += fmt::format("{}_sum{} {:g}\n", name, p_render_labels(labels), snap.sum / 1e9);
+            result += fmt::format("{}_count{} {}\n", name, p_render_labels(labels), snap.count);
+        }
+    }
+    return result;
+}
+
+/**
+ * Shortcut for registry::get_counter.
+ * */
+inline auto get_counter(const std::string& name, const std::string& help, const registry::labels_t& labels = {})
+    -> counter& {
+    return registry::get_instance().get_counter(name, help, labels);
+}
+/**
+ * Shortcut for registry::get_gauge.
+ * */
+inline auto get_gauge(const std::string& name, const std::string& help, const registry::labels_t& labels = {})
+    -> gauge& {
+    return registry::get_instance().get_gauge(name, help, labels);
+}
+/**
+ * Shortcut for registry::get_histogram.
+ * */
+inline auto get_histogram(const std::string& name, const std::string& help, const registry::labels_t& labels = {})
+    -> histogram& {
+    return registry::get_instance().get_histogram(name, help, labels);
+}
+
+} // namespace metrics
+} // namespace bot
@@ -0,0 +1,87 @@
+#pragma once
+#include "core/logging_obj.h"
+#include "core/metrics.h"
+
+#include <boost/asio.hpp>
+#include <string>
+#include <thread>
+
+namespace bot {
+namespace metrics {
+
+/**
+ * Local HTTP endpoint that serves metrics in Prometheus text format on GET /metrics. \n
+ * Listens on loopback only and serves requests one by one from it's own thread.
+ * */
+class http_endpoint: public logging_obj {
+public:
+    /**
+     * Starts listening.
+     * @param port port on 127.0.0.1 to listen on.
+     * */
+    http_endpoint(unsigned short port);
+    /**
+     * Stops listening and joins the thread.
+     * */
+    ~http_endpoint();
+
+protected:
+    boost::asio::io_context m_io;              /**< Context of the endpoint's thread */
+    boost::asio::ip::tcp::acceptor m_acceptor; /**< Acceptor on the loopback */
+    std::thread m_thread;                      /**< Thread running the context */
+
+    void p_accept();
+    void p_serve(boost::asio::ip::tcp::socket& socket);
+};
+
+http_endpoint::http_endpoint(unsigned short port):
+    m_acceptor(m_io, {boost::asio::ip::address_v4::loopback(), port}) {
+    m_lgr.info("metrics::http_endpoint listening on 127.0.0.1:{}", port);
+    p_accept();
+    m_thread = std::thread([this] { m_io.run(); });
+}
+
+http_endpoint::~http_endpoint() {
+    m_io.stop();
+    if(m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void http_endpoint::p_accept() {
+    m_acceptor.async_accept([this](boost::system::error_code ec, boost::asio::ip::tcp::socket socket) {
+        if(!ec) {
+            p_serve(socket);
+        }
+        p_accept();
+    });
+}
+
+void http_endpoint::p_serve(boost::asio::ip::tcp::socket& socket) {
+    boost::system::error_code ec;
+    boost::asio::streambuf buf;
+    boost::asio::read_until(socket, buf, "\r\n\r\n", ec);
+    if(ec) {
+        m_lgr.debug("metrics::http_endpoint read failed: {}", ec.message());
+        return;
+    }
+    std::istream is(&buf);
+    std::string method, path;
+    is >> method >> path;
+
+    std::string status = "200 OK", type = "text/plain; version=0.0.4", body;
+    if(method != "GET") {
+        status = "405 Method Not Allowed";
+    } else if(path == "/metrics") {
+        body = registry::get_instance().render_prometheus();
+    } else {
+        status = "404 Not Found";
+    }
+    auto response = fmt::format("HTTP/1.1 {}\r\nContent-Type: {}\r\nContent-Length: {}\r\nConnection: close\r\n\r\n{}",
+                                status, type, body.size(), body);
+    boost::asio::write(socket, boost::asio::buffer(response), ec);
+    socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+}
+
+} // namespace metrics
+} // namespace bot
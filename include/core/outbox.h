@@ -0,0 +1,431 @@
+#pragma once
+#include "components/logger.hpp"
+#include "core/logging_obj.h"
+#include "core/metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tgbot/tgbot.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace bot {
+
+/**
+ * Threads that help the calling thread with a batch of jobs. They're started once, kept for later batches
+ * and joined by the destructor, so a batch doesn't pay for starting threads.
+ * */
+class send_pool {
+public:
+    using job_t = std::function<void(std::size_t)>; /**< Job, takes an index in a batch */
+
+    /**
+     * Constructor, starts the threads.
+     * @param threads amount of threads.
+     * */
+    send_pool(std::size_t threads);
+    /**
+     * Destructor, joins the threads.
+     * */
+    ~send_pool();
+    send_pool(const send_pool&) = delete;
+    send_pool& operator=(const send_pool&) = delete;
+
+    /**
+     * Runs job for every index of a batch on the calling thread and up to helpers threads of the pool,
+     * returns once it's done for all of them. Job mustn't throw.
+     * @param count amount of indices.
+     * @param helpers most threads of the pool to use.
+     * @param job job to run.
+     * */
+    void run(std::size_t count, std::size_t helpers, const job_t& job);
+    /**
+     * Returns amount of threads.
+     * */
+    auto size() const -> std::size_t { return m_threads.size(); }
+
+protected:
+    std::mutex m_mutex;                  /**< Guards the batch */
+    std::condition_variable m_wake;      /**< Wakes threads up for a batch */
+    std::condition_variable m_done;      /**< Wakes the calling thread up when helpers are done */
+    const job_t* m_job     = nullptr;    /**< Job of the current batch */
+    std::size_t m_count    = 0;          /**< Indices of the current batch */
+    std::size_t m_helpers  = 0;          /**< Threads taking part in the current batch */
+    std::size_t m_finished = 0;          /**< Threads done with the current batch */
+    std::uint64_t m_batch  = 0;          /**< Number of the current batch */
+    bool m_stop            = false;      /**< Flag to finish the threads */
+    std::atomic<std::size_t> m_next {0}; /**< Next index to take */
+    std::vector<std::thread> m_threads;  /**< Threads */
+
+    void p_run(std::size_t index);
+    void p_drain(const job_t& job, std::size_t count);
+};
+
+/**
+ * Paces outgoing messages and defers them instead of losing them when Telegram asks to slow down. \n
+ * A 429 response parks the chat until its retry_after expires, then its messages go out in order,
+ * other chats keep sending meanwhile. The global rate is adapted AIMD-style: halved on every 429,
+ * raised by one message per second for every second of sending without them. A message that doesn't fit
+ * the rate is deferred too, so handlers never wait. \n
+ * Not thread-safe, used on the handling thread.
+ * */
+class outbox: public logging_obj {
+public:
+    using clock  = std::chrono::steady_clock; /**< Clock of deadlines */
+    using send_t = std::function<void()>;     /**< Deferred send, throws like TgBot::Api does */
+
+    /**
+     * Constructor.
+     * @param max_rate most messages per second, Telegram allows about 30.
+     * @param chat_limit most deferred messages of a chat, older ones are dropped.
+     * */
+    outbox(double max_rate = 30, std::size_t chat_limit = 100);
+
+    /**
+     * Sends a message now if the chat isn't parked, has nothing deferred and the rate allows it,
+     * otherwise or on a 429 response defers it.
+     * Other errors are thrown as usual.
+     * @param chat_id id of a chat.
+     * @param func function that sends the message, it's copied if the message is deferred.
+     * @returns result of func, empty if the message was deferred.
+     * */
+    template<class Func>
+    auto send(std::int64_t chat_id, Func&& func) -> decltype(func());
+    /**
+     * Sends a message to many chats, like send does for each of them,
+     * but messages that may go now are sent by up to parallel threads at once,
+     * the calling one and threads of a pool that's started by the first call.
+     * Errors other than 429 are logged, so one chat doesn't stop the rest.
+     * @param chat_ids ids of chats.
+     * @param func function that takes a chat id and sends the message to it, called concurrently,
+     * it's copied if a message is deferred.
+     * @param parallel most sends in flight, the calling thread is one of the senders.
+     * @returns amount of messages sent now.
+     * */
+    template<class Func>
+    auto send_many(const std::vector<std::int64_t>& chat_ids, const Func& func, std::size_t parallel) -> std::size_t;
+    /**
+     * Sends deferred messages of chats that aren't parked while the rate allows,
+     * messages that fail with other errors than 429 are dropped.
+     * @param now current time.
+     * @returns time of the next flush that can send something, std::nullopt if nothing is deferred.
+     * */
+    auto flush(clock::time_point now) -> std::optional<clock::time_point>;
+    /**
+     * Drops all deferred messages.
+     * @returns amount of dropped messages.
+     * */
+    auto clear() -> std::size_t;
+    /**
+     * Returns amount of deferred messages.
+     * */
+    auto pending() const -> std::size_t { return m_pending; }
+    auto rate() const -> double { return m_rate; }
+    /**
+     * Extracts retry_after from description of a 429 response, e.g. "Too Many Requests: retry after 35".
+     * @param description description of an error.
+     * @returns seconds to wait, std::nullopt if it's not a 429 response.
+     * */
+    static auto retry_after(const std::string& description) -> std::optional<std::chrono::seconds>;
+
+protected:
+    /**
+     * Deferred messages of a chat.
+     * */
+    struct chat_queue {
+        std::deque<send_t> messages; /**< Messages in sending order */
+        clock::time_point parked;    /**< Nothing is sent before that */
+    };
+
+    double m_max_rate;                                    /**< Most messages per second */
+    double m_min_rate = 1;                                /**< Least messages per second */
+    double m_rate;                                        /**< Current messages per second */
+    double m_tokens;                                      /**< Messages that may be sent now */
+    clock::time_point m_refilled;                         /**< Time tokens were refilled */
+    std::size_t m_chat_limit;                             /**< Most deferred messages of a chat */
+    std::size_t m_pending = 0;                            /**< Deferred messages */
+    std::unordered_map<std::int64_t, chat_queue> m_chats; /**< Chats with deferred messages */
+    metrics::counter& m_deferred;                         /**< Messages deferred */
+    metrics::counter& m_retried;                          /**< Deferred messages sent later */
+    metrics::counter& m_dropped;                          /**< Deferred messages dropped */
+    metrics::counter& m_limited;                          /**< 429 responses */
+    metrics::gauge& m_rate_gauge;                         /**< Current rate */
+    std::unique_ptr<send_pool> m_pool;                    /**< Threads of send_many, null until it needs them */
+
+    auto p_take(clock::time_point now) -> bool;
+    void p_on_sent();
+    void p_on_limited(std::int64_t chat_id, std::chrono::seconds wait, clock::time_point now);
+    void p_defer(std::int64_t chat_id, send_t send);
+};
+
+send_pool::send_pool(std::size_t threads) {
+    m_threads.reserve(threads);
+    for(std::size_t i = 0; i < threads; i++) {
+        m_threads.emplace_back([this, i] { p_run(i); });
+    }
+}
+
+send_pool::~send_pool() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for(auto& t: m_threads) {
+        t.join();
+    }
+}
+
+void send_pool::run(std::size_t count, std::size_t helpers, const job_t& job) {
+    helpers = std::min({helpers, m_threads.size(), count ? count - 1 : 0});
+    m_next  = 0; //helpers of the last batch are done with it
+    if(!helpers) {
+        p_drain(job, count); //nothing to share
+        return;
+    }
+    {
+        std::lock_guard lock(m_mutex);
+        m_job      = &job;
+        m_count    = count;
+        m_helpers  = helpers;
+        m_finished = 0;
+        m_batch++;
+    }
+    m_wake.notify_all();
+    p_drain(job, count);
+    std::unique_lock lock(m_mutex);
+    m_done.wait(lock, [this] { return m_finished == m_helpers; }); //job stays alive until no helper holds it
+    m_job = nullptr;
+}
+
+void send_pool::p_run(std::size_t index) {
+    std::uint64_t seen = 0;
+    std::unique_lock lock(m_mutex);
+    while(true) {
+        m_wake.wait(lock, [&] { return m_stop || m_batch != seen; });
+        if(m_stop) {
+            return;
+        }
+        seen = m_batch;
+        if(index >= m_helpers) {
+            continue; //not needed for a batch this small
+        }
+        auto& job  = *m_job;
+        auto count = m_count;
+        lock.unlock();
+        p_drain(job, count);
+        lock.lock();
+        if(++m_finished == m_helpers) {
+            m_done.notify_one();
+        }
+    }
+}
+
+void send_pool::p_drain(const job_t& job, std::size_t count) {
+    for(auto i = m_next++; i < count; i = m_next++) {
+        job(i);
+    }
+}
+
+outbox::outbox(double max_rate, std::size_t chat_limit):
+    m_max_rate(std::max(max_rate, m_min_rate)), m_rate(m_max_rate), m_tokens(m_max_rate), m_refilled(clock::now()),
+    m_chat_limit(std::max<std::size_t>(chat_limit, 1)),
+    m_deferred(metrics::get_counter("bot_messages_deferred_total",
+                                    "Messages deferred because of a 429 response, a parked chat or the send rate")),
+    m_retried(metrics::get_counter("bot_messages_retried_total", "Deferred messages sent later")),
+    m_dropped(metrics::get_counter("bot_messages_dropped_total",
+                                   "Deferred messages dropped because of errors or an overflowing chat queue")),
+    m_limited(metrics::get_counter("bot_rate_limited_total", "429 Too Many Requests responses of TG API")),
+    m_rate_gauge(metrics::get_gauge("bot_send_rate", "Messages per second the bot allows itself to send")) {
+    m_rate_gauge.set(static_cast<std::int64_t>(m_rate));
+}
+
+template<class Func>
+auto outbox::send(std::int64_t chat_id, Func&& func) -> decltype(func()) {
+    auto now = clock::now();
+    if(m_chats.count(chat_id) || !p_take(now)) {
+        p_defer(chat_id, [func]() mutable { func(); });
+        return {};
+    }
+    try {
+        auto result = func();
+        p_on_sent();
+        return result;
+    } catch(const TgBot::TgException& e) {
+        auto wait = retry_after(e.what());
+        if(!wait) {
+            throw;
+        }
+        p_on_limited(chat_id, *wait, now);
+        p_defer(chat_id, [func]() mutable { func(); });
+        return {};
+    }
+}
+
+template<class Func>
+auto outbox::send_many(const std::vector<std::int64_t>& chat_ids, const Func& func, std::size_t parallel)
+    -> std::size_t {
+    auto now = clock::now();
+    std::vector<std::int64_t> ready;
+    ready.reserve(chat_ids.size());
+    for(auto chat_id: chat_ids) {
+        if(m_chats.count(chat_id) || !p_take(now)) {
+            p_defer(chat_id, [func, chat_id] { func(chat_id); });
+        } else {
+            ready.emplace_back(chat_id);
+        }
+    }
+    std::vector<std::exception_ptr> errors(ready.size());
+    auto helpers = std::min(parallel, ready.size());
+    helpers      = helpers ? helpers - 1 : 0; //the calling thread sends too
+    if(helpers && (!m_pool || m_pool->size() < helpers)) {
+        m_pool = std::make_unique<send_pool>(helpers); //sized once for the most parallel broadcast
+    }
+    send_pool::job_t job = [&](std::size_t i) {
+        try {
+            func(ready[i]);
+        } catch(...) {
+            errors[i] = std::current_exception();
+        }
+    };
+    if(m_pool) {
+        m_pool->run(ready.size(), helpers, job);
+    } else {
+        for(std::size_t i = 0; i < ready.size(); i++) {
+            job(i);
+        }
+    }
+    std::size_t sent = 0;
+    for(std::size_t i = 0; i < ready.size(); i++) {
+        if(!errors[i]) {
+            p_on_sent();
+            sent++;
+            continue;
+        }
+        try {
+            std::rethrow_exception(errors[i]);
+        } catch(const TgBot::TgException& e) {
+            if(auto wait = retry_after(e.what())) {
+                auto chat_id = ready[i];
+                p_on_limited(chat_id, *wait, now);
+                p_defer(chat_id, [func, chat_id] { func(chat_id); });
+                continue;
+            }
+            m_lgr.warn("outbox::send_many chat:{} failed: {}", ready[i], e.what());
+        } catch(const std::exception& e) {
+            m_lgr.warn("outbox::send_many chat:{} failed: {}", ready[i], e.what());
+        }
+    }
+    return sent;
+}
+
+auto outbox::flush(clock::time_point now) -> std::optional<clock::time_point> {
+    std::optional<clock::time_point> next;
+    for(auto it = m_chats.begin(); it != m_chats.end();) {
+        auto& [chat_id, chat] = *it;
+        while(!chat.messages.empty() && chat.parked <= now && p_take(now)) {
+            try {
+                chat.messages.front()();
+                p_on_sent();
+                m_retried.add();
+            } catch(const TgBot::TgException& e) {
+                if(auto wait = retry_after(e.what())) {
+                    p_on_limited(chat_id, *wait, now);
+                    break;
+                }
+                m_lgr.warn("outbox::flush chat:{} dropped a message: {}", chat_id, e.what());
+                m_dropped.add();
+            } catch(const std::exception& e) {
+                m_lgr.warn("outbox::flush chat:{} dropped a message: {}", chat_id, e.what());
+                m_dropped.add();
+            }
+            chat.messages.pop_front();
+            m_pending--;
+        }
+        if(chat.messages.empty()) {
+            it = m_chats.erase(it);
+            continue;
+        }
+        //either parked or out of tokens
+        auto due = std::max(chat.parked, now + std::chrono::duration_cast<clock::duration>(
+                                                  std::chrono::duration<double>(1 / m_rate)));
+        next     = next ? std::min(*next, due) : due;
+        ++it;
+    }
+    return next;
+}
+
+auto outbox::clear() -> std::size_t {
+    auto dropped = m_pending;
+    m_dropped.add(dropped);
+    m_chats.clear();
+    m_pending = 0;
+    return dropped;
+}
+
+auto outbox::retry_after(const std::string& description) -> std::optional<std::chrono::seconds> {
+    constexpr std::string_view marker = "retry after ";
+    if(description.find("Too Many Requests") == std::string::npos) {
+        return std::nullopt;
+    }
+    auto pos = description.find(marker);
+    if(pos == std::string::npos) {
+        return std::chrono::seconds(1);
+    }
+    return std::chrono::seconds(std::strtoll(description.c_str() + pos + marker.size(), nullptr, 10));
+}
+
+auto outbox::p_take(clock::time_point now) -> bool {
+    std::chrono::duration<double> elapsed = now - m_refilled;
+    m_tokens   = std::min(m_rate, m_tokens + elapsed.count() * m_rate);
+    m_refilled = now;
+    if(m_tokens < 1) {
+        return false;
+    }
+    m_tokens -= 1;
+    return true;
+}
+
+void outbox::p_on_sent() {
+    //a message takes 1/rate seconds, so that's +1 message per second for a second of sending
+    m_rate = std::min(m_max_rate, m_rate + 1 / m_rate);
+    m_rate_gauge.set(static_cast<std::int64_t>(m_rate));
+}
+
+void outbox::p_on_limited(std::int64_t chat_id, std::chrono::seconds wait, clock::time_point now) {
+    m_limited.add();
+    m_rate   = std::max(m_min_rate, m_rate / 2);
+    m_tokens = std::min(m_tokens, m_rate);
+    m_rate_gauge.set(static_cast<std::int64_t>(m_rate));
+    m_chats[chat_id].parked = now + wait;
+    m_lgr.warn("outbox::p_on_limited chat:{} parked for {}s, rate is {:.1f}/s now", chat_id, wait.count(), m_rate);
+}
+
+void outbox::p_defer(std::int64_t chat_id, send_t send) {
+    auto& chat = m_chats[chat_id];
+    if(chat.messages.size() >= m_chat_limit) {
+        m_lgr.warn("outbox::p_defer chat:{} has {} deferred messages, dropping the oldest", chat_id,
+                   chat.messages.size());
+        chat.messages.pop_front();
+        m_pending--;
+        m_dropped.add();
+    }
+    chat.messages.emplace_back(std::move(send));
+    m_pending++;
+    m_deferred.add();
+}
+
+} // namespace bot
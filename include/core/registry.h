@@ -0,0 +1,324 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace bot {
+
+/**
+ * Generational handle to an element of a slot_map. \n
+ * Handle stays valid until the element is erased, after that it is detected as stale
+ * because slot's generation doesn't match anymore.
+ * */
+struct handle {
+    using index_t                 = std::uint32_t;                       /**< Slot index type define */
+    using generation_t            = std::uint32_t;                       /**< Generation type define */
+    static constexpr index_t npos = std::numeric_limits<index_t>::max(); /**< Index of a null handle */
+    index_t index                 = npos;                                /**< Index of a slot */
+    generation_t generation       = 0;                                   /**< Generation of a slot */
+
+    bool operator==(const handle& rhs) const { return index == rhs.index && generation == rhs.generation; }
+    bool operator!=(const handle& rhs) const { return !(*this == rhs); }
+    bool operator<(const handle& rhs) const {
+        return index < rhs.index || (index == rhs.index && generation < rhs.generation);
+    }
+};
+
+/**
+ * Container with stable generational handles and dense storage. \n
+ * Values are kept contiguous for iteration, erase swaps last value into the hole.
+ * Lookup, insertion and erase are O(1).
+ * */
+template<class T>
+class slot_map {
+public:
+    using value_type     = T;                                /**< Stored value type define */
+    using dense_t        = std::vector<T>;                   /**< Dense storage type define */
+    using iterator       = typename dense_t::iterator;       /**< Iterator over dense values */
+    using const_iterator = typename dense_t::const_iterator; /**< Const iterator over dense values */
+
+    /**
+     * Constructs a value in place.
+     * @param args arguments to be passed to value's constructor.
+     * @returns handle to a new value.
+     * */
+    template<class... Args>
+    auto emplace(Args&&... args) -> handle;
+    /**
+     * Erases value referenced by a handle. Stale handles are ignored.
+     * @param h handle of a value.
+     * @returns true if value was erased.
+     * */
+    auto erase(handle h) -> bool;
+    /**
+     * Validated lookup.
+     * @param h handle of a value.
+     * @returns pointer to a value or nullptr if handle is stale.
+     * */
+    auto get(handle h) noexcept -> T*;
+    /**
+     * Validated const lookup.
+     * @param h handle of a value.
+     * @returns pointer to a value or nullptr if handle is stale.
+     * */
+    auto get(handle h) const noexcept -> const T*;
+    /**
+     * Checks if handle references alive value.
+     * @param h handle to check.
+     * */
+    auto contains(handle h) const noexcept -> bool;
+    /**
+     * Returns handle of a value by it's position in dense storage.
+     * @param dense_index position in dense storage.
+     * */
+    auto handle_at(std::size_t dense_index) const -> handle;
+    /**
+     * Reserves storage for count values.
+     * @param count amount of values.
+     * */
+    void reserve(std::size_t count);
+
+    auto size() const noexcept -> std::size_t { return m_dense.size(); }
+    auto empty() const noexcept -> bool { return m_dense.empty(); }
+    auto begin() noexcept -> iterator { return m_dense.begin(); }
+    auto end() noexcept -> iterator { return m_dense.end(); }
+    auto begin() const noexcept -> const_iterator { return m_dense.begin(); }
+    auto end() const noexcept -> const_iterator { return m_dense.end(); }
+
+protected:
+    /** Indirection slot, holds value's position in dense storage or next free slot. */
+    struct slot {
+        handle::index_t dense;
+        handle::generation_t generation;
+    };
+
+    dense_t m_dense;                              /**< Values */
+    std::vector<handle::index_t> m_dense_to_slot; /**< Back references from values to slots */
+    std::vector<slot> m_slots;                    /**< Slots */
+    handle::index_t m_free = handle::npos;        /**< Head of free slots list */
+};
+
+template<class T>
+template<class... Args>
+auto slot_map<T>::emplace(Args&&... args) -> handle {
+    handle::index_t index;
+    if(m_free != handle::npos) {
+        index  = m_free;
+        m_free = m_slots[index].dense;
+    } else {
+        index = static_cast<handle::index_t>(m_slots.size());
+        m_slots.push_back({0, 0});
+    }
+    auto& s = m_slots[index];
+    s.dense = static_cast<handle::index_t>(m_dense.size());
+    m_dense.emplace_back(std::forward<Args>(args)...);
+    m_dense_to_slot.emplace_back(index);
+    return {index, s.generation};
+}
+
+template<class T>
+auto slot_map<T>::erase(handle h) -> bool {
+    if(!contains(h)) {
+        return false;
+    }
+    auto& s    = m_slots[h.index];
+    auto dense = s.dense;
+    auto last  = static_cast<handle::index_t>(m_dense.size() - 1);
+    T erased   = std::move(m_dense[dense]); //destroyed after bookkeeping, so destructors see consistent state
+    if(dense != last) {
+        if constexpr(std::is_move_assignable_v<T>) {
+            m_dense[dense] = std::move(m_dense[last]);
+        } else { //entities with const members, e.g. identifyable::id
+            m_dense[dense].~T();
+            new(&m_dense[dense]) T(std::move(m_dense[last]));
+        }
+        m_dense_to_slot[dense]                = m_dense_to_slot[last];
+        m_slots[m_dense_to_slot[dense]].dense = dense;
+    }
+    m_dense.pop_back();
+    m_dense_to_slot.pop_back();
+    ++s.generation;
+    s.dense = m_free;
+    m_free  = h.index;
+    return true;
+}
+
+template<class T>
+auto slot_map<T>::get(handle h) noexcept -> T* {
+    if(!contains(h)) {
+        return nullptr;
+    }
+    return std::launder(&m_dense[m_slots[h.index].dense]);
+}
+
+template<class T>
+auto slot_map<T>::get(handle h) const noexcept -> const T* {
+    if(!contains(h)) {
+        return nullptr;
+    }
+    return std::launder(&m_dense[m_slots[h.index].dense]);
+}
+
+template<class T>
+auto slot_map<T>::contains(handle h) const noexcept -> bool {
+    return h.index < m_slots.size() && m_slots[h.index].generation == h.generation &&
+           m_slots[h.index].dense < m_dense.size() && m_dense_to_slot[m_slots[h.index].dense] == h.index;
+}
+
+template<class T>
+auto slot_map<T>::handle_at(std::size_t dense_index) const -> handle {
+    auto index = m_dense_to_slot.at(dense_index);
+    return {index, m_slots[index].generation};
+}
+
+template<class T>
+void slot_map<T>::reserve(std::size_t count) {
+    m_dense.reserve(count);
+    m_dense_to_slot.reserve(count);
+    m_slots.reserve(count);
+}
+
+/**
+ * Traits of entity's storage. \n
+ * Entities with derived classes have to be boxed, since dense storage holds values of a single type.
+ * */
+template<class T>
+struct entity_traits {
+    static constexpr bool boxed = false; /**< Whether or not entity is stored by unique_ptr */
+};
+
+/**
+ * Storage of all entities of type T, one per type and thread. \n
+ * Entities are owned by the thread that created them and are reachable only from it:
+ * the bot handles all updates on one thread, while headless drivers like the table simulator
+ * run independent tables on many threads without any locking.
+ * */
+template<class T>
+class registry {
+public:
+    using storage_t = std::conditional_t<entity_traits<T>::boxed, std::unique_ptr<T>, T>; /**< Stored type define */
+
+    /**
+     * Returns registry of the calling thread, constructs it on first use.
+     * */
+    static auto get_instance() -> registry& {
+        thread_local registry instance;
+        return instance;
+    }
+
+    registry(const registry&) = delete;
+    registry& operator=(const registry&) = delete;
+
+    /**
+     * Constructs entity of type U derived from T.
+     * @param args arguments to be passed to entity's constructor.
+     * @returns handle to entity.
+     * */
+    template<class U = T, class... Args>
+    auto emplace(Args&&... args) -> handle {
+        if constexpr(entity_traits<T>::boxed) {
+            return m_entities.emplace(std::make_unique<U>(std::forward<Args>(args)...));
+        } else {
+            static_assert(std::is_same_v<T, U>, "derived entities must be boxed, see entity_traits");
+            return m_entities.emplace(std::forward<Args>(args)...);
+        }
+    }
+    /**
+     * Destroys entity, all handles to it become stale.
+     * @param h handle of entity.
+     * */
+    auto destroy(handle h) -> bool { return m_entities.erase(h); }
+    /**
+     * Validated lookup.
+     * @param h handle of entity.
+     * @returns pointer to entity or nullptr.
+     * */
+    auto get(handle h) noexcept -> T* {
+        auto ptr = m_entities.get(h);
+        if(!ptr) {
+            return nullptr;
+        }
+        if constexpr(entity_traits<T>::boxed) {
+            return ptr->get();
+        } else {
+            return ptr;
+        }
+    }
+    /**
+     * Returns storage of entities for iteration.
+     * */
+    auto entities() -> slot_map<storage_t>& { return m_entities; }
+
+protected:
+    slot_map<storage_t> m_entities; /**< Entities storage */
+
+    registry() = default;
+};
+
+/**
+ * Non-owning pointer-like handle to entity stored in registry<T>. \n
+ * Copying it doesn't touch any reference counters, dereferencing is a validated O(1) lookup.
+ * Stale pointer compares false to bool.
+ * */
+template<class T>
+class entity_ptr {
+public:
+    using element_type = T; /**< Entity type define */
+
+    entity_ptr() = default;
+    entity_ptr(std::nullptr_t) { }
+    explicit entity_ptr(handle h): m_handle(h) { }
+
+    auto get() const noexcept -> T* { return registry<T>::get_instance().get(m_handle); }
+    auto operator->() const noexcept -> T* { return get(); }
+    auto operator*() const noexcept -> T& { return *get(); }
+    explicit operator bool() const noexcept { return get() != nullptr; }
+    auto get_handle() const noexcept -> handle { return m_handle; }
+
+    friend bool operator==(const entity_ptr& lhs, const entity_ptr& rhs) { return lhs.m_handle == rhs.m_handle; }
+    friend bool operator!=(const entity_ptr& lhs, const entity_ptr& rhs) { return lhs.m_handle != rhs.m_handle; }
+    friend bool operator<(const entity_ptr& lhs, const entity_ptr& rhs) { return lhs.m_handle < rhs.m_handle; }
+    friend bool operator==(const entity_ptr& lhs, std::nullptr_t) { return !lhs; }
+    friend bool operator!=(const entity_ptr& lhs, std::nullptr_t) { return static_cast<bool>(lhs); }
+
+protected:
+    handle m_handle; /**< Handle of entity */
+};
+
+/**
+ * Creates entity of type U in registry<T>, analogue of std::make_shared.
+ * @param args arguments to be passed to entity's constructor.
+ * @returns pointer to created entity.
+ * */
+template<class T, class U = T, class... Args>
+auto make_entity(Args&&... args) -> entity_ptr<T> {
+    return entity_ptr<T>(registry<T>::get_instance().template emplace<U>(std::forward<Args>(args)...));
+}
+
+/**
+ * Destroys entity, all pointers to it become stale.
+ * @param ptr pointer to entity.
+ * @returns true if entity was alive.
+ * */
+template<class T>
+auto destroy_entity(const entity_ptr<T>& ptr) -> bool {
+    return registry<T>::get_instance().destroy(ptr.get_handle());
+}
+
+}; // namespace bot
+
+namespace std {
+template<class T>
+struct hash<bot::entity_ptr<T>> {
+    auto operator()(const bot::entity_ptr<T>& ptr) const noexcept -> std::size_t {
+        auto h = ptr.get_handle();
+        return std::hash<std::uint64_t> {}((std::uint64_t(h.generation) << 32) | h.index);
+    }
+};
+} // namespace std
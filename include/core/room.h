@@ -1,5 +1,6 @@
 #pragma once
 #include "core/datatypes.h"
+#include "core/history.h"
 #include "core/identifyable.h"
 #include "core/lazy_utils.h"
 #include "core/logger.h"
@@ -33,6 +34,7 @@ public:
         unsubscribed;               /**< Set with unsubscribed users to prevent them from getting unwanted messages. */
     property<token_t> token   = ""; /**< Room's token, used for joining it. */
     property<user_cont> users = {}; /**< Users' container. */
+    property<message_history> history; /**< Recent relayed messages, limited by server's history_limit. */
 
     /**
      * Procedure for adding user into the room.
@@ -77,6 +79,11 @@ public:
      * @returns room's description, string
      * */
     virtual std::string log_desc() const;
+    /**
+     * Bytes occupied by the room: strings, users' container and sets, users themselves are not included.
+     * @returns size in bytes
+     * */
+    virtual auto memory_usage() const -> std::size_t;
 };
 }; // namespace bot
 
@@ -87,12 +94,12 @@ namespace bot {
 room::room(id_t id): identifyable(id) { }
 
 void room::add_user(user_ptr user) {
-    auto prefix = fmt::format("room::add_user room:{} {}", desc(), user->log_desc());
+    auto prefix = bot::lazy([&] { return fmt::format("room::add_user room:{} {}", desc(), user->log_desc()); });
     m_lgr.info("{} room:{}, adding user", prefix, desc());
     this->users().emplace_back(user);
 }
 void room::del_user(user_ptr user) {
-    auto prefix = fmt::format("room::del_user room:{} {}", desc(), user->log_desc());
+    auto prefix = bot::lazy([&] { return fmt::format("room::del_user room:{} {}", desc(), user->log_desc()); });
     if(utils::erase(users(), user)) {
         user->current_room() = nullptr;
         m_lgr.info("{} room:{}, deleting user", prefix, desc());
@@ -106,7 +113,7 @@ bool room::contains_user(const user_ptr user) const {
     return bot::utils::contains(users.get(), user);
 }
 user_ptr room::get_user(const id_t& id) const {
-    auto prefix  = fmt::format("room::get_user room:{} id:{}", desc(), id);
+    auto prefix  = bot::lazy([&] { return fmt::format("room::get_user room:{} id:{}", desc(), id); });
     auto pred    = [&id](const user_ptr& u) { return u->id() == id; };
     auto user_it = utils::find_if(users(), pred);
     if(user_it != users().end()) {
@@ -117,7 +124,7 @@ user_ptr room::get_user(const id_t& id) const {
     return nullptr;
 }
 user_ptr room::get_user(const user::token_t& token) const {
-    auto prefix  = fmt::format("room::get_user room:{} token:{}", desc(), token);
+    auto prefix  = bot::lazy([&] { return fmt::format("room::get_user room:{} token:{}", desc(), token); });
     auto pred    = [&token](const user_ptr& u) { return u->token() == token; };
     auto user_it = utils::find_if(users(), pred);
     if(user_it != users().end()) {
@@ -129,7 +136,7 @@ user_ptr room::get_user(const user::token_t& token) const {
 }
 
 void room::process_mes(user_ptr user, mes_ptr mes) {
-    auto prefix = fmt::format("room::process_mes room:{} user:{}", desc(), user->desc());
+    auto prefix = bot::lazy([&] { return fmt::format("room::process_mes room:{} user:{}", desc(), user->desc()); });
     m_lgr.debug("{} wrote: {}", prefix, mes->text);
 }
 std::string room::desc() const {
@@ -140,6 +147,12 @@ std::string room::log_desc() const {
     return name() + "[tk:" + token() + "][id:" + std::to_string(id()) + "]";
 }
 
+auto room::memory_usage() const -> std::size_t {
+    return sizeof(room) + utils::heap_usage(name()) + utils::heap_usage(token()) + utils::heap_usage(users()) +
+           utils::heap_usage(banned()) + utils::heap_usage(muted()) + utils::heap_usage(unsubscribed()) +
+           history().memory_usage();
+}
+
 }; // namespace bot
 
 #include "core/user.h"
@@ -1,17 +1,23 @@
 #pragma once
 #include "components/logger.hpp"
 #include "core/datatypes.h"
+#include "core/hibernation.h"
 #include "core/logging_obj.h"
+#include "core/metrics.h"
 #include "core/property.h"
 #include "core/room.h"
+#include "core/snapshot.h"
 #include "core/user.h"
 #include "core/utils.h"
 
+#include <filesystem>
 #include <map>
 #include <memory>
 #include <random>
 #include <set>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace bot {
@@ -19,17 +25,34 @@ namespace bot {
  * Utility class to generate random tokens.
  * */
 class token_generator {
-    static inline std::set<std::string> p_tokens;   /**< Set to keep already generated tokens */
-    const static size_t p_token_len            = 8; /**< Define for token's length */
-    const static inline std::string p_alphabet =    /**< Alphabet for generating tokens */
+    static inline std::unordered_set<std::uint64_t> p_tokens; /**< Keys of already generated tokens, see p_key */
+    const static size_t p_token_len            = 8;           /**< Define for token's length */
+    const static inline std::string p_alphabet =              /**< Alphabet for generating tokens */
         "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
 
+    /**
+     * Func that packs a token into an integer, 8 letters of the alphabet fit into 46 bits. \n
+     * Tokens of another shape are hashed, a collision only makes gen() draw once more.
+     * @param token token to pack.
+     * */
+    static auto p_key(const std::string& token) -> std::uint64_t;
+
 public:
     /**
      * Func that generates a random unique token.
      * @returns a token
      * */
     static std::string gen();
+    /**
+     * Func that remembers a token generated before, e.g. loaded from a snapshot, so it's never generated again.
+     * @param token token to remember.
+     * */
+    static void remember(const std::string& token);
+    /**
+     * Func that prepares storage for a given amount of tokens.
+     * @param count amount of tokens.
+     * */
+    static void reserve(std::size_t count);
 };
 
 std::string token_generator::gen() {
@@ -42,14 +65,99 @@ std::string token_generator::gen() {
     bool end = false;
     do {
         std::generate(result.begin(), result.end(), [&]() { return p_alphabet.at(dist(p_gen)); });
-        if(p_tokens.find(result) == p_tokens.end()) {
-            end = true;
-            p_tokens.emplace(result);
-        }
+        end = p_tokens.emplace(p_key(result)).second;
     } while(!end);
     return result;
 };
 
+auto token_generator::p_key(const std::string& token) -> std::uint64_t {
+    bool packable     = token.size() == p_token_len;
+    std::uint64_t key = 0;
+    for(std::size_t i = 0; packable && i < token.size(); i++) {
+        auto c     = token[i];
+        auto index = c >= 'a' && c <= 'z' ? c - 'a' : c >= 'A' && c <= 'Z' ? c - 'A' + 26 : -1;
+        packable   = index >= 0;
+        key        = key * p_alphabet.size() + index;
+    }
+    return packable ? key : std::hash<std::string> {}(token) | (std::uint64_t {1} << 63);
+}
+
+void token_generator::remember(const std::string& token) {
+    p_tokens.emplace(p_key(token));
+}
+
+void token_generator::reserve(std::size_t count) {
+    p_tokens.reserve(count);
+}
+
+/**
+ * Distribution of memory usage over entities of one kind, in bytes.
+ * */
+struct memory_group {
+    std::size_t count = 0; /**< Amount of entities */
+    std::size_t total = 0; /**< Sum of entities' usage */
+    std::size_t p50   = 0; /**< Median entity */
+    std::size_t p99   = 0; /**< 99th percentile entity */
+    std::size_t max   = 0; /**< Biggest entity */
+
+    /**
+     * Builds distribution from entities' sizes.
+     * @param sizes sizes of entities.
+     * */
+    static auto of(std::vector<std::size_t> sizes) -> memory_group;
+    /**
+     * Renders distribution in a single line.
+     * @param name name of entities.
+     * */
+    auto to_string(const char* name) const -> std::string;
+};
+
+/**
+ * Memory usage of a server, see server::memory_usage.
+ * */
+struct memory_stats {
+    memory_group users;         /**< Users, without rooms */
+    memory_group rooms;         /**< Rooms including their games, lobby included */
+    memory_group games;         /**< Games alone, filled by servers that know about games */
+    std::size_t containers = 0; /**< Server's own containers */
+
+    auto total() const -> std::size_t { return users.total + rooms.total + containers; }
+    /**
+     * Renders stats, one group per line.
+     * */
+    auto to_string() const -> std::string;
+};
+
+auto memory_group::of(std::vector<std::size_t> sizes) -> memory_group {
+    memory_group result;
+    if(sizes.empty()) {
+        return result;
+    }
+    std::sort(sizes.begin(), sizes.end());
+    result.count = sizes.size();
+    for(auto s: sizes) {
+        result.total += s;
+    }
+    result.p50 = sizes[sizes.size() / 2];
+    result.p99 = sizes[(sizes.size() * 99 + 99) / 100 - 1];
+    result.max = sizes.back();
+    return result;
+}
+
+auto memory_group::to_string(const char* name) const -> std::string {
+    return fmt::format("memory {}: {} total {}B avg {}B p50 {}B p99 {}B max {}B\n", name, count, total,
+                       count ? total / count : 0, p50, p99, max);
+}
+
+auto memory_stats::to_string() const -> std::string {
+    std::string result = users.to_string("users") + rooms.to_string("rooms");
+    if(games.count) {
+        result += games.to_string("games");
+    }
+    result += fmt::format("memory containers: {}B\nmemory total: {}B\n", containers, total());
+    return result;
+}
+
 /**
  * Server class to hold users and rooms
  * */
@@ -60,21 +168,52 @@ protected:
      * Function to return new room's id
      * */
     id_t p_get_room_id();
+    /**
+     * Function to create an empty room entity of server's room type while loading a snapshot.
+     * @param id id of a room.
+     * */
+    virtual auto p_make_room(id_t id) -> room_ptr;
+    /**
+     * Function to encode room's game for a snapshot, base server has no games.
+     * @param room room to save.
+     * @returns encoded state, empty if there is nothing to save
+     * */
+    virtual auto p_save_game(const room_ptr& room) const -> std::string;
+    /**
+     * Function to restore room's game from a snapshot, called when all users and rooms are loaded.
+     * @param room room to restore the game in.
+     * @param data encoded state, see p_save_game.
+     * */
+    virtual void p_load_game(const room_ptr& room, const std::string& data);
+    /**
+     * Function to free room's game after it was saved by p_save_game for hibernation.
+     * @param room room to free the game of.
+     * */
+    virtual void p_drop_game(const room_ptr& room);
+
+    metrics::gauge& m_users_gauge;              /**< Amount of connected users */
+    metrics::gauge& m_rooms_gauge;              /**< Amount of rooms besides lobby */
+    std::unique_ptr<hibernation> m_hibernation; /**< Idle rooms' bookkeeping, null if hibernation is disabled */
 
 public:
-    using room_cont = std::vector<room_ptr>;                  /**< Define for rooms container */
-    using user_cont = std::map<identifyable::id_t, user_ptr>; /**< Define for users container */
+    using room_cont = std::vector<room_ptr>; /**< Define for rooms container */
+    using user_cont =
+        std::unordered_map<identifyable::id_t, user_ptr>; /**< Define for users container, maps tg id to user's handle */
 
-    property<room_cont> rooms = {};      /**< Rooms' pointers container */
-    property<room_ptr> lobby  = nullptr; /**< Pointer to the lobby room */
-    property<user_cont> users = {};      /**< Users' container */
+    property<room_cont> rooms = {};         /**< Rooms' pointers container */
+    property<room_ptr> lobby  = nullptr;    /**< Pointer to the lobby room */
+    property<user_cont> users = {};         /**< Users' container */
+    property<history_limits> history_limit; /**< Limits of every room's message history */
 
     /**
      * Default constructor, initializes the lobby
      * */
     server();
 
-    virtual ~server() {};
+    /**
+     * Destructor, destroys server's users and rooms entities.
+     * */
+    virtual ~server();
     /**
      * Function to find a user by their's id.
      * @returns user_ptr if they are found
@@ -98,29 +237,83 @@ public:
     virtual void on_user_connect(user_ptr user);
     /**
      * Function to be called when user disconnects to the server.
+     * Removes user from rooms' banned, muted and unsubscribed sets and destroys user's entity,
+     * all pointers to it become stale.
      * @param user ptr to a user that diconnected to the server.
      * */
     virtual void on_user_disconnect(user_ptr user);
     /**
      * Function to be called when room became empty.
-     * By default, this function deletes the room.
+     * By default, this function deletes the room and destroys it's entity.
      * @param room ptr to a room that became empty
      * */
     virtual void on_room_empty(room_ptr room);
+    /**
+     * Function to walk users and rooms and measure memory they occupy.
+     * @returns distribution of usage per entity kind
+     * */
+    virtual auto memory_usage() const -> memory_stats;
+    /**
+     * Function to copy users and rooms into plain data, that may be written from another thread.
+     * Games of hibernated rooms are only linked, snapshot::read_game_files reads them.
+     * @returns server's state
+     * */
+    virtual auto make_snapshot() const -> snapshot::server_state;
+    /**
+     * Function to restore users and rooms from a snapshot.
+     * Server has to be fresh, with an empty lobby only. Throws runtime exception on inconsistent state.
+     * @param state state made by make_snapshot.
+     */
+    virtual void load_snapshot(const snapshot::server_state& state);
+    /**
+     * Function to enable hibernation of rooms' games that are idle for a given period.
+     * @param dir directory for records of hibernated games.
+     * @param idle period of inactivity.
+     * */
+    void enable_hibernation(const std::string& dir, std::chrono::seconds idle);
+    /**
+     * Function to be called before anything addressed to a room is handled.
+     * Restores room's game if it's hibernated and marks the room as active.
+     * @param room ptr to a room.
+     * */
+    void touch_room(const room_ptr& room);
+    /**
+     * Function to save games of idle rooms to disk and free them.
+     * @returns amount of hibernated rooms
+     * */
+    auto hibernate_idle() -> std::size_t;
+    /**
+     * Function to get amount of hibernated rooms, 0 if hibernation is disabled.
+     * */
+    auto hibernated_rooms() const -> std::size_t;
 };
 
-server::server() {
-    lobby            = std::make_shared<room>(0);
+server::server():
+    m_users_gauge(metrics::get_gauge("bot_users", "Connected users")),
+    m_rooms_gauge(metrics::get_gauge("bot_rooms", "Rooms, lobby excluded")) {
+    lobby            = make_entity<room>(0);
     lobby()->name    = std::string("lobby");
     lobby()->token() = token_generator::gen();
 }
 
+server::~server() {
+    m_users_gauge.sub(users().size());
+    m_rooms_gauge.sub(rooms().size());
+    for(auto& [id, user]: users()) {
+        destroy_entity(user);
+    }
+    for(auto& room: rooms()) {
+        destroy_entity(room);
+    }
+    destroy_entity(lobby());
+}
+
 id_t server::p_get_room_id() {
     return ++p_last_room_id;
 }
 
 user_ptr server::get_user(id_t id) const {
-    auto prefix  = fmt::format("server::get_user id:{}", id);
+    auto prefix  = bot::lazy([&] { return fmt::format("server::get_user id:{}", id); });
     auto user_it = users().find(id);
     if(user_it != users().end()) {
         return user_it->second;
@@ -130,7 +323,7 @@ user_ptr server::get_user(id_t id) const {
 }
 
 room_ptr server::get_room(const room::token_t& token) const {
-    auto prefix  = fmt::format("server::get_room token:{}", token);
+    auto prefix  = bot::lazy([&] { return fmt::format("server::get_room token:{}", token); });
     auto room_it = std::find_if(rooms().begin(), rooms().end(), [&token](auto room) { return room->token() == token; });
     if(room_it != rooms().end()) {
         return *room_it;
@@ -140,41 +333,59 @@ room_ptr server::get_room(const room::token_t& token) const {
 }
 
 room_ptr server::create_room(user_ptr user) {
-    auto prefix = fmt::format("server::create_room {}", user->desc());
+    auto prefix = bot::lazy([&] { return fmt::format("server::create_room {}", user->desc()); });
     lobby()->del_user(user);
 
-    auto room     = std::make_shared<class room>(p_get_room_id());
+    auto room     = make_entity<class room>(p_get_room_id());
     room->token() = token_generator::gen();
     room->add_user(user);
     room->owner()        = user;
     user->current_room() = room;
     rooms().emplace_back(room);
+    m_rooms_gauge.add();
 
     m_lgr.info("{} created room {}", prefix, utils::get_desc(room));
     return room;
 }
 
 void server::on_user_connect(user_ptr user) {
-    auto prefix = fmt::format("server::on_user_connect {}", user->desc());
+    auto prefix = bot::lazy([&] { return fmt::format("server::on_user_connect {}", user->desc()); });
     users().emplace(user->id, user);
+    m_users_gauge.add();
     user->token = token_generator::gen();
     m_lgr.info("{} connected, got token:{}", prefix, user->token());
 }
 
 void server::on_user_disconnect(user_ptr user) {
-    auto prefix = fmt::format("server::on_user_disconnect {}", user->desc());
-    users().erase(user->id);
+    auto prefix = bot::lazy([&] { return fmt::format("server::on_user_disconnect {}", user->desc()); });
     m_lgr.info("{} diconnected", prefix);
+    users().erase(user->id);
+    m_users_gauge.sub();
+    auto forget = [&user](room_ptr room) {
+        room->banned().erase(user);
+        room->muted().erase(user);
+        room->unsubscribed().erase(user);
+    };
+    forget(lobby());
+    for(auto& room: rooms()) {
+        forget(room);
+    } //the handle dies with the user, rooms must not keep it
+    destroy_entity(user);
 }
 
 void server::on_room_empty(room_ptr room) {
-    auto prefix = fmt::format("server::on_room_empty room:{}", room->desc());
+    auto prefix = bot::lazy([&] { return fmt::format("server::on_room_empty room:{}", room->desc()); });
     if(!room->users().empty()) {
         m_lgr.error("{} called on non-empty room", prefix);
         return;
     }
     if(utils::erase(rooms(), room)) {
         m_lgr.info("{} removed a room", prefix);
+        if(m_hibernation) {
+            m_hibernation->forget(room->id());
+        }
+        m_rooms_gauge.sub();
+        destroy_entity(room);
     } else {
         auto mes = fmt::format("{} no such room in the server to delete", prefix);
         m_lgr.error(mes);
@@ -182,4 +393,224 @@ void server::on_room_empty(room_ptr room) {
     }
 }
 
+auto server::p_make_room(id_t id) -> room_ptr {
+    return make_entity<room>(id);
+}
+
+auto server::p_save_game(const room_ptr&) const -> std::string {
+    return {};
+}
+
+void server::p_load_game(const room_ptr&, const std::string&) { }
+
+void server::p_drop_game(const room_ptr&) { }
+
+auto server::make_snapshot() const -> snapshot::server_state {
+    auto ids = [](const auto& cont) {
+        std::vector<std::uint64_t> result;
+        result.reserve(cont.size());
+        for(auto& user: cont) {
+            result.emplace_back(user->id());
+        }
+        return result;
+    };
+    snapshot::server_state state;
+    state.last_room_id = p_last_room_id;
+    state.users.reserve(users().size());
+    for(auto& [id, user]: users()) {
+        auto& u = state.users.emplace_back();
+        u.id    = id;
+        u.name  = user->name();
+        u.token = user->token();
+        if(auto room = user->current_room()) {
+            u.room = room->id();
+        }
+    }
+    state.rooms.reserve(rooms().size() + 1);
+    auto save_room = [&](const room_ptr& room) {
+        auto& r        = state.rooms.emplace_back();
+        r.id           = room->id();
+        r.name         = room->name();
+        r.token        = room->token();
+        r.owner        = room->owner() ? room->owner()->id() : 0;
+        r.users        = room == lobby() ? std::vector<std::uint64_t> {} : ids(room->users());
+        r.banned       = ids(room->banned());
+        r.muted        = ids(room->muted());
+        r.unsubscribed = ids(room->unsubscribed());
+        if(m_hibernation && m_hibernation->is_hibernated(room->id())) {
+            try {
+                r.game_file = m_hibernation->link(room->id()); //records are what p_save_game returned
+            } catch(const std::filesystem::filesystem_error& e) {
+                m_lgr.warn("server::make_snapshot room:{} record is read instead: {}", room->log_desc(), e.what());
+                r.game = m_hibernation->read(room->id());
+            }
+        } else {
+            r.game = p_save_game(room);
+        }
+    };
+    save_room(lobby());
+    for(auto& room: rooms()) {
+        save_room(room);
+    }
+    return state;
+}
+
+void server::load_snapshot(const snapshot::server_state& state) {
+    auto prefix = "server::load_snapshot";
+    if(!users().empty() || !rooms().empty() || !lobby()->users().empty()) {
+        auto mes = fmt::format("{} server is not empty", prefix);
+        m_lgr.error(mes);
+        throw std::runtime_error(mes);
+    }
+    if(state.rooms.empty() || state.rooms.front().id != 0) {
+        auto mes = fmt::format("{} snapshot has no lobby", prefix);
+        m_lgr.error(mes);
+        throw std::runtime_error(mes);
+    }
+    std::unordered_map<std::uint64_t, room_ptr> rooms_by_id;
+    token_generator::reserve(state.users.size() + state.rooms.size());
+    for(auto& r: state.rooms) {
+        auto room         = r.id == 0 ? lobby() : p_make_room(r.id);
+        room->name()      = r.name;
+        room->token()     = r.token;
+        rooms_by_id[r.id] = room;
+        token_generator::remember(r.token);
+        if(r.id != 0) {
+            rooms().emplace_back(room);
+        }
+    }
+
+    //users go straight into containers, room::add_user would log every single one of them
+    auto& entities = registry<user>::get_instance().entities();
+    entities.reserve(entities.size() + state.users.size());
+    users().reserve(state.users.size());
+    lobby()->users().reserve(state.users.size());
+    for(auto& u: state.users) {
+        auto room_it = rooms_by_id.find(u.room);
+        if(room_it == rooms_by_id.end()) {
+            throw std::runtime_error(fmt::format("{} user {} is in unknown room {}", prefix, u.id, u.room));
+        }
+        auto user            = make_entity<class user>(u.id);
+        user->name()         = u.name;
+        user->token()        = u.token;
+        user->current_room() = room_it->second;
+        token_generator::remember(u.token);
+        users().emplace(u.id, user);
+        if(u.room == 0) {
+            lobby()->users().emplace_back(user);
+        }
+    }
+
+    for(auto& r: state.rooms) {
+        auto& room   = rooms_by_id.at(r.id);
+        auto to_user = [&](std::uint64_t id) {
+            auto user = get_user(id);
+            if(!user) {
+                throw std::runtime_error(fmt::format("{} room {} refers to unknown user {}", prefix, r.id, id));
+            }
+            return user;
+        };
+        auto load_set = [&](const std::vector<std::uint64_t>& ids, std::set<user_ptr>& set) {
+            for(auto id: ids) {
+                set.emplace(to_user(id));
+            }
+        };
+        room->owner() = r.owner ? to_user(r.owner) : nullptr;
+        if(r.id != 0) { //lobby's users are restored from users' rooms
+            room->users().reserve(r.users.size());
+            for(auto id: r.users) {
+                room->users().emplace_back(to_user(id));
+            }
+        }
+        load_set(r.banned, room->banned());
+        load_set(r.muted, room->muted());
+        load_set(r.unsubscribed, room->unsubscribed());
+    }
+    auto now = hibernation::clock::now();
+    for(auto& r: state.rooms) {
+        if(!r.game.empty()) {
+            p_load_game(rooms_by_id.at(r.id), r.game);
+            if(m_hibernation) {
+                m_hibernation->touch(rooms_by_id.at(r.id), now);
+            }
+        }
+    }
+    p_last_room_id = std::max<id_t>(p_last_room_id, state.last_room_id);
+    m_users_gauge.add(users().size());
+    m_rooms_gauge.add(rooms().size());
+    m_lgr.info("{} loaded {} users and {} rooms", prefix, users().size(), rooms().size());
+}
+
+void server::enable_hibernation(const std::string& dir, std::chrono::seconds idle) {
+    m_hibernation = std::make_unique<hibernation>(dir, idle);
+}
+
+void server::touch_room(const room_ptr& room) {
+    static auto& wakeups = metrics::get_counter("bot_room_wakeups_total", "Hibernated games restored from disk");
+    static auto& latency = metrics::get_histogram("bot_room_wakeup_duration_seconds",
+                                                  "Time to restore a hibernated game");
+    if(!m_hibernation || !room || room == lobby()) {
+        return;
+    }
+    if(m_hibernation->is_hibernated(room->id())) {
+        auto time = utils::measure<std::chrono::nanoseconds>([&] {
+            p_load_game(room, m_hibernation->read(room->id()));
+            m_hibernation->release(room->id());
+        });
+        latency.record(time);
+        wakeups.add();
+        m_lgr.info("server::touch_room room:{} woke up in {}us", room->log_desc(), time.count() / 1000);
+    }
+    m_hibernation->touch(room, hibernation::clock::now());
+}
+
+auto server::hibernate_idle() -> std::size_t {
+    static auto& hibernations = metrics::get_counter("bot_room_hibernations_total", "Games hibernated to disk");
+    if(!m_hibernation) {
+        return 0;
+    }
+    std::size_t count = 0;
+    auto now          = hibernation::clock::now();
+    while(auto room = m_hibernation->pop_idle(now)) {
+        auto data = p_save_game(room);
+        if(data.empty()) {
+            continue; //nothing to hibernate, the room is tracked again when it's touched
+        }
+        try {
+            m_hibernation->store(room->id(), data);
+        } catch(const std::exception& e) {
+            m_lgr.error("server::hibernate_idle room:{} stays in memory: {}", room->log_desc(), e.what());
+            m_hibernation->touch(room, now);
+            break;
+        }
+        p_drop_game(room);
+        hibernations.add();
+        count++;
+        m_lgr.debug("server::hibernate_idle room:{} hibernated, {} bytes", room->log_desc(), data.size());
+    }
+    return count;
+}
+
+auto server::hibernated_rooms() const -> std::size_t {
+    return m_hibernation ? m_hibernation->hibernated() : 0;
+}
+
+auto server::memory_usage() const -> memory_stats {
+    memory_stats result;
+    std::vector<std::size_t> sizes;
+    sizes.reserve(users().size());
+    for(auto& [id, user]: users()) {
+        sizes.emplace_back(user->memory_usage());
+    }
+    result.users = memory_group::of(std::move(sizes));
+
+    sizes = {lobby()->memory_usage()};
+    for(auto& room: rooms()) {
+        sizes.emplace_back(room->memory_usage());
+    }
+    result.rooms      = memory_group::of(std::move(sizes));
+    result.containers = sizeof(server) + utils::heap_usage(users()) + utils::heap_usage(rooms());
+    return result;
+}
+
 }; // namespace bot
\ No newline at end of file
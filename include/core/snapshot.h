@@ -0,0 +1,478 @@
+#pragma once
+#include "components/logger.hpp"
+#include "core/lazy_utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace bot {
+namespace snapshot {
+
+constexpr char magic[8]        = {'T', 'G', 'P', 'K', 'S', 'N', 'A', 'P'}; /**< First bytes of a snapshot file */
+constexpr std::uint32_t version = 3;                                      /**< Version of the format */
+
+/**
+ * Appends plain values and strings to a binary buffer, native byte order.
+ * */
+class encoder {
+public:
+    /**
+     * Appends a trivially copyable value.
+     * @param value value to append.
+     * */
+    template<class T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        m_data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    /**
+     * Appends a string prefixed with its length.
+     * @param str string to append.
+     * */
+    void put_str(const std::string& str) {
+        put(static_cast<std::uint32_t>(str.size()));
+        m_data += str;
+    }
+    /**
+     * Appends a vector of trivially copyable values prefixed with its length.
+     * @param vec values to append.
+     * */
+    template<class T>
+    void put_vec(const std::vector<T>& vec) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        put(static_cast<std::uint32_t>(vec.size()));
+        m_data.append(reinterpret_cast<const char*>(vec.data()), vec.size() * sizeof(T));
+    }
+    /**
+     * Appends an unsigned value in LEB128, 7 bits per byte, so small values take a single byte.
+     * @param value value to append.
+     * */
+    void put_varint(std::uint64_t value) {
+        for(; value >= 0x80; value >>= 7) {
+            m_data += static_cast<char>(value | 0x80);
+        }
+        m_data += static_cast<char>(value);
+    }
+    auto data() -> std::string& { return m_data; }
+
+protected:
+    std::string m_data; /**< Encoded bytes */
+};
+
+/**
+ * Reads values written by encoder from a buffer.
+ * Throws runtime exception if the buffer ends too early.
+ * */
+class decoder {
+public:
+    /**
+     * Constructor.
+     * @param data encoded bytes, must outlive the decoder.
+     * @param size amount of bytes.
+     * */
+    decoder(const char* data, std::size_t size): m_pos(data), m_end(data + size) { }
+
+    template<class T>
+    auto get() -> T {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T value;
+        std::memcpy(&value, p_take(sizeof(T)), sizeof(T));
+        return value;
+    }
+    auto get_str() -> std::string {
+        auto size = get<std::uint32_t>();
+        return std::string(p_take(size), size);
+    }
+    template<class T>
+    auto get_vec() -> std::vector<T> {
+        static_assert(std::is_trivially_copyable_v<T>);
+        auto count = check_count(get<std::uint32_t>(), sizeof(T));
+        auto bytes = p_take(count * sizeof(T));
+        std::vector<T> result(count);
+        if(count) {
+            std::memcpy(result.data(), bytes, count * sizeof(T));
+        }
+        return result;
+    }
+    auto get_varint() -> std::uint64_t {
+        std::uint64_t value = 0;
+        for(unsigned shift = 0; shift < 64; shift += 7) {
+            auto byte = static_cast<std::uint8_t>(*p_take(1));
+            value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            if(!(byte & 0x80)) {
+                return value;
+            }
+        }
+        throw std::runtime_error("snapshot has a too long varint");
+    }
+    /**
+     * Takes next bytes as a separate decoder, e.g. to skip unknown tails of length-prefixed records.
+     * @param size amount of bytes.
+     * */
+    auto sub(std::size_t size) -> decoder { return decoder(p_take(size), size); }
+    auto empty() const -> bool { return m_pos == m_end; }
+    /**
+     * Checks a decoded amount of elements against bytes left before anything is allocated for them,
+     * so a corrupt amount throws instead of exhausting memory.
+     * Throws runtime exception if the elements can't fit.
+     * @param count amount of elements.
+     * @param min_size least bytes an element is encoded with.
+     * @returns count.
+     * */
+    auto check_count(std::uint64_t count, std::size_t min_size) const -> std::size_t {
+        if(count > static_cast<std::size_t>(m_end - m_pos) / std::max<std::size_t>(min_size, 1)) {
+            throw std::runtime_error("snapshot is truncated");
+        }
+        return static_cast<std::size_t>(count);
+    }
+
+protected:
+    const char* m_pos; /**< Next byte to read */
+    const char* m_end; /**< End of the buffer */
+
+    auto p_take(std::size_t size) -> const char* {
+        if(static_cast<std::size_t>(m_end - m_pos) < size) {
+            throw std::runtime_error("snapshot is truncated");
+        }
+        auto result = m_pos;
+        m_pos += size;
+        return result;
+    }
+};
+
+/**
+ * Saved user.
+ * */
+struct user_state {
+    std::uint64_t id = 0;   /**< Telegram id */
+    std::string name;       /**< Name */
+    std::string token;      /**< Token */
+    std::uint64_t room = 0; /**< Id of the current room, 0 is the lobby */
+};
+
+/**
+ * Saved room, users are referred to by their telegram ids.
+ * */
+struct room_state {
+    std::uint64_t id = 0;                    /**< Id of the room, 0 is the lobby */
+    std::string name;                        /**< Name */
+    std::string token;                       /**< Token */
+    std::uint64_t owner = 0;                 /**< Owner, 0 if none */
+    std::vector<std::uint64_t> users;        /**< Users in joining order, lobby's users are known from their rooms */
+    std::vector<std::uint64_t> banned;       /**< Banned users */
+    std::vector<std::uint64_t> muted;        /**< Muted users */
+    std::vector<std::uint64_t> unsubscribed; /**< Unsubscribed users */
+    std::string game;                        /**< Game state encoded by the server that owns the room, may be empty */
+    std::string game_file;                   /**< Link to a hibernated game's record, read into game by the writer */
+};
+
+/**
+ * Plain copy of a server, independent from entity registries, so it may be written from another thread.
+ * */
+struct server_state {
+    std::uint64_t last_room_id = 0; /**< Last generated room id */
+    std::int32_t update_offset = 0; /**< Offset past the last update applied to the state, 0 if unknown */
+    std::vector<user_state> users;  /**< Users */
+    std::vector<room_state> rooms;  /**< Rooms, the lobby goes first */
+};
+
+/**
+ * Encodes server state: header, update offset, then users, then rooms.
+ * @param state state to encode.
+ * @returns encoded bytes.
+ * */
+auto encode(const server_state& state) -> std::string;
+/**
+ * Decodes server state, throws runtime exception on wrong header or truncated data.
+ * @param data encoded bytes.
+ * @param size amount of bytes.
+ * */
+auto decode(const char* data, std::size_t size) -> server_state;
+/**
+ * Writes bytes to a temporary file and renames it over the path, so readers never see a partial file.
+ * @param path path of a file.
+ * @param data bytes to write.
+ * */
+void write_file(const std::string& path, const std::string& data);
+/**
+ * Reads a whole file with a single sequential read.
+ * @param path path of a file.
+ * @returns bytes, std::nullopt if there is no such file.
+ * */
+auto read_file(const std::string& path) -> std::optional<std::string>;
+/**
+ * Encodes state and writes it with write_file.
+ * @param path path of a snapshot.
+ * @param state state to write.
+ * */
+void write(const std::string& path, const server_state& state);
+/**
+ * Reads a snapshot with read_file.
+ * @param path path of a snapshot.
+ * @returns state, std::nullopt if there is no such file.
+ * */
+auto read(const std::string& path) -> std::optional<server_state>;
+/**
+ * Reads games of rooms from their game_file links and removes the links,
+ * throws runtime exception if a link is missing.
+ * @param state state to complete.
+ * */
+void read_game_files(server_state& state);
+/**
+ * Removes game_file links of a state that won't be written.
+ * @param state state to drop.
+ * */
+void remove_game_files(const server_state& state);
+
+auto encode(const server_state& state) -> std::string {
+    encoder enc;
+    enc.data().reserve(64 + state.users.size() * 48 + state.rooms.size() * 64);
+    enc.data().append(magic, sizeof(magic));
+    enc.put(version);
+    enc.put(std::uint32_t {0x01020304}); //byte order mark
+    enc.put(state.last_room_id);
+    enc.put(state.update_offset);
+    enc.put(static_cast<std::uint64_t>(state.users.size()));
+    for(auto& u: state.users) {
+        enc.put(u.id);
+        enc.put_str(u.name);
+        enc.put_str(u.token);
+        enc.put(u.room);
+    }
+    enc.put(static_cast<std::uint64_t>(state.rooms.size()));
+    for(auto& r: state.rooms) {
+        enc.put(r.id);
+        enc.put_str(r.name);
+        enc.put_str(r.token);
+        enc.put(r.owner);
+        enc.put_vec(r.users);
+        enc.put_vec(r.banned);
+        enc.put_vec(r.muted);
+        enc.put_vec(r.unsubscribed);
+        enc.put_str(r.game);
+    }
+    return std::move(enc.data());
+}
+
+auto decode(const char* data, std::size_t size) -> server_state {
+    decoder dec(data, size);
+    char header[sizeof(magic)];
+    for(auto& c: header) {
+        c = dec.get<char>();
+    }
+    if(std::memcmp(header, magic, sizeof(magic)) != 0) {
+        throw std::runtime_error("not a snapshot file");
+    }
+    auto v = dec.get<std::uint32_t>();
+    if(v != version && v != 2) { //version 2 has no update offset
+        throw std::runtime_error(fmt::format("unsupported snapshot version {}", v));
+    }
+    if(dec.get<std::uint32_t>() != 0x01020304) {
+        throw std::runtime_error("snapshot was written on a machine with another byte order");
+    }
+    server_state state;
+    state.last_room_id = dec.get<std::uint64_t>();
+    if(v > 2) {
+        state.update_offset = dec.get<std::int32_t>();
+    }
+    state.users.resize(dec.check_count(dec.get<std::uint64_t>(), 24)); //id, name, token and room
+    for(auto& u: state.users) {
+        u.id    = dec.get<std::uint64_t>();
+        u.name  = dec.get_str();
+        u.token = dec.get_str();
+        u.room  = dec.get<std::uint64_t>();
+    }
+    state.rooms.resize(dec.check_count(dec.get<std::uint64_t>(), 44)); //ids, strings and lists
+    for(auto& r: state.rooms) {
+        r.id           = dec.get<std::uint64_t>();
+        r.name         = dec.get_str();
+        r.token        = dec.get_str();
+        r.owner        = dec.get<std::uint64_t>();
+        r.users        = dec.get_vec<std::uint64_t>();
+        r.banned       = dec.get_vec<std::uint64_t>();
+        r.muted        = dec.get_vec<std::uint64_t>();
+        r.unsubscribed = dec.get_vec<std::uint64_t>();
+        r.game         = dec.get_str();
+    }
+    if(!dec.empty()) {
+        throw std::runtime_error("trailing bytes after snapshot");
+    }
+    return state;
+}
+
+void write_file(const std::string& path, const std::string& data) {
+    auto tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out.write(data.data(), data.size());
+        out.flush();
+        if(!out) {
+            throw std::runtime_error("can't write " + tmp);
+        }
+    }
+    if(std::rename(tmp.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("can't rename " + tmp + " to " + path);
+    }
+}
+
+auto read_file(const std::string& path) -> std::optional<std::string> {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if(!in) {
+        return std::nullopt;
+    }
+    std::string data(static_cast<std::size_t>(in.tellg()), '\0');
+    in.seekg(0);
+    if(!in.read(data.data(), data.size())) {
+        throw std::runtime_error("can't read " + path);
+    }
+    return data;
+}
+
+void write(const std::string& path, const server_state& state) {
+    write_file(path, encode(state));
+}
+
+auto read(const std::string& path) -> std::optional<server_state> {
+    auto data = read_file(path);
+    if(!data) {
+        return std::nullopt;
+    }
+    return decode(data->data(), data->size());
+}
+
+void read_game_files(server_state& state) {
+    for(auto& r: state.rooms) {
+        if(r.game_file.empty()) {
+            continue;
+        }
+        auto data = read_file(r.game_file);
+        if(!data) {
+            throw std::runtime_error(fmt::format("no game record {} of room {}", r.game_file, r.id));
+        }
+        r.game = std::move(*data);
+        std::filesystem::remove(r.game_file);
+        r.game_file.clear();
+    }
+}
+
+void remove_game_files(const server_state& state) {
+    for(auto& r: state.rooms) {
+        if(!r.game_file.empty()) {
+            std::error_code ec;
+            std::filesystem::remove(r.game_file, ec);
+        }
+    }
+}
+
+/**
+ * Background thread that writes submitted states. \n
+ * Only the latest submitted state is kept, so a slow disk never queues snapshots up.
+ * Games of hibernated rooms are read from their links here, not by the thread that made the state.
+ * */
+class writer {
+public:
+    /**
+     * Constructor, starts the thread.
+     * @param path path of a snapshot.
+     * */
+    writer(std::string path);
+    /**
+     * Destructor, writes pending state and joins the thread.
+     * */
+    ~writer();
+    writer(const writer&) = delete;
+    writer& operator=(const writer&) = delete;
+
+    /**
+     * Hands state over to the thread, replaces a pending one and removes its links.
+     * @param state state to write.
+     * */
+    void submit(server_state state);
+    /**
+     * Returns amount of written snapshots.
+     * */
+    auto written() const -> std::size_t;
+
+protected:
+    std::string m_path;                  /**< Path of a snapshot */
+    mutable std::mutex m_mutex;          /**< Guards pending state and counters */
+    std::condition_variable m_cv;        /**< Wakes the thread up */
+    std::optional<server_state> m_state; /**< State waiting to be written */
+    std::size_t m_written = 0;           /**< Written snapshots */
+    bool m_stop           = false;       /**< Flag to finish the thread */
+    logger m_lgr;                        /**< Logger */
+    std::thread m_thread;                /**< Writing thread */
+
+    void p_run();
+};
+
+writer::writer(std::string path): m_path(std::move(path)), m_lgr(get_logger()), m_thread([this] { p_run(); }) { }
+
+writer::~writer() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_one();
+    m_thread.join();
+}
+
+void writer::submit(server_state state) {
+    std::optional<server_state> replaced;
+    {
+        std::lock_guard lock(m_mutex);
+        replaced.swap(m_state);
+        m_state = std::move(state);
+    }
+    m_cv.notify_one();
+    if(replaced) {
+        remove_game_files(*replaced);
+    }
+}
+
+auto writer::written() const -> std::size_t {
+    std::lock_guard lock(m_mutex);
+    return m_written;
+}
+
+void writer::p_run() {
+    std::unique_lock lock(m_mutex);
+    while(true) {
+        m_cv.wait(lock, [this] { return m_stop || m_state; });
+        if(!m_state) {
+            return; //stopped with nothing pending
+        }
+        auto state = std::move(*m_state);
+        m_state.reset();
+        lock.unlock();
+        try {
+            auto time = utils::measure<std::chrono::milliseconds>([&] {
+                read_game_files(state);
+                write(m_path, state);
+            });
+            m_lgr.info("snapshot::writer written {} users and {} rooms to {} in {}ms", state.users.size(),
+                       state.rooms.size(), m_path, time.count());
+        } catch(const std::exception& e) {
+            m_lgr.error("snapshot::writer failed: {}", e.what());
+        }
+        remove_game_files(state); //links left by a failure
+        lock.lock();
+        m_written++;
+    }
+}
+
+} // namespace snapshot
+} // namespace bot
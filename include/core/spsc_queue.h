@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+namespace bot {
+
+/**
+ * Lock-free FIFO queue of a fixed capacity between one producer thread and one consumer thread. \n
+ * Values are swapped in and out of preallocated slots instead of being copied, so both sides get back
+ * buffers of earlier values and a steady flow of values doesn't allocate.
+ * */
+template<class T>
+class spsc_queue {
+public:
+    /**
+     * Constructor.
+     * @param capacity most values in the queue, at least 1.
+     * */
+    spsc_queue(std::size_t capacity): m_slots((capacity ? capacity : 1) + 1) { }
+    spsc_queue(const spsc_queue&) = delete;
+    spsc_queue& operator=(const spsc_queue&) = delete;
+
+    /**
+     * Swaps a value into the queue, called by the producer only, never waits.
+     * @param value value to append, holds a recycled value of an earlier pop afterwards.
+     * @returns false if the queue is full, value is left untouched then.
+     * */
+    auto try_push(T& value) -> bool;
+    /**
+     * Swaps the oldest value out of the queue, called by the consumer only, never waits.
+     * @param out receives the value, its old content is recycled by a later push.
+     * @returns false if the queue is empty.
+     * */
+    auto try_pop(T& out) -> bool;
+    /**
+     * Returns amount of values in the queue, exact only on the producer or the consumer thread.
+     * */
+    auto size() const -> std::size_t;
+
+protected:
+    std::vector<T> m_slots;                          /**< Ring of values, one slot stays free */
+    alignas(64) std::atomic<std::size_t> m_head {0}; /**< Next slot to push to, written by the producer */
+    alignas(64) std::atomic<std::size_t> m_tail {0}; /**< Next slot to pop from, written by the consumer */
+};
+
+template<class T>
+auto spsc_queue<T>::try_push(T& value) -> bool {
+    auto head = m_head.load(std::memory_order_relaxed);
+    auto next = (head + 1) % m_slots.size();
+    if(next == m_tail.load(std::memory_order_acquire)) {
+        return false;
+    }
+    std::swap(m_slots[head], value);
+    m_head.store(next, std::memory_order_release);
+    return true;
+}
+
+template<class T>
+auto spsc_queue<T>::try_pop(T& out) -> bool {
+    auto tail = m_tail.load(std::memory_order_relaxed);
+    if(tail == m_head.load(std::memory_order_acquire)) {
+        return false;
+    }
+    std::swap(out, m_slots[tail]);
+    m_tail.store((tail + 1) % m_slots.size(), std::memory_order_release);
+    return true;
+}
+
+template<class T>
+auto spsc_queue<T>::size() const -> std::size_t {
+    auto head = m_head.load(std::memory_order_acquire);
+    auto tail = m_tail.load(std::memory_order_acquire);
+    return (head + m_slots.size() - tail) % m_slots.size();
+}
+
+} // namespace bot
@@ -0,0 +1,326 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bot {
+
+/**
+ * Hierarchical timing wheel: 4 levels of 256 slots, a slot of every level spans the whole level below. \n
+ * Timers are intrusive doubly linked lists over a pool of nodes, so schedule and cancel are O(1)
+ * and don't allocate in a steady state. A timer is moved to a lower level at most once per level,
+ * advancing is O(1) per tick besides that. Not thread-safe, see timer_thread.
+ * */
+template<class T>
+class timing_wheel {
+public:
+    using clock                         = std::chrono::steady_clock;                     /**< Clock of deadlines */
+    static constexpr std::uint32_t npos = std::numeric_limits<std::uint32_t>::max(); /**< Null index */
+
+    /**
+     * Handle of a scheduled timer, cancelling it after expiration is safe and does nothing.
+     * */
+    struct handle {
+        std::uint32_t index      = npos; /**< Index of timer's node */
+        std::uint32_t generation = 0;    /**< Generation of the node when timer was scheduled */
+    };
+
+    /**
+     * Constructor.
+     * @param tick resolution of the wheel, deadlines are rounded up to it.
+     * @param start time of the tick 0.
+     * */
+    timing_wheel(clock::duration tick, clock::time_point start = clock::now());
+
+    /**
+     * Schedules a timer, deadlines in the past expire on the next tick.
+     * Deadlines further than 2^32 ticks are clamped.
+     * @param deadline time of expiration.
+     * @param value value to hand over on expiration.
+     * @returns handle to cancel the timer.
+     * */
+    auto schedule(clock::time_point deadline, T value) -> handle;
+    /**
+     * Cancels a timer.
+     * @param h handle of the timer.
+     * @returns true if timer was pending.
+     * */
+    auto cancel(handle h) -> bool;
+    /**
+     * Advances the wheel up to a given time and hands over values of expired timers in deadline order.
+     * Callback may schedule new timers.
+     * @param now current time.
+     * @param on_expired callback taking T&&.
+     * */
+    template<class Func>
+    void advance(clock::time_point now, Func&& on_expired);
+    /**
+     * Returns amount of pending timers.
+     * */
+    auto size() const -> std::size_t { return m_size; }
+
+protected:
+    static constexpr std::size_t levels    = 4;              /**< Amount of levels */
+    static constexpr std::size_t slot_bits = 8;              /**< Bits of a tick per level */
+    static constexpr std::size_t slots     = 1 << slot_bits; /**< Slots per level */
+
+    /**
+     * Pooled timer.
+     * */
+    struct node {
+        T value {};                      /**< Value to hand over */
+        std::uint64_t expires    = 0;    /**< Tick of expiration */
+        std::uint32_t prev       = npos; /**< Previous node in the slot */
+        std::uint32_t next       = npos; /**< Next node in the slot */
+        std::uint32_t slot       = npos; /**< Slot the node is linked to, npos if it's free */
+        std::uint32_t generation = 0;    /**< Incremented when the node is freed */
+    };
+
+    clock::duration m_tick;                            /**< Resolution */
+    clock::time_point m_start;                         /**< Time of the tick 0 */
+    std::uint64_t m_current = 0;                       /**< Last processed tick */
+    std::size_t m_size      = 0;                       /**< Pending timers */
+    std::vector<node> m_nodes;                         /**< Pool of nodes */
+    std::vector<std::uint32_t> m_free;                 /**< Free nodes */
+    std::array<std::uint32_t, levels * slots> m_heads; /**< Heads of slots' lists */
+
+    void p_link(std::uint32_t index);
+    void p_unlink(std::uint32_t index);
+    void p_free(std::uint32_t index);
+    void p_cascade(std::size_t level);
+};
+
+template<class T>
+timing_wheel<T>::timing_wheel(clock::duration tick, clock::time_point start): m_tick(tick), m_start(start) {
+    m_heads.fill(npos);
+}
+
+template<class T>
+auto timing_wheel<T>::schedule(clock::time_point deadline, T value) -> handle {
+    std::uint32_t index;
+    if(m_free.empty()) {
+        index = static_cast<std::uint32_t>(m_nodes.size());
+        m_nodes.emplace_back();
+    } else {
+        index = m_free.back();
+        m_free.pop_back();
+    }
+    auto& n = m_nodes[index];
+    n.value = std::move(value);
+    //rounded up, so a timer never expires before its deadline
+    std::uint64_t ticks = deadline > m_start ? (deadline - m_start + m_tick - clock::duration(1)) / m_tick : 0;
+    n.expires           = std::max(ticks, m_current + 1);
+    p_link(index);
+    m_size++;
+    return {index, n.generation};
+}
+
+template<class T>
+auto timing_wheel<T>::cancel(handle h) -> bool {
+    if(h.index >= m_nodes.size() || m_nodes[h.index].generation != h.generation || m_nodes[h.index].slot == npos) {
+        return false;
+    }
+    p_unlink(h.index);
+    p_free(h.index);
+    return true;
+}
+
+template<class T>
+template<class Func>
+void timing_wheel<T>::advance(clock::time_point now, Func&& on_expired) {
+    if(now < m_start) {
+        return;
+    }
+    std::uint64_t target = (now - m_start) / m_tick;
+    while(m_current < target) {
+        if(m_size == 0) { //nothing to cascade or expire
+            m_current = target;
+            return;
+        }
+        m_current++;
+        for(std::size_t level = 1; level < levels; level++) {
+            if(m_current & ((std::uint64_t {1} << (slot_bits * level)) - 1)) {
+                break; //lower levels haven't wrapped around yet
+            }
+            p_cascade(level);
+        }
+        auto& head = m_heads[m_current & (slots - 1)];
+        while(head != npos) {
+            auto index = head;
+            p_unlink(index);
+            auto value = std::move(m_nodes[index].value);
+            p_free(index);
+            on_expired(std::move(value));
+        }
+    }
+}
+
+template<class T>
+void timing_wheel<T>::p_link(std::uint32_t index) {
+    auto& n    = m_nodes[index];
+    auto delta = n.expires - m_current;
+    if(delta >> (slot_bits * levels)) {
+        delta     = (std::uint64_t {1} << (slot_bits * levels)) - 1;
+        n.expires = m_current + delta;
+    }
+    std::size_t level = 0;
+    while(delta >> (slot_bits * (level + 1))) {
+        level++;
+    }
+    n.slot = static_cast<std::uint32_t>(level * slots + ((n.expires >> (slot_bits * level)) & (slots - 1)));
+    n.prev = npos;
+    n.next = m_heads[n.slot];
+    if(n.next != npos) {
+        m_nodes[n.next].prev = index;
+    }
+    m_heads[n.slot] = index;
+}
+
+template<class T>
+void timing_wheel<T>::p_unlink(std::uint32_t index) {
+    auto& n = m_nodes[index];
+    if(n.prev != npos) {
+        m_nodes[n.prev].next = n.next;
+    } else {
+        m_heads[n.slot] = n.next;
+    }
+    if(n.next != npos) {
+        m_nodes[n.next].prev = n.prev;
+    }
+    n.slot = npos;
+}
+
+template<class T>
+void timing_wheel<T>::p_free(std::uint32_t index) {
+    auto& n = m_nodes[index];
+    n.value = T {};
+    n.generation++;
+    m_free.emplace_back(index);
+    m_size--;
+}
+
+template<class T>
+void timing_wheel<T>::p_cascade(std::size_t level) {
+    auto& head = m_heads[level * slots + ((m_current >> (slot_bits * level)) & (slots - 1))];
+    auto index = head;
+    head       = npos;
+    while(index != npos) {
+        auto next = m_nodes[index].next;
+        p_link(index); //closer to expiration now, goes to a lower level
+        index = next;
+    }
+}
+
+/**
+ * Timing wheel ticked by its own thread. \n
+ * Values of expired timers are collected rather than handled on the timer thread,
+ * so they are handled by the thread that owns state they refer to, see take_expired.
+ * */
+template<class T>
+class timer_thread {
+public:
+    using clock  = typename timing_wheel<T>::clock;  /**< Clock of deadlines */
+    using handle = typename timing_wheel<T>::handle; /**< Handle of a timer */
+
+    /**
+     * Constructor, starts the thread.
+     * @param tick resolution of timers.
+     * */
+    timer_thread(typename clock::duration tick);
+    /**
+     * Destructor, stops the thread, pending timers are dropped.
+     * */
+    ~timer_thread();
+    timer_thread(const timer_thread&) = delete;
+    timer_thread& operator=(const timer_thread&) = delete;
+
+    /**
+     * Schedules a timer, see timing_wheel::schedule.
+     * */
+    auto schedule(typename clock::time_point deadline, T value) -> handle;
+    /**
+     * Cancels a timer, see timing_wheel::cancel.
+     * */
+    auto cancel(handle h) -> bool;
+    /**
+     * Takes values of timers expired since the last call, in deadline order.
+     * */
+    auto take_expired() -> std::vector<T>;
+    /**
+     * Returns amount of timers that are pending or expired and not taken yet.
+     * */
+    auto pending() const -> std::size_t;
+
+protected:
+    typename clock::duration m_tick; /**< Resolution */
+    mutable std::mutex m_mutex;      /**< Guards the wheel and expired values */
+    std::condition_variable m_cv;    /**< Wakes the thread up to stop */
+    timing_wheel<T> m_wheel;         /**< Pending timers */
+    std::vector<T> m_expired;        /**< Values of expired timers */
+    bool m_stop = false;             /**< Flag to finish the thread */
+    std::thread m_thread;            /**< Ticking thread */
+
+    void p_run();
+};
+
+template<class T>
+timer_thread<T>::timer_thread(typename clock::duration tick):
+    m_tick(tick), m_wheel(tick), m_thread([this] { p_run(); }) { }
+
+template<class T>
+timer_thread<T>::~timer_thread() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_one();
+    m_thread.join();
+}
+
+template<class T>
+auto timer_thread<T>::schedule(typename clock::time_point deadline, T value) -> handle {
+    std::lock_guard lock(m_mutex);
+    return m_wheel.schedule(deadline, std::move(value));
+}
+
+template<class T>
+auto timer_thread<T>::cancel(handle h) -> bool {
+    std::lock_guard lock(m_mutex);
+    return m_wheel.cancel(h);
+}
+
+template<class T>
+auto timer_thread<T>::take_expired() -> std::vector<T> {
+    std::vector<T> result;
+    std::lock_guard lock(m_mutex);
+    result.swap(m_expired);
+    return result;
+}
+
+template<class T>
+auto timer_thread<T>::pending() const -> std::size_t {
+    std::lock_guard lock(m_mutex);
+    return m_wheel.size() + m_expired.size();
+}
+
+template<class T>
+void timer_thread<T>::p_run() {
+    std::unique_lock lock(m_mutex);
+    auto next = clock::now();
+    while(!m_stop) {
+        next += m_tick;
+        if(m_cv.wait_until(lock, next, [this] { return m_stop; })) {
+            return;
+        }
+        m_wheel.advance(clock::now(), [this](T&& value) { m_expired.emplace_back(std::move(value)); });
+    }
+}
+
+} // namespace bot
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fmt/format.h>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace bot {
+namespace trace {
+
+/**
+ * Finished span, stored in a per-thread ring buffer.
+ * */
+struct event {
+    const char* name     = nullptr; /**< Static name of a stage */
+    std::int64_t start   = 0;       /**< Start, ns since steady_clock's epoch */
+    std::int64_t dur     = 0;       /**< Duration, ns */
+    std::int64_t chat_id = 0;       /**< Chat of an update being handled */
+    const char* command  = nullptr; /**< Command of an update being handled, static or owned by room_bot */
+    char room[16]        = {};      /**< Token of sender's room */
+};
+
+/**
+ * Single-writer ring buffer of finished spans, oldest events are overwritten.
+ * */
+class ring {
+public:
+    static constexpr std::size_t capacity = 1 << 15; /**< Events per thread */
+
+    ring(std::size_t tid): tid(tid) { }
+
+    void push(const event& ev) noexcept {
+        auto head                 = m_head.load(std::memory_order_relaxed);
+        m_events[head % capacity] = ev;
+        m_head.store(head + 1, std::memory_order_release);
+    }
+    /**
+     * Copies stored events, oldest first. Expected to be called when the writer is quiescent.
+     * */
+    auto events() const -> std::vector<event> {
+        auto head  = m_head.load(std::memory_order_acquire);
+        auto first = head > capacity ? head - capacity : 0;
+        std::vector<event> result;
+        result.reserve(head - first);
+        for(auto i = first; i < head; i++) {
+            result.push_back(m_events[i % capacity]);
+        }
+        return result;
+    }
+
+    const std::size_t tid; /**< Index of writer thread, used as tid in trace */
+
+protected:
+    std::array<event, capacity> m_events; /**< Events storage */
+    std::atomic<std::size_t> m_head {0};  /**< Amount of pushed events */
+};
+
+/**
+ * Tags of the update that is being handled by current thread.
+ * */
+struct context {
+    bool sampled         = false;
+    std::int64_t chat_id = 0;
+    const char* command  = nullptr;
+    char room[16]        = {};
+};
+
+namespace detail {
+inline std::atomic<std::size_t> sample_every {0}; ///< 0 - tracing disabled, N - trace every Nth update
+inline std::atomic<std::size_t> updates {0};      ///< Updates seen by root spans
+inline std::mutex rings_mutex;
+inline std::vector<std::shared_ptr<ring>> rings;
+inline thread_local context ctx;
+
+inline auto now() noexcept -> std::int64_t {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+inline auto local_ring() -> ring& {
+    thread_local std::shared_ptr<ring> r = [] {
+        std::lock_guard lock(rings_mutex);
+        return rings.emplace_back(std::make_shared<ring>(rings.size()));
+    }();
+    return *r;
+}
+} // namespace detail
+
+/**
+ * Enables tracing.
+ * @param sample_every trace every Nth update, 1 - trace everything.
+ * */
+inline void enable(std::size_t sample_every) {
+    detail::sample_every = std::max<std::size_t>(sample_every, 1);
+}
+
+/**
+ * Checks if tracing is enabled.
+ * */
+inline auto enabled() noexcept -> bool {
+    return detail::sample_every.load(std::memory_order_relaxed) != 0;
+}
+
+/**
+ * Tags spans of current update with sender's room.
+ * @param token token of a room.
+ * */
+inline void tag_room(const std::string& token) noexcept {
+    auto& ctx = detail::ctx;
+    if(ctx.sampled) {
+        auto len = std::min(token.size(), sizeof(ctx.room) - 1);
+        std::memcpy(ctx.room, token.data(), len);
+        ctx.room[len] = '\0';
+    }
+}
+
+/**
+ * RAII span of a stage. Records nothing unless current update is sampled.
+ * */
+class span {
+public:
+    /**
+     * Starts a span.
+     * @param name static name of a stage.
+     * */
+    span(const char* name) noexcept: m_name(detail::ctx.sampled ? name : nullptr) {
+        if(m_name) {
+            m_start = detail::now();
+        }
+    }
+    ~span() {
+        if(m_name) {
+            p_record();
+        }
+    }
+    span(const span&) = delete;
+    span& operator=(const span&) = delete;
+
+protected:
+    const char* m_name;      /**< Name of a stage, nullptr if not sampled */
+    std::int64_t m_start {}; /**< Start time */
+
+    span(const char* name, bool): m_name(name) { }
+
+    void p_record() {
+        auto& ctx = detail::ctx;
+        event ev;
+        ev.name    = m_name;
+        ev.start   = m_start;
+        ev.dur     = detail::now() - m_start;
+        ev.chat_id = ctx.chat_id;
+        ev.command = ctx.command;
+        std::memcpy(ev.room, ctx.room, sizeof(ev.room));
+        detail::local_ring().push(ev);
+    }
+};
+
+/**
+ * RAII span of a whole update. Makes sampling decision and sets tags for nested spans.
+ * */
+class root_span: public span {
+public:
+    /**
+     * Starts handling of an update.
+     * @param name static name of a stage.
+     * @param chat_id chat of an update.
+     * @param command command of an update, must outlive the span.
+     * */
+    root_span(const char* name, std::int64_t chat_id, const char* command) noexcept: span(nullptr, false) {
+        auto every = detail::sample_every.load(std::memory_order_relaxed);
+        if(!every || detail::updates.fetch_add(1, std::memory_order_relaxed) % every != 0) {
+            return;
+        }
+        auto& ctx   = detail::ctx;
+        ctx.sampled = true;
+        ctx.chat_id = chat_id;
+        ctx.command = command;
+        ctx.room[0] = '\0';
+        m_name      = name;
+        m_start     = detail::now();
+    }
+    ~root_span() {
+        if(m_name) {
+            p_record();
+            m_name = nullptr;
+        }
+        detail::ctx = context {};
+    }
+};
+
+/**
+ * Writes all rings as Chrome/Perfetto trace-event JSON.
+ * Threads that write spans should be stopped by then.
+ * @param path path of a file.
+ * @returns amount of written events.
+ * */
+inline auto dump(const std::string& path) -> std::size_t {
+    std::vector<std::shared_ptr<ring>> rings;
+    {
+        std::lock_guard lock(detail::rings_mutex);
+        rings = detail::rings;
+    }
+    std::ofstream out(path);
+    out << "{\"traceEvents\":[\n";
+    std::size_t count = 0;
+    for(auto& r: rings) {
+        for(auto& ev: r->events()) {
+            out << (count++ ? ",\n" : "");
+            out << fmt::format("{{\"name\":\"{}\",\"cat\":\"bot\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":1,"
+                               "\"tid\":{},\"args\":{{\"chat\":{},\"command\":\"{}\",\"room\":\"{}\"}}}}",
+                               ev.name, ev.start / 1e3, ev.dur / 1e3, r->tid, ev.chat_id,
+                               ev.command ? ev.command : "", ev.room);
+        }
+    }
+    out << "\n]}\n";
+    return count;
+}
+
+} // namespace trace
+} // namespace bot
@@ -0,0 +1,183 @@
+#pragma once
+#include "components/logger.hpp"
+#include "core/logging_obj.h"
+#include "core/metrics.h"
+#include "core/snapshot.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <unordered_set>
+#include <vector>
+
+namespace bot {
+
+/**
+ * Journal of applied update ids, so a restarted bot resumes long polling right after the last applied update
+ * and skips updates Telegram delivers again. \n
+ * Ids are appended to a file as raw int32 and made durable by one fdatasync per handled batch,
+ * a torn last record is ignored on load. The last window ids are kept in memory for O(1) lookups,
+ * the file is rewritten with them once it grows past twice the window.
+ * */
+class update_log: public logging_obj {
+public:
+    /**
+     * Constructor, loads the journal if it exists.
+     * Throws runtime exception if the file can't be opened.
+     * @param path path of the journal.
+     * @param window amount of recent ids to remember.
+     * */
+    update_log(const std::string& path, std::size_t window = 4096);
+    /**
+     * Destructor, syncs recorded ids.
+     * */
+    ~update_log();
+    update_log(const update_log&) = delete;
+    update_log& operator=(const update_log&) = delete;
+
+    /**
+     * Returns offset to resume long polling from, 0 if the journal is empty or too old to trust its ids.
+     * */
+    auto offset() const -> std::int32_t { return m_offset; }
+    /**
+     * Checks if an update is among the recently applied ones.
+     * @param id update_id.
+     * */
+    auto applied(std::int32_t id) const -> bool { return m_set.count(id); }
+    /**
+     * Records an applied update, it's durable after the next sync.
+     * @param id update_id.
+     * */
+    void record(std::int32_t id);
+    /**
+     * Writes recorded ids and waits for them to reach the disk.
+     * Throws runtime exception if the write fails.
+     * */
+    void sync();
+
+protected:
+    //Telegram picks ids of new updates randomly after a week without updates
+    static constexpr std::chrono::hours max_age {24 * 7}; /**< Older journals give no offset */
+
+    std::string m_path;                     /**< Path of the journal */
+    std::size_t m_window;                   /**< Amount of ids to remember */
+    int m_fd = -1;                          /**< Journal opened for appending */
+    std::vector<std::int32_t> m_ring;       /**< Last ids, m_head is the oldest once it's full */
+    std::size_t m_head = 0;                 /**< Next position to overwrite in the ring */
+    std::unordered_set<std::int32_t> m_set; /**< Ids of the ring */
+    std::vector<std::int32_t> m_pending;    /**< Recorded ids not written yet */
+    std::size_t m_records = 0;              /**< Records in the file */
+    std::int32_t m_offset = 0;              /**< Offset to resume from */
+    metrics::histogram& m_sync_hist;        /**< Durations of sync */
+
+    void p_remember(std::int32_t id);
+    void p_open();
+    void p_compact();
+};
+
+update_log::update_log(const std::string& path, std::size_t window):
+    m_path(path), m_window(window ? window : 1),
+    m_sync_hist(metrics::get_histogram("bot_update_log_sync_duration_seconds",
+                                       "Time to write and fdatasync ids of a handled batch of updates")) {
+    m_ring.reserve(m_window);
+    m_set.reserve(m_window * 2);
+    if(auto data = snapshot::read_file(path)) {
+        auto fresh = std::filesystem::file_time_type::clock::now() - std::filesystem::last_write_time(path) < max_age;
+        m_records  = data->size() / sizeof(std::int32_t);
+        auto first = m_records > m_window ? m_records - m_window : 0;
+        for(auto i = first; i < m_records; i++) {
+            std::int32_t id;
+            std::memcpy(&id, data->data() + i * sizeof(id), sizeof(id));
+            p_remember(id);
+        }
+        if(m_records && fresh) {
+            std::int32_t last;
+            std::memcpy(&last, data->data() + (m_records - 1) * sizeof(last), sizeof(last));
+            m_offset = last + 1;
+        }
+        m_lgr.info("update_log::update_log {} has {} ids, resuming from offset {}", path, m_records, m_offset);
+        if(data->size() % sizeof(std::int32_t)) {
+            m_lgr.warn("update_log::update_log {} ends with a torn record, rewriting", path);
+            p_compact();
+        }
+    }
+    if(m_fd < 0) {
+        p_open();
+    }
+}
+
+update_log::~update_log() {
+    try {
+        sync();
+    } catch(const std::exception& e) {
+        m_lgr.error("update_log::~update_log {}", e.what());
+    }
+    ::close(m_fd);
+}
+
+void update_log::record(std::int32_t id) {
+    p_remember(id);
+    m_pending.emplace_back(id);
+    m_offset = id + 1;
+}
+
+void update_log::sync() {
+    if(m_pending.empty()) {
+        return;
+    }
+    metrics::scoped_timer timer(m_sync_hist);
+    auto bytes = m_pending.size() * sizeof(std::int32_t);
+    if(::write(m_fd, m_pending.data(), bytes) != static_cast<ssize_t>(bytes) || ::fdatasync(m_fd) != 0) {
+        auto mes = fmt::format("update_log::sync can't write {}: {}", m_path, std::strerror(errno));
+        m_lgr.error(mes);
+        throw std::runtime_error(mes);
+    }
+    m_records += m_pending.size();
+    m_pending.clear();
+    if(m_records > m_window * 2) {
+        p_compact();
+    }
+}
+
+void update_log::p_remember(std::int32_t id) {
+    if(m_ring.size() < m_window) {
+        m_ring.emplace_back(id);
+    } else {
+        m_set.erase(m_ring[m_head]);
+        m_ring[m_head] = id;
+        m_head         = (m_head + 1) % m_window;
+    }
+    m_set.emplace(id);
+}
+
+void update_log::p_open() {
+    m_fd = ::open(m_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if(m_fd < 0) {
+        auto mes = fmt::format("update_log::p_open can't open {}: {}", m_path, std::strerror(errno));
+        m_lgr.error(mes);
+        throw std::runtime_error(mes);
+    }
+}
+
+void update_log::p_compact() {
+    std::string data;
+    data.reserve(m_ring.size() * sizeof(std::int32_t));
+    for(std::size_t i = 0; i < m_ring.size(); i++) { //oldest first
+        auto id = m_ring[(m_head + i) % m_ring.size()];
+        data.append(reinterpret_cast<const char*>(&id), sizeof(id));
+    }
+    snapshot::write_file(m_path, data);
+    if(m_fd >= 0) {
+        ::close(m_fd);
+    }
+    p_open();
+    ::fsync(m_fd);
+    m_records = m_ring.size();
+}
+
+} // namespace bot
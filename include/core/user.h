@@ -1,5 +1,7 @@
 #pragma once
+#include "core/datatypes.h"
 #include "core/identifyable.h"
+#include "core/lazy_utils.h"
 #include "core/nameable.h"
 
 #include <cstddef>
@@ -14,7 +16,7 @@ class room;
  * */
 class user: public nameable, public identifyable {
 public:
-    using room_ptr = std::shared_ptr<room>; /**< define for room pointer */
+    using room_ptr = bot::room_ptr; /**< define for room pointer */
     using token_t  = std::string;           /**< define for token's type */
 
     /**
@@ -37,6 +39,12 @@ public:
      * @returns user's description
      * */
     virtual std::string log_desc() const;
+
+    /**
+     * Bytes occupied by the user, including owned strings.
+     * @returns size in bytes
+     * */
+    virtual auto memory_usage() const -> std::size_t;
 };
 
 user::user(id_t id): identifyable(id) { }
@@ -49,6 +57,10 @@ std::string user::log_desc() const {
     return name() + "[tk:" + token() + "][id:" + std::to_string(id()) + "]";
 }
 
+auto user::memory_usage() const -> std::size_t {
+    return sizeof(user) + utils::heap_usage(name()) + utils::heap_usage(token());
+}
+
 }; // namespace bot
 
 #include "core/room.h"
\ No newline at end of file
@@ -3,9 +3,14 @@
 #include "core/lazy_utils.h"
 #include "core/logger.h"
 #include "core/logging_obj.h"
+#include "core/metrics.h"
 #include "core/property.h"
 #include "games/player.h"
 
+#include <memory_resource>
+#include <queue>
+#include <string>
+#include <string_view>
 #include <vector>
 namespace games {
 
@@ -15,19 +20,23 @@ namespace games {
 class game: public bot::logging_obj {
 protected:
 public:
-    using player_ptr   = std::shared_ptr<player>; /**< Define for player pointer type. */
-    using players_cont = std::vector<player_ptr>; /**< Define for player's container. */
+    using player_ptr         = bot::entity_ptr<player>; /**< Define for player pointer type. */
+    using players_cont       = std::vector<player_ptr>; /**< Define for player's container, in seat order. */
+    using spectators_queue_t = player::queue_t;         /**< Define for queue of messages to spectators. */
 
     bot::property<players_cont> players; /**< Property storing players. */
     enum class state { playing, ended };
     bot::property<enum state> state; /**< Game state. */
 
     /**
-     * Default constructor.
+     * Constructor.
+     * @param resource memory resource of messages to spectators, e.g. game's pool of texts.
+     * It's only stored until the game is constructed, so a derived game may pass its own member.
      * */
-    game();
+    game(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
     /**
      * Virtual destructor for polymorphism purposes.
+     * Destroys players' entities.
      * */
     virtual ~game();
     /**
@@ -53,26 +62,92 @@ public:
      * */
     virtual void handle_exit(const player_ptr pl) = 0;
     /**
-     * Function to remove someone from the game.
+     * Function to remove someone from the game and destroy player's entity.
      * If user is not in the game, throws runtime exception.
      * Derived classes should consider to do so too.
      * @param pl player to remove.
      * */
     virtual void del_player(const player_ptr& pl);
+    /**
+     * Function to get bytes occupied by the game and its players.
+     * Derived classes should add their own state.
+     * @returns size in bytes.
+     * */
+    virtual auto memory_usage() const -> std::size_t;
+    /**
+     * Function to add message to send later to users of the room that watch the game without playing. \n
+     * It's sent once for all spectators, so it must hold public information only.
+     * @param mes message to send.
+     * */
+    void send_spectators(std::string_view mes);
+    /**
+     * Function to get message queue to send to spectators.
+     * @returns messages queue that has to be sent to every spectator.
+     * */
+    auto spectators_queue() -> spectators_queue_t&;
+    /**
+     * Drops queued messages to spectators and their memory, doesn't allocate.
+     * Has to be called before the memory resource of the queue is released.
+     * */
+    void clear_spectators();
+
+protected:
+    std::pmr::memory_resource* m_spectators_resource; /**< Memory resource of messages to spectators. */
+    spectators_queue_t m_spectators_mes;               /**< Messages queue to send to spectators. */
+
+    /**
+     * Gauge of games that exist at the moment.
+     * */
+    static auto metrics_active() -> bot::metrics::gauge&;
 };
 
-game::game() { }
+game::game(std::pmr::memory_resource* resource):
+    m_spectators_resource(resource), m_spectators_mes(std::pmr::list<player::mes_t>(resource)) {
+    metrics_active().add();
+}
 
-game::~game() {};
+game::~game() {
+    metrics_active().sub();
+    for(auto& pl: players()) {
+        bot::destroy_entity(pl);
+    }
+};
+
+auto game::metrics_active() -> bot::metrics::gauge& {
+    static auto& gauge = bot::metrics::get_gauge("bot_games_active", "Games that exist at the moment");
+    return gauge;
+}
 
 auto game::is_playing(const bot::user_ptr user) const -> bool {
     return bot::utils::contains_if(players(), [&user](auto pl) { return pl->user() == user; });
 }
 
 void game::del_player(const player_ptr& pl) {
-    if(!bot::utils::erase(players(), pl)) {
+    auto copy = pl; //pl may reference an element of players()
+    if(!bot::utils::erase(players(), copy)) {
         throw std::runtime_error("player is not in the game");
     }
+    bot::destroy_entity(copy);
+}
+
+void game::send_spectators(std::string_view mes) {
+    m_spectators_mes.emplace(mes);
+}
+
+auto game::spectators_queue() -> spectators_queue_t& {
+    return m_spectators_mes;
+}
+
+void game::clear_spectators() {
+    m_spectators_mes = spectators_queue_t(std::pmr::list<player::mes_t>(m_spectators_resource));
+}
+
+auto game::memory_usage() const -> std::size_t {
+    auto result = sizeof(game) + bot::utils::heap_usage(players());
+    for(auto& pl: players()) {
+        result += pl->memory_usage();
+    }
+    return result;
 }
 
 }; // namespace games
\ No newline at end of file
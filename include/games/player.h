@@ -3,8 +3,12 @@
 #include "core/property.h"
 #include "core/user.h"
 
+#include <list>
 #include <memory>
+#include <memory_resource>
 #include <queue>
+#include <string>
+#include <string_view>
 
 namespace games {
 
@@ -12,16 +16,22 @@ namespace games {
  * Game player's class.
  * */
 class player {
+public:
+    using mes_t   = std::pmr::string;                         /**< Queued message type define. */
+    using queue_t = std::queue<mes_t, std::pmr::list<mes_t>>; /**< Messages queue type define. */
+
 protected:
-    std::queue<std::string> mes_to_send; /**< Messages queue to send to user. */
+    std::pmr::memory_resource* resource; /**< Memory resource of player's hand-scoped data. */
+    queue_t mes_to_send;                 /**< Messages queue to send to user. */
 public:
     bot::property<bot::user_ptr> user; /**< Property storing bot's user pointer. */
 
     /**
      * Constructor.
      * @param user bot's user pointer.
+     * @param resource memory resource for queued messages, e.g. game's arena.
      * */
-    player(bot::user_ptr user);
+    player(bot::user_ptr user, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
     /**
      * Virtual destructor for polymorphism purposes.
      * */
@@ -39,28 +49,58 @@ public:
      * Function to add message to send to player later.
      * @param mes message to send.
      * */
-    void send(const std::string& mes);
+    void send(std::string_view mes);
 
     /**
      * Function to get message queue to send to player.
      * @returns messages queue that has to be sent to user.
      * */
-    auto mes_queue() -> std::queue<std::string>&;
+    auto mes_queue() -> queue_t&;
+    /**
+     * Drops queued messages and their memory, doesn't allocate.
+     * Has to be called before the memory resource is released.
+     * */
+    void clear_queue();
+    /**
+     * Bytes occupied by the player.
+     * Queued messages are not included, they are accounted by the owner of the memory resource.
+     * @returns size in bytes
+     * */
+    virtual auto memory_usage() const -> std::size_t;
 };
 
-player::player(bot::user_ptr user): user(user) { }
+player::player(bot::user_ptr user, std::pmr::memory_resource* resource):
+    resource(resource), mes_to_send(std::pmr::list<mes_t>(resource)), user(user) { }
 player::~player() { }
 
 bool operator==(const player& lhs, const player& rhs) {
     return lhs.user() == rhs.user();
 }
 
-void player::send(const std::string& mes) {
+void player::send(std::string_view mes) {
     mes_to_send.emplace(mes);
 }
 
-auto player::mes_queue() -> std::queue<std::string>& {
+auto player::mes_queue() -> queue_t& {
     return mes_to_send;
 }
 
-}; // namespace games
\ No newline at end of file
+void player::clear_queue() {
+    mes_to_send = queue_t(std::pmr::list<mes_t>(resource));
+}
+
+auto player::memory_usage() const -> std::size_t {
+    return sizeof(player);
+}
+
+}; // namespace games
+
+namespace bot {
+/**
+ * Players have derived classes for each game, so they are boxed in their registry.
+ * */
+template<>
+struct entity_traits<games::player> {
+    static constexpr bool boxed = true;
+};
+}; // namespace bot
\ No newline at end of file
@@ -28,22 +28,32 @@ public:
      * @param user ptr to a user that exited the room.
      * */
     virtual void del_user(bot::user_ptr user) override;
+    /**
+     * Bytes occupied by the room and its game.
+     * @returns size in bytes
+     * */
+    auto memory_usage() const -> std::size_t override;
 };
 
 game_room::game_room(id_t id): bot::room(id) { }
 
+auto game_room::memory_usage() const -> std::size_t {
+    auto result = bot::room::memory_usage() + sizeof(game_room) - sizeof(bot::room);
+    return game() ? result + game()->memory_usage() : result;
+}
+
 void game_room::del_user(bot::user_ptr user) {
-    if(!game()) {
-        return; //no need to delete player from game
-    }
-    auto player_it = bot::utils::find_if(game()->players(), [&](auto pl) { return pl->user() == user; });
-    if(player_it != game()->players().end()) {
-        game()->handle_exit(*player_it);
-        try {
-            game()->del_player(*player_it);
-        } catch(...) { //in case if "handle_exit" deletes it
+    if(game()) {
+        auto player_it = bot::utils::find_if(game()->players(), [&](auto pl) { return pl->user() == user; });
+        if(player_it != game()->players().end()) {
+            auto player = *player_it; //"handle_exit" may delete it, the iterator goes stale then
+            game()->handle_exit(player);
+            if(bot::utils::contains(game()->players(), player)) {
+                game()->del_player(player);
+            }
         }
     }
+    bot::room::del_user(user);
 }
 
 }; // namespace games
\ No newline at end of file
@@ -1,4 +1,5 @@
 #pragma once
+#include "core/lazy_utils.h"
 #include "core/property.h"
 #include "poker/coin.h"
 
@@ -34,6 +35,11 @@ public:
      * @param coins container with coins to add to a bank.
      * */
     void add_coins(coins_t& coins);
+
+    /** Memory usage.
+     * @returns bytes occupied by the bank, its container and coins.
+     * */
+    auto memory_usage() const -> std::size_t;
 };
 
 bank::bank(size_t size) {
@@ -64,4 +70,8 @@ void bank::add_coins(bank::coins_t& coins) {
     coins.shrink_to_fit();
 }
 
+auto bank::memory_usage() const -> std::size_t {
+    return sizeof(bank) + bot::utils::heap_usage(coins()) + coins().size() * sizeof(coin);
+}
+
 }; // namespace poker
\ No newline at end of file
@@ -1,25 +1,131 @@
 #pragma once
 #include "core/bot.h"
+#include "core/timer_wheel.h"
 #include "games/room.h"
 #include "poker/game.h"
+#include "poker/hand_history.h"
+#include "poker/hand_index.h"
+#include "poker/icm.h"
 #include "poker/room.h"
 #include "poker/server.h"
 
+#include <chrono>
+#include <random>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace poker {
 
 class poker_bot: public bot::room_bot {
+    /**
+     * Value of a turn's timer, timers of turns that already ended are recognized by seq.
+     * */
+    struct turn_timer {
+        bot::room_ptr room;    /**< Room of the table */
+        std::uint64_t seq = 0; /**< Sequence number of the turn's timer */
+    };
+    using timers_t = bot::timer_thread<turn_timer>; /**< Define for turn timers */
+    /**
+     * Turn in process at a table.
+     * */
+    struct turn_state {
+        using id_t = bot::identifyable::id_t; /**< Define for user's id */
+
+        games::game::player_ptr player;                            /**< Player to act */
+        id_t user               = 0;                               /**< Id of player's user */
+        const games::game* game = nullptr;                         /**< Game of the turn */
+        std::uint64_t seq       = 0;                               /**< Sequence number of the armed timer */
+        timers_t::handle timer;                                    /**< Armed timer */
+        bool in_bank = false;                                      /**< Whether time bank is running */
+        timers_t::clock::time_point bank_start;                    /**< When time bank started to run */
+        std::unordered_map<id_t, std::chrono::milliseconds> banks; /**< Time banks left in the game by user */
+    };
+
+    std::unique_ptr<timers_t> m_turn_timers;                /**< Deadlines of turns, null if disabled */
+    std::unordered_map<bot::room_ptr, turn_state> m_turns; /**< Turns in process by room */
+    std::chrono::milliseconds m_turn_timeout {0};           /**< Time to act */
+    std::chrono::milliseconds m_time_bank {0};              /**< Extra time of a player per game */
+    std::uint64_t m_turn_seq = 0;                           /**< Last sequence number of a timer */
+    std::unique_ptr<hand_history::writer> m_hands;          /**< Writer of finished hands, null if disabled */
+    std::unique_ptr<hand_history::searcher> m_searcher;     /**< Searches of hand history, null if disabled */
+
     void p_on_room_poker_start(bot::mes_ptr mes);
     void p_on_room_poker_bet(bot::mes_ptr mes);
+    void p_on_room_poker_fold(bot::mes_ptr mes);
+    /**
+     * Replies with ICM equity of every player of the room's game for comma separated payouts,
+     * e.g. /poker_icm 50,30,20, so players can settle a deal.
+     * */
+    void p_on_room_poker_icm(bot::mes_ptr mes);
+    /**
+     * Replies to an admin with hands of the hand history that match criteria, e.g. /poker_hands user=42 board=flush,
+     * see hand_history::parse_query. The search runs on the searcher's thread, since it indexes history files
+     * that are new or grew since the last search first, the file being written at least.
+     * The reply is sent by p_on_poll once it's done.
+     * */
+    void p_on_poker_hands_request(bot::mes_ptr mes);
+    /**
+     * Sends replies of finished hand history searches.
+     * */
+    void p_send_search_replies();
+    /**
+     * Hands a hand the last action finished over to the hand history writer, then
+     * sends queued messages of the room's game: players' ones to each player, spectators' ones
+     * joined into one text and fanned out to every room user that isn't playing and is subscribed,
+     * so the table is rendered once per action however many users watch it.
+     * */
     void p_process_mes_queues(games::game_room& room);
+    /**
+     * Arms a timer for the current turn of the room's game if the turn has changed since the last call. \n
+     * Called after everything that may advance the game, the timer of the previous turn is cancelled.
+     * */
+    void p_arm_turn(const bot::room_ptr& room);
+    /**
+     * Handles expired timer on the handling thread, between updates, so the automatic action
+     * is ordered with players' commands like any of them. \n
+     * Starts player's time bank first, then checks if there is nothing to call or folds.
+     * */
+    void p_on_turn_expired(const turn_timer& timer);
+
+protected:
+    void p_on_poll() override;
+    /**
+     * Sends what the leave caused in the room's game and hands a hand it finished over to the writer,
+     * otherwise the next hand would drop it.
+     * */
+    void p_on_user_left(const bot::room_ptr& room) override;
+    /**
+     * Wakes up every second while turns or hand history searches are pending, so they are handled in time.
+     * */
+    auto p_poll_timeout() const -> std::int32_t override;
 
 public:
-    poker_bot(const std::string& token);
+    /**
+     * Constructor, adds poker commands.
+     * @param token TG API token.
+     * @param http settings of api's connection pool.
+     * */
+    poker_bot(const std::string& token, const bot::http_pool_config& http = {});
+
+    /**
+     * Enables turn timers: a player that doesn't act in time spends their time bank
+     * and then checks or folds automatically.
+     * @param timeout time to act.
+     * @param time_bank extra time of every player per game.
+     * @param tick resolution of timers.
+     * */
+    void enable_turn_timers(std::chrono::milliseconds timeout, std::chrono::milliseconds time_bank,
+                            std::chrono::milliseconds tick = std::chrono::milliseconds(100));
+    /**
+     * Enables hand history: every finished hand is appended to rolling binary files, see hand_history::writer.
+     * Throws filesystem exception if the directory can't be created.
+     * @param config settings of the writer.
+     * */
+    void enable_hand_history(const hand_history::writer_config& config);
 };
 
-poker_bot::poker_bot(const std::string& token): bot::room_bot(token) {
+poker_bot::poker_bot(const std::string& token, const bot::http_pool_config& http): bot::room_bot(token, http) {
     using args_t       = std::vector<std::string>;
     const auto no_args = args_t {};
 
@@ -31,21 +137,51 @@ poker_bot::poker_bot(const std::string& token): bot::room_bot(token) {
     this->room_bot::m_commands.emplace_back("poker_bet", "make a bet in poker", args_t {"amount"},
                                             [this](auto mes) { p_on_room_poker_bet(mes); });
 
-    auto& ev = m_bot.getEvents();
-    for(auto& cmd: m_commands) {
-        ev.onCommand(cmd.cmd_word(), cmd.callback());
-    }
+    this->room_bot::m_commands.emplace_back("poker_fold", "fold in poker", no_args,
+                                            [this](auto mes) { p_on_room_poker_fold(mes); });
+
+    this->room_bot::m_commands.emplace_back("poker_icm", "ICM equity of stacks for payouts, e.g. 50,30,20",
+                                            args_t {"payouts"}, [this](auto mes) { p_on_room_poker_icm(mes); });
+
+    this->room_bot::m_commands.emplace_back(
+        "poker_hands", "search hand history, admins only",
+        args_t {"user=id", "pot=least", "board=textures", "from=unix_time", "to=unix_time"},
+        [this](auto mes) { p_on_poker_hands_request(mes); }, 5);
+
+    p_register_commands();
 }
 
 void poker_bot::p_process_mes_queues(games::game_room& room) {
+    if(auto poker = dynamic_cast<game_poker*>(room.game().get())) {
+        if(auto hand = poker->take_finished_hand(); hand && m_hands) {
+            hand->table = room.id();
+            m_hands->submit(*hand);
+        }
+    }
     for(auto& pl: room.game()->players()) {
         auto& mes_q = pl->mes_queue();
         while(!mes_q.empty()) {
             auto& mes = mes_q.front();
-            api.sendMessage(pl->user()->id(), mes);
+            p_send_message(pl->user()->id(), std::string(mes));
             mes_q.pop();
         }
     }
+    auto& spect_q = room.game()->spectators_queue();
+    if(spect_q.empty()) {
+        return;
+    }
+    std::string text {std::string_view(spect_q.front())};
+    for(spect_q.pop(); !spect_q.empty(); spect_q.pop()) {
+        text += "\n\n";
+        text += spect_q.front();
+    }
+    std::vector<std::int64_t> chat_ids;
+    for(auto& u: room.users()) {
+        if(!room.unsubscribed().count(u) && !room.game()->is_playing(u)) {
+            chat_ids.emplace_back(u->id());
+        }
+    }
+    p_send_many(chat_ids, text);
 }
 
 void poker_bot::p_on_room_poker_start(bot::mes_ptr mes) {
@@ -59,8 +195,13 @@ void poker_bot::p_on_room_poker_start(bot::mes_ptr mes) {
     using namespace bot::utils;
 
     auto room = dyn_cast<poker::game_poker_room>(user->current_room());
-    room->start_game();
+    {
+        bot::trace::span span("game");
+        bot::alloc::scope alloc_scope(bot::alloc::tag::game);
+        room->start_game();
+    }
     p_process_mes_queues(*room);
+    p_arm_turn(user->current_room());
 }
 
 void poker_bot::p_on_room_poker_bet(bot::mes_ptr mes) {
@@ -77,8 +218,258 @@ void poker_bot::p_on_room_poker_bet(bot::mes_ptr mes) {
     auto poker = dyn_cast<poker::game_poker>(room->game());
     auto words = StringTools::split(mes->text, ' ');
     auto size  = std::stoi(words.at(1));
-    poker->handle_bet(user, size);
+    {
+        bot::trace::span span("game");
+        bot::alloc::scope alloc_scope(bot::alloc::tag::game);
+        poker->handle_bet(user, size);
+    }
     p_process_mes_queues(*room);
+    p_arm_turn(user->current_room());
+}
+
+void poker_bot::p_on_room_poker_fold(bot::mes_ptr mes) {
+    [[maybe_unused]] auto id   = mes->chat->id;
+    [[maybe_unused]] auto& s   = *(this->s.get());
+    [[maybe_unused]] auto user = std::get<0>(p_process_cmd(mes));
+    [[maybe_unused]] auto cmd  = std::get<1>(p_process_cmd(mes));
+    if(!user) {
+        return;
+    }
+    using namespace bot::utils;
+
+    auto room = dyn_cast<poker::game_poker_room>(user->current_room());
+    if(!room || !room->game()) {
+        return;
+    }
+    auto poker = dyn_cast<poker::game_poker>(room->game());
+    {
+        bot::trace::span span("game");
+        bot::alloc::scope alloc_scope(bot::alloc::tag::game);
+        poker->handle_fold(user);
+    }
+    p_process_mes_queues(*room);
+    p_arm_turn(user->current_room());
+}
+
+void poker_bot::p_on_room_poker_icm(bot::mes_ptr mes) {
+    [[maybe_unused]] auto id   = mes->chat->id;
+    [[maybe_unused]] auto user = std::get<0>(p_process_cmd(mes));
+    [[maybe_unused]] auto cmd  = std::get<1>(p_process_cmd(mes));
+    if(!user || !cmd) {
+        return;
+    }
+    using namespace bot::utils;
+
+    auto room = dyn_cast<poker::game_poker_room>(user->current_room());
+    if(!room || !room->game()) {
+        p_send_message(id, "There is no game in this room");
+        return;
+    }
+    std::vector<double> payouts;
+    try {
+        for(auto& word: StringTools::split(StringTools::split(mes->text, ' ').at(1), ',')) {
+            payouts.emplace_back(std::stod(word));
+        }
+    } catch(const std::exception&) {
+        p_send_message(id, "Payouts have to be numbers separated by commas, e.g. 50,30,20");
+        return;
+    }
+    auto& players = room->game()->players();
+    std::mt19937 gen(std::random_device {}());
+    auto equity          = icm::equity(icm::stacks(players), payouts, std::chrono::milliseconds(50), gen);
+    std::string response = "ICM equity:";
+    for(std::size_t i = 0; i < players.size(); i++) {
+        auto& u = *players[i]->user();
+        response += fmt::format("\n{}[{}] stack:{} equity:{:.2f}", u.name(), u.token(),
+                                stat_cast<player_poker>(players[i])->bank().coins().size(), equity[i]);
+    }
+    p_send_message(id, response);
+}
+
+void poker_bot::enable_turn_timers(std::chrono::milliseconds timeout, std::chrono::milliseconds time_bank,
+                                   std::chrono::milliseconds tick) {
+    m_turn_timers  = std::make_unique<timers_t>(tick);
+    m_turn_timeout = timeout;
+    m_time_bank    = time_bank;
+}
+
+void poker_bot::p_on_poker_hands_request(bot::mes_ptr mes) {
+    auto id          = mes->chat->id;
+    auto [user, cmd] = p_process_cmd(mes);
+    auto prefix      = log_prefix("poker_bot::on_poker_hands", mes);
+    if(!user || !cmd) {
+        return;
+    }
+    if(!bot::utils::contains(m_admins, user->id())) {
+        m_lgr.warn("{} not an admin", prefix);
+        p_send_message(id, "Only admins can search hand history");
+        return;
+    }
+    if(!m_searcher) {
+        p_send_message(id, "Hand history is disabled");
+        return;
+    }
+    auto words = StringTools::split(mes->text, ' ');
+    hand_history::hand_query query;
+    try {
+        query = hand_history::parse_query(std::vector<std::string>(words.begin() + 1, words.end()));
+    } catch(const std::invalid_argument& e) {
+        p_send_message(id, e.what());
+        return;
+    }
+    if(!m_searcher->submit(id, query)) {
+        p_send_message(id, "Too many searches are running, try again later");
+    }
+}
+
+void poker_bot::p_send_search_replies() {
+    constexpr std::size_t max_message = 4096; //TG's limit
+    auto prefix                       = "poker_bot::p_send_search_replies";
+    for(auto& reply: m_searcher->take_replies()) {
+        if(reply.failed) {
+            p_send_message(reply.chat_id, "Hand history search failed");
+            continue;
+        }
+        auto& result = reply.result;
+        m_lgr.info("{} chat:{} {} of {} hands match, {} files, {} indexed", prefix, reply.chat_id, result.matched,
+                   result.hands, result.files, result.indexed);
+        auto response = fmt::format("{} of {} hands match", result.matched, result.hands);
+        for(auto& hand: result.found) {
+            auto text = hand_history::describe(hand);
+            if(response.size() + 1 + text.size() > max_message) {
+                break;
+            }
+            response += "\n" + text;
+        }
+        p_send_message(reply.chat_id, response);
+    }
+}
+
+void poker_bot::enable_hand_history(const hand_history::writer_config& config) {
+    constexpr std::size_t max_hands = 5; //a hand takes about 600 bytes, replies fit TG's limit
+    m_hands                         = std::make_unique<hand_history::writer>(config);
+    m_searcher                      = std::make_unique<hand_history::searcher>(config.dir, max_hands);
+}
+
+void poker_bot::p_arm_turn(const bot::room_ptr& room) {
+    if(!m_turn_timers) {
+        return;
+    }
+    auto game_room = bot::utils::dyn_cast<games::game_room>(room);
+    auto game      = game_room ? game_room->game().get() : nullptr;
+    auto poker     = dynamic_cast<game_poker*>(game);
+    auto player    = poker ? poker->current_player() : nullptr;
+    auto it        = m_turns.find(room);
+    if(it == m_turns.end()) {
+        if(!player) {
+            return;
+        }
+        it = m_turns.emplace(room, turn_state {}).first;
+    }
+    auto& turn = it->second;
+    if(turn.game == game && turn.player == player) {
+        return; //same turn, its deadline stays
+    }
+    m_turn_timers->cancel(turn.timer);
+    auto now = timers_t::clock::now();
+    if(turn.game != game) {
+        turn.banks.clear();
+    } else if(turn.in_bank) {
+        auto& bank = turn.banks[turn.user];
+        bank -= std::min(bank, std::chrono::duration_cast<std::chrono::milliseconds>(now - turn.bank_start));
+    }
+    if(!player) {
+        m_turns.erase(it); //hand is over, next one starts a new game
+        return;
+    }
+    turn.game    = game;
+    turn.player  = player;
+    turn.user    = player->user()->id();
+    turn.in_bank = false;
+    turn.seq     = ++m_turn_seq;
+    turn.banks.try_emplace(turn.user, m_time_bank);
+    turn.timer = m_turn_timers->schedule(now + m_turn_timeout, {room, turn.seq});
+}
+
+void poker_bot::p_on_turn_expired(const turn_timer& timer) {
+    static auto& banks  = bot::metrics::get_counter("bot_turn_timeouts_total", "Turns that weren't made in time",
+                                                    {{"action", "time_bank"}});
+    static auto& checks = bot::metrics::get_counter("bot_turn_timeouts_total", "Turns that weren't made in time",
+                                                    {{"action", "check"}});
+    static auto& folds  = bot::metrics::get_counter("bot_turn_timeouts_total", "Turns that weren't made in time",
+                                                    {{"action", "fold"}});
+    auto it = m_turns.find(timer.room);
+    if(it == m_turns.end() || it->second.seq != timer.seq) {
+        return; //turn was made or the game has changed
+    }
+    auto& turn = it->second;
+    auto room  = bot::utils::dyn_cast<poker::game_poker_room>(timer.room);
+    if(!room) { //room was closed
+        m_turns.erase(it);
+        return;
+    }
+    s->touch_room(timer.room);
+    auto poker = room->game() ? bot::utils::dyn_cast<game_poker>(room->game()) : nullptr;
+    if(!poker || !turn.player || poker->current_player() != turn.player) {
+        p_arm_turn(timer.room); //player left or game was restored from hibernation meanwhile
+        return;
+    }
+    auto user  = turn.player->user();
+    auto now   = timers_t::clock::now();
+    auto& bank = turn.banks[turn.user];
+    if(!turn.in_bank && bank.count() > 0) {
+        turn.in_bank    = true;
+        turn.bank_start = now;
+        turn.seq        = ++m_turn_seq;
+        turn.timer      = m_turn_timers->schedule(now + bank, {timer.room, turn.seq});
+        banks.add();
+        p_send_message(user->id(), fmt::format("Time is up, your time bank is running: {}s", bank.count() / 1000));
+        return;
+    }
+    bank         = std::chrono::milliseconds(0);
+    turn.in_bank = false;
+    bool check   = poker->to_call(turn.player) == 0;
+    m_lgr.info("poker_bot::p_on_turn_expired room:{} {} {} automatically", room->log_desc(), user->log_desc(),
+               check ? "checks" : "folds");
+    {
+        bot::trace::root_span span("turn_timeout", user->id(), check ? "check" : "fold");
+        bot::alloc::scope alloc_scope(bot::alloc::tag::game);
+        if(check) {
+            poker->handle_bet(user, 0);
+        } else {
+            poker->handle_fold(user);
+        }
+    }
+    (check ? checks : folds).add();
+    p_send_message(user->id(), check ? "Time is up, you checked" : "Time is up, you folded");
+    p_process_mes_queues(*room);
+    p_arm_turn(timer.room);
+}
+
+void poker_bot::p_on_user_left(const bot::room_ptr& room) {
+    auto game_room = bot::utils::dyn_cast<games::game_room>(room);
+    if(!game_room || !game_room->game()) {
+        return;
+    }
+    p_process_mes_queues(*game_room);
+    p_arm_turn(room);
+}
+
+void poker_bot::p_on_poll() {
+    if(m_searcher) {
+        p_send_search_replies();
+    }
+    if(!m_turn_timers) {
+        return;
+    }
+    for(auto& timer: m_turn_timers->take_expired()) {
+        p_on_turn_expired(timer);
+    }
+}
+
+auto poker_bot::p_poll_timeout() const -> std::int32_t {
+    auto searching = m_searcher && m_searcher->pending();
+    return (m_turn_timers && m_turn_timers->pending()) || searching ? 1 : bot::room_bot::p_poll_timeout();
 }
 
 }; // namespace poker
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include "core/property.h"
 #include "poker/kinds.h"
 
+#include <cstdint>
+#include <stdexcept>
 #include <string>
 #include <utility>
 
@@ -19,6 +21,15 @@ public:
     card& operator=(const card& c) = default;
     bool operator==(const card& c) const;
     bool operator<(const card& c) const;
+
+    /**
+     * Packs the card into a byte, see from_code.
+     * */
+    auto code() const -> std::uint8_t;
+    /**
+     * Unpacks a card packed by code, throws runtime exception on a wrong code.
+     * */
+    static auto from_code(std::uint8_t code) -> card;
 };
 
 card::card(unsigned value, const struct kind& k): value(value), kind(k) { }
@@ -31,5 +42,15 @@ bool card::operator<(const card& c) const {
     std::string str_c = std::to_string(c.value) + c.kind.name;
     return str < str_c;
 }
+auto card::code() const -> std::uint8_t {
+    return static_cast<std::uint8_t>(kind.id * 13 + value - 2);
+}
+auto card::from_code(std::uint8_t code) -> card {
+    const struct kind* kinds[] = {&hearts, &tiles, &clovers, &pikes};
+    if(code >= 13 * 4) {
+        throw std::runtime_error("wrong card code " + std::to_string(code));
+    }
+    return card(code % 13 + 2, *kinds[code / 13]);
+}
 
 }; // namespace poker
\ No newline at end of file
@@ -1,10 +1,14 @@
 #pragma once
+#include "core/lazy_utils.h"
+#include "core/snapshot.h"
 #include "poker/card.h"
 #include "poker/kinds.h"
 
 #include <algorithm>
+#include <array>
 #include <memory>
 #include <random>
+#include <sstream>
 #include <vector>
 
 namespace poker {
@@ -12,20 +16,54 @@ namespace poker {
 class deck {
 public:
     using deck_t = std::vector<card>;
+    using seed_t = std::array<std::uint32_t, 4>; /**< Seed of a hand, 128 bits */
 
     deck();
 
+    /**
+     * Reseeds deck's generator and makes next_seed draw from it, gives reproducible hands
+     * for benchmarks and simulations.
+     * @param value seed of the generator.
+     * */
+    void seed(std::mt19937::result_type value);
+    /**
+     * Reseeds deck's generator with a seed of a hand through std::seed_seq, see game_poker::init_game.
+     * @param value seed of the hand.
+     * */
+    void seed(const seed_t& value);
+    /**
+     * Returns a seed for the next hand: drawn from std::random_device, or from deck's generator
+     * if the deck was seeded with seed(value), so hands of a seeded deck stay reproducible. \n
+     * Seeds of an unseeded deck don't depend on each other, so cards of one hand tell nothing about the next ones.
+     * */
+    auto next_seed() -> seed_t;
     void refill();
     void shuffle();
     auto get_cards() -> deck_t&;
     auto get_cards() const -> const deck_t&;
     auto get_card() -> card;
     auto peek_card() const -> const card&;
+    /**
+     * Bytes occupied by the deck, its generators and cards.
+     * @returns size in bytes
+     * */
+    auto memory_usage() const -> std::size_t;
+    /**
+     * Encodes remaining cards and the state of the generator, so following shuffles stay the same.
+     * @param enc encoder to append to.
+     * */
+    void save(bot::snapshot::encoder& enc) const;
+    /**
+     * Restores a deck saved by save.
+     * @param dec decoder to read from.
+     * */
+    void load(bot::snapshot::decoder& dec);
 
 protected:
     std::mt19937 gen;
     std::random_device rd;
     deck_t m_cards;
+    bool m_seeded = false; /**< Seeds of hands are drawn from gen, not saved, so a restored deck is random */
 };
 
 deck::deck() {
@@ -33,6 +71,21 @@ deck::deck() {
     refill();
     shuffle();
 }
+void deck::seed(std::mt19937::result_type value) {
+    gen.seed(value);
+    m_seeded = true;
+}
+void deck::seed(const seed_t& value) {
+    std::seed_seq seq(value.begin(), value.end());
+    gen.seed(seq);
+}
+auto deck::next_seed() -> seed_t {
+    seed_t result;
+    for(auto& word: result) {
+        word = m_seeded ? gen() : rd();
+    }
+    return result;
+}
 void deck::refill() {
     m_cards.clear();
 
@@ -67,5 +120,41 @@ auto deck::get_card() -> card {
 auto deck::peek_card() const -> const card& {
     return m_cards.front();
 }
+void deck::save(bot::snapshot::encoder& enc) const {
+    std::vector<std::uint8_t> codes;
+    codes.reserve(m_cards.size());
+    for(auto& c: m_cards) {
+        codes.emplace_back(c.code());
+    }
+    enc.put_vec(codes);
+    //the standard only defines textual state of the engine, it's 625 numbers
+    std::stringstream text;
+    text << gen;
+    std::vector<std::uint32_t> state;
+    for(std::uint32_t word; text >> word;) {
+        state.emplace_back(word);
+    }
+    enc.put_vec(state);
+}
+void deck::load(bot::snapshot::decoder& dec) {
+    m_cards.clear();
+    for(auto code: dec.get_vec<std::uint8_t>()) {
+        m_cards.emplace_back(card::from_code(code));
+    }
+    std::stringstream text;
+    for(auto word: dec.get_vec<std::uint32_t>()) {
+        text << word << ' ';
+    }
+    if(!(text >> gen)) {
+        throw std::runtime_error("deck::load wrong state of the generator");
+    }
+}
+auto deck::memory_usage() const -> std::size_t {
+    auto result = sizeof(deck) + bot::utils::heap_usage(m_cards);
+    for(auto& c: m_cards) {
+        result += bot::utils::heap_usage(c.kind.name);
+    }
+    return result;
+}
 
 }; // namespace poker
\ No newline at end of file
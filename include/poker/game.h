@@ -1,27 +1,48 @@
 #pragma once
 #include "components/logger.hpp"
+#include "core/alloc_profile.h"
+#include "core/arena.h"
 #include "core/datatypes.h"
 #include "core/property.h"
+#include "core/snapshot.h"
+#include "core/tracing.h"
 #include "games/game.h"
 #include "poker/bank.h"
 #include "poker/coin.h"
 #include "poker/deck.h"
+#include "poker/hand_history.h"
 #include "poker/player.h"
+#include "poker/ranking.h"
+
+#include <iterator>
+#include <memory_resource>
+#include <optional>
+#include <random>
 
 namespace poker {
 
 class game_poker: public games::game {
+protected:
+    mutable bot::arena m_arena;                                /**< Memory of hand-scoped data, reset by init_game */
+    mutable std::pmr::unsynchronized_pool_resource m_messages; /**< Recycled memory of texts, taken from the arena */
+
 public:
-    using player_ptr = std::shared_ptr<player_poker>; /**< Define for poker player ptr */
-    bot::property<class bank> bank;                   /**< Bank property to hold coins */
-    bot::property<class deck> cards;                  /**< Cards property to hold a deck */
-    bot::property<std::vector<card>> table;           /**< Cards on a table container property */
+    using player_ptr = games::game::player_ptr;  /**< Define for poker player ptr */
+    using text_t     = std::pmr::string;         /**< Define for rendered text, allocated in m_messages */
+    bot::property<class bank> bank;              /**< Bank property to hold coins */
+    bot::property<class deck> cards;             /**< Cards property to hold a deck */
+    bot::property<std::pmr::vector<card>> table; /**< Cards on a table container property */
 
     /** Constructor.
      * @param users users of a room to add to the game as players.
      * @param blind_bet size of a blind bet.
+     * @param start_stack coins of every added player.
      * */
-    game_poker(const std::vector<bot::user_ptr>& users, std::size_t blind_bet);
+    game_poker(const std::vector<bot::user_ptr>& users, std::size_t blind_bet, std::size_t start_stack = 100);
+    /** Destructor.
+     * Destroys players before the arena their data lives in.
+     * */
+    ~game_poker() override;
 
     /** Function to add player.
      * Adds user as a poker player if game is not in process and
@@ -34,47 +55,103 @@ public:
     /** Function to handle exited player.
      * Throws exception if player is not a poker player or if
      * he's not present in a game.
+     * A player that leaves during a hand folds, if it was his turn the turn moves on.
      * WARNING:don't handles coins yet, TODO:fix it
      * @param pl pointer to exited player.
      * */
     void handle_exit(const game::player_ptr pl) override;
 
     /** Game initiator.
-     * Refills deck, shuffles it, fills players hands and sends game states to them.
+     * Starts a new hand: resets previous one, moves blinds to the next seats, refills deck,
+     * shuffles it, fills players hands and sends game states to them and spectators.
+     * The deck is reseeded for every hand and the seed is recorded, so the hand can be replayed.
+     * @param seed seed of the hand's shuffle, see deck::next_seed if not given.
      * */
-    void init_game();
+    void init_game(std::optional<deck::seed_t> seed = std::nullopt);
 
     /** Player bet handler.
      * Takes coins from a player if it's his turn, checks its size end advance game state.
+     * Bet of 0 is a check.
      * @param user pointer to a user that made a bet.
      * @param size size of a bet.
      * */
     void handle_bet(bot::user_ptr user, std::size_t size);
+    /** Player fold handler.
+     * Removes player from the hand if it's his turn and advances game state.
+     * @param user pointer to a user that folded.
+     * */
     void handle_fold(bot::user_ptr user);
 
-private:
-    std::size_t p_last_bet;                          /**< last bet to keep track */
+    /** Sets size of the big blind, applied from the next hand. */
+    void set_blind(std::size_t size);
+    /** Returns size of the big blind. */
+    auto blind() const -> std::size_t;
+    /** Returns player whose turn it is, nullptr if hand is not in process. */
+    auto current_player() const -> player_ptr;
+    /** Returns amount of coins player has to bet to stay in the hand. */
+    auto to_call(const player_ptr& pl) const -> std::size_t;
+    /** Returns amount of players that haven't folded in current hand. */
+    auto in_hand() const -> std::size_t;
+    /**
+     * Returns record of the hand the last action finished, nullptr if it didn't finish one
+     * or the hand was restored from a snapshot of an older version.
+     * The record may be swapped out, e.g. by hand_history::writer::submit, the next hand starts a new one.
+     * */
+    auto take_finished_hand() -> hand_history::hand_record*;
+    /** Returns record of the current hand so far, see take_finished_hand. */
+    auto hand() const -> const hand_history::hand_record& { return p_hand; }
+    /** Returns bytes occupied by the game: players, bank, deck and the arena with hand-scoped data. */
+    auto memory_usage() const -> std::size_t override;
+
+    /**
+     * Encodes the whole game including a hand in process and the deck's generator,
+     * players are referred to by their seats, see poker_server snapshots and hibernation.
+     * @param enc encoder to append to.
+     * */
+    void save(bot::snapshot::encoder& enc) const;
+    /**
+     * Restores a game saved by save, the game must have the same players in the same order.
+     * Throws runtime exception on inconsistent data.
+     * @param dec decoder to read from.
+     * */
+    void load(bot::snapshot::decoder& dec);
+
+protected:
+    std::size_t p_last_bet = 0;                      /**< last bet to keep track */
     player_ptr p_cur_player;                         /**< current player pointer */
     player_ptr p_big_blind_pl;                       /**< big blinded player */
     player_ptr p_small_blind_pl;                     /**< small blinded player */
     std::size_t p_big_blind_bet;                     /**< amount of required big blind */
-    std::map<game_poker::player_ptr, size_t> p_bets; /**< container which represents players bets summ*/
+    std::pmr::map<player_ptr, size_t> p_bets;        /**< street bets of players in the hand, no folded */
     bool p_small_blind_made_bet;                     /**< flag to indicate small bet status */
+    std::size_t p_to_act = 0;                        /**< players that still have to act on current street */
+    std::size_t p_button = 0;                        /**< seat of the next hand's big blind */
+    std::size_t p_start_stack;                       /**< coins of an added player */
+    hand_history::hand_record p_hand;                /**< record of the hand in process */
+    bool p_hand_recorded = false;                    /**< p_hand has every action of the hand */
+    bool p_hand_finished = false;                    /**< p_hand is finished and not taken yet */
 
     auto p_player_to_it(game_poker::player_ptr p) -> players_cont::iterator;
     auto p_it_to_player(players_cont::iterator it) -> game_poker::player_ptr;
     auto p_user_to_player(const bot::user_ptr u) -> game_poker::player_ptr;
+    auto p_poker(const game::player_ptr& pl) const -> player_poker*;
     void p_advance_place();
+    auto p_due_to_act(const game::player_ptr& pl) -> bool;
     void p_fill_hand(game::player_ptr pl);
     void p_handle_bet(game::player_ptr pl, size_t);
-    auto p_render_game_state() const -> std::string;
+    void p_end_action();
+    void p_finish_hand();
+    auto p_text() const -> text_t;
+    auto p_render_game_state() const -> text_t;
     auto p_render_card(const card& c) const -> std::string;
     auto p_render_coins(const bank::coins_t& c) const -> std::string;
-    void p_send_state(const std::string& game_state, game::player_ptr pl);
+    void p_send_state(const text_t& game_state, game::player_ptr pl);
     void p_fill_table();
+    void p_record(const game::player_ptr& pl, hand_history::action_type type, std::size_t amount);
 };
 
-game_poker::game_poker(const std::vector<bot::user_ptr>& users, std::size_t blind_bet): games::game() {
+game_poker::game_poker(const std::vector<bot::user_ptr>& users, std::size_t blind_bet, std::size_t start_stack):
+    games::game(&m_messages), m_messages(&m_arena), table(&m_arena), p_bets(&m_arena), p_start_stack(start_stack) {
     this->state()          = state::ended;
     p_big_blind_bet        = blind_bet;
     p_small_blind_made_bet = false;
@@ -83,9 +160,16 @@ game_poker::game_poker(const std::vector<bot::user_ptr>& users, std::size_t blin
     }
 }
 
+game_poker::~game_poker() {
+    clear_spectators(); //queued messages live in m_messages
+    for(auto& pl: players()) {
+        bot::destroy_entity(pl);
+    }
+    players().clear();
+}
+
 auto game_poker::add_player(const bot::user_ptr user) -> bool {
-    auto lgr    = get_logger();
-    auto prefix = fmt::format("game_poker::add_player {}", user->log_desc());
+    auto prefix = bot::lazy([&] { return fmt::format("game_poker::add_player {}", user->log_desc()); });
     auto pl     = p_user_to_player(user);
 
     if(state() == state::playing) {
@@ -98,21 +182,20 @@ auto game_poker::add_player(const bot::user_ptr user) -> bool {
         return false;
     }
 
-    auto game_pl = players().emplace_back(new player_poker(user));
-    pl           = bot::utils::dyn_cast<player_poker>(game_pl);
+    pl = players().emplace_back(bot::make_entity<games::player, player_poker>(user, &m_messages));
     bank::coins_t temp;
-    for(size_t i = 0; i < 100; i++) {
+    for(size_t i = 0; i < p_start_stack; i++) {
         temp.emplace_back(new poker::coin(1));
     }
-    pl->bank().add_coins(temp);
+    p_poker(pl)->bank().add_coins(temp);
     m_lgr.info("{} joined poker game", user->log_desc());
     return true;
 }
 
 void game_poker::handle_exit(const game::player_ptr pl) {
-    auto lgr    = get_logger();
-    auto prefix = fmt::format("game_poker::handle_exit {}", pl->user()->log_desc());
-    auto cast   = std::dynamic_pointer_cast<const poker::player_poker>(pl);
+    auto& lgr   = m_lgr;
+    auto prefix = bot::lazy([&] { return fmt::format("game_poker::handle_exit {}", pl->user()->log_desc()); });
+    auto cast   = bot::utils::dyn_cast<const poker::player_poker>(pl);
     if(!cast) {
         auto mes = fmt::format("{} wrong player class in the poker game", prefix);
         lgr.error(mes);
@@ -124,38 +207,115 @@ void game_poker::handle_exit(const game::player_ptr pl) {
         lgr.error(mes);
         throw std::runtime_error(mes);
     }
-    players().erase(it);
-    p_bets.erase(std::const_pointer_cast<poker::player_poker>(cast)); //TODO:test
-    auto mes = fmt::format("{} exited poker game", prefix);
-    lgr.debug(mes);
+    lgr.debug("{} exited poker game", prefix);
+    if(state() == state::playing && p_bets.count(pl)) {
+        auto due = p_due_to_act(pl);
+        p_record(pl, hand_history::action_type::leave, 0);
+        p_bets.erase(pl);
+        auto mes = p_text();
+        fmt::format_to(std::back_inserter(mes), "{}[{}] left and folded", pl->user()->name(), pl->user()->token());
+        for(auto& p: players()) {
+            p->send(mes);
+        }
+        send_spectators(mes);
+        if(pl == p_cur_player) {
+            p_to_act--;
+            p_end_action(); //moves the turn on while the player is still seated
+        } else if(p_bets.size() == 1) {
+            p_finish_hand();
+        } else if(due) {
+            p_to_act--;
+        }
+    }
+    if(p_small_blind_pl == pl) {
+        p_small_blind_pl = nullptr;
+    }
+    if(p_big_blind_pl == pl) {
+        p_big_blind_pl = nullptr;
+    }
+    del_player(pl);
 }
 
-void game_poker::init_game() {
+void game_poker::init_game(std::optional<deck::seed_t> seed) {
+    state()                = state::playing;
+    p_last_bet             = 0;
+    p_small_blind_made_bet = false;
+    p_cur_player           = nullptr;
+    p_big_blind_pl         = nullptr;
+    p_small_blind_pl       = nullptr;
+    p_hand.clear();
+    p_hand.big_blind = p_big_blind_bet;
+    p_hand.actions.reserve(players().size() * 8); //hands rarely take more, so betting doesn't allocate
+    p_hand_recorded = true;
+    p_hand_finished = false;
+
+    //previous hand's data goes away with the arena, messages not yet taken by the bot are kept
+    std::vector<std::pair<player_ptr, std::string>> pending;
+    std::size_t coins = bank().coins().size();
+    for(auto& pl: players()) {
+        for(auto& queue = pl->mes_queue(); !queue.empty(); queue.pop()) {
+            pending.emplace_back(pl, std::string_view(queue.front()));
+        }
+        pl->clear_queue();
+        p_poker(pl)->clear_cards();
+        coins += p_poker(pl)->bank().coins().size();
+    }
+    std::vector<std::string> pending_spectators;
+    for(auto& queue = spectators_queue(); !queue.empty(); queue.pop()) {
+        pending_spectators.emplace_back(std::string_view(queue.front()));
+    }
+    clear_spectators();
+    table() = std::pmr::vector<card>(&m_arena);
+    p_bets  = std::pmr::map<player_ptr, size_t>(&m_arena);
+    m_messages.release();
+    m_arena.reset();
+    table().reserve(5);
+    for(auto& pl: players()) {
+        p_poker(pl)->cards().reserve(2);
+    }
+    for(auto& [pl, mes]: pending) {
+        pl->send(mes);
+    }
+    for(auto& mes: pending_spectators) {
+        send_spectators(mes);
+    }
+    bank().coins().reserve(coins); //pot can't outgrow coins in the game, so bets don't reallocate
+
+    p_hand.seed = seed ? *seed : cards().next_seed();
+    cards().seed(*p_hand.seed);
     cards().refill();
     cards().shuffle();
     p_fill_table();
 
     if(players().size() >= 1) {
-        p_big_blind_pl = bot::utils::dyn_cast<player_poker>(players().at(0));
+        p_big_blind_pl = players().at(p_button % players().size());
         p_cur_player   = p_big_blind_pl;
     }
     if(players().size() >= 2) {
-        p_small_blind_pl = bot::utils::dyn_cast<player_poker>(players().at(1));
+        p_small_blind_pl = players().at((p_button + 1) % players().size());
     }
+    p_button++;
     for(auto& pl: players()) {
         p_fill_hand(pl);
+        p_bets[pl] = 0;
+        auto& cards = p_poker(pl)->cards();
+        p_hand.seats.push_back(
+            {pl->user()->id(), p_poker(pl)->bank().coins().size(), {cards.at(0).code(), cards.at(1).code()}});
     }
+    p_to_act = p_bets.size();
     if(p_big_blind_pl) {
         auto tmp_pl   = p_big_blind_pl;
         auto bet_size = p_big_blind_bet;
-        auto& bank    = tmp_pl->bank();
+        auto& bank    = p_poker(tmp_pl)->bank();
         if(bank.coins().size() >= bet_size) {
             auto tmp = bank.get_coins(bet_size);
             this->bank().add_coins(tmp);
-            auto mes = fmt::format("Big blind was taken from you ({}))", bet_size);
-            tmp_pl->send(std::move(mes));
+            auto mes = p_text();
+            fmt::format_to(std::back_inserter(mes), "Big blind was taken from you ({}))", bet_size);
+            tmp_pl->send(mes);
             p_bets[tmp_pl] += bet_size;
             p_last_bet = bet_size;
+            p_record(tmp_pl, hand_history::action_type::blind, bet_size);
         } else {
             //TODO:handle properly
         }
@@ -163,13 +323,15 @@ void game_poker::init_game() {
     if(p_small_blind_pl) {
         auto tmp_pl   = p_small_blind_pl;
         auto bet_size = p_big_blind_bet / 2;
-        auto& bank    = tmp_pl->bank();
+        auto& bank    = p_poker(tmp_pl)->bank();
         if(bank.coins().size() >= bet_size) {
             auto tmp = bank.get_coins(bet_size);
             this->bank().add_coins(tmp);
-            auto mes = fmt::format("Small blind was taken from you ({})", bet_size);
+            auto mes = p_text();
+            fmt::format_to(std::back_inserter(mes), "Small blind was taken from you ({})", bet_size);
             tmp_pl->send(mes);
             p_bets[tmp_pl] += bet_size;
+            p_record(tmp_pl, hand_history::action_type::blind, bet_size);
         } else {
             //TODO:handle properly
         }
@@ -178,16 +340,21 @@ void game_poker::init_game() {
     for(auto& pl: players()) {
         p_send_state(state, pl);
     }
+    send_spectators(state);
     p_advance_place(); //advance from big blind to small blind
 }
 void game_poker::handle_bet(bot::user_ptr user, std::size_t size) {
-    auto lgr    = get_logger();
-    auto prefix = fmt::format("game_poker::handle_bet {}", user->log_desc());
+    auto& lgr   = m_lgr;
+    auto prefix = bot::lazy([&] { return fmt::format("game_poker::handle_bet {}", user->log_desc()); });
     auto pl     = p_user_to_player(user);
     if(!pl) {
         lgr.error("{} no such player", prefix);
         return;
     }
+    if(state() != state::playing) {
+        pl->send("There is no hand in process");
+        return;
+    }
     if(pl != p_cur_player) {
         lgr.debug("{} bet in wrong order", prefix);
         pl->send("It's not your turn to make a bet");
@@ -195,16 +362,171 @@ void game_poker::handle_bet(bot::user_ptr user, std::size_t size) {
     }
     p_handle_bet(pl, size);
 }
+void game_poker::handle_fold(bot::user_ptr user) {
+    auto& lgr   = m_lgr;
+    auto prefix = bot::lazy([&] { return fmt::format("game_poker::handle_fold {}", user->log_desc()); });
+    auto pl     = p_user_to_player(user);
+    if(!pl) {
+        lgr.error("{} no such player", prefix);
+        return;
+    }
+    if(state() != state::playing) {
+        pl->send("There is no hand in process");
+        return;
+    }
+    if(pl != p_cur_player) {
+        lgr.debug("{} fold in wrong order", prefix);
+        pl->send("It's not your turn to fold");
+        return;
+    }
+    lgr.debug("{} folded", prefix);
+    p_record(pl, hand_history::action_type::fold, 0);
+    p_bets.erase(pl);
+    p_to_act--;
+    auto mes = p_text();
+    fmt::format_to(std::back_inserter(mes), "{}[{}] folded", pl->user()->name(), pl->user()->token());
+    for(auto& p: players()) {
+        p->send(mes);
+    }
+    send_spectators(mes);
+    p_end_action();
+}
+
+void game_poker::set_blind(std::size_t size) {
+    p_big_blind_bet = size;
+}
+auto game_poker::blind() const -> std::size_t {
+    return p_big_blind_bet;
+}
+auto game_poker::current_player() const -> player_ptr {
+    return state() == state::playing ? p_cur_player : nullptr;
+}
+auto game_poker::in_hand() const -> std::size_t {
+    return p_bets.size();
+}
+auto game_poker::take_finished_hand() -> hand_history::hand_record* {
+    if(!p_hand_finished) {
+        return nullptr;
+    }
+    p_hand_finished = false;
+    return &p_hand;
+}
+void game_poker::save(bot::snapshot::encoder& enc) const {
+    auto seat  = [&](const player_ptr& pl) { return static_cast<std::uint64_t>(bot::utils::index(players(), pl)); };
+    auto codes = [](const auto& cards) {
+        std::vector<std::uint8_t> result;
+        for(auto& c: cards) {
+            result.emplace_back(c.code());
+        }
+        return result;
+    };
+    enc.put(static_cast<std::uint8_t>(state() == state::playing));
+    enc.put(static_cast<std::uint64_t>(p_big_blind_bet));
+    enc.put(static_cast<std::uint64_t>(p_button));
+    enc.put(static_cast<std::uint64_t>(p_last_bet));
+    enc.put(static_cast<std::uint64_t>(p_to_act));
+    enc.put(static_cast<std::uint8_t>(p_small_blind_made_bet));
+    enc.put(seat(p_cur_player));
+    enc.put(seat(p_big_blind_pl));
+    enc.put(seat(p_small_blind_pl));
+    for(auto& pl: players()) {
+        enc.put(static_cast<std::uint64_t>(p_poker(pl)->bank().coins().size()));
+        enc.put_vec(codes(p_poker(pl)->cards()));
+    }
+    enc.put(static_cast<std::uint64_t>(bank().coins().size()));
+    enc.put_vec(codes(table()));
+    std::vector<std::uint64_t> bet_seats, bet_sizes;
+    for(std::size_t i = 0; i < players().size(); i++) { //seat order, handles of players differ after load
+        if(auto it = p_bets.find(players()[i]); it != p_bets.end()) {
+            bet_seats.emplace_back(i);
+            bet_sizes.emplace_back(it->second);
+        }
+    }
+    enc.put_vec(bet_seats);
+    enc.put_vec(bet_sizes);
+    cards().save(enc);
+    enc.put(static_cast<std::uint8_t>(p_hand_recorded));
+    hand_history::encode(p_hand, 0, enc);
+}
+void game_poker::load(bot::snapshot::decoder& dec) {
+    auto prefix = "game_poker::load";
+    auto seat   = [&](std::uint64_t index) -> player_ptr {
+        if(index == static_cast<std::uint64_t>(-1)) {
+            return nullptr;
+        }
+        if(index >= players().size()) {
+            auto mes = fmt::format("{} seat {} of {} players", prefix, index, players().size());
+            m_lgr.error(mes);
+            throw std::runtime_error(mes);
+        }
+        return players()[index];
+    };
+    state()                = dec.get<std::uint8_t>() ? state::playing : state::ended;
+    p_big_blind_bet        = dec.get<std::uint64_t>();
+    p_button               = dec.get<std::uint64_t>();
+    p_last_bet             = dec.get<std::uint64_t>();
+    p_to_act               = dec.get<std::uint64_t>();
+    p_small_blind_made_bet = dec.get<std::uint8_t>();
+    p_cur_player           = seat(dec.get<std::uint64_t>());
+    p_big_blind_pl         = seat(dec.get<std::uint64_t>());
+    p_small_blind_pl       = seat(dec.get<std::uint64_t>());
+    std::size_t coins      = 0;
+    for(auto& pl: players()) {
+        auto poker_pl    = p_poker(pl);
+        poker_pl->bank() = poker::bank(dec.get<std::uint64_t>());
+        coins += poker_pl->bank().coins().size();
+        poker_pl->clear_cards();
+        for(auto code: dec.get_vec<std::uint8_t>()) {
+            poker_pl->add_card(card::from_code(code));
+        }
+    }
+    bank() = poker::bank(dec.get<std::uint64_t>());
+    bank().coins().reserve(coins + bank().coins().size());
+    table().clear();
+    for(auto code: dec.get_vec<std::uint8_t>()) {
+        table().emplace_back(card::from_code(code));
+    }
+    auto bet_seats = dec.get_vec<std::uint64_t>();
+    auto bet_sizes = dec.get_vec<std::uint64_t>();
+    if(bet_seats.size() != bet_sizes.size()) {
+        auto mes = fmt::format("{} {} bets for {} seats", prefix, bet_sizes.size(), bet_seats.size());
+        m_lgr.error(mes);
+        throw std::runtime_error(mes);
+    }
+    p_bets.clear();
+    for(std::size_t i = 0; i < bet_seats.size(); i++) {
+        p_bets[seat(bet_seats[i])] = bet_sizes[i];
+    }
+    cards().load(dec);
+    p_hand_finished = false;
+    p_hand_recorded = !dec.empty() && dec.get<std::uint8_t>(); //snapshots of older versions have no record
+    if(p_hand_recorded) {
+        hand_history::decode(dec, 0, p_hand);
+    }
+}
+auto game_poker::memory_usage() const -> std::size_t {
+    return games::game::memory_usage() + sizeof(game_poker) - sizeof(games::game) + bank().memory_usage() -
+           sizeof(class bank) + cards().memory_usage() - sizeof(class deck) + m_arena.memory_usage() -
+           sizeof(bot::arena);
+}
+auto game_poker::to_call(const player_ptr& pl) const -> std::size_t {
+    if(pl == p_small_blind_pl && !p_small_blind_made_bet) {
+        return p_big_blind_bet / 2;
+    }
+    auto it = p_bets.find(pl);
+    if(it == p_bets.end() || it->second >= p_last_bet) {
+        return 0;
+    }
+    return p_last_bet - it->second;
+}
 
 auto game_poker::p_player_to_it(game_poker::player_ptr p) -> players_cont::iterator {
-    using namespace bot::utils;
-    auto lbd = [&p](auto plr) { return dyn_cast<player_poker>(plr) == p; };
-    auto it  = std::find_if(players().begin(), players().end(), lbd);
+    auto it = std::find(players().begin(), players().end(), p);
     return it;
 }
 auto game_poker::p_it_to_player(players_cont::iterator it) -> game_poker::player_ptr {
     using namespace bot::utils;
-    auto lgr      = get_logger();
+    auto& lgr     = m_lgr;
     auto prefix   = "game_poker::p_it_to_player";
     auto pl       = *it;
     auto poker_pl = dyn_cast<player_poker>(pl);
@@ -213,7 +535,7 @@ auto game_poker::p_it_to_player(players_cont::iterator it) -> game_poker::player
         lgr.error(mes);
         throw std::runtime_error(mes);
     }
-    return poker_pl;
+    return pl;
 }
 auto game_poker::p_user_to_player(const bot::user_ptr u) -> game_poker::player_ptr {
     using namespace bot::utils;
@@ -222,11 +544,14 @@ auto game_poker::p_user_to_player(const bot::user_ptr u) -> game_poker::player_p
     if(pl == players().end()) {
         return nullptr;
     }
-    return dyn_cast<player_poker>(*pl);
+    return *pl;
+}
+auto game_poker::p_poker(const game::player_ptr& pl) const -> player_poker* {
+    return bot::utils::stat_cast<player_poker>(pl);
 }
 void game_poker::p_advance_place() {
     using namespace bot::utils;
-    auto lgr    = get_logger();
+    auto& lgr   = m_lgr;
     auto prefix = "game_poker::p_advance_place";
     auto it     = p_player_to_it(p_cur_player);
     if(it == players().end()) {
@@ -234,14 +559,32 @@ void game_poker::p_advance_place() {
         lgr.error(mes);
         throw std::runtime_error(mes);
     }
-    if(*it == *players().rbegin()) {
-        it = players().begin();
-    } else {
-        it++;
-    }
-    p_cur_player = dyn_cast<player_poker>(*it);
+    do {
+        if(*it == *players().rbegin()) {
+            it = players().begin();
+        } else {
+            it++;
+        }
+    } while(!p_bets.count(*it));
+    p_cur_player = *it;
     p_cur_player->send("It's your turn.");
 }
+auto game_poker::p_due_to_act(const game::player_ptr& pl) -> bool {
+    //players due to act are the next p_to_act ones in the hand, starting from the current one
+    auto it = p_player_to_it(p_cur_player);
+    for(std::size_t ahead = 0; ahead < p_to_act && it != players().end();) {
+        if(p_bets.count(*it)) {
+            if(*it == pl) {
+                return true;
+            }
+            ahead++;
+        }
+        if(++it == players().end()) {
+            it = players().begin();
+        }
+    }
+    return false;
+}
 void game_poker::p_fill_hand(game::player_ptr pl) {
     using namespace bot::utils;
     auto p     = dyn_cast<player_poker>(pl);
@@ -252,76 +595,138 @@ void game_poker::p_fill_hand(game::player_ptr pl) {
     p->add_card(std::move(card2));
 }
 void game_poker::p_handle_bet(game::player_ptr pl, size_t size) {
-    auto lgr        = get_logger();
-    auto prefix     = fmt::format("game_poker::p_handle_bet {}", pl->user()->log_desc());
-    auto cast       = std::dynamic_pointer_cast<player_poker>(pl);
+    auto& lgr       = m_lgr;
+    auto prefix     = bot::lazy([&] { return fmt::format("game_poker::p_handle_bet {}", pl->user()->log_desc()); });
+    auto cast       = p_poker(pl);
     auto& coins     = cast->bank().coins();
     auto& game_bank = bank().coins();
     if(coins.size() < size) {
-        auto mes = fmt::format("{} attempt to bet {}, but bank is:{}", prefix, size, coins.size());
-        lgr.debug(mes);
-        auto mes_pl = fmt::format("You can't make that bet, your bank is:{}", coins.size());
+        lgr.debug("{} attempt to bet {}, but bank is:{}", prefix, size, coins.size());
+        auto mes_pl = p_text();
+        fmt::format_to(std::back_inserter(mes_pl), "You can't make that bet, your bank is:{}", coins.size());
         pl->send(mes_pl);
         return;
     }
-    if(cast == p_small_blind_pl) {
-        if(!p_small_blind_made_bet && size != p_big_blind_bet / 2) {
-            auto mes = fmt::format("Your bet can't be other than {}", p_big_blind_bet / 2);
-            pl->send(mes);
-            return;
-        } else {
-            p_small_blind_made_bet = true;
-        }
-    } else {
-        if(p_bets[cast] + size < p_last_bet) {
-            auto mes = fmt::format("Your bet can't be lower than {}", p_last_bet - p_bets[cast]);
+    if(pl == p_small_blind_pl && !p_small_blind_made_bet) {
+        if(size != p_big_blind_bet / 2) {
+            auto mes = p_text();
+            fmt::format_to(std::back_inserter(mes), "Your bet can't be other than {}", p_big_blind_bet / 2);
             pl->send(mes);
             return;
         }
+        p_small_blind_made_bet = true;
+    } else if(p_bets[pl] + size < p_last_bet) {
+        auto mes = p_text();
+        fmt::format_to(std::back_inserter(mes), "Your bet can't be lower than {}", p_last_bet - p_bets[pl]);
+        pl->send(mes);
+        return;
     }
     m_lgr.debug("{} made a bet:{}", prefix, size);
-    if(p_bets[cast] > p_last_bet) {
-        p_last_bet = p_bets[cast];
-    }
     std::move(coins.begin(), coins.begin() + size, std::back_inserter(game_bank));
     coins.erase(coins.begin(), coins.begin() + size);
+
+    p_record(pl, hand_history::action_type::bet, size);
+    p_bets[pl] += size;
+    if(p_bets[pl] > p_last_bet) { //raise, everyone else has to answer it
+        p_last_bet = p_bets[pl];
+        p_to_act   = p_bets.size();
+    }
+    p_to_act--;
+    p_end_action();
+}
+void game_poker::p_end_action() {
+    if(p_bets.size() == 1) { //everyone else folded
+        p_finish_hand();
+        return;
+    }
+    if(p_to_act == 0) { //street is over
+        if(table().size() == 5) {
+            p_finish_hand();
+            return;
+        }
+        p_fill_table();
+        for(auto& el: p_bets) {
+            el.second = 0;
+        }
+        p_last_bet = 0;
+        p_to_act   = p_bets.size();
+    }
     p_advance_place();
-    /*
-    auto mes = pl->user()->desc() + " made a bet:" + std::to_string(size);
+    auto state = p_render_game_state();
     for(auto& pl: players()) {
-        pl->send(mes);
+        p_send_state(state, pl);
     }
-    */
-
-    p_bets[cast] += size;
-    {
-        size_t prev_bet = p_bets.begin()->second;
-        bool equals =
-            std::all_of(p_bets.begin(), p_bets.end(), [&prev_bet](auto pair) { return pair.second == prev_bet; });
-        if(equals) {
-            if(table().size() != 5) {
-                p_fill_table();
-                for(auto& el: p_bets) {
-                    el.second = 0;
-                }
-            } else {
-                //TODO:handle properly
+    send_spectators(state);
+}
+void game_poker::p_finish_hand() {
+    std::vector<player_ptr> winners;
+    std::string best;
+    for(auto& pl: players()) { //seat order, so the odd coin of a split pot is deterministic
+        if(!p_bets.count(pl)) {
+            continue;
+        }
+        auto rank = p_bets.size() == 1 ? std::string() : best_ranking(p_poker(pl)->cards(), table());
+        if(winners.empty() || rank > best) {
+            winners = {pl};
+            best    = std::move(rank);
+        } else if(rank == best) {
+            winners.emplace_back(pl);
+        }
+    }
+    auto pot   = bank().coins().size();
+    auto share = pot / winners.size();
+    for(std::size_t i = 0; i < winners.size(); i++) {
+        auto won   = share + (i == 0 ? pot % winners.size() : 0);
+        auto coins = bank().get_coins(won);
+        p_poker(winners[i])->bank().add_coins(coins);
+        if(p_hand_recorded) {
+            if(auto seat = p_hand.seat_of(winners[i]->user()->id())) {
+                p_hand.seats[*seat].won += won;
             }
         }
+        m_lgr.debug("game_poker::p_finish_hand {} won {}", winners[i]->user()->log_desc(), won);
+        auto& user = *winners[i]->user();
+        auto mes   = p_text();
+        fmt::format_to(std::back_inserter(mes), "{}[{}] won {} coins", user.name(), user.token(), won);
+        for(auto& pl: players()) {
+            pl->send(mes);
+        }
+        send_spectators(mes);
+    }
+    state()      = state::ended;
+    p_cur_player = nullptr;
+    if(p_hand_recorded) {
+        for(auto& c: table()) {
+            p_hand.board.emplace_back(c.code());
+        }
+        p_hand.time = static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch())
+                .count());
+        p_hand_finished = true;
     }
     auto state = p_render_game_state();
     for(auto& pl: players()) {
         p_send_state(state, pl);
     }
+    send_spectators(state);
 }
-auto game_poker::p_render_game_state() const -> std::string {
-    auto mes = "Bank: " + p_render_coins(bank().coins());
+auto game_poker::p_text() const -> text_t {
+    return text_t(&m_messages);
+}
+auto game_poker::p_render_game_state() const -> text_t {
+    bot::trace::span span("render");
+    bot::alloc::scope alloc_scope(bot::alloc::tag::render);
+    auto mes = p_text();
+    mes += "Bank: ";
+    mes += p_render_coins(bank().coins());
     mes += "\nTable: ";
     for(auto& card: table()) {
-        mes += p_render_card(card) + " ";
+        mes += p_render_card(card);
+        mes += " ";
     }
-    for(auto [pl_ptr, count]: p_bets) {
-        mes += "\n" + pl_ptr->user()->desc() + " bet:" + std::to_string(count);
+    for(auto& [pl_ptr, count]: p_bets) {
+        auto& user = *pl_ptr->user();
+        fmt::format_to(std::back_inserter(mes), "\n{}[{}] bet:{}", user.name(), user.token(), count);
     }
     return mes;
 }
@@ -342,23 +747,39 @@ auto game_poker::p_render_coins(const bank::coins_t& c) const -> std::string {
     auto mes = std::to_string(c.size());
     return mes;
 }
-void game_poker::p_send_state(const std::string& game_state, game::player_ptr pl) {
-    auto mes      = game_state;
-    auto cast     = std::dynamic_pointer_cast<player_poker>(pl);
+void game_poker::p_send_state(const text_t& game_state, game::player_ptr pl) {
+    bot::trace::span span("render");
+    bot::alloc::scope alloc_scope(bot::alloc::tag::render);
+    auto mes      = p_text();
+    auto cast     = p_poker(pl);
     auto& pl_bank = cast->bank();
-    mes += "\nYour bank:" + p_render_coins(pl_bank.coins());
-    if(cast != p_small_blind_pl || p_small_blind_made_bet) {
+    mes += game_state;
+    mes += "\nYour bank:";
+    mes += p_render_coins(pl_bank.coins());
+    if(pl != p_small_blind_pl || p_small_blind_made_bet) {
         auto c1 = p_render_card(cast->cards().at(0));
         auto c2 = p_render_card(cast->cards().at(1));
-        mes += fmt::format("\nHand: {} {}", c1, c2);
+        fmt::format_to(std::back_inserter(mes), "\nHand: {} {}", c1, c2);
     } else {
-        mes += fmt::format("\nTo open your cards, bet {} coins", p_big_blind_bet / 2);
+        fmt::format_to(std::back_inserter(mes), "\nTo open your cards, bet {} coins", p_big_blind_bet / 2);
     }
     pl->send(mes);
 }
 
+void game_poker::p_record(const game::player_ptr& pl, hand_history::action_type type, std::size_t amount) {
+    if(!p_hand_recorded) {
+        return;
+    }
+    auto seat = p_hand.seat_of(pl->user()->id());
+    if(!seat) {
+        p_hand_recorded = false; //can't happen, players don't join during a hand
+        return;
+    }
+    p_hand.actions.push_back({static_cast<std::uint8_t>(*seat), type, amount});
+}
+
 void game_poker::p_fill_table() {
-    auto lgr    = get_logger();
+    auto& lgr   = m_lgr;
     auto prefix = "game_poker::p_fill_table";
 
     if(table().size() == 5) {
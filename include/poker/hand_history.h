@@ -0,0 +1,664 @@
+#pragma once
+#include "components/logger.hpp"
+#include "core/logging_obj.h"
+#include "core/mapped_file.h"
+#include "core/metrics.h"
+#include "core/snapshot.h"
+#include "core/spsc_queue.h"
+#include "poker/card.h"
+#include "poker/deck.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <filesystem>
+#include <fmt/chrono.h>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+
+namespace poker {
+namespace hand_history {
+
+constexpr char magic[8]                = {'T', 'G', 'P', 'K', 'H', 'A', 'N', 'D'}; /**< First bytes of a history file */
+constexpr std::uint32_t version        = 1;                                        /**< Version of the format */
+constexpr const char* extension        = ".tgh";                                   /**< Extension of history files */
+constexpr std::uint64_t flag_seed      = 1; /**< Flag of a hand with a 32-bit seed, such hands can't be replayed */
+constexpr std::uint64_t flag_wide_seed = 2; /**< Flag of a hand with a 128-bit seed */
+
+/**
+ * What a player did.
+ * */
+enum class action_type : std::uint8_t {
+    blind, /**< Forced bet taken by the game */
+    bet,   /**< Bet, 0 is a check */
+    fold,  /**< Fold */
+    leave  /**< Fold of a player who left the game, in turn or not */
+};
+
+/**
+ * Compression of a block's payload.
+ * */
+enum class codec : std::uint8_t {
+    none,   /**< Stored as is */
+    deflate /**< zlib stream */
+};
+
+/**
+ * Player of a recorded hand.
+ * */
+struct seat {
+    std::uint64_t user  = 0;              /**< Telegram id */
+    std::uint64_t stack = 0;              /**< Coins before blinds */
+    std::array<std::uint8_t, 2> cards {}; /**< Hole cards, see card::code */
+    std::uint64_t won   = 0;              /**< Coins taken from the pot */
+};
+
+/**
+ * Action of a recorded hand.
+ * */
+struct action {
+    std::uint8_t seat    = 0;                /**< Index of the acting seat */
+    action_type type     = action_type::bet; /**< What the player did */
+    std::uint64_t amount = 0;                /**< Coins put in the pot */
+};
+
+/**
+ * Completed hand of a game_poker.
+ * */
+struct hand_record {
+    std::uint64_t time      = 0;       /**< Unix time the hand finished at, seconds */
+    std::uint64_t table     = 0;       /**< Id of the room */
+    std::uint64_t big_blind = 0;       /**< Size of the big blind */
+    std::optional<deck::seed_t> seed;  /**< Seed of the deck's shuffle, see game_poker::init_game */
+    std::vector<seat> seats;           /**< Players in seat order */
+    std::vector<std::uint8_t> board;   /**< Cards on the table, see card::code */
+    std::vector<action> actions;       /**< Blinds, bets, folds and leaves in order */
+
+    /**
+     * Empties the record, keeps capacity of containers.
+     * */
+    void clear();
+    /**
+     * Returns coins the winners took, that's the whole pot.
+     * */
+    auto pot() const -> std::uint64_t;
+    /**
+     * Returns index of a user's seat, std::nullopt if the user didn't play the hand.
+     * @param user telegram id.
+     * */
+    auto seat_of(std::uint64_t user) const -> std::optional<std::size_t>;
+};
+
+/**
+ * Block of hands in a file, blocks are self-describing, so reading their headers gives an index of the file.
+ * */
+struct block_info {
+    std::size_t offset        = 0;                         /**< Offset of the payload in the file */
+    std::uint32_t stored      = 0;                         /**< Bytes of the payload in the file */
+    std::uint32_t raw         = 0;                         /**< Bytes of the payload once decompressed */
+    std::uint32_t hands       = 0;                         /**< Amount of hands */
+    hand_history::codec codec = hand_history::codec::none; /**< Compression of the payload */
+    std::uint64_t first_time  = 0;                         /**< Time of the first hand */
+    std::uint64_t last_time   = 0;                         /**< Time of the last hand */
+    std::uint32_t crc         = 0;                         /**< CRC-32 of the stored payload */
+
+    static constexpr std::size_t header_size = 33; /**< Bytes of an encoded header */
+};
+
+/**
+ * Encodes a hand: varints for numbers, a byte per card, an action is a varint of its seat and type
+ * followed by the zigzag difference of its amount from the previous action's.
+ * Typical hand of 6 players takes 60-80 bytes before compression.
+ * @param hand hand to encode.
+ * @param prev_time time of the previous hand of the block, time is stored as a difference.
+ * @param enc encoder to append to.
+ * */
+void encode(const hand_record& hand, std::uint64_t prev_time, bot::snapshot::encoder& enc);
+/**
+ * Decodes a hand encoded by encode.
+ * Throws runtime exception on truncated data.
+ * @param dec decoder to read from.
+ * @param prev_time time of the previous hand of the block.
+ * @param hand record to fill, its containers are reused.
+ * */
+void decode(bot::snapshot::decoder& dec, std::uint64_t prev_time, hand_record& hand);
+/**
+ * Renders a hand as text, one line per seat and action.
+ * @param hand hand to render.
+ * */
+auto describe(const hand_record& hand) -> std::string;
+/**
+ * Renders a card code as a rank and a suit letter, e.g. "Ah".
+ * @param code code of a card.
+ * */
+auto card_name(std::uint8_t code) -> std::string;
+/**
+ * Lists history files of a directory in the order they were written.
+ * @param dir directory of history files.
+ * */
+auto list_files(const std::string& dir) -> std::vector<std::string>;
+
+/**
+ * Settings of writer.
+ * */
+struct writer_config {
+    std::string dir;                                  /**< Directory of history files */
+    std::string name       = "hands";                 /**< Prefix of file names, one per writer of a directory */
+    std::size_t block_size = 64 * 1024;               /**< Raw bytes of a block before it's written */
+    std::chrono::milliseconds flush_interval {10000}; /**< Longest time a hand waits in an unwritten block */
+    std::size_t file_size = 64 * 1024 * 1024;         /**< Files are rolled over once they're that big */
+    bool compress         = true;                     /**< Deflate blocks */
+    std::size_t queue     = 4096;                     /**< Most finished hands waiting for the thread */
+};
+
+/**
+ * Appends finished hands to rolling history files from a background thread. \n
+ * Hands are handed over through a lock-free queue, so a table never waits for the disk,
+ * and encoded into blocks that are compressed and written once they're big or old enough.
+ * A file is a header followed by blocks, each with a header of its own,
+ * so a crash loses at most the unwritten block and a torn last block is skipped by readers.
+ * */
+class writer: public bot::logging_obj {
+public:
+    /**
+     * Constructor, creates the directory and starts the thread.
+     * Throws filesystem exception if the directory can't be created.
+     * @param config settings.
+     * */
+    writer(writer_config config);
+    /**
+     * Destructor, writes queued hands and joins the thread.
+     * */
+    ~writer();
+    writer(const writer&) = delete;
+    writer& operator=(const writer&) = delete;
+
+    /**
+     * Hands a finished hand over to the thread, called from one thread only.
+     * The record is swapped with a recycled one instead of being copied, so it doesn't allocate.
+     * @param hand hand to write, holds an old record afterwards.
+     * @returns false if the queue is full, the hand is dropped then.
+     * */
+    auto submit(hand_record& hand) -> bool;
+    /**
+     * Returns amount of hands written to files.
+     * */
+    auto written() const -> std::size_t { return m_written.load(std::memory_order_relaxed); }
+
+protected:
+    static constexpr std::chrono::milliseconds poll {50}; /**< Sleep of the thread when the queue is empty */
+
+    writer_config m_config;                          /**< Settings */
+    bot::spsc_queue<hand_record> m_queue;            /**< Hands from the table */
+    std::atomic<bool> m_stop {false};                /**< Flag to finish the thread */
+    std::atomic<std::size_t> m_written {0};          /**< Hands written to files */
+    int m_fd                  = -1;                  /**< Current file */
+    std::size_t m_file_size   = 0;                   /**< Bytes of the current file */
+    bot::snapshot::encoder m_block;                  /**< Raw payload of the current block */
+    bot::snapshot::encoder m_hand;                   /**< Encoded hand before it's appended */
+    std::string m_compressed;                        /**< Compressed payload */
+    std::uint32_t m_block_hands = 0;                 /**< Hands of the current block */
+    std::uint64_t m_first_time  = 0;                 /**< Time of the block's first hand */
+    std::uint64_t m_last_time   = 0;                 /**< Time of the block's last hand */
+    std::chrono::steady_clock::time_point m_started; /**< When the block got its first hand */
+    bot::metrics::counter& m_recorded;               /**< Hands written */
+    bot::metrics::counter& m_dropped;                /**< Hands lost */
+    bot::metrics::counter& m_bytes;                  /**< Bytes written */
+    bot::metrics::histogram& m_write_hist;           /**< Durations of block writes */
+    std::thread m_thread;                            /**< Writing thread */
+
+    void p_run();
+    void p_append(const hand_record& hand);
+    void p_flush();
+    void p_open();
+    void p_write(const std::string& data);
+};
+
+/**
+ * Reads a history file written by writer.
+ * */
+class reader: public bot::logging_obj {
+public:
+    /**
+     * Constructor, maps the file and reads headers of its blocks, a torn or corrupted tail is logged and ignored.
+     * Throws runtime exception if there is no such file or it's not a history file.
+     * @param path path of a history file.
+     * @param verify whether to check every block's CRC now, otherwise a block is checked when it's read,
+     * so opening a file to read a few blocks doesn't touch the rest of it.
+     * */
+    reader(const std::string& path, bool verify = true);
+
+    /**
+     * Returns headers of valid blocks in file order.
+     * */
+    auto blocks() const -> const std::vector<block_info>& { return m_blocks; }
+    /**
+     * Returns bytes of the file as it was mapped, a file being written may have grown since.
+     * */
+    auto size() const -> std::size_t { return m_file.size(); }
+    /**
+     * Decodes hands of a block.
+     * Throws runtime exception on a corrupted block.
+     * @param index index of the block.
+     * @returns hands in the order they were written.
+     * */
+    auto read_block(std::size_t index) const -> std::vector<hand_record>;
+    /**
+     * Calls func for every hand of the file, the record is reused between calls.
+     * @param func function that takes const hand_record&.
+     * */
+    template<class Func>
+    void for_each(Func&& func) const;
+
+protected:
+    std::string m_path;               /**< Path of the file */
+    bot::mapped_file m_file;          /**< Bytes of the file */
+    bool m_verified;                  /**< Whether CRCs of blocks were checked on open */
+    std::vector<block_info> m_blocks; /**< Valid blocks */
+
+    auto p_payload(const block_info& block) const -> std::string;
+    template<class Func>
+    void p_decode_block(const block_info& block, hand_record& hand, Func&& func) const;
+};
+
+/**
+ * Maps signed differences to unsigned values, small ones of either sign to small ones.
+ * */
+auto zigzag(std::int64_t value) -> std::uint64_t {
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+auto unzigzag(std::uint64_t value) -> std::int64_t {
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+void hand_record::clear() {
+    time      = 0;
+    table     = 0;
+    big_blind = 0;
+    seed.reset();
+    seats.clear();
+    board.clear();
+    actions.clear();
+}
+
+auto hand_record::pot() const -> std::uint64_t {
+    std::uint64_t result = 0;
+    for(auto& s: seats) {
+        result += s.won;
+    }
+    return result;
+}
+
+auto hand_record::seat_of(std::uint64_t user) const -> std::optional<std::size_t> {
+    for(std::size_t i = 0; i < seats.size(); i++) {
+        if(seats[i].user == user) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+void encode(const hand_record& hand, std::uint64_t prev_time, bot::snapshot::encoder& enc) {
+    enc.put_varint(zigzag(static_cast<std::int64_t>(hand.time - prev_time)));
+    enc.put_varint(hand.table);
+    enc.put_varint(hand.big_blind);
+    enc.put_varint(hand.seed ? flag_wide_seed : 0);
+    if(hand.seed) {
+        enc.put(*hand.seed); //random, varints would only make it longer
+    }
+    enc.put_varint(hand.seats.size());
+    for(auto& s: hand.seats) {
+        enc.put_varint(s.user);
+        enc.put_varint(s.stack);
+        enc.put(s.cards);
+        enc.put_varint(s.won);
+    }
+    enc.put(static_cast<std::uint8_t>(hand.board.size()));
+    enc.data().append(hand.board.begin(), hand.board.end());
+    enc.put_varint(hand.actions.size());
+    std::uint64_t prev_amount = 0;
+    for(auto& a: hand.actions) {
+        enc.put_varint(static_cast<std::uint64_t>(a.seat) << 2 | static_cast<std::uint8_t>(a.type));
+        enc.put_varint(zigzag(static_cast<std::int64_t>(a.amount - prev_amount)));
+        prev_amount = a.amount;
+    }
+}
+
+void decode(bot::snapshot::decoder& dec, std::uint64_t prev_time, hand_record& hand) {
+    hand.clear();
+    hand.time      = prev_time + unzigzag(dec.get_varint());
+    hand.table     = dec.get_varint();
+    hand.big_blind = dec.get_varint();
+    auto flags = dec.get_varint();
+    if(flags & flag_seed) {
+        dec.get_varint();
+    }
+    if(flags & flag_wide_seed) {
+        hand.seed = dec.get<deck::seed_t>();
+    }
+    hand.seats.resize(dec.check_count(dec.get_varint(), 5)); //4 varints and 2 cards
+    for(auto& s: hand.seats) {
+        s.user  = dec.get_varint();
+        s.stack = dec.get_varint();
+        s.cards = dec.get<std::array<std::uint8_t, 2>>();
+        s.won   = dec.get_varint();
+    }
+    hand.board.resize(dec.get<std::uint8_t>());
+    for(auto& c: hand.board) {
+        c = dec.get<std::uint8_t>();
+    }
+    hand.actions.resize(dec.check_count(dec.get_varint(), 2)); //2 varints
+    std::uint64_t prev_amount = 0;
+    for(auto& a: hand.actions) {
+        auto code   = dec.get_varint();
+        a.seat      = static_cast<std::uint8_t>(code >> 2);
+        a.type      = static_cast<action_type>(code & 3);
+        a.amount    = prev_amount + unzigzag(dec.get_varint());
+        prev_amount = a.amount;
+    }
+}
+
+auto card_name(std::uint8_t code) -> std::string {
+    constexpr const char* ranks = "23456789TJQKA";
+    constexpr const char* suits = "hdcs"; //kind ids: hearts, tiles, clovers, pikes
+    auto c                      = card::from_code(code);
+    return {ranks[c.value - 2], suits[c.kind.id]};
+}
+
+auto describe(const hand_record& hand) -> std::string {
+    constexpr const char* types[] = {"blind", "bet", "fold", "leave"};
+    auto result = fmt::format("{:%Y-%m-%d %H:%M:%S} table:{} big blind:{} pot:{}",
+                              fmt::gmtime(static_cast<std::time_t>(hand.time)), hand.table, hand.big_blind, hand.pot());
+    result += hand.seed ? fmt::format(" seed:{:08x}\n", fmt::join(*hand.seed, "")) : "\n";
+    for(std::size_t i = 0; i < hand.seats.size(); i++) {
+        auto& s = hand.seats[i];
+        fmt::format_to(std::back_inserter(result), "  seat {} user:{} stack:{} hand:{} {} won:{}\n", i, s.user,
+                       s.stack, card_name(s.cards[0]), card_name(s.cards[1]), s.won);
+    }
+    result += "  board:";
+    for(auto c: hand.board) {
+        result += " " + card_name(c);
+    }
+    result += "\n";
+    for(auto& a: hand.actions) {
+        auto type = static_cast<std::size_t>(a.type) < std::size(types) ? types[static_cast<std::size_t>(a.type)] : "?";
+        fmt::format_to(std::back_inserter(result), "  seat {} {} {}\n", a.seat, type, a.amount);
+    }
+    return result;
+}
+
+auto list_files(const std::string& dir) -> std::vector<std::string> {
+    std::vector<std::string> result;
+    for(auto& entry: std::filesystem::directory_iterator(dir)) {
+        if(entry.is_regular_file() && entry.path().extension() == extension) {
+            result.emplace_back(entry.path().string());
+        }
+    }
+    std::sort(result.begin(), result.end()); //names end with the time of the first block
+    return result;
+}
+
+writer::writer(writer_config config):
+    m_config(std::move(config)), m_queue(m_config.queue),
+    m_recorded(bot::metrics::get_counter("bot_hands_recorded_total", "Finished hands written to hand history")),
+    m_dropped(bot::metrics::get_counter("bot_hands_dropped_total",
+                                        "Finished hands lost because the history queue was full or a write failed")),
+    m_bytes(bot::metrics::get_counter("bot_hand_history_bytes_total", "Bytes written to hand history files")),
+    m_write_hist(bot::metrics::get_histogram("bot_hand_history_block_write_seconds",
+                                             "Time to compress and write a block of hand history")) {
+    std::filesystem::create_directories(m_config.dir);
+    m_block.data().reserve(m_config.block_size + 1024);
+    m_thread = std::thread([this] { p_run(); });
+}
+
+writer::~writer() {
+    m_stop.store(true, std::memory_order_release);
+    m_thread.join();
+    if(m_fd >= 0) {
+        ::fsync(m_fd);
+        ::close(m_fd);
+    }
+}
+
+auto writer::submit(hand_record& hand) -> bool {
+    if(!m_queue.try_push(hand)) {
+        m_dropped.add();
+        m_lgr.warn("hand_history::writer queue is full, dropped a hand of table {}", hand.table);
+        return false;
+    }
+    return true;
+}
+
+void writer::p_run() {
+    hand_record hand;
+    while(true) {
+        //checked before draining, so every hand submitted before the stop is written
+        auto stop = m_stop.load(std::memory_order_acquire);
+        auto any  = false;
+        while(m_queue.try_pop(hand)) {
+            p_append(hand);
+            any = true;
+        }
+        if(m_block_hands && (stop || std::chrono::steady_clock::now() - m_started >= m_config.flush_interval)) {
+            p_flush();
+        }
+        if(stop) {
+            return;
+        }
+        if(!any) {
+            std::this_thread::sleep_for(poll);
+        }
+    }
+}
+
+void writer::p_append(const hand_record& hand) {
+    if(!m_block_hands) {
+        m_started    = std::chrono::steady_clock::now();
+        m_first_time = hand.time;
+        m_last_time  = hand.time;
+    }
+    m_hand.data().clear();
+    encode(hand, m_last_time, m_hand);
+    m_block.put_varint(m_hand.data().size());
+    m_block.data() += m_hand.data();
+    m_last_time = hand.time;
+    m_block_hands++;
+    if(m_block.data().size() >= m_config.block_size) {
+        p_flush();
+    }
+}
+
+void writer::p_flush() {
+    bot::metrics::scoped_timer timer(m_write_hist);
+    auto& raw     = m_block.data();
+    auto* payload = &raw;
+    auto type     = codec::none;
+    if(m_config.compress) {
+        auto size = compressBound(raw.size());
+        m_compressed.resize(size);
+        if(compress2(reinterpret_cast<Bytef*>(m_compressed.data()), &size, reinterpret_cast<const Bytef*>(raw.data()),
+                     raw.size(), Z_DEFAULT_COMPRESSION) == Z_OK &&
+           size < raw.size()) {
+            m_compressed.resize(size);
+            payload = &m_compressed;
+            type    = codec::deflate;
+        }
+    }
+    bot::snapshot::encoder block;
+    block.data().reserve(block_info::header_size + payload->size());
+    block.put(static_cast<std::uint32_t>(payload->size()));
+    block.put(static_cast<std::uint32_t>(raw.size()));
+    block.put(m_block_hands);
+    block.put(static_cast<std::uint8_t>(type));
+    block.put(m_first_time);
+    block.put(m_last_time);
+    block.put(static_cast<std::uint32_t>(
+        crc32(0, reinterpret_cast<const Bytef*>(payload->data()), static_cast<uInt>(payload->size()))));
+    block.data() += *payload;
+    try {
+        if(m_fd < 0 || m_file_size >= m_config.file_size) {
+            p_open();
+        }
+        p_write(block.data());
+        m_recorded.add(m_block_hands);
+        m_bytes.add(block.data().size());
+        m_written.fetch_add(m_block_hands, std::memory_order_relaxed);
+        m_lgr.debug("hand_history::writer wrote {} hands in {} bytes, {} raw", m_block_hands, block.data().size(),
+                    raw.size());
+    } catch(const std::exception& e) {
+        m_lgr.error("hand_history::writer dropped {} hands: {}", m_block_hands, e.what());
+        m_dropped.add(m_block_hands);
+    }
+    raw.clear();
+    m_block_hands = 0;
+}
+
+void writer::p_open() {
+    if(m_fd >= 0) {
+        ::fsync(m_fd);
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                       .count();
+    auto name = fmt::format("{}-{}{}", m_config.name, seconds, extension);
+    auto path = (std::filesystem::path(m_config.dir) / name).string();
+    m_fd      = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if(m_fd < 0) {
+        throw std::runtime_error(fmt::format("can't open {}: {}", path, std::strerror(errno)));
+    }
+    m_file_size = static_cast<std::size_t>(::lseek(m_fd, 0, SEEK_END));
+    if(!m_file_size) { //a file of the same second is appended to
+        bot::snapshot::encoder header;
+        header.data().append(magic, sizeof(magic));
+        header.put(version);
+        header.put(std::uint32_t {0x01020304}); //byte order mark
+        p_write(header.data());
+    }
+    m_lgr.info("hand_history::writer writing to {}", path);
+}
+
+void writer::p_write(const std::string& data) {
+    for(std::size_t done = 0; done < data.size();) {
+        auto n = ::write(m_fd, data.data() + done, data.size() - done);
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(fmt::format("can't write: {}", std::strerror(errno)));
+        }
+        done += static_cast<std::size_t>(n);
+    }
+    m_file_size += data.size();
+}
+
+reader::reader(const std::string& path, bool verify): m_path(path), m_file(path), m_verified(verify) {
+    auto* data = m_file.data();
+    bot::snapshot::decoder dec(data, m_file.size());
+    try {
+        char head[sizeof(magic)];
+        for(auto& c: head) {
+            c = dec.get<char>();
+        }
+        if(std::memcmp(head, magic, sizeof(magic)) != 0 || dec.get<std::uint32_t>() != version ||
+           dec.get<std::uint32_t>() != 0x01020304) {
+            throw std::runtime_error("wrong header");
+        }
+    } catch(const std::exception& e) {
+        throw std::runtime_error(fmt::format("hand_history::reader {} is not a hand history: {}", path, e.what()));
+    }
+    std::size_t offset = sizeof(magic) + 8;
+    while(offset < m_file.size()) {
+        if(m_file.size() - offset < block_info::header_size) {
+            m_lgr.warn("hand_history::reader {} ends with a torn block header at {}", path, offset);
+            break;
+        }
+        bot::snapshot::decoder header(data + offset, block_info::header_size);
+        block_info block;
+        block.stored     = header.get<std::uint32_t>();
+        block.raw        = header.get<std::uint32_t>();
+        block.hands      = header.get<std::uint32_t>();
+        block.codec      = static_cast<hand_history::codec>(header.get<std::uint8_t>());
+        block.first_time = header.get<std::uint64_t>();
+        block.last_time  = header.get<std::uint64_t>();
+        block.crc        = header.get<std::uint32_t>();
+        block.offset     = offset + block_info::header_size;
+        if(m_file.size() - block.offset < block.stored) {
+            m_lgr.warn("hand_history::reader {} ends with a torn block at {}", path, offset);
+            break;
+        }
+        if(verify && crc32(0, reinterpret_cast<const Bytef*>(data + block.offset), block.stored) != block.crc) {
+            m_lgr.warn("hand_history::reader {} has a corrupted block at {}, skipping the rest", path, offset);
+            break;
+        }
+        m_blocks.emplace_back(block);
+        offset = block.offset + block.stored;
+    }
+}
+
+auto reader::read_block(std::size_t index) const -> std::vector<hand_record> {
+    std::vector<hand_record> result;
+    hand_record hand;
+    p_decode_block(m_blocks.at(index), hand, [&](const hand_record& h) { result.emplace_back(h); });
+    return result;
+}
+
+template<class Func>
+void reader::for_each(Func&& func) const {
+    hand_record hand;
+    for(auto& block: m_blocks) {
+        p_decode_block(block, hand, func);
+    }
+}
+
+auto reader::p_payload(const block_info& block) const -> std::string {
+    auto* stored = m_file.data() + block.offset;
+    if(!m_verified && crc32(0, reinterpret_cast<const Bytef*>(stored), block.stored) != block.crc) {
+        throw std::runtime_error(fmt::format("hand_history::reader {} has a corrupted block at {}", m_path,
+                                             block.offset));
+    }
+    if(block.codec == codec::none) {
+        return std::string(stored, block.stored);
+    }
+    if(block.codec != codec::deflate) {
+        throw std::runtime_error(fmt::format("hand_history::reader {} unknown codec {}", m_path,
+                                             static_cast<int>(block.codec)));
+    }
+    std::string result(block.raw, '\0');
+    uLongf size = block.raw;
+    if(uncompress(reinterpret_cast<Bytef*>(result.data()), &size,
+                  reinterpret_cast<const Bytef*>(stored), block.stored) != Z_OK ||
+       size != block.raw) {
+        throw std::runtime_error(fmt::format("hand_history::reader {} can't decompress block at {}", m_path,
+                                             block.offset));
+    }
+    return result;
+}
+
+template<class Func>
+void reader::p_decode_block(const block_info& block, hand_record& hand, Func&& func) const {
+    auto payload = p_payload(block);
+    bot::snapshot::decoder dec(payload.data(), payload.size());
+    auto prev_time = block.first_time;
+    for(std::uint32_t i = 0; i < block.hands; i++) {
+        auto record = dec.sub(dec.get_varint());
+        decode(record, prev_time, hand);
+        prev_time = hand.time;
+        func(static_cast<const hand_record&>(hand));
+    }
+}
+
+} // namespace hand_history
+} // namespace poker
@@ -0,0 +1,623 @@
+#pragma once
+#include "core/logging_obj.h"
+#include "core/mapped_file.h"
+#include "core/snapshot.h"
+#include "poker/hand_history.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace poker {
+namespace hand_history {
+
+constexpr char index_magic[8]         = {'T', 'G', 'P', 'K', 'H', 'I', 'D', 'X'}; /**< First bytes of an index */
+constexpr std::uint32_t index_version = 1;                                        /**< Version of the index format */
+constexpr const char* index_extension = ".tgi";                                   /**< Extension of index files */
+
+/**
+ * Bits of a board's texture, see board_texture.
+ * */
+namespace texture {
+constexpr std::uint8_t paired            = 1 << 0; /**< Two or more cards of a rank */
+constexpr std::uint8_t trips             = 1 << 1; /**< Three or more cards of a rank */
+constexpr std::uint8_t flush_possible    = 1 << 2; /**< Three or more cards of a suit */
+constexpr std::uint8_t flush             = 1 << 3; /**< Five cards of a suit */
+constexpr std::uint8_t straight_possible = 1 << 4; /**< Three ranks that fit in a straight */
+constexpr std::uint8_t river             = 1 << 5; /**< All five cards are dealt */
+
+/**
+ * Names of bits for queries.
+ * */
+constexpr std::pair<const char*, std::uint8_t> names[] = {{"paired", paired},
+                                                          {"trips", trips},
+                                                          {"flush_possible", flush_possible},
+                                                          {"flush", flush},
+                                                          {"straight_possible", straight_possible},
+                                                          {"river", river}};
+} // namespace texture
+
+/**
+ * Filter of hands, a hand matches when it passes every set criterion.
+ * */
+struct hand_query {
+    std::optional<std::uint64_t> user;                                 /**< Telegram id of a seated player */
+    std::uint64_t min_pot = 0;                                         /**< Least pot */
+    std::uint8_t board    = 0;                                         /**< Texture bits the board has all of */
+    std::uint64_t from    = 0;                                         /**< Earliest unix time */
+    std::uint64_t to      = std::numeric_limits<std::uint64_t>::max(); /**< Latest unix time */
+
+    /**
+     * Returns whether criteria of index columns are set, a query of a user only is answered by postings alone.
+     * */
+    auto has_columns() const -> bool {
+        return min_pot || board || from || to != std::numeric_limits<std::uint64_t>::max();
+    }
+};
+
+/**
+ * Outcome of search.
+ * */
+struct search_result {
+    std::size_t files   = 0;        /**< History files searched */
+    std::size_t indexed = 0;        /**< Indexes built because they were missing or stale */
+    std::size_t hands   = 0;        /**< Hands in the files */
+    std::size_t matched = 0;        /**< Hands that match */
+    std::vector<hand_record> found; /**< First matching hands up to the limit, in file order */
+};
+
+/**
+ * Columnar side index of a history file, memory-mapped. \n
+ * The index of "x.tgh" is "x.tgi". It's a header followed by aligned columns with a value per hand:
+ * times, pots and board textures, then the first hand of every block to locate hands in the history file,
+ * then sorted user ids with their postings, sorted lists of hands each user played. \n
+ * A query turns postings into a bitmap of hands and intersects it with bitmaps of column predicates,
+ * columns are evaluated only for words of the bitmap that still have candidates,
+ * so a query touches a small part of the index and no hand is decoded until it's known to match.
+ * The index records the size of the history file it was built of, a file that grew since is indexed again.
+ * */
+class hand_index: public bot::logging_obj {
+public:
+    /**
+     * Constructor, maps an index.
+     * Throws runtime exception if there is no such file or it's not a valid index.
+     * @param path path of an index file.
+     * */
+    hand_index(const std::string& path);
+
+    /**
+     * Returns bytes of the history file the index was built of.
+     * */
+    auto source_size() const -> std::uint64_t { return m_source_size; }
+    /**
+     * Returns amount of indexed hands.
+     * */
+    auto hands() const -> std::size_t { return m_hands; }
+    /**
+     * Returns amount of distinct players of indexed hands.
+     * */
+    auto users() const -> std::size_t { return m_users; }
+    /**
+     * Finds hands that match a query.
+     * @param query filter of hands.
+     * @returns indexes of matching hands in file order.
+     * */
+    auto match(const hand_query& query) const -> std::vector<std::uint32_t>;
+    /**
+     * Locates a hand in the history file.
+     * @param hand index of a hand.
+     * @returns index of the block and position of the hand in it.
+     * */
+    auto locate(std::uint32_t hand) const -> std::pair<std::size_t, std::size_t>;
+
+protected:
+    static constexpr std::size_t header_size = 64; /**< Bytes of the header */
+
+    bot::mapped_file m_file;                      /**< Mapped index */
+    std::uint64_t m_source_size        = 0;       /**< Bytes of the indexed history file */
+    std::size_t m_hands                = 0;       /**< Indexed hands */
+    std::size_t m_blocks               = 0;       /**< Blocks of the history file */
+    std::size_t m_users                = 0;       /**< Distinct players */
+    const std::uint64_t* m_times       = nullptr; /**< Unix time of every hand */
+    const std::uint64_t* m_pots        = nullptr; /**< Pot of every hand */
+    const std::uint64_t* m_block_first = nullptr; /**< First hand of every block and amount of hands */
+    const std::uint64_t* m_user_ids    = nullptr; /**< Sorted ids of players */
+    const std::uint64_t* m_offsets     = nullptr; /**< Start of every player's postings and their end */
+    const std::uint32_t* m_postings    = nullptr; /**< Hands of every player, sorted */
+    const std::uint8_t* m_textures     = nullptr; /**< Board texture of every hand */
+};
+
+/**
+ * Computes texture bits of a board.
+ * @param board cards of the board, see card::code.
+ * */
+auto board_texture(const std::vector<std::uint8_t>& board) -> std::uint8_t;
+/**
+ * Parses comma separated names of texture bits, e.g. "paired,flush_possible".
+ * Throws invalid argument exception on an unknown name.
+ * @param names names of bits.
+ * */
+auto parse_texture(const std::string& names) -> std::uint8_t;
+/**
+ * Parses words like "user=42", "pot=100", "board=flush", "from=1700000000" or "to=1700086400" into a query.
+ * Throws invalid argument exception on an unknown key or a malformed value.
+ * @param words criteria, each one once at most.
+ * */
+auto parse_query(const std::vector<std::string>& words) -> hand_query;
+/**
+ * Returns path of the index of a history file.
+ * @param history path of a history file.
+ * */
+auto index_path(const std::string& history) -> std::string;
+/**
+ * Reads a history file and writes its index next to it, replacing an old one atomically,
+ * so indexes that are mapped stay valid.
+ * Throws runtime exception if the history file can't be read or the index can't be written.
+ * @param history path of a history file.
+ * @returns amount of indexed hands.
+ * */
+auto build_index(const std::string& history) -> std::size_t;
+/**
+ * Maps the index of a history file, builds it first if it's missing, stale or invalid.
+ * @param history path of a history file.
+ * @param built set to whether the index was built.
+ * */
+auto open_index(const std::string& history, bool& built) -> hand_index;
+/**
+ * Searches history files with their indexes, building the missing ones.
+ * Only blocks that have hands to return are read and decoded.
+ * @param files paths of history files.
+ * @param query filter of hands.
+ * @param limit most hands to return, all of them are counted.
+ * */
+auto search(const std::vector<std::string>& files, const hand_query& query, std::size_t limit) -> search_result;
+
+/**
+ * Runs searches of a history directory on its own thread, so reading files and building indexes
+ * doesn't hold up the thread that takes requests. Replies are taken back by that thread,
+ * in the order requests were submitted.
+ * */
+class searcher: public bot::logging_obj {
+public:
+    /**
+     * Finished search.
+     * */
+    struct reply {
+        std::int64_t chat_id = 0; /**< Chat that asked for it */
+        search_result result;     /**< Found hands, empty if the search failed */
+        bool failed = false;      /**< Whether the search threw, it's logged */
+    };
+
+    /**
+     * Constructor, starts the thread.
+     * @param dir directory of history files.
+     * @param limit most hands of a reply.
+     * @param queue most searches waiting to run.
+     * */
+    searcher(std::string dir, std::size_t limit, std::size_t queue = 4);
+    /**
+     * Destructor, drops waiting searches, waits for the running one and joins the thread.
+     * */
+    ~searcher();
+    searcher(const searcher&) = delete;
+    searcher& operator=(const searcher&) = delete;
+
+    /**
+     * Queues a search.
+     * @param chat_id chat to reply to.
+     * @param query filter of hands.
+     * @returns false if too many searches are waiting, the search is dropped then.
+     * */
+    auto submit(std::int64_t chat_id, hand_query query) -> bool;
+    /**
+     * Returns searches finished since the last call.
+     * */
+    auto take_replies() -> std::vector<reply>;
+    /**
+     * Returns amount of submitted searches whose replies weren't taken yet.
+     * */
+    auto pending() const -> std::size_t { return m_pending.load(std::memory_order_relaxed); }
+
+protected:
+    /**
+     * Search waiting to run.
+     * */
+    struct request {
+        std::int64_t chat_id; /**< Chat to reply to */
+        hand_query query;     /**< Filter of hands */
+    };
+
+    std::string m_dir;                  /**< Directory of history files */
+    std::size_t m_limit;                /**< Most hands of a reply */
+    std::size_t m_queue_size;           /**< Most waiting searches */
+    std::mutex m_mutex;                 /**< Guards requests, replies and the stop flag */
+    std::condition_variable m_cv;       /**< Wakes the thread up on a request or stop */
+    std::deque<request> m_requests;     /**< Waiting searches */
+    std::vector<reply> m_replies;       /**< Finished searches */
+    bool m_stop = false;                /**< Flag to finish the thread */
+    std::atomic<std::size_t> m_pending; /**< Submitted searches whose replies weren't taken */
+    std::thread m_thread;               /**< Searching thread */
+
+    void p_run();
+};
+
+hand_index::hand_index(const std::string& path): m_file(path) {
+    auto* data = m_file.data();
+    auto size  = m_file.size();
+    auto fail  = [&](const char* what) {
+        return std::runtime_error(fmt::format("hand_history::hand_index {} is not a valid index: {}", path, what));
+    };
+    if(size < header_size) {
+        throw fail("short header");
+    }
+    bot::snapshot::decoder dec(data, header_size);
+    if(std::memcmp(data, index_magic, sizeof(index_magic)) != 0) {
+        throw fail("wrong magic");
+    }
+    dec.sub(sizeof(index_magic));
+    if(dec.get<std::uint32_t>() != index_version || dec.get<std::uint32_t>() != 0x01020304) {
+        throw fail("wrong version");
+    }
+    m_source_size = dec.get<std::uint64_t>();
+    m_hands       = dec.get<std::uint64_t>();
+    m_blocks      = dec.get<std::uint64_t>();
+    m_users       = dec.get<std::uint64_t>();
+    auto postings = dec.get<std::uint64_t>();
+    if(m_hands > std::numeric_limits<std::uint32_t>::max() || m_blocks > size || m_users > size || postings > size) {
+        throw fail("wrong size");
+    }
+    auto padded   = (postings * sizeof(std::uint32_t) + 7) / 8 * 8;
+    auto expected = header_size + (m_hands * 2 + m_blocks + 1 + m_users * 2 + 1) * sizeof(std::uint64_t) + padded +
+                    m_hands;
+    if(expected != size) {
+        throw fail("wrong size");
+    }
+    auto column = [&, offset = header_size](std::size_t bytes) mutable {
+        auto* result = data + offset;
+        offset += bytes;
+        return result;
+    };
+    //mapping is page aligned and every 8 byte column starts at a multiple of 8
+    m_times       = reinterpret_cast<const std::uint64_t*>(column(m_hands * 8));
+    m_pots        = reinterpret_cast<const std::uint64_t*>(column(m_hands * 8));
+    m_block_first = reinterpret_cast<const std::uint64_t*>(column((m_blocks + 1) * 8));
+    m_user_ids    = reinterpret_cast<const std::uint64_t*>(column(m_users * 8));
+    m_offsets     = reinterpret_cast<const std::uint64_t*>(column((m_users + 1) * 8));
+    m_postings    = reinterpret_cast<const std::uint32_t*>(column(padded));
+    m_textures    = reinterpret_cast<const std::uint8_t*>(column(m_hands));
+    //queries index hands by these columns without checks, so a corrupt file must not get past here
+    auto sorted = [](const std::uint64_t* first, std::size_t count, auto less) {
+        return std::adjacent_find(first, first + count, [&](auto a, auto b) { return !less(a, b); }) == first + count;
+    };
+    auto consistent =
+        m_block_first[0] == 0 && m_block_first[m_blocks] == m_hands && m_offsets[0] == 0 &&
+        m_offsets[m_users] == postings && sorted(m_block_first, m_blocks + 1, std::less_equal<>()) &&
+        sorted(m_user_ids, m_users, std::less<>()) && sorted(m_offsets, m_users + 1, std::less_equal<>()) &&
+        std::all_of(m_postings, m_postings + postings, [&](std::uint32_t hand) { return hand < m_hands; });
+    if(!consistent) {
+        throw fail("inconsistent columns");
+    }
+}
+
+auto hand_index::match(const hand_query& query) const -> std::vector<std::uint32_t> {
+    std::vector<std::uint32_t> result;
+    std::vector<std::uint64_t> bits((m_hands + 63) / 64, 0);
+    if(query.user) {
+        auto* end = m_user_ids + m_users;
+        auto* it  = std::lower_bound(m_user_ids, end, *query.user);
+        if(it == end || *it != *query.user) {
+            return result;
+        }
+        auto u = static_cast<std::size_t>(it - m_user_ids);
+        for(auto p = m_offsets[u]; p < m_offsets[u + 1]; p++) {
+            bits[m_postings[p] / 64] |= std::uint64_t {1} << (m_postings[p] % 64);
+        }
+    } else {
+        std::fill(bits.begin(), bits.end(), ~std::uint64_t {0});
+        if(m_hands % 64) {
+            bits.back() = (std::uint64_t {1} << (m_hands % 64)) - 1;
+        }
+    }
+    auto columns = query.has_columns();
+    for(std::size_t w = 0; w < bits.size(); w++) {
+        if(!bits[w]) {
+            continue;
+        }
+        if(columns) {
+            std::uint64_t word = 0;
+            auto first         = w * 64;
+            auto count         = std::min<std::size_t>(64, m_hands - first);
+            for(std::size_t i = 0; i < count; i++) {
+                auto h     = first + i;
+                auto match = m_pots[h] >= query.min_pot && (m_textures[h] & query.board) == query.board &&
+                             m_times[h] >= query.from && m_times[h] <= query.to;
+                word |= static_cast<std::uint64_t>(match) << i;
+            }
+            bits[w] &= word;
+        }
+        for(auto word = bits[w]; word; word &= word - 1) {
+            result.emplace_back(static_cast<std::uint32_t>(w * 64 + __builtin_ctzll(word)));
+        }
+    }
+    return result;
+}
+
+auto hand_index::locate(std::uint32_t hand) const -> std::pair<std::size_t, std::size_t> {
+    auto* it    = std::upper_bound(m_block_first, m_block_first + m_blocks + 1, std::uint64_t {hand});
+    auto block  = static_cast<std::size_t>(it - m_block_first) - 1;
+    return {block, hand - m_block_first[block]};
+}
+
+auto board_texture(const std::vector<std::uint8_t>& board) -> std::uint8_t {
+    std::uint8_t ranks[13] {}, suits[4] {};
+    unsigned seen = 0;
+    for(auto c: board) {
+        auto rank = c % 13; //see card::code, 0 is a deuce and 12 is an ace
+        ranks[rank]++;
+        suits[c / 13 % 4]++;
+        seen |= 1u << rank;
+    }
+    std::uint8_t result = 0;
+    for(auto n: ranks) {
+        result |= n >= 2 ? texture::paired : 0;
+        result |= n >= 3 ? texture::trips : 0;
+    }
+    for(auto n: suits) {
+        result |= n >= 3 ? texture::flush_possible : 0;
+        result |= n >= 5 ? texture::flush : 0;
+    }
+    auto straights = seen << 1 | seen >> 12; //an ace plays below a deuce too
+    for(unsigned low = 0; low + 5 <= 14; low++) {
+        if(__builtin_popcount(straights >> low & 0x1F) >= 3) {
+            result |= texture::straight_possible;
+        }
+    }
+    result |= board.size() >= 5 ? texture::river : 0;
+    return result;
+}
+
+auto parse_texture(const std::string& names) -> std::uint8_t {
+    std::uint8_t result = 0;
+    std::size_t start   = 0;
+    while(start <= names.size()) {
+        auto end  = std::min(names.find(',', start), names.size());
+        auto name = names.substr(start, end - start);
+        auto it   = std::find_if(std::begin(texture::names), std::end(texture::names),
+                                 [&](auto& n) { return name == n.first; });
+        if(it == std::end(texture::names)) {
+            throw std::invalid_argument(fmt::format("unknown board texture \"{}\"", name));
+        }
+        result |= it->second;
+        start = end + 1;
+    }
+    return result;
+}
+
+auto parse_query(const std::vector<std::string>& words) -> hand_query {
+    hand_query result;
+    for(auto& word: words) {
+        auto eq = word.find('=');
+        if(eq == std::string::npos) {
+            throw std::invalid_argument(fmt::format("\"{}\" is not a key=value criterion", word));
+        }
+        auto key   = word.substr(0, eq);
+        auto value = word.substr(eq + 1);
+        auto num   = [&] {
+            auto digits = !value.empty() && value.size() <= 19 &&
+                          std::all_of(value.begin(), value.end(), [](char c) { return c >= '0' && c <= '9'; });
+            if(!digits) {
+                throw std::invalid_argument(fmt::format("{} has to be a number", key));
+            }
+            return static_cast<std::uint64_t>(std::stoull(value));
+        };
+        if(key == "user") {
+            result.user = num();
+        } else if(key == "pot") {
+            result.min_pot = num();
+        } else if(key == "board") {
+            result.board = parse_texture(value);
+        } else if(key == "from") {
+            result.from = num();
+        } else if(key == "to") {
+            result.to = num();
+        } else {
+            throw std::invalid_argument(fmt::format("unknown criterion {}, use user, pot, board, from or to", key));
+        }
+    }
+    return result;
+}
+
+auto index_path(const std::string& history) -> std::string {
+    return std::filesystem::path(history).replace_extension(index_extension).string();
+}
+
+auto build_index(const std::string& history) -> std::size_t {
+    reader r(history);
+    std::vector<std::uint64_t> times, pots, block_first;
+    std::vector<std::uint8_t> textures;
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> seats; //user and hand
+    std::uint64_t first = 0;
+    block_first.reserve(r.blocks().size() + 1);
+    for(auto& block: r.blocks()) {
+        block_first.emplace_back(first);
+        first += block.hands;
+    }
+    times.reserve(first);
+    pots.reserve(first);
+    textures.reserve(first);
+    r.for_each([&](const hand_record& hand) {
+        auto index = static_cast<std::uint32_t>(times.size());
+        times.emplace_back(hand.time);
+        pots.emplace_back(hand.pot());
+        textures.emplace_back(board_texture(hand.board));
+        for(auto& s: hand.seats) {
+            seats.emplace_back(s.user, index);
+        }
+    });
+    std::sort(seats.begin(), seats.end());
+    seats.erase(std::unique(seats.begin(), seats.end()), seats.end());
+    std::vector<std::uint64_t> users, offsets;
+    std::vector<std::uint32_t> postings;
+    postings.reserve(seats.size());
+    for(auto& [user, hand]: seats) {
+        if(users.empty() || users.back() != user) {
+            users.emplace_back(user);
+            offsets.emplace_back(postings.size());
+        }
+        postings.emplace_back(hand);
+    }
+    offsets.emplace_back(postings.size());
+    block_first.emplace_back(times.size());
+
+    bot::snapshot::encoder enc;
+    auto append = [&](auto& column) {
+        enc.data().append(reinterpret_cast<const char*>(column.data()), column.size() * sizeof(column[0]));
+    };
+    enc.data().reserve(128 + times.size() * 17 + block_first.size() * 8 + users.size() * 16 + postings.size() * 4);
+    enc.data().append(index_magic, sizeof(index_magic));
+    enc.put(index_version);
+    enc.put(std::uint32_t {0x01020304}); //byte order mark
+    enc.put(static_cast<std::uint64_t>(r.size()));
+    enc.put(static_cast<std::uint64_t>(times.size()));
+    enc.put(static_cast<std::uint64_t>(r.blocks().size()));
+    enc.put(static_cast<std::uint64_t>(users.size()));
+    enc.put(static_cast<std::uint64_t>(postings.size()));
+    enc.data().resize(64, '\0'); //reserved
+    append(times);
+    append(pots);
+    append(block_first);
+    append(users);
+    append(offsets);
+    append(postings);
+    enc.data().resize((enc.data().size() + 7) / 8 * 8, '\0');
+    append(textures);
+    bot::snapshot::write_file(index_path(history), enc.data());
+    return times.size();
+}
+
+auto open_index(const std::string& history, bool& built) -> hand_index {
+    auto path = index_path(history);
+    built     = false;
+    if(std::filesystem::exists(path)) {
+        try {
+            hand_index index(path);
+            if(index.source_size() == std::filesystem::file_size(history)) {
+                return index;
+            }
+        } catch(const std::runtime_error& e) {
+            get_logger().warn("hand_history::open_index rebuilding {}: {}", path, e.what());
+        }
+    }
+    build_index(history);
+    built = true;
+    return hand_index(path);
+}
+
+auto search(const std::vector<std::string>& files, const hand_query& query, std::size_t limit) -> search_result {
+    search_result result;
+    for(auto& file: files) {
+        auto built = false;
+        auto index = open_index(file, built);
+        auto hands = index.match(query);
+        result.files++;
+        result.indexed += built;
+        result.hands += index.hands();
+        result.matched += hands.size();
+        if(hands.empty() || result.found.size() >= limit) {
+            continue;
+        }
+        reader r(file, false);
+        std::size_t loaded = -1;
+        std::vector<hand_record> block;
+        for(auto h: hands) {
+            if(result.found.size() >= limit) {
+                break;
+            }
+            auto [b, pos] = index.locate(h);
+            if(b != loaded) {
+                block  = r.read_block(b);
+                loaded = b;
+            }
+            result.found.emplace_back(std::move(block.at(pos)));
+        }
+    }
+    return result;
+}
+
+searcher::searcher(std::string dir, std::size_t limit, std::size_t queue):
+    m_dir(std::move(dir)), m_limit(limit), m_queue_size(queue), m_pending(0), m_thread([this] { p_run(); }) { }
+
+searcher::~searcher() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_one();
+    m_thread.join();
+}
+
+auto searcher::submit(std::int64_t chat_id, hand_query query) -> bool {
+    {
+        std::lock_guard lock(m_mutex);
+        if(m_requests.size() >= m_queue_size) {
+            m_lgr.warn("hand_history::searcher {} searches are waiting, dropped one of chat {}", m_requests.size(),
+                       chat_id);
+            return false;
+        }
+        m_requests.push_back({chat_id, std::move(query)});
+        m_pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_cv.notify_one();
+    return true;
+}
+
+auto searcher::take_replies() -> std::vector<reply> {
+    std::vector<reply> result;
+    {
+        std::lock_guard lock(m_mutex);
+        result.swap(m_replies);
+    }
+    m_pending.fetch_sub(result.size(), std::memory_order_relaxed);
+    return result;
+}
+
+void searcher::p_run() {
+    std::unique_lock lock(m_mutex);
+    while(true) {
+        m_cv.wait(lock, [this] { return m_stop || !m_requests.empty(); });
+        if(m_stop) {
+            return;
+        }
+        auto req = std::move(m_requests.front());
+        m_requests.pop_front();
+        lock.unlock();
+
+        reply rep;
+        rep.chat_id = req.chat_id;
+        try {
+            rep.result = search(list_files(m_dir), req.query, m_limit);
+        } catch(const std::exception& e) {
+            m_lgr.error("hand_history::searcher search of chat {} failed: {}", req.chat_id, e.what());
+            rep.failed = true;
+        }
+
+        lock.lock();
+        m_replies.emplace_back(std::move(rep));
+    }
+}
+
+} // namespace hand_history
+} // namespace poker
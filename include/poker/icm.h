@@ -0,0 +1,161 @@
+#pragma once
+#include "games/game.h"
+#include "poker/player.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace poker {
+/**
+ * Independent Chip Model: a player finishes first with probability proportional to their stack,
+ * the next places are played out the same way among the rest. \n
+ * Equity is an expected payout of a player, in units of payouts.
+ * */
+namespace icm {
+
+constexpr std::size_t exact_limit = 18; /**< Most players equity computes exactly, 2^n doubles of memory */
+
+/**
+ * Computes equity exactly by dynamic programming over subsets of players that took top places,
+ * O(2^n * n) instead of enumerating n! finishing orders.
+ * Throws runtime exception if there are more than exact_limit players.
+ * @param stacks chips of every player, players with no chips take the last places.
+ * @param payouts payouts of places starting from the first, may be shorter or longer than stacks.
+ * @returns equity of every player.
+ * */
+auto exact(const std::vector<std::size_t>& stacks, const std::vector<double>& payouts) -> std::vector<double>;
+/**
+ * Estimates equity by sampling finishing orders until a time budget or a sample limit is spent. \n
+ * A sampled order is the order of exponential variables with stacks as rates, which has
+ * the model's distribution, so a sample is O(n) and needs no renormalization.
+ * @param stacks chips of every player.
+ * @param payouts payouts of places starting from the first.
+ * @param budget time to spend, at least one batch of samples is taken.
+ * @param gen generator of samples.
+ * @param max_samples samples to stop at before the budget is spent.
+ * @returns estimated equity of every player.
+ * */
+auto monte_carlo(const std::vector<std::size_t>& stacks, const std::vector<double>& payouts,
+                 std::chrono::nanoseconds budget, std::mt19937& gen, std::size_t max_samples = 1 << 22)
+    -> std::vector<double>;
+/**
+ * Computes equity exactly for up to exact_limit players and estimates it with monte_carlo otherwise.
+ * */
+auto equity(const std::vector<std::size_t>& stacks, const std::vector<double>& payouts,
+            std::chrono::nanoseconds budget, std::mt19937& gen) -> std::vector<double>;
+/**
+ * Returns stacks of poker players in seat order.
+ * @param players players of a game_poker.
+ * */
+auto stacks(const games::game::players_cont& players) -> std::vector<std::size_t>;
+
+auto exact(const std::vector<std::size_t>& stacks, const std::vector<double>& payouts) -> std::vector<double> {
+    auto n = stacks.size();
+    if(n > exact_limit) {
+        throw std::runtime_error("icm::exact " + std::to_string(n) + " players, limit is " +
+                                 std::to_string(exact_limit));
+    }
+    std::vector<double> result(n, 0);
+    auto places = std::min(n, payouts.size());
+    if(places == 0) {
+        return result;
+    }
+    std::size_t total = 0;
+    for(auto s: stacks) {
+        total += s;
+    }
+    //probability[mask]: players of the mask took the top popcount(mask) places in some order
+    std::vector<double> probability(std::size_t {1} << n, 0);
+    std::vector<std::size_t> placed_chips(std::size_t {1} << n, 0);
+    probability[0] = 1;
+    for(std::size_t mask = 0; mask < probability.size(); mask++) {
+        auto p = probability[mask];
+        if(p == 0) {
+            continue;
+        }
+        auto place = static_cast<std::size_t>(__builtin_popcountll(mask));
+        if(place >= places) {
+            continue; //nothing is paid further
+        }
+        auto left = total - placed_chips[mask];
+        auto rest = n - place;
+        for(std::size_t j = 0; j < n; j++) {
+            auto bit = std::size_t {1} << j;
+            if(mask & bit) {
+                continue;
+            }
+            //players with no chips take the last places in random order
+            auto next = left ? p * stacks[j] / left : p / rest;
+            if(next == 0) {
+                continue;
+            }
+            result[j] += next * payouts[place];
+            probability[mask | bit] += next;
+            placed_chips[mask | bit] = placed_chips[mask] + stacks[j];
+        }
+    }
+    return result;
+}
+
+auto monte_carlo(const std::vector<std::size_t>& stacks, const std::vector<double>& payouts,
+                 std::chrono::nanoseconds budget, std::mt19937& gen, std::size_t max_samples)
+    -> std::vector<double> {
+    using clock = std::chrono::steady_clock;
+    constexpr std::size_t batch = 32; //samples between checks of the clock
+    auto n      = stacks.size();
+    auto places = std::min(n, payouts.size());
+    std::vector<double> result(n, 0);
+    if(places == 0) {
+        return result;
+    }
+    std::exponential_distribution<double> exp(1);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::vector<std::pair<double, std::size_t>> keys(n);
+    const auto last     = std::numeric_limits<double>::max() / 2;
+    auto deadline       = clock::now() + budget;
+    std::size_t samples = 0;
+    do {
+        for(std::size_t b = 0; b < batch; b++) {
+            for(std::size_t j = 0; j < n; j++) {
+                //players with no chips go after everyone else, in random order
+                auto key = stacks[j] ? exp(gen) / stacks[j] : last * (1 + uniform(gen));
+                keys[j]  = {key, j};
+            }
+            std::partial_sort(keys.begin(), keys.begin() + places, keys.end());
+            for(std::size_t place = 0; place < places; place++) {
+                result[keys[place].second] += payouts[place];
+            }
+        }
+        samples += batch;
+    } while(samples < max_samples && clock::now() < deadline);
+    for(auto& r: result) {
+        r /= samples;
+    }
+    return result;
+}
+
+auto equity(const std::vector<std::size_t>& stacks, const std::vector<double>& payouts,
+            std::chrono::nanoseconds budget, std::mt19937& gen) -> std::vector<double> {
+    if(stacks.size() <= exact_limit) {
+        return exact(stacks, payouts);
+    }
+    return monte_carlo(stacks, payouts, budget, gen);
+}
+
+auto stacks(const games::game::players_cont& players) -> std::vector<std::size_t> {
+    std::vector<std::size_t> result;
+    result.reserve(players.size());
+    for(auto& pl: players) {
+        result.emplace_back(bot::utils::stat_cast<player_poker>(pl)->bank().coins().size());
+    }
+    return result;
+}
+
+} // namespace icm
+} // namespace poker
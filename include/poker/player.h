@@ -7,18 +7,34 @@
 #include "poker/card.h"
 
 #include <memory>
+#include <memory_resource>
 
 namespace poker {
 
 class player_poker: public games::player {
 public:
-    using cards_t  = std::vector<class card>;
+    using cards_t  = std::pmr::vector<class card>;
     using coin_ptr = std::unique_ptr<struct coin>;
 
-    player_poker(bot::user_ptr user);
-
+    /**
+     * Constructor.
+     * @param user bot's user pointer.
+     * @param resource memory resource for hand-scoped data, owned by the game.
+     * */
+    player_poker(bot::user_ptr user, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    /**
+     * Drops cards and their memory, doesn't allocate.
+     * Has to be called before the memory resource is released.
+     * */
     void clear_cards();
     void add_card(card&& c);
+    /**
+     * Bytes occupied by the player and their bank.
+     * Cards are not included, they are accounted by the owner of the memory resource.
+     * @returns size in bytes
+     * */
+    auto memory_usage() const -> std::size_t override;
 
     bot::property<cards_t> cards;
     bot::property<class bank> bank;
@@ -26,12 +42,17 @@ public:
 protected:
 };
 
-player_poker::player_poker(bot::user_ptr user): games::player(user), bank(0) { }
+player_poker::player_poker(bot::user_ptr user, std::pmr::memory_resource* resource):
+    games::player(user, resource), cards(resource), bank(0) { }
 
 void player_poker::clear_cards() {
-    this->cards().clear();
+    this->cards() = cards_t(resource);
 }
 void player_poker::add_card(card&& c) {
     this->cards().emplace_back(std::move(c));
 }
+auto player_poker::memory_usage() const -> std::size_t {
+    return games::player::memory_usage() + sizeof(player_poker) - sizeof(games::player) + bank().memory_usage() -
+           sizeof(class bank);
+}
 }; // namespace poker
\ No newline at end of file
@@ -0,0 +1,118 @@
+#pragma once
+#include "poker/card.h"
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace poker {
+
+/* ------------------------------------------------------------------------------------------------- */
+// Produce a string whose lexicographic rank order reflects the ranking of the hand in poker.
+// Examples:  "41000-63"     ;four of a kind (6s), the odd card is a 3
+//            "22100-928"    ;two pair (9s and 2s), the odd card is an 8
+//            "32000-da"     ;full house with three kings and two 10s
+//            "312ST-ba987"  ;jack-high straight
+// Hex digits (abcde) are used instead of TJQKA to get the lexicographic order right.
+// Credit: geoffp at codewars
+std::string ranking_string(const std::vector<card>& cards) {
+    unsigned c, r;
+
+    // Count the number of occurrences of each rank:
+    std::vector<unsigned> rc(15, 0);
+    for(r = 2; r <= 14; r++) {
+        for(auto& c: cards) {
+            if(c.value == r) {
+                ++rc[r];
+            }
+        }
+    }
+
+    // In an ace-low straight (but not in any other situation), an ace is considered to have rank 1:
+    if(rc[2] == 1 && rc[3] == 1 && rc[4] == 1 && rc[5] == 1 && rc[14] == 1) {
+        rc[1]  = 1;
+        rc[14] = 0;
+    }
+
+    // Check for a straight:
+    bool straight = std::search_n(rc.begin(), rc.end(), 5, 1) != rc.end();
+
+    // Check for a flush:
+    auto flush_pred = [&cards](auto c) { return c.kind == cards.front().kind; };
+    bool flush      = std::all_of(cards.begin(), cards.end(), flush_pred);
+
+    // Form the second (tie-breaking) part of the ranking string:
+    std::string tiebreak;
+    tiebreak.reserve(5 + 5 + 1);
+    {
+        std::ostringstream tiebreak_;
+        std::ostringstream kinds_;
+        for(c = 4; c > 0; c--) {
+            for(r = 14; r >= 1; r--) {
+                if(rc[r] == c) {
+                    tiebreak_ << std::hex << r;
+                    for(auto& card: cards) {
+                        if(card.value == r || (r == 1 && card.value == 14)) {
+                            kinds_ << card.kind.name.front();
+                        }
+                    }
+                }
+            }
+        }
+        tiebreak = tiebreak_.str();
+        tiebreak += "-";
+        tiebreak += kinds_.str();
+    }
+
+    // Form the first (hand type) part of the ranking string:
+    std::string s;
+    if(straight) {
+        s = flush ? "5STFL" : "312ST";
+    } else if(flush) {
+        s = "313FL";
+    } else {
+        std::sort(rc.begin(), rc.end());
+        for(r = 14; r > 9; r--) s += ('0' + rc[r]);
+    }
+
+    return s + "-" + tiebreak;
+}
+
+/**
+ * Ranks the best 5-card hand that can be made of player's cards and the table.
+ * @param hand player's cards.
+ * @param table cards on the table.
+ * @returns ranking string without suits, greater string is a stronger hand, equal strings split the pot.
+ * */
+template<class Hand, class Table>
+std::string best_ranking(const Hand& hand, const Table& table) {
+    std::vector<card> all(hand.begin(), hand.end());
+    all.insert(all.end(), table.begin(), table.end());
+    auto strip = [](std::string rank) { return rank.substr(0, rank.find_last_of('-')); };
+    if(all.size() <= 5) {
+        return strip(ranking_string(all));
+    }
+
+    std::string best;
+    std::vector<card> five;
+    five.reserve(5);
+    for(unsigned mask = 0; mask < (1u << all.size()); mask++) {
+        if(__builtin_popcount(mask) != 5) {
+            continue;
+        }
+        five.clear();
+        for(unsigned i = 0; i < all.size(); i++) {
+            if(mask & (1u << i)) {
+                five.emplace_back(all[i]);
+            }
+        }
+        auto rank = strip(ranking_string(five));
+        if(rank > best) {
+            best = std::move(rank);
+        }
+    }
+    return best;
+}
+
+}; // namespace poker
\ No newline at end of file
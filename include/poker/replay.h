@@ -0,0 +1,224 @@
+#pragma once
+#include "core/logging_obj.h"
+#include "core/registry.h"
+#include "core/user.h"
+#include "poker/game.h"
+#include "poker/hand_history.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace poker {
+namespace hand_history {
+
+/**
+ * Outcome of a replay.
+ * */
+struct replay_result {
+    std::size_t applied = 0; /**< Recorded actions the engine went through, blinds included */
+    std::string divergence;  /**< What the engine did differently from the record, empty if nothing */
+
+    auto ok() const -> bool { return divergence.empty(); }
+};
+
+/**
+ * Re-runs recorded hands through game_poker to reconstruct them action by action. \n
+ * A replayed game is seated like the record, gets the recorded stacks and the seed of the hand's shuffle,
+ * then recorded actions are applied one by one, a leave through game_poker::handle_exit. The engine records the replayed hand itself,
+ * so after every action its record is compared with the log and the first difference is reported:
+ * that's how a log of an older engine is checked against the current one. \n
+ * Entities of replayed users live in registries of the calling thread, so a replayer is used on one thread.
+ * */
+class replayer: public bot::logging_obj {
+public:
+    replayer() = default;
+    /**
+     * Destructor, destroys the replayed game and its users.
+     * */
+    ~replayer();
+    replayer(const replayer&) = delete;
+    replayer& operator=(const replayer&) = delete;
+
+    /**
+     * Replays a hand up to an action.
+     * @param hand recorded hand, must have a seed.
+     * @param actions amount of recorded actions to apply, all of them by default.
+     * Blinds are always applied, they're taken by game_poker::init_game.
+     * When every action is applied the outcome of the hand is compared with the record too.
+     * @returns applied actions and the first divergence.
+     * */
+    auto replay(const hand_record& hand, std::size_t actions = -1) -> replay_result;
+    /**
+     * Returns the game as it is after the last replay, nullptr before the first one.
+     * */
+    auto game() const -> const game_poker* { return m_game.get(); }
+    /**
+     * Renders the game after the last replay: pot, board, bets, stacks and hole cards of every seat.
+     * */
+    auto render() const -> std::string;
+
+protected:
+    /**
+     * Gives the replayer access to the game's seating.
+     * */
+    class engine: public game_poker {
+    public:
+        using game_poker::game_poker;
+        friend class replayer;
+    };
+
+    std::unique_ptr<engine> m_game;     /**< Replayed game */
+    std::vector<bot::user_ptr> m_users; /**< Users of seats */
+
+    void p_reset();
+    auto p_player(const bot::user_ptr& user) const -> game_poker::player_ptr;
+    auto p_compare(const hand_record& hand, std::size_t count) const -> std::string;
+};
+
+replayer::~replayer() {
+    p_reset();
+}
+
+auto replayer::replay(const hand_record& hand, std::size_t actions) -> replay_result {
+    replay_result result;
+    p_reset();
+    if(!hand.seed) {
+        result.divergence = "the hand has no seed, it was recorded before 128-bit seeds were";
+        return result;
+    }
+    if(hand.seats.size() < 2) {
+        result.divergence = fmt::format("the hand has {} seats", hand.seats.size());
+        return result;
+    }
+    for(auto& s: hand.seats) {
+        auto& user  = m_users.emplace_back(bot::make_entity<bot::user>(s.user));
+        user->name() = std::to_string(s.user);
+    }
+    m_game = std::make_unique<engine>(m_users, hand.big_blind, 0);
+    for(std::size_t i = 0; i < hand.seats.size(); i++) {
+        m_game->p_poker(m_game->players()[i])->bank() = poker::bank(hand.seats[i].stack);
+    }
+    //big blind goes to players()[p_button], it's the first recorded action
+    auto button = !hand.actions.empty() && hand.actions[0].type == action_type::blind ? hand.actions[0].seat : 0;
+    m_game->p_button = button;
+    m_game->init_game(*hand.seed);
+
+    auto& replayed = m_game->hand();
+    if(replayed.actions.size() > hand.actions.size()) {
+        result.divergence = fmt::format("the engine took {} blinds, the hand has {} actions", replayed.actions.size(),
+                                        hand.actions.size());
+        return result;
+    }
+    if(auto diff = p_compare(hand, replayed.actions.size()); !diff.empty()) {
+        result.divergence = diff;
+        return result;
+    }
+    result.applied = replayed.actions.size();
+    for(auto i = result.applied; i < std::min(hand.actions.size(), actions); i++) {
+        auto& a  = hand.actions[i];
+        auto cur = m_game->current_player();
+        if(!cur) {
+            result.divergence = fmt::format("action {}: the hand is over already", i);
+            return result;
+        }
+        if(a.type == action_type::leave) { //a player may leave out of turn
+            auto pl = a.seat < m_users.size() ? p_player(m_users[a.seat]) : nullptr;
+            if(!pl) {
+                result.divergence = fmt::format("action {}: seat {} isn't in the game", i, a.seat);
+                return result;
+            }
+            m_game->handle_exit(pl);
+        } else if(a.seat >= m_users.size() || cur->user() != m_users[a.seat]) {
+            result.divergence = fmt::format("action {}: seat {} acts instead of {}", i,
+                                            bot::utils::index(m_users, cur->user()), a.seat);
+            return result;
+        } else if(a.type == action_type::fold) {
+            m_game->handle_fold(m_users[a.seat]);
+        } else {
+            m_game->handle_bet(m_users[a.seat], a.amount);
+        }
+        if(auto diff = p_compare(hand, i + 1); !diff.empty()) {
+            result.divergence = diff;
+            return result;
+        }
+        result.applied = i + 1;
+    }
+    if(result.applied < hand.actions.size()) {
+        return result;
+    }
+    if(m_game->current_player()) {
+        result.divergence = "the hand isn't over after the last action";
+        return result;
+    }
+    if(replayed.board != hand.board) {
+        result.divergence = "board differs";
+    }
+    for(std::size_t i = 0; i < hand.seats.size() && result.ok(); i++) {
+        auto& s = replayed.seats[i];
+        auto& r = hand.seats[i];
+        if(s.cards != r.cards) {
+            result.divergence = fmt::format("seat {}: hand {} {} instead of {} {}", i, card_name(s.cards[0]),
+                                            card_name(s.cards[1]), card_name(r.cards[0]), card_name(r.cards[1]));
+        } else if(s.won != r.won) {
+            result.divergence = fmt::format("seat {}: won {} instead of {}", i, s.won, r.won);
+        }
+    }
+    return result;
+}
+
+auto replayer::render() const -> std::string {
+    if(!m_game) {
+        return {};
+    }
+    auto result = std::string(m_game->p_render_game_state());
+    for(std::size_t i = 0; i < m_users.size(); i++) {
+        auto pl = p_player(m_users[i]);
+        if(!pl) {
+            fmt::format_to(std::back_inserter(result), "\nseat {} user:{} left", i, m_users[i]->id());
+            continue;
+        }
+        auto& p    = *m_game->p_poker(pl);
+        auto cards = p.cards().size() == 2 ?
+                         fmt::format("{} {}", card_name(p.cards()[0].code()), card_name(p.cards()[1].code())) :
+                         std::string("-");
+        fmt::format_to(std::back_inserter(result), "\nseat {} user:{} stack:{} hand:{}{}", i, m_users[i]->id(),
+                       p.bank().coins().size(), cards, pl == m_game->current_player() ? " to act" : "");
+    }
+    return result;
+}
+
+void replayer::p_reset() {
+    m_game.reset(); //destroys players before their users
+    for(auto& user: m_users) {
+        bot::destroy_entity(user);
+    }
+    m_users.clear();
+}
+
+auto replayer::p_player(const bot::user_ptr& user) const -> game_poker::player_ptr {
+    auto& players = m_game->players();
+    auto it       = std::find_if(players.begin(), players.end(), [&](auto& pl) { return pl->user() == user; });
+    return it == players.end() ? nullptr : *it;
+}
+
+auto replayer::p_compare(const hand_record& hand, std::size_t count) const -> std::string {
+    auto& replayed = m_game->hand();
+    if(replayed.actions.size() != count) {
+        return fmt::format("action {}: the engine recorded {} actions instead of {}", count ? count - 1 : 0,
+                           replayed.actions.size(), count);
+    }
+    for(std::size_t i = 0; i < count; i++) {
+        auto& a = replayed.actions[i];
+        auto& r = hand.actions[i];
+        if(a.seat != r.seat || a.type != r.type || a.amount != r.amount) {
+            return fmt::format("action {}: seat {} type {} amount {} instead of seat {} type {} amount {}", i, a.seat,
+                               static_cast<int>(a.type), a.amount, r.seat, static_cast<int>(r.type), r.amount);
+        }
+    }
+    return {};
+}
+
+} // namespace hand_history
+} // namespace poker
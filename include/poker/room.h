@@ -2,22 +2,35 @@
 #include "games/room.h"
 #include "poker/bank.h"
 #include "poker/game.h"
+
+#include <optional>
+#include <random>
 namespace poker {
 
 class game_poker_room: public games::game_room {
 public:
     game_poker_room(id_t id);
 
+    bot::property<std::optional<std::mt19937::result_type>> seed; /**< Deck seed of started games, random if empty */
+
     void start_game();
+    auto memory_usage() const -> std::size_t override;
 };
 
 game_poker_room::game_poker_room(id_t id): games::game_room(id) { }
 
+auto game_poker_room::memory_usage() const -> std::size_t {
+    return games::game_room::memory_usage() + sizeof(game_poker_room) - sizeof(games::game_room);
+}
+
 void game_poker_room::start_game() {
     auto& user_ptrs_vec = this->users();
     auto min_bet        = 10;
     auto poker          = new game_poker(user_ptrs_vec, min_bet);
     this->game()        = std::unique_ptr<poker::game_poker>(poker);
+    if(seed()) {
+        poker->cards().seed(*seed());
+    }
     poker->init_game();
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 #include "core/server.h"
 #include "core/utils.h"
+#include "poker/room.h"
 
 #include <memory>
 #include <vector>
@@ -9,26 +10,96 @@ namespace poker {
 using namespace bot;
 
 class poker_server: public server {
+protected:
+    auto p_make_room(id_t id) -> room_ptr override;
+    /**
+     * Saves room's poker game: ids of players in seat order and the game itself, see game_poker::save.
+     * */
+    auto p_save_game(const room_ptr& room) const -> std::string override;
+    /**
+     * Creates poker game with saved players and restores it, a hand in process goes on from where it was.
+     * */
+    void p_load_game(const room_ptr& room, const std::string& data) override;
+    void p_drop_game(const room_ptr& room) override;
+
 public:
     poker_server();
     room_ptr create_room(user_ptr user) override;
+    auto memory_usage() const -> memory_stats override;
 };
 
 poker_server::poker_server(): server() { }
 
 room_ptr poker_server::create_room(user_ptr user) {
-    auto prefix = fmt::format("poker_server::create_room user:{}", user->log_desc());
+    auto prefix = bot::lazy([&] { return fmt::format("poker_server::create_room user:{}", user->log_desc()); });
     lobby()->del_user(user);
 
-    auto room     = std::make_shared<class poker::game_poker_room>(p_get_room_id());
+    auto room     = make_entity<bot::room, poker::game_poker_room>(p_get_room_id());
     room->token() = token_generator::gen();
     room->add_user(user);
     room->owner()        = user;
     user->current_room() = room;
     rooms().emplace_back(room);
+    m_rooms_gauge.add();
 
     m_lgr.info("{} created room {}", prefix, room->log_desc());
     return room;
 }
 
+auto poker_server::p_make_room(id_t id) -> room_ptr {
+    return make_entity<bot::room, poker::game_poker_room>(id);
+}
+
+auto poker_server::p_save_game(const room_ptr& room) const -> std::string {
+    auto game_room = bot::utils::dyn_cast<games::game_room>(room);
+    if(!game_room || !game_room->game()) {
+        return {};
+    }
+    auto poker = dynamic_cast<const game_poker*>(game_room->game().get());
+    if(!poker) {
+        return {};
+    }
+    std::vector<std::uint64_t> ids;
+    for(auto& pl: poker->players()) {
+        ids.emplace_back(pl->user()->id());
+    }
+    snapshot::encoder enc;
+    enc.put_vec(ids);
+    poker->save(enc);
+    return std::move(enc.data());
+}
+
+void poker_server::p_load_game(const room_ptr& room, const std::string& data) {
+    snapshot::decoder dec(data.data(), data.size());
+    auto ids = dec.get_vec<std::uint64_t>();
+    std::vector<user_ptr> users;
+    for(auto id: ids) {
+        auto user = get_user(id);
+        if(!user) {
+            throw std::runtime_error(fmt::format("poker_server::p_load_game unknown player {}", id));
+        }
+        users.emplace_back(user);
+    }
+    auto poker = std::make_unique<game_poker>(users, 0);
+    poker->load(dec);
+    bot::utils::stat_cast<poker::game_poker_room>(room)->game() = std::move(poker);
+}
+
+void poker_server::p_drop_game(const room_ptr& room) {
+    bot::utils::stat_cast<poker::game_poker_room>(room)->game().reset();
+}
+
+auto poker_server::memory_usage() const -> memory_stats {
+    auto result = server::memory_usage();
+    std::vector<std::size_t> sizes;
+    for(auto& room: rooms()) {
+        auto game_room = bot::utils::dyn_cast<games::game_room>(room);
+        if(game_room && game_room->game()) {
+            sizes.emplace_back(game_room->game()->memory_usage());
+        }
+    }
+    result.games = memory_group::of(std::move(sizes));
+    return result;
+}
+
 }; // namespace poker
\ No newline at end of file
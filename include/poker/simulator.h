@@ -0,0 +1,532 @@
+#pragma once
+#include "core/lazy_utils.h"
+#include "core/registry.h"
+#include "core/user.h"
+#include "poker/deck.h"
+#include "poker/game.h"
+#include "poker/hand_history.h"
+#include "poker/ranking.h"
+#include "poker/room.h"
+#include "poker/tournament.h"
+
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace poker {
+namespace sim {
+
+/**
+ * What a strategy knows when it's its turn.
+ * */
+struct view {
+    const player_poker& self;            /**< Acting player */
+    const std::pmr::vector<card>& table; /**< Cards on the table */
+    std::size_t to_call;                 /**< Coins to bet to stay in the hand */
+    std::size_t stack;                   /**< Coins of the acting player */
+    std::size_t pot;                     /**< Coins in the game's bank */
+    std::size_t big_blind;               /**< Size of the big blind */
+    std::size_t opponents;               /**< Players in the hand besides the acting one */
+};
+
+/**
+ * Decision of a strategy.
+ * */
+struct action {
+    enum class type { fold, bet };
+    enum type type;   /**< Fold or bet, bet of 0 is a check */
+    std::size_t size; /**< Size of a bet */
+};
+
+/**
+ * Scripted player's behaviour.
+ * */
+class strategy {
+public:
+    virtual ~strategy() = default;
+    /**
+     * Decides what to do.
+     * @param v state of the hand.
+     * @param gen generator of the table, the only source of randomness to keep runs reproducible.
+     * */
+    virtual auto decide(const view& v, std::mt19937& gen) -> action = 0;
+    virtual auto name() const -> const char* = 0;
+};
+
+/**
+ * Calls every bet it can afford, folds otherwise.
+ * */
+class always_call: public strategy {
+public:
+    auto decide(const view& v, std::mt19937&) -> action override {
+        if(v.to_call > v.stack) {
+            return {action::type::fold, 0};
+        }
+        return {action::type::bet, v.to_call};
+    }
+    auto name() const -> const char* override { return "call"; }
+};
+
+/**
+ * Folds, calls or raises at random.
+ * */
+class random_play: public strategy {
+public:
+    auto decide(const view& v, std::mt19937& gen) -> action override {
+        auto roll = std::uniform_int_distribution<int>(0, 99)(gen);
+        if(v.to_call > v.stack || (v.to_call > 0 && roll < 15)) {
+            return {action::type::fold, 0};
+        }
+        auto raise = v.big_blind * std::uniform_int_distribution<std::size_t>(1, 3)(gen);
+        if(roll >= 80 && v.to_call + raise <= v.stack) {
+            return {action::type::bet, v.to_call + raise};
+        }
+        return {action::type::bet, v.to_call};
+    }
+    auto name() const -> const char* override { return "random"; }
+};
+
+/**
+ * Estimates equity by Monte Carlo against random hands and continues only above a threshold.
+ * */
+class equity_threshold: public strategy {
+public:
+    /**
+     * Constructor.
+     * @param threshold minimal equity to call.
+     * @param samples Monte Carlo samples per decision.
+     * */
+    equity_threshold(double threshold = 0.5, std::size_t samples = 8): m_threshold(threshold), m_samples(samples) { }
+
+    auto decide(const view& v, std::mt19937& gen) -> action override {
+        if(v.to_call == 0) {
+            return {action::type::bet, 0};
+        }
+        if(v.to_call > v.stack || p_equity(v, gen) < m_threshold) {
+            return {action::type::fold, 0};
+        }
+        return {action::type::bet, v.to_call};
+    }
+    auto name() const -> const char* override { return "equity"; }
+
+protected:
+    double m_threshold;    /**< Minimal equity to call */
+    std::size_t m_samples; /**< Samples per decision */
+    deck m_deck;           /**< Scratch deck */
+
+    /**
+     * Equity against one random hand, raised to the power of opponents count.
+     * */
+    auto p_equity(const view& v, std::mt19937& gen) -> double {
+        auto& hand  = v.self.cards();
+        auto known  = [&](const card& c) { return bot::utils::contains(hand, c) || bot::utils::contains(v.table, c); };
+        double wins = 0;
+        for(std::size_t s = 0; s < m_samples; s++) {
+            m_deck.refill();
+            auto& cards = m_deck.get_cards();
+            cards.erase(std::remove_if(cards.begin(), cards.end(), known), cards.end());
+            std::shuffle(cards.begin(), cards.end(), gen);
+
+            std::vector<card> table(v.table.begin(), v.table.end());
+            std::vector<card> opponent {cards[0], cards[1]};
+            for(std::size_t i = 2; table.size() < 5; i++) {
+                table.emplace_back(cards[i]);
+            }
+            auto own = best_ranking(hand, table), other = best_ranking(opponent, table);
+            wins += own > other ? 1 : own == other ? 0.5 : 0;
+        }
+        return std::pow(wins / m_samples, std::max<std::size_t>(v.opponents, 1));
+    }
+};
+
+/**
+ * Creates strategy by name: call, random or equity.
+ * Throws exception on unknown name.
+ * */
+auto make_strategy(const std::string& name) -> std::unique_ptr<strategy> {
+    if(name == "call") {
+        return std::make_unique<always_call>();
+    } else if(name == "random") {
+        return std::make_unique<random_play>();
+    } else if(name == "equity") {
+        return std::make_unique<equity_threshold>();
+    }
+    throw std::runtime_error("unknown strategy: " + name);
+}
+
+/**
+ * Asks a strategy what the current player of a game does.
+ * @param game game with a hand in process.
+ * @param s strategy of the current player.
+ * @param gen generator of the table.
+ * */
+auto decide(game_poker& game, strategy& s, std::mt19937& gen) -> action {
+    auto cur   = game.current_player();
+    auto pl    = bot::utils::stat_cast<player_poker>(cur);
+    auto stack = pl->bank().coins().size(), pot = game.bank().coins().size();
+    view v {*pl, game.table(), game.to_call(cur), stack, pot, game.blind(), game.in_hand() - 1};
+    return s.decide(v, gen);
+}
+
+/**
+ * Makes the current player of a game act, folds if the game refuses a bet.
+ * @param game game with a hand in process.
+ * @param act decision of the current player.
+ * @returns true if the bet was refused.
+ * */
+auto apply(game_poker& game, const action& act) -> bool {
+    auto cur      = game.current_player();
+    bool rejected = false;
+    if(act.type == action::type::bet) {
+        auto recorded = game.hand().actions.size(); //the game records every bet it takes, a refused one isn't
+        game.handle_bet(cur->user(), act.size);
+        rejected = game.hand().actions.size() == recorded;
+    }
+    if(act.type == action::type::fold || rejected) {
+        game.handle_fold(cur->user());
+    }
+    return rejected;
+}
+
+/**
+ * Counter of global allocations made by the calling thread. \n
+ * Set by a driver that replaces operator new, then tables count allocations of betting actions.
+ * */
+inline std::size_t (*allocations)() = nullptr;
+
+/**
+ * Counters of a simulation.
+ * */
+struct stats {
+    std::size_t hands         = 0; /**< Finished hands */
+    std::size_t actions       = 0; /**< handle_bet and handle_fold calls */
+    std::size_t rejected      = 0; /**< Actions the game refused, followed by a fold */
+    std::size_t messages      = 0; /**< Discarded player::send messages */
+    std::size_t restarts      = 0; /**< Games restarted because someone ran out of coins */
+    std::size_t violations    = 0; /**< Chip conservation or liveness violations */
+    std::size_t steady        = 0; /**< Betting actions that didn't end a hand, first hand of a game excluded */
+    std::size_t steady_allocs = 0; /**< Global allocations made by steady actions, see sim::allocations */
+    std::size_t memory        = 0; /**< Bytes occupied by rooms with their games, see table::get_stats */
+    std::size_t tournaments   = 0; /**< Finished tournaments, see tournament_run */
+    std::size_t moves         = 0; /**< Players moved between tournament tables */
+    std::size_t broken        = 0; /**< Broken tournament tables */
+    std::size_t spread        = 0; /**< Largest difference of tournament tables' sizes seen after a round */
+
+    auto operator+=(const stats& rhs) -> stats& {
+        hands += rhs.hands;
+        actions += rhs.actions;
+        rejected += rhs.rejected;
+        messages += rhs.messages;
+        restarts += rhs.restarts;
+        violations += rhs.violations;
+        steady += rhs.steady;
+        steady_allocs += rhs.steady_allocs;
+        memory += rhs.memory;
+        tournaments += rhs.tournaments;
+        moves += rhs.moves;
+        broken += rhs.broken;
+        spread = std::max(spread, rhs.spread);
+        return *this;
+    }
+};
+
+/**
+ * Headless table: users with no transport, seated in a game_poker_room and driven through
+ * handle_bet/handle_fold by scripted strategies. \n
+ * Entities live in registries of the thread that created the table, so the table must be used
+ * and destroyed on that thread.
+ * */
+class table: public bot::logging_obj {
+public:
+    /**
+     * Constructor, seats users and starts the game.
+     * @param id id of the table, also used to make unique user ids.
+     * @param strategies strategy of each seat, their count is a count of seats.
+     * @param seed seed of the table's decks and strategies.
+     * */
+    table(std::size_t id, std::vector<std::unique_ptr<strategy>> strategies, std::uint32_t seed);
+    ~table();
+
+    /**
+     * Plays one hand to completion, starts it first if needed.
+     * */
+    void play_hand();
+    /**
+     * Returns counters, memory is measured on the call.
+     * */
+    auto get_stats() -> const stats&;
+    /**
+     * Makes the table hand its finished hands over to a hand history writer.
+     * @param hands writer used by the table's thread only, must outlive the table.
+     * */
+    void set_hand_history(hand_history::writer* hands) { m_hands = hands; }
+
+protected:
+    static constexpr std::size_t max_actions = 10000; /**< Actions in a hand before it's considered stuck */
+    static constexpr std::size_t start_stack = 100;   /**< Starting coins of each player, see game_poker::add_player */
+    static constexpr std::size_t big_blind   = 10;    /**< See game_poker_room::start_game */
+
+    bot::room_ptr m_room;                              /**< Room entity, game_poker_room */
+    std::vector<bot::user_ptr> m_users;                /**< Seated users */
+    std::vector<std::unique_ptr<strategy>> m_strategy; /**< Strategy of each user */
+    std::mt19937 m_gen;                                /**< Table's generator */
+    stats m_stats;                                     /**< Counters */
+    bool m_started = false;                            /**< Whether first hand was started by start_game */
+    bool m_first   = true;                             /**< Whether current hand is the first one of a game */
+    hand_history::writer* m_hands = nullptr;           /**< Writer of finished hands, null if disabled */
+
+    auto p_room() const -> game_poker_room*;
+    auto p_game() const -> game_poker*;
+    void p_start_game();
+    void p_drain();
+    void p_check_chips(const char* where);
+};
+
+table::table(std::size_t id, std::vector<std::unique_ptr<strategy>> strategies, std::uint32_t seed):
+    m_strategy(std::move(strategies)), m_gen(seed) {
+    m_room = bot::make_entity<bot::room, game_poker_room>(id);
+    for(std::size_t i = 0; i < m_strategy.size(); i++) {
+        auto user    = bot::make_entity<bot::user>(id * m_strategy.size() + i + 1);
+        user->name() = fmt::format("{}{}", m_strategy[i]->name(), i);
+        m_room->add_user(user);
+        user->current_room() = m_room;
+        m_users.emplace_back(user);
+    }
+}
+
+table::~table() {
+    bot::destroy_entity(m_room);
+    for(auto& user: m_users) {
+        bot::destroy_entity(user);
+    }
+}
+
+auto table::p_room() const -> game_poker_room* {
+    return bot::utils::stat_cast<game_poker_room>(m_room);
+}
+auto table::p_game() const -> game_poker* {
+    return static_cast<game_poker*>(p_room()->game().get());
+}
+
+void table::p_start_game() {
+    p_room()->seed() = m_gen();
+    p_room()->start_game();
+    m_started = true;
+    m_first   = true;
+}
+
+void table::p_drain() {
+    for(auto& pl: p_game()->players()) {
+        auto& queue = pl->mes_queue();
+        m_stats.messages += queue.size();
+        while(!queue.empty()) {
+            queue.pop();
+        }
+    }
+    p_game()->clear_spectators();
+}
+
+void table::p_check_chips(const char* where) {
+    auto game  = p_game();
+    auto total = game->bank().coins().size();
+    for(auto& pl: game->players()) {
+        total += bot::utils::stat_cast<player_poker>(pl)->bank().coins().size();
+    }
+    if(total != start_stack * m_users.size()) {
+        m_stats.violations++;
+        m_lgr.error("sim::table {} chips are not conserved after {}: {} instead of {}", m_room->token(), where, total,
+                    start_stack * m_users.size());
+    }
+}
+
+auto table::get_stats() -> const stats& {
+    m_stats.memory = m_room->memory_usage();
+    return m_stats;
+}
+
+void table::play_hand() {
+    if(!m_started) {
+        p_start_game();
+    } else {
+        auto broke = bot::utils::contains_if(p_game()->players(), [](auto& pl) {
+            return bot::utils::stat_cast<player_poker>(pl)->bank().coins().size() < big_blind;
+        });
+        if(broke) {
+            m_stats.restarts++;
+            p_start_game();
+        } else {
+            p_game()->init_game();
+            m_first = false;
+        }
+    }
+    p_drain();
+    p_check_chips("init_game");
+
+    auto game = p_game();
+    for(std::size_t actions = 0; auto cur = game->current_player(); actions++) {
+        if(actions == max_actions) {
+            m_stats.violations++;
+            m_lgr.error("sim::table {} hand is stuck after {} actions", m_room->token(), actions);
+            break;
+        }
+        auto seat = bot::utils::index(m_users, cur->user());
+        auto act  = decide(*game, *m_strategy.at(seat), m_gen);
+
+        m_stats.actions++;
+        auto allocs_before = allocations ? allocations() : 0;
+        auto rejected      = apply(*game, act);
+        auto allocs        = allocations ? allocations() - allocs_before : 0;
+
+        p_check_chips(act.type == action::type::bet ? "handle_bet" : "handle_fold");
+        m_stats.rejected += rejected;
+        if(!m_first && !rejected && game->current_player()) {
+            m_stats.steady++;
+            m_stats.steady_allocs += allocs;
+        }
+        p_drain();
+    }
+    if(auto hand = game->take_finished_hand(); hand && m_hands) {
+        hand->table = m_room->id();
+        m_hands->submit(*hand);
+    }
+    m_stats.hands++;
+}
+
+/**
+ * Headless tournament: users with no transport play every table of a poker::tournament with scripted strategies. \n
+ * Tables play in rounds, a hand at each table per round, and every round takes a fixed amount of virtual time,
+ * so blind levels go up the same way in every run. Chips are checked to be conserved after each round. \n
+ * Same thread rules as for table apply.
+ * */
+class tournament_run: public bot::logging_obj {
+public:
+    /**
+     * Constructor, registers entrants.
+     * @param id id of the run, also used to make unique user ids.
+     * @param strategies strategy of each entrant, their count is a count of entrants.
+     * @param conf settings of the tournament, seeded with seed if it has no seed.
+     * @param seed seed of the run's strategies.
+     * @param round virtual time of a round of hands.
+     * */
+    tournament_run(std::size_t id, std::vector<std::unique_ptr<strategy>> strategies, tournament_config conf,
+                   std::uint32_t seed, std::chrono::seconds round = std::chrono::minutes(2));
+    ~tournament_run();
+
+    /**
+     * Plays the tournament to the end.
+     * */
+    void play();
+    auto get_stats() const -> const stats& { return m_stats; }
+
+protected:
+    static constexpr std::size_t max_actions = 10000;  /**< Actions in a hand before it's considered stuck */
+    static constexpr std::size_t max_rounds  = 100000; /**< Rounds before the tournament is considered stuck */
+
+    std::vector<bot::user_ptr> m_users;                       /**< Entrants */
+    std::vector<std::unique_ptr<strategy>> m_strategy;        /**< Strategy of each entrant */
+    std::unordered_map<bot::user_ptr, std::size_t> m_indices; /**< Index of each entrant */
+    std::unique_ptr<tournament> m_tournament;                 /**< Tournament */
+    std::size_t m_chips;                                      /**< Coins in the tournament */
+    std::mt19937 m_gen;                                       /**< Generator of strategies */
+    std::chrono::seconds m_round;                             /**< Virtual time of a round */
+    stats m_stats;                                            /**< Counters */
+
+    void p_play_hand(game_poker& game);
+    void p_drain(game_poker& game);
+};
+
+tournament_run::tournament_run(std::size_t id, std::vector<std::unique_ptr<strategy>> strategies,
+                               tournament_config conf, std::uint32_t seed, std::chrono::seconds round):
+    m_strategy(std::move(strategies)), m_chips(m_strategy.size() * conf.start_stack), m_gen(seed), m_round(round) {
+    for(std::size_t i = 0; i < m_strategy.size(); i++) {
+        auto user       = bot::make_entity<bot::user>(id * m_strategy.size() + i + 1);
+        user->name()    = fmt::format("{}{}", m_strategy[i]->name(), i);
+        m_indices[user] = i;
+        m_users.emplace_back(user);
+    }
+    if(!conf.seed) {
+        conf.seed = seed;
+    }
+    m_tournament = std::make_unique<tournament>(m_users, std::move(conf));
+}
+
+tournament_run::~tournament_run() {
+    m_tournament.reset(); //players go before their users
+    for(auto& user: m_users) {
+        bot::destroy_entity(user);
+    }
+}
+
+void tournament_run::play() {
+    tournament::clock::time_point now {};
+    m_tournament->start(now);
+    for(std::size_t round = 0; !m_tournament->finished(); round++) {
+        if(round == max_rounds) {
+            m_stats.violations++;
+            m_lgr.error("sim::tournament_run is stuck after {} rounds, {} players left", round,
+                        m_tournament->remaining());
+            break;
+        }
+        now += m_round;
+        bool played = false;
+        for(std::size_t i = 0; i < m_tournament->tables().size() && !m_tournament->finished(); i++) {
+            auto& t = m_tournament->tables()[i];
+            if(!t.open || t.game->state() != games::game::state::playing) {
+                continue;
+            }
+            p_play_hand(*t.game);
+            m_tournament->on_hand_end(i, now);
+            played = true;
+        }
+        if(auto chips = m_tournament->chips(); chips != m_chips) {
+            m_stats.violations++;
+            m_lgr.error("sim::tournament_run chips are not conserved after round {}: {} instead of {}", round, chips,
+                        m_chips);
+        }
+        if(!played) {
+            m_stats.violations++;
+            m_lgr.error("sim::tournament_run no table plays in round {}, {} players left", round,
+                        m_tournament->remaining());
+            break;
+        }
+        m_stats.spread = std::max(m_stats.spread, m_tournament->spread());
+    }
+    auto& counters = m_tournament->get_stats();
+    m_stats.tournaments++;
+    m_stats.hands += counters.hands;
+    m_stats.moves += counters.moves;
+    m_stats.broken += counters.broken;
+}
+
+void tournament_run::p_drain(game_poker& game) {
+    for(auto& pl: game.players()) {
+        auto& queue = pl->mes_queue();
+        m_stats.messages += queue.size();
+        while(!queue.empty()) {
+            queue.pop();
+        }
+    }
+    game.clear_spectators();
+}
+
+void tournament_run::p_play_hand(game_poker& game) {
+    p_drain(game);
+    for(std::size_t actions = 0; auto cur = game.current_player(); actions++) {
+        if(actions == max_actions) {
+            m_stats.violations++;
+            m_lgr.error("sim::tournament_run hand is stuck after {} actions", actions);
+            break;
+        }
+        auto act = decide(game, *m_strategy.at(m_indices.at(cur->user())), m_gen);
+        m_stats.actions++;
+        m_stats.rejected += apply(game, act);
+        p_drain(game);
+    }
+}
+
+} // namespace sim
+} // namespace poker
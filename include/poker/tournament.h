@@ -0,0 +1,446 @@
+#pragma once
+#include "components/logger.hpp"
+#include "core/lazy_utils.h"
+#include "core/logging_obj.h"
+#include "core/user.h"
+#include "poker/bank.h"
+#include "poker/game.h"
+#include "poker/player.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace poker {
+
+/**
+ * Blind level of a tournament.
+ * */
+struct blind_level {
+    std::size_t big_blind;                        /**< Big blind, small one is a half of it */
+    std::chrono::steady_clock::duration duration; /**< How long the level lasts */
+};
+
+/**
+ * Blind schedule of 10 minutes levels for stacks of 200 coins.
+ * */
+auto default_blind_levels() -> std::vector<blind_level> {
+    std::vector<blind_level> result;
+    for(std::size_t bb: {2, 4, 6, 8, 10, 14, 20, 30, 40, 60, 80, 100, 150, 200}) {
+        result.push_back({bb, std::chrono::minutes(10)});
+    }
+    return result;
+}
+
+/**
+ * Settings of a tournament.
+ * */
+struct tournament_config {
+    std::size_t seats                 = 9;                      /**< Seats per table */
+    std::size_t start_stack           = 200;                    /**< Coins of every entrant */
+    std::vector<blind_level> levels   = default_blind_levels(); /**< Blind schedule, not empty */
+    std::optional<std::uint32_t> seed = std::nullopt;           /**< Seed of seating and decks, random if empty */
+};
+
+/**
+ * Multi-table tournament: seats entrants over game_poker tables, raises blinds by a schedule,
+ * eliminates players who can't post the big blind and breaks and balances tables. \n
+ * It doesn't play hands itself, a driver (a bot or a headless simulator) plays a table's hand
+ * to the end and reports it with on_hand_end, the engine then reseats players and starts the next hand. \n
+ * Players are only moved between hands: a player moved to a table with a hand in process waits
+ * for it to end. Balancing moves as few players as possible: only the surplus over the shortest
+ * table plus one leaves a table, and the table to break is always one of the shortest. Shortest and longest
+ * tables are selected with heaps whose stale entries are skipped lazily, so thousands of entrants are cheap. \n
+ * game_poker has no all-in, so a player whose stack is below the big blind is eliminated
+ * and the rest of the stack is forfeited, see chips.
+ * */
+class tournament: public bot::logging_obj {
+public:
+    using clock                       = std::chrono::steady_clock;    /**< Clock of blind levels */
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1); /**< No table */
+
+    /**
+     * Table of a tournament.
+     * */
+    struct table {
+        std::unique_ptr<game_poker> game;                              /**< Game, nullptr once the table is broken */
+        std::vector<std::pair<bot::user_ptr, bank::coins_t>> arrivals; /**< Moved players waiting for the hand's end */
+        std::size_t hands = 0;                                         /**< Hands played */
+        bool open         = true;                                      /**< Whether the table isn't broken */
+
+        auto size() const -> std::size_t { return open ? game->players().size() + arrivals.size() : 0; }
+    };
+
+    /**
+     * Counters of a tournament.
+     * */
+    struct stats {
+        std::size_t hands      = 0; /**< Finished hands */
+        std::size_t moves      = 0; /**< Players moved between tables */
+        std::size_t broken     = 0; /**< Broken tables */
+        std::size_t eliminated = 0; /**< Eliminated players */
+    };
+
+    /**
+     * Constructor. Throws runtime exception on less than 2 entrants, 2 seats or an empty blind schedule.
+     * @param entrants users to play, each user has to be in the tournament once.
+     * @param conf settings.
+     * */
+    tournament(std::vector<bot::user_ptr> entrants, tournament_config conf);
+
+    /**
+     * Seats entrants randomly, tables differ by a player at most, and starts first hands.
+     * @param now start of the first blind level.
+     * */
+    void start(clock::time_point now);
+    /**
+     * Processes the end of a hand: seats players waiting for it, eliminates players short of the big blind,
+     * breaks or balances the table and starts its next hand. Tables waiting for players are processed too.
+     * Throws runtime exception if the table is broken or its hand is still in process.
+     * @param index index of a table.
+     * @param now current time, selects blind level of next hands.
+     * */
+    void on_hand_end(std::size_t index, clock::time_point now);
+
+    /**
+     * Returns blind level at a given time. Once the schedule is over, the big blind of the last level
+     * doubles every its duration, so a tournament ends however many chips are in play.
+     * */
+    auto level_at(clock::time_point now) const -> blind_level;
+    /**
+     * Returns all tables including broken ones, indices are stable.
+     * */
+    auto tables() const -> const std::vector<table>& { return m_tables; }
+    /**
+     * Returns index of user's table, npos if user was eliminated or isn't in the tournament.
+     * */
+    auto table_of(const bot::user_ptr& user) const -> std::size_t;
+    /**
+     * Returns amount of players left.
+     * */
+    auto remaining() const -> std::size_t { return m_seats.size(); }
+    auto finished() const -> bool { return m_seats.size() <= 1; }
+    /**
+     * Returns eliminated players, the first one took the last place.
+     * */
+    auto eliminated() const -> const std::vector<bot::user_ptr>& { return m_eliminated; }
+    /**
+     * Returns winner, nullptr until the tournament is finished.
+     * */
+    auto winner() const -> bot::user_ptr;
+    /**
+     * Returns coins in play and forfeited by eliminated players, equals entrants times start stack.
+     * */
+    auto chips() const -> std::size_t;
+    /**
+     * Returns difference between the longest and the shortest open tables.
+     * */
+    auto spread() -> std::size_t;
+    auto get_stats() const -> const stats& { return m_stats; }
+
+protected:
+    using entry    = std::pair<std::size_t, std::size_t>;                                 /**< Table's size and index */
+    using min_heap = std::priority_queue<entry, std::vector<entry>, std::greater<entry>>; /**< Shortest tables first */
+    using max_heap = std::priority_queue<entry>;                                          /**< Longest tables first */
+
+    std::vector<bot::user_ptr> m_entrants;                  /**< Entrants in seating order */
+    tournament_config m_conf;                               /**< Settings */
+    std::mt19937 m_gen;                                     /**< Generator of seating and decks */
+    clock::time_point m_start;                              /**< Start of the first level */
+    std::size_t m_blind = 0;                                /**< Big blind of the last started hand */
+    std::vector<table> m_tables;                            /**< Tables */
+    std::size_t m_open = 0;                                 /**< Open tables */
+    std::vector<std::size_t> m_idle;                        /**< Open tables without a hand in process */
+    std::unordered_map<bot::user_ptr, std::size_t> m_seats; /**< Table of every player left */
+    std::vector<bot::user_ptr> m_eliminated;                /**< Eliminated players */
+    std::size_t m_forfeited = 0;                            /**< Coins of eliminated players */
+    min_heap m_shortest;                                    /**< Open tables by size, some entries are outdated */
+    max_heap m_longest;                                     /**< Open tables by size, see m_shortest */
+    stats m_stats;                                          /**< Counters */
+
+    static auto p_poker(const games::game::player_ptr& pl) -> player_poker*;
+    template<class Heap>
+    auto p_top(Heap& heap) -> std::size_t;
+    void p_push(std::size_t index);
+    void p_settle(clock::time_point now);
+    auto p_between_hands(std::size_t index, clock::time_point now) -> bool;
+    void p_seat(std::size_t index, const bot::user_ptr& user, bank::coins_t& coins);
+    void p_eliminate(std::size_t index, std::size_t big_blind);
+    auto p_break(std::size_t index) -> bool;
+    void p_shed(std::size_t index);
+    void p_move(std::size_t from, games::game::player_ptr pl);
+    void p_start_hand(std::size_t index, clock::time_point now);
+};
+
+tournament::tournament(std::vector<bot::user_ptr> entrants, tournament_config conf):
+    m_entrants(std::move(entrants)), m_conf(std::move(conf)),
+    m_gen(m_conf.seed ? *m_conf.seed : std::random_device {}()) {
+    if(m_entrants.size() < 2 || m_conf.seats < 2 || m_conf.levels.empty()) {
+        auto mes = fmt::format("tournament::tournament {} entrants, {} seats, {} levels", m_entrants.size(),
+                               m_conf.seats, m_conf.levels.size());
+        m_lgr.error(mes);
+        throw std::runtime_error(mes);
+    }
+}
+
+void tournament::start(clock::time_point now) {
+    m_start        = now;
+    auto count     = (m_entrants.size() + m_conf.seats - 1) / m_conf.seats;
+    auto big_blind = level_at(now).big_blind;
+    std::shuffle(m_entrants.begin(), m_entrants.end(), m_gen);
+    std::vector<std::vector<bot::user_ptr>> seating(count);
+    for(std::size_t i = 0; i < m_entrants.size(); i++) {
+        seating[i % count].emplace_back(m_entrants[i]);
+        m_seats[m_entrants[i]] = i % count;
+    }
+    m_tables.resize(count);
+    for(std::size_t i = 0; i < count; i++) {
+        auto& t = m_tables[i];
+        t.game  = std::make_unique<game_poker>(seating[i], big_blind, 0);
+        if(m_conf.seed) { //otherwise every deck draws seeds of its hands from std::random_device
+            t.game->cards().seed(m_gen());
+        }
+        for(auto& pl: t.game->players()) {
+            p_poker(pl)->bank() = bank(m_conf.start_stack);
+        }
+        m_open++;
+        m_idle.emplace_back(i);
+        p_push(i);
+    }
+    m_lgr.info("tournament::start {} entrants at {} tables, big blind {}", m_entrants.size(), count, big_blind);
+    p_settle(now);
+}
+
+void tournament::on_hand_end(std::size_t index, clock::time_point now) {
+    auto prefix = "tournament::on_hand_end";
+    auto& t     = m_tables.at(index);
+    if(!t.open || t.game->state() == games::game::state::playing) {
+        auto mes = fmt::format("{} table {} has no finished hand", prefix, index);
+        m_lgr.error(mes);
+        throw std::runtime_error(mes);
+    }
+    t.hands++;
+    m_stats.hands++;
+    if(!bot::utils::contains(m_idle, index)) {
+        m_idle.emplace_back(index);
+    }
+    p_settle(now);
+}
+
+auto tournament::level_at(clock::time_point now) const -> blind_level {
+    auto elapsed      = now - m_start;
+    auto& levels      = m_conf.levels;
+    std::size_t index = 0;
+    for(; index + 1 < levels.size() && elapsed >= levels[index].duration; index++) {
+        elapsed -= levels[index].duration;
+    }
+    auto level = levels[index];
+    if(index + 1 == levels.size() && level.duration.count() > 0) {
+        auto doublings = std::min<std::int64_t>(elapsed / level.duration, 32);
+        level.big_blind <<= doublings;
+    }
+    return level;
+}
+
+auto tournament::table_of(const bot::user_ptr& user) const -> std::size_t {
+    auto it = m_seats.find(user);
+    return it == m_seats.end() ? npos : it->second;
+}
+
+auto tournament::winner() const -> bot::user_ptr {
+    return m_seats.size() == 1 ? m_seats.begin()->first : nullptr;
+}
+
+auto tournament::chips() const -> std::size_t {
+    auto result = m_forfeited;
+    for(auto& t: m_tables) {
+        if(!t.open) {
+            continue;
+        }
+        result += t.game->bank().coins().size();
+        for(auto& pl: t.game->players()) {
+            result += p_poker(pl)->bank().coins().size();
+        }
+        for(auto& [user, coins]: t.arrivals) {
+            result += coins.size();
+        }
+    }
+    return result;
+}
+
+auto tournament::spread() -> std::size_t {
+    auto shortest = p_top(m_shortest), longest = p_top(m_longest);
+    return shortest == npos ? 0 : m_tables[longest].size() - m_tables[shortest].size();
+}
+
+auto tournament::p_poker(const games::game::player_ptr& pl) -> player_poker* {
+    return bot::utils::stat_cast<player_poker>(pl);
+}
+
+template<class Heap>
+auto tournament::p_top(Heap& heap) -> std::size_t {
+    //every change of a table pushes a new entry, so entries that don't match the table are outdated
+    for(; !heap.empty(); heap.pop()) {
+        auto& t = m_tables[heap.top().second];
+        if(t.open && t.size() == heap.top().first) {
+            return heap.top().second;
+        }
+    }
+    return npos;
+}
+
+void tournament::p_push(std::size_t index) {
+    if(m_shortest.size() > 4 * m_open + 64) { //rebuilt from open tables, so outdated entries don't pile up
+        m_shortest = {};
+        m_longest  = {};
+        for(std::size_t i = 0; i < m_tables.size(); i++) {
+            if(m_tables[i].open) {
+                m_shortest.emplace(m_tables[i].size(), i);
+                m_longest.emplace(m_tables[i].size(), i);
+            }
+        }
+        return;
+    }
+    if(m_tables[index].open) {
+        m_shortest.emplace(m_tables[index].size(), index);
+        m_longest.emplace(m_tables[index].size(), index);
+    }
+}
+
+void tournament::p_settle(clock::time_point now) {
+    //processing a table may seat players at another waiting one, so repeat until nothing changes
+    for(bool progress = true; progress && !finished();) {
+        progress = false;
+        for(auto index: std::vector<std::size_t>(m_idle)) {
+            if(p_between_hands(index, now)) {
+                bot::utils::erase(m_idle, index);
+                progress = true;
+            }
+        }
+    }
+    if(finished()) {
+        m_lgr.info("tournament::p_settle finished after {} hands, winner {}", m_stats.hands,
+                   winner() ? winner()->log_desc() : std::string("none"));
+    }
+}
+
+auto tournament::p_between_hands(std::size_t index, clock::time_point now) -> bool {
+    auto& t = m_tables[index];
+    for(auto& [user, coins]: t.arrivals) {
+        p_seat(index, user, coins);
+    }
+    t.arrivals.clear();
+    p_eliminate(index, level_at(now).big_blind);
+    if(finished()) {
+        return false;
+    }
+    if(p_break(index)) {
+        return true;
+    }
+    p_shed(index);
+    if(t.game->players().size() < 2) {
+        return false; //waits for players from other tables
+    }
+    p_start_hand(index, now);
+    return true;
+}
+
+void tournament::p_seat(std::size_t index, const bot::user_ptr& user, bank::coins_t& coins) {
+    auto& game = *m_tables[index].game;
+    game.add_player(user);
+    p_poker(game.players().back())->bank().add_coins(coins);
+}
+
+void tournament::p_eliminate(std::size_t index, std::size_t big_blind) {
+    auto& game = *m_tables[index].game;
+    std::vector<games::game::player_ptr> busted;
+    for(auto& pl: game.players()) {
+        if(p_poker(pl)->bank().coins().size() < big_blind) {
+            busted.emplace_back(pl);
+        }
+    }
+    if(busted.empty()) {
+        return;
+    }
+    //shorter stacks take lower places, seat order breaks ties
+    std::stable_sort(busted.begin(), busted.end(), [](auto& lhs, auto& rhs) {
+        return p_poker(lhs)->bank().coins().size() < p_poker(rhs)->bank().coins().size();
+    });
+    for(auto& pl: busted) {
+        if(finished()) {
+            break;
+        }
+        auto user = pl->user();
+        m_lgr.debug("tournament::p_eliminate {} with {} coins, place {}", user->log_desc(),
+                    p_poker(pl)->bank().coins().size(), m_seats.size());
+        m_forfeited += p_poker(pl)->bank().coins().size();
+        game.handle_exit(pl);
+        m_seats.erase(user);
+        m_eliminated.emplace_back(std::move(user));
+        m_stats.eliminated++;
+    }
+    p_push(index);
+}
+
+auto tournament::p_break(std::size_t index) -> bool {
+    auto& t = m_tables[index];
+    if(m_open < 2 || m_seats.size() > m_conf.seats * (m_open - 1)) {
+        return false;
+    }
+    if(t.size() != m_tables[p_top(m_shortest)].size()) {
+        return false; //one of the shortest tables is broken, so the fewest players move
+    }
+    m_lgr.debug("tournament::p_break table {}, {} players move", index, t.size());
+    t.open = false; //heaps don't offer it as a destination anymore
+    m_open--;
+    m_stats.broken++;
+    while(!t.game->players().empty()) {
+        p_move(index, t.game->players().front());
+    }
+    t.game.reset();
+    return true;
+}
+
+void tournament::p_shed(std::size_t index) {
+    auto& t = m_tables[index];
+    while(t.size() > m_tables[p_top(m_shortest)].size() + 1) {
+        p_move(index, t.game->players().front()); //longest seated players move first
+    }
+}
+
+void tournament::p_move(std::size_t from, games::game::player_ptr pl) {
+    auto dest  = p_top(m_shortest);
+    auto user  = pl->user();
+    auto& d    = m_tables[dest];
+    auto coins = std::move(p_poker(pl)->bank().coins());
+    m_tables[from].game->handle_exit(pl);
+    p_push(from);
+    if(d.game->state() == games::game::state::playing) {
+        d.arrivals.emplace_back(user, std::move(coins));
+    } else {
+        p_seat(dest, user, coins);
+    }
+    m_seats[user] = dest;
+    m_stats.moves++;
+    p_push(dest);
+}
+
+void tournament::p_start_hand(std::size_t index, clock::time_point now) {
+    auto big_blind = level_at(now).big_blind;
+    if(big_blind != m_blind) {
+        m_blind = big_blind;
+        m_lgr.info("tournament::p_start_hand big blind {}, {} players left", big_blind, m_seats.size());
+    }
+    auto& game = *m_tables[index].game;
+    game.set_blind(big_blind);
+    game.init_game();
+}
+
+} // namespace poker
@@ -1,5 +1,8 @@
 #include "components/logger.hpp"
+#include "core/alloc_profile.h"
 #include "core/bot.h"
+#include "core/metrics_endpoint.h"
+#include "core/tracing.h"
 #include "poker/bank.h"
 #include "poker/bot.h"
 #include "poker/card.h"
@@ -23,6 +26,14 @@ void setup_handlers() {
     ::signal(SIGABRT, &my_signal_handler);
 }
 
+static poker::poker_bot* running_bot = nullptr;
+
+void stop_handler(int) {
+    if(running_bot) {
+        running_bot->stop();
+    }
+}
+
 static auto original_terminate_handler {std::get_terminate()};
 
 void terminate_handler() {
@@ -36,11 +47,6 @@ int main(int argc, char* argv[]) {
     setup_handlers();
     std::set_terminate(terminate_handler);
 
-    auto lgr = initialization_logger();
-    lgr.set_level(logger::level::info);
-    auto internal = lgr.get_internal_logger();
-    internal->set_pattern("[%Y-%m-%d %T] [%L] %v");
-
     //parse options
     namespace po = boost::program_options;
     po::options_description desc("Allowed options");
@@ -55,10 +61,76 @@ int main(int argc, char* argv[]) {
                        "4 - err\n"
                        "5 - critical\n"
                        "6 - off\n");
+    desc.add_options()("log-async", "write logs from a dedicated thread pool");
+    desc.add_options()("log-queue-size", po::value<std::size_t>()->default_value(8192),
+                       "async log queue size, in messages");
+    desc.add_options()("log-threads", po::value<std::size_t>()->default_value(1), "async log thread pool size");
+    desc.add_options()("log-overflow", po::value<std::string>()->default_value("block"),
+                       "what to do when async log queue is full.\n"
+                       "block - wait for free space\n"
+                       "overrun - discard the oldest message\n");
+    desc.add_options()("log-file-size", po::value<std::size_t>()->default_value(0),
+                       "rotate log file after that many bytes, 0 - never rotate");
+    desc.add_options()("log-files", po::value<std::size_t>()->default_value(3), "amount of rotated log files to keep");
+    desc.add_options()("metrics-port", po::value<unsigned short>()->default_value(0),
+                       "port on 127.0.0.1 to serve prometheus metrics on, 0 - disabled");
+    desc.add_options()("trace-file", po::value<std::string>(),
+                       "write chrome trace-event json of handled updates to this file on exit");
+    desc.add_options()("trace-sample", po::value<std::size_t>()->default_value(10), "trace every Nth update");
+    desc.add_options()("snapshot-file", po::value<std::string>(),
+                       "load users and rooms from this file on start and save them there periodically");
+    desc.add_options()("snapshot-interval", po::value<std::size_t>()->default_value(60),
+                       "seconds between snapshots");
+    desc.add_options()("hibernate-dir", po::value<std::string>(),
+                       "directory to hibernate games of idle rooms to, disabled if not set");
+    desc.add_options()("hibernate-after", po::value<std::size_t>()->default_value(600),
+                       "seconds without messages before a room's game is hibernated");
+    desc.add_options()("update-log", po::value<std::string>(),
+                       "journal of applied updates to resume from after a restart without applying them twice");
+    desc.add_options()("history-messages", po::value<std::size_t>()->default_value(50),
+                       "relayed messages every room keeps for /history, 0 to disable");
+    desc.add_options()("history-bytes", po::value<std::size_t>()->default_value(8 * 1024),
+                       "bytes of text every room keeps for /history");
+    desc.add_options()("turn-timeout", po::value<std::size_t>()->default_value(60),
+                       "seconds a poker player has to act before checking or folding automatically, 0 to disable");
+    desc.add_options()("time-bank", po::value<std::size_t>()->default_value(30),
+                       "extra seconds of every poker player per game, spent after turn timeout");
+    desc.add_options()("hand-history", po::value<std::string>(),
+                       "directory to append every finished poker hand to, disabled if not set");
+    desc.add_options()("hand-history-compress", po::value<bool>()->default_value(true),
+                       "deflate blocks of hand history");
+    desc.add_options()("admin", po::value<std::vector<std::size_t>>()->multitoken(),
+                       "telegram ids of users allowed to use admin commands, e.g. /stats, /poker_hands");
+    desc.add_options()("api-url", po::value<std::string>()->default_value("https://api.telegram.org"),
+                       "Bot API server, e.g. a local http:// stand-in for testing");
+    desc.add_options()("http-connections", po::value<std::size_t>()->default_value(4),
+                       "most keep-alive connections to the Bot API");
+    desc.add_options()("http-pipeline", po::value<std::size_t>()->default_value(4),
+                       "most requests in flight on one Bot API connection");
+    desc.add_options()("http-idle-timeout", po::value<std::size_t>()->default_value(50),
+                       "seconds an idle Bot API connection is kept for reuse");
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, desc), vm);
     po::notify(vm);
 
+    logger_config log_cfg;
+    log_cfg.async          = vm.count("log-async");
+    log_cfg.queue_size     = vm["log-queue-size"].as<std::size_t>();
+    log_cfg.threads        = vm["log-threads"].as<std::size_t>();
+    log_cfg.file_max_size  = vm["log-file-size"].as<std::size_t>();
+    log_cfg.file_max_count = vm["log-files"].as<std::size_t>();
+    auto overflow          = vm["log-overflow"].as<std::string>();
+    if(overflow == "overrun") {
+        log_cfg.overflow_policy = logger_config::overflow::overrun_oldest;
+    } else if(overflow != "block") {
+        throw std::runtime_error("param [log-overflow] must be block or overrun, see --help");
+    }
+
+    auto lgr = initialization_logger(log_cfg);
+    lgr.set_level(logger::level::info);
+    auto internal = lgr.get_internal_logger();
+    internal->set_pattern("[%Y-%m-%d %T] [%L] %v");
+
     if(vm.count("help")) {
         std::stringstream ss;
         ss << desc;
@@ -86,8 +158,61 @@ int main(int argc, char* argv[]) {
         throw std::runtime_error(mes);
     }
 
-    poker::poker_bot b(token);
+    std::unique_ptr<bot::metrics::http_endpoint> metrics;
+    if(auto port = vm["metrics-port"].as<unsigned short>()) {
+        metrics = std::make_unique<bot::metrics::http_endpoint>(port);
+    }
+
+    std::string trace_file;
+    if(vm.count("trace-file")) {
+        trace_file = vm["trace-file"].as<std::string>();
+        bot::trace::enable(vm["trace-sample"].as<std::size_t>());
+    }
+
+    bot::http_pool_config http;
+    http.url          = vm["api-url"].as<std::string>();
+    http.connections  = vm["http-connections"].as<std::size_t>();
+    http.pipeline     = vm["http-pipeline"].as<std::size_t>();
+    http.idle_timeout = std::chrono::seconds(vm["http-idle-timeout"].as<std::size_t>());
+
+    poker::poker_bot b(token, http);
+    b.set_history_limits({vm["history-messages"].as<std::size_t>(), vm["history-bytes"].as<std::size_t>()});
+    if(auto timeout = vm["turn-timeout"].as<std::size_t>()) {
+        b.enable_turn_timers(std::chrono::seconds(timeout), std::chrono::seconds(vm["time-bank"].as<std::size_t>()));
+    }
+    if(vm.count("hibernate-dir")) {
+        b.enable_hibernation(vm["hibernate-dir"].as<std::string>(),
+                             std::chrono::seconds(vm["hibernate-after"].as<std::size_t>()));
+    }
+    if(vm.count("hand-history")) {
+        poker::hand_history::writer_config hands;
+        hands.dir      = vm["hand-history"].as<std::string>();
+        hands.compress = vm["hand-history-compress"].as<bool>();
+        b.enable_hand_history(hands);
+    }
+    if(vm.count("admin")) {
+        b.set_admins(vm["admin"].as<std::vector<std::size_t>>());
+    }
+    if(vm.count("update-log")) {
+        b.enable_update_log(vm["update-log"].as<std::string>());
+    }
+    if(vm.count("snapshot-file")) {
+        b.enable_snapshots(vm["snapshot-file"].as<std::string>(),
+                           std::chrono::seconds(vm["snapshot-interval"].as<std::size_t>()));
+    }
+    running_bot = &b;
+    ::signal(SIGINT, &stop_handler);
+    ::signal(SIGTERM, &stop_handler);
     b.start();
+    running_bot = nullptr;
+
+    if(!trace_file.empty()) {
+        auto count = bot::trace::dump(trace_file);
+        lgr.info("written {} trace events to {}", count, trace_file);
+    }
+    if constexpr(bot::alloc::enabled) {
+        lgr.info("allocations by subsystem:\n{}", bot::alloc::report());
+    }
 
     return 0;
 }
\ No newline at end of file
@@ -5,83 +5,13 @@
 #include <poker/card.h>
 #include <poker/deck.h>
 #include <poker/kinds.h>
+#include <poker/ranking.h>
 #include <set>
 #include <sstream>
 #include <unordered_set>
 
 using cards_t = std::vector<poker::card>;
 
-/* ------------------------------------------------------------------------------------------------- */
-// Produce a string whose lexicographic rank order reflects the ranking of the hand in poker.
-// Examples:  "41000-63"     ;four of a kind (6s), the odd card is a 3
-//            "22100-928"    ;two pair (9s and 2s), the odd card is an 8
-//            "32000-da"     ;full house with three kings and two 10s
-//            "312ST-ba987"  ;jack-high straight
-// Hex digits (abcde) are used instead of TJQKA to get the lexicographic order right.
-// Credit: geoffp at codewars
-std::string ranking_string(const std::vector<poker::card>& cards) {
-    unsigned c, r;
-
-    // Count the number of occurrences of each rank:
-    std::vector<unsigned> rc(15, 0);
-    for(r = 2; r <= 14; r++) {
-        for(auto& c: cards) {
-            if(c.value == r) {
-                ++rc[r];
-            }
-        }
-    }
-
-    // In an ace-low straight (but not in any other situation), an ace is considered to have rank 1:
-    if(rc[2] == 1 && rc[3] == 1 && rc[4] == 1 && rc[5] == 1 && rc[14] == 1) {
-        rc[1]  = 1;
-        rc[14] = 0;
-    }
-
-    // Check for a straight:
-    bool straight = std::search_n(rc.begin(), rc.end(), 5, 1) != rc.end();
-
-    // Check for a flush:
-    auto flush_pred = [&cards](auto c) { return c.kind == cards.front().kind; };
-    bool flush      = std::all_of(cards.begin(), cards.end(), flush_pred);
-
-    // Form the second (tie-breaking) part of the ranking string:
-    std::string tiebreak;
-    tiebreak.reserve(5 + 5 + 1);
-    {
-        std::ostringstream tiebreak_;
-        std::ostringstream kinds_;
-        for(c = 4; c > 0; c--) {
-            for(r = 14; r >= 1; r--) {
-                if(rc[r] == c) {
-                    tiebreak_ << std::hex << r;
-                    for(auto& card: cards) {
-                        if(card.value == r || (r == 1 && card.value == 14)) {
-                            kinds_ << card.kind.name.front();
-                        }
-                    }
-                }
-            }
-        }
-        tiebreak = tiebreak_.str();
-        tiebreak += "-";
-        tiebreak += kinds_.str();
-    }
-
-    // Form the first (hand type) part of the ranking string:
-    std::string s;
-    if(straight) {
-        s = flush ? "5STFL" : "312ST";
-    } else if(flush) {
-        s = "313FL";
-    } else {
-        std::sort(rc.begin(), rc.end());
-        for(r = 14; r > 9; r--) s += ('0' + rc[r]);
-    }
-
-    return s + "-" + tiebreak;
-}
-
 void print(const cards_t& cards) {
     for(auto& card: cards) {
         std::cout << "v:" << card.value;
@@ -195,7 +125,7 @@ std::set<combination> get_combs(const cards_t& cards, const cards_t& hand) {
     std::vector<std::string> comb_strings;
     comb_strings.reserve(hands.size());
     for(auto& hand: hands) {
-        auto tmp = ranking_string(hand);
+        auto tmp = poker::ranking_string(hand);
         comb_strings.emplace_back(std::move(tmp));
     }
     //results.reserve(comb_strings.size());
@@ -0,0 +1,210 @@
+/**
+ * Checks that queries answered by the index of a history file find the same hands as a scan of every hand,
+ * and that indexes with corrupted columns are refused when they're opened. \n
+ * Exits with non-zero code if a check fails.
+ * */
+#include "components/logger.hpp"
+#include "poker/hand_index.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace hh = poker::hand_history;
+namespace fs = std::filesystem;
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if(!ok) {
+        std::cerr << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+/**
+ * Hand of 2 to 6 players out of 20 users, one of them takes the pot.
+ * */
+auto random_hand(std::mt19937& gen, std::uint64_t time) -> hh::hand_record {
+    hh::hand_record hand;
+    hand.time      = time;
+    hand.big_blind = 10;
+    std::vector<std::uint64_t> users(20);
+    for(std::size_t i = 0; i < users.size(); i++) {
+        users[i] = 1000 + i;
+    }
+    std::shuffle(users.begin(), users.end(), gen);
+    std::vector<std::uint8_t> cards(52);
+    for(std::size_t i = 0; i < cards.size(); i++) {
+        cards[i] = static_cast<std::uint8_t>(i);
+    }
+    std::shuffle(cards.begin(), cards.end(), gen);
+    auto seats = std::uniform_int_distribution<std::size_t>(2, 6)(gen);
+    for(std::size_t i = 0; i < seats; i++) {
+        hand.seats.push_back({users[i], 100, {cards[2 * i], cards[2 * i + 1]}, 0});
+    }
+    hand.seats[std::uniform_int_distribution<std::size_t>(0, seats - 1)(gen)].won =
+        std::uniform_int_distribution<std::uint64_t>(15, 600)(gen);
+    hand.board.assign(cards.end() - std::uniform_int_distribution<std::size_t>(0, 5)(gen), cards.end());
+    return hand;
+}
+
+/**
+ * Writes a history file of random hands to a directory.
+ * @returns path of the file.
+ * */
+auto write_history(const std::string& dir, std::size_t hands) -> std::string {
+    std::mt19937 gen(42);
+    {
+        hh::writer_config config;
+        config.dir        = dir;
+        config.block_size = 4096;
+        hh::writer writer(config);
+        for(std::size_t i = 0; i < hands; i++) {
+            auto hand = random_hand(gen, 1700000000 + i * 60);
+            check(writer.submit(hand), "hand " + std::to_string(i) + " is dropped");
+        }
+    }
+    auto files = hh::list_files(dir);
+    check(files.size() == 1, std::to_string(files.size()) + " history files are written");
+    return files.empty() ? std::string() : files.front();
+}
+
+auto matches(const hh::hand_query& query, const hh::hand_record& hand) -> bool {
+    return (!query.user || hand.seat_of(*query.user)) && hand.pot() >= query.min_pot &&
+           (hh::board_texture(hand.board) & query.board) == query.board && hand.time >= query.from &&
+           hand.time <= query.to;
+}
+
+auto describe(const hh::hand_query& query) -> std::string {
+    return fmt::format("user={} pot={} board={} from={} to={}", query.user ? std::to_string(*query.user) : "-",
+                       query.min_pot, query.board, query.from, query.to);
+}
+
+void check_queries(const std::string& history) {
+    std::vector<hh::hand_record> hands;
+    hh::reader(history).for_each([&](const hh::hand_record& hand) { hands.emplace_back(hand); });
+    hh::build_index(history);
+    hh::hand_index index(hh::index_path(history));
+    check(index.hands() == hands.size(), std::to_string(index.hands()) + " hands are indexed instead of " +
+                                             std::to_string(hands.size()));
+
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> coin(0, 1);
+    auto first = hands.empty() ? 0 : hands.front().time, last = hands.empty() ? 0 : hands.back().time;
+    for(int round = 0; round < 500; round++) {
+        hh::hand_query query;
+        if(coin(gen)) {
+            query.user = std::uniform_int_distribution<std::uint64_t>(995, 1025)(gen); //some ids never played
+        }
+        if(coin(gen)) {
+            query.min_pot = std::uniform_int_distribution<std::uint64_t>(0, 700)(gen);
+        }
+        if(coin(gen)) {
+            query.board = static_cast<std::uint8_t>(1u << std::uniform_int_distribution<int>(0, 5)(gen));
+        }
+        if(coin(gen)) {
+            query.from = std::uniform_int_distribution<std::uint64_t>(first, last)(gen);
+            query.to   = std::uniform_int_distribution<std::uint64_t>(query.from, last + 60)(gen);
+        }
+        std::vector<std::uint32_t> want;
+        for(std::size_t i = 0; i < hands.size(); i++) {
+            if(matches(query, hands[i])) {
+                want.emplace_back(static_cast<std::uint32_t>(i));
+            }
+        }
+        auto got = index.match(query);
+        check(got == want, describe(query) + ": index finds " + std::to_string(got.size()) + " hands, scan " +
+                               std::to_string(want.size()));
+
+        auto result = hh::search({history}, query, 3);
+        check(result.matched == want.size() && result.found.size() == std::min<std::size_t>(want.size(), 3),
+              describe(query) + ": search finds " + std::to_string(result.matched) + " hands");
+        for(std::size_t i = 0; i < result.found.size() && i < want.size(); i++) {
+            check(result.found[i].time == hands[want[i]].time, describe(query) + ": search returns a wrong hand");
+        }
+        if(failures > 10) {
+            return;
+        }
+    }
+}
+
+/**
+ * Overwrites a word of a column, checks that the index is refused then and restores it.
+ * */
+void check_corrupted(const std::string& index, std::size_t offset, std::uint64_t value, std::size_t bytes,
+                     const std::string& what) {
+    std::string original;
+    {
+        std::ifstream in(index, std::ios::binary);
+        original.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    auto corrupted = original;
+    std::memcpy(corrupted.data() + offset, &value, bytes);
+    std::ofstream(index, std::ios::binary | std::ios::trunc) << corrupted;
+    try {
+        hh::hand_index opened(index);
+        check(false, "index with " + what + " is opened");
+    } catch(const std::runtime_error& e) {
+        check(std::string(e.what()).find("inconsistent columns") != std::string::npos,
+              "index with " + what + " is refused for \"" + e.what() + "\"");
+    }
+    std::ofstream(index, std::ios::binary | std::ios::trunc) << original;
+}
+
+void check_validation(const std::string& history) {
+    hh::build_index(history);
+    auto index = hh::index_path(history);
+    std::uint64_t hands = 0, blocks = 0, users = 0;
+    {
+        hh::hand_index opened(index);
+        hands = opened.hands();
+        users = opened.users();
+        std::ifstream in(index, std::ios::binary);
+        in.seekg(40); //after magic, version, byte order, source size and hands
+        in.read(reinterpret_cast<char*>(&blocks), sizeof(blocks));
+    }
+    //columns: times, pots, first hands of blocks, user ids, offsets of postings, postings
+    auto block_first = 64 + hands * 16; //header is 64 bytes
+    auto user_ids    = block_first + (blocks + 1) * 8;
+    auto offsets     = user_ids + users * 8;
+    auto postings    = offsets + (users + 1) * 8;
+
+    check_corrupted(index, postings + 4, hands, 4, "a posting past the last hand");
+    check_corrupted(index, postings, std::uint32_t {0xFFFFFFFF}, 4, "a huge posting");
+    check_corrupted(index, offsets + 8, 1000000, 8, "an offset past postings");
+    check_corrupted(index, offsets + 16, 0, 8, "decreasing offsets");
+    check_corrupted(index, offsets, 1, 8, "offsets that don't start at 0");
+    check_corrupted(index, user_ids + 8, 0, 8, "unsorted user ids");
+    check_corrupted(index, block_first + 8, hands + 1, 8, "a block past the last hand");
+
+    hh::hand_index restored(index);
+    check(restored.hands() == hands, "restored index has " + std::to_string(restored.hands()) + " hands");
+}
+
+int main() {
+    auto lgr = initialization_logger(logger_config{});
+    lgr.set_level(logger::level::err);
+
+    auto dir = (fs::temp_directory_path() / ("test_hand_index." + std::to_string(getpid()))).string();
+    fs::remove_all(dir);
+    auto history = write_history(dir, 3000);
+    if(!history.empty()) {
+        check_queries(history);
+        check_validation(history);
+    }
+    fs::remove_all(dir);
+
+    if(failures) {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    std::cout << "all checks passed\n";
+    return 0;
+}
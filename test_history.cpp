@@ -0,0 +1,143 @@
+/**
+ * Checks the message history ring against a plain queue of strings: texts that wrap around the end
+ * of the buffer, eviction by either limit, truncation at UTF-8 boundaries and changes of limits. \n
+ * Exits with non-zero code if a check fails.
+ * */
+#include "core/history.h"
+
+#include <deque>
+#include <iostream>
+#include <random>
+#include <string>
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if(!ok) {
+        std::cerr << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+/**
+ * Straightforward history with the same rules.
+ * */
+struct model {
+    bot::history_limits limits;
+    std::deque<std::string> messages;
+    std::size_t used = 0;
+
+    void push(std::string text) {
+        auto length = std::min(text.size(), limits.bytes);
+        while(length && length < text.size() && (text[length] & 0xC0) == 0x80) {
+            length--;
+        }
+        text.resize(length);
+        while(!messages.empty() && (messages.size() == limits.messages || used + length > limits.bytes)) {
+            used -= messages.front().size();
+            messages.pop_front();
+        }
+        used += length;
+        messages.emplace_back(std::move(text));
+    }
+    auto last(std::size_t n, std::size_t max_bytes) const -> std::string {
+        std::deque<std::string> taken;
+        std::size_t bytes = 0;
+        for(auto it = messages.rbegin(); it != messages.rend() && taken.size() < n; ++it) {
+            auto more = it->size() + (taken.empty() ? 0 : 1);
+            if(bytes + more > max_bytes) {
+                break;
+            }
+            bytes += more;
+            taken.emplace_front(*it);
+        }
+        if(taken.empty() && n && !messages.empty()) {
+            auto length = max_bytes;
+            while(length && (messages.back()[length] & 0xC0) == 0x80) {
+                length--;
+            }
+            return messages.back().substr(0, length);
+        }
+        std::string result;
+        for(std::size_t i = 0; i < taken.size(); i++) {
+            result += i ? "\n" + taken[i] : taken[i];
+        }
+        return result;
+    }
+};
+
+auto random_text(std::mt19937& gen, std::size_t max_length) -> std::string {
+    static const std::string pieces[] = {"a", "b", "z", "0", " ", "\xD0\xB6", "\xE2\x99\xA0", "\xF0\x9F\x82\xA1"};
+    std::uniform_int_distribution<std::size_t> length(0, max_length), piece(0, std::size(pieces) - 1);
+    std::string result;
+    for(auto n = length(gen); result.size() < n;) {
+        result += pieces[piece(gen)];
+    }
+    return result;
+}
+
+void check_against_model() {
+    std::mt19937 gen(42);
+    for(auto limits: {bot::history_limits {5, 64}, bot::history_limits {50, 37}, bot::history_limits {1, 16}}) {
+        bot::message_history history;
+        model m {limits, {}, 0};
+        for(int i = 0; i < 20000; i++) {
+            auto text = random_text(gen, limits.bytes + limits.bytes / 2);
+            history.push(text, limits);
+            m.push(text);
+            check(history.size() == m.messages.size(), "history keeps " + std::to_string(history.size()) +
+                                                           " messages instead of " +
+                                                           std::to_string(m.messages.size()));
+            std::uniform_int_distribution<std::size_t> n(0, limits.messages + 1), bytes(0, limits.bytes * 2);
+            auto count = n(gen), max_bytes = bytes(gen);
+            auto got = history.last(count, max_bytes), want = m.last(count, max_bytes);
+            check(got == want, "last(" + std::to_string(count) + ", " + std::to_string(max_bytes) + ") is \"" + got +
+                                   "\" instead of \"" + want + "\"");
+            if(failures > 10) {
+                return;
+            }
+        }
+    }
+}
+
+void check_wraparound() {
+    bot::history_limits limits {10, 16};
+    bot::message_history history;
+    history.push("0123456789", limits);
+    history.push("ab", limits);
+    history.push("cdefgh", limits); //evicts the first one, 4 bytes go to the end of the buffer and 2 to its start
+    check(history.size() == 2, "first message isn't evicted by the byte limit");
+    check(history.last(10, 100) == "ab\ncdefgh", "wrapped messages are \"" + history.last(10, 100) + "\"");
+    check(history.last(10, 8) == "cdefgh", "older messages that don't fit aren't left out");
+    check(history.last(10, 4) == "cdef", "newest message that doesn't fit isn't truncated");
+    history.push("ijklmnop", limits); //fills the buffer up right after the wrapped one
+    check(history.last(10, 100) == "ab\ncdefgh\nijklmnop",
+          "messages after the wrap are \"" + history.last(10, 100) + "\"");
+}
+
+void check_limits() {
+    bot::message_history history;
+    check(history.memory_usage() == 0, "empty history allocates");
+    history.push("text", {0, 1024});
+    check(history.size() == 0 && history.memory_usage() == 0, "disabled history keeps messages");
+    history.push("\xE2\x99\xA0\xE2\x99\xA0", {4, 4}); //two 3-byte characters don't fit in 4 bytes
+    check(history.last(4, 100) == "\xE2\x99\xA0", "truncation splits a character");
+    check(history.last(4, 2).empty(), "truncation of the result splits a character");
+    history.push("abc", {4, 8});
+    check(history.size() == 1 && history.last(4, 100) == "abc", "new limits don't drop what is kept");
+    history.clear();
+    check(history.size() == 0 && history.memory_usage() == 0, "clear keeps buffers");
+}
+
+int main() {
+    check_against_model();
+    check_wraparound();
+    check_limits();
+
+    if(failures) {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    std::cout << "all checks passed\n";
+    return 0;
+}
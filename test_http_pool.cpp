@@ -0,0 +1,229 @@
+/**
+ * Checks http_pool against a local plain-HTTP stand-in for Bot API: connections are reused, pipelined requests
+ * get their own responses, a reused connection closed by the server is retried and requests queued behind
+ * a broken connection go to another one. \n
+ * Exits with non-zero code if a check fails.
+ * */
+#include "components/logger.hpp"
+#include "core/http_pool.h"
+
+#include <atomic>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using tcp = boost::asio::ip::tcp;
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if(!ok) {
+        std::cerr << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+/**
+ * Reads a request with its body.
+ * @returns path of the request, empty if the connection is closed.
+ * */
+auto read_request(tcp::socket& socket, std::string& buffer) -> std::string {
+    boost::system::error_code ec;
+    auto end = boost::asio::read_until(socket, boost::asio::dynamic_buffer(buffer), "\r\n\r\n", ec);
+    if(ec) {
+        return {};
+    }
+    auto head = buffer.substr(0, end);
+    auto from = head.find(' ') + 1;
+    auto path = head.substr(from, head.find(' ', from) - from);
+    std::size_t length = 0;
+    if(auto pos = head.find("Content-Length: "); pos != std::string::npos) {
+        length = std::stoul(head.substr(pos + 16));
+    }
+    if(buffer.size() < end + length) {
+        auto rest = end + length - buffer.size();
+        boost::asio::read(socket, boost::asio::dynamic_buffer(buffer), boost::asio::transfer_exactly(rest), ec);
+        if(ec) {
+            return {};
+        }
+    }
+    buffer.erase(0, end + length);
+    return path;
+}
+
+void respond(tcp::socket& socket, const std::string& body, bool keep_alive) {
+    auto response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " +
+                    std::to_string(body.size()) + "\r\nConnection: " + (keep_alive ? "keep-alive" : "close") +
+                    "\r\n\r\n" + body;
+    boost::system::error_code ec;
+    boost::asio::write(socket, boost::asio::buffer(response), ec);
+}
+
+/**
+ * Answers every request of a connection with its path.
+ * */
+void echo(tcp::socket& socket) {
+    std::string buffer;
+    for(auto path = read_request(socket, buffer); !path.empty(); path = read_request(socket, buffer)) {
+        respond(socket, path, true);
+    }
+}
+
+/**
+ * Stand-in server on a local port, accepts connections one by one and runs a script for each of them.
+ * */
+struct stand_in {
+    using script_t = std::function<void(tcp::socket&, int)>; /**< Takes a connection and its number from 0 */
+
+    boost::asio::io_context io;
+    tcp::acceptor acceptor {io, {boost::asio::ip::make_address("127.0.0.1"), 0}};
+    std::atomic<int> accepted {0};
+    std::atomic<bool> stop {false};
+    std::thread thread;
+
+    stand_in(script_t script) {
+        thread = std::thread([this, script] {
+            while(true) {
+                tcp::socket socket(io);
+                boost::system::error_code ec;
+                acceptor.accept(socket, ec);
+                if(ec || stop) {
+                    return;
+                }
+                script(socket, accepted++);
+            }
+        });
+    }
+    ~stand_in() {
+        stop = true;
+        tcp::socket wake(io); //unblocks accept
+        boost::system::error_code ec;
+        wake.connect(acceptor.local_endpoint(), ec);
+        thread.join();
+    }
+
+    auto url(const std::string& path) const -> TgBot::Url {
+        return TgBot::Url("http://127.0.0.1:" + std::to_string(acceptor.local_endpoint().port()) + path);
+    }
+};
+
+void check_reuse() {
+    stand_in server([](tcp::socket& socket, int) { echo(socket); });
+    bot::http_pool pool;
+    for(int i = 0; i < 10; i++) {
+        auto path = "/getMe" + std::to_string(i);
+        check(pool.makeRequest(server.url(path), {}) == path, "response of " + path + " is wrong");
+    }
+    check(server.accepted == 1, std::to_string(server.accepted) + " connections for sequential requests");
+}
+
+void check_pipelining() {
+    stand_in server([](tcp::socket& socket, int) { echo(socket); });
+    bot::http_pool_config conf;
+    conf.connections = 1;
+    conf.pipeline    = 4;
+    bot::http_pool pool(conf);
+    std::vector<std::future<bool>> results;
+    for(int i = 0; i < 32; i++) {
+        results.emplace_back(std::async(std::launch::async, [&pool, &server, i] {
+            auto path = "/sendMessage" + std::to_string(i);
+            return pool.makeRequest(server.url(path), {TgBot::HttpReqArg("text", path)}) == path;
+        }));
+    }
+    std::size_t wrong = 0;
+    for(auto& r: results) {
+        wrong += !r.get();
+    }
+    check(wrong == 0, std::to_string(wrong) + " pipelined requests got responses of others");
+    check(server.accepted == 1, std::to_string(server.accepted) + " connections with a limit of 1");
+}
+
+void check_idle_retry() {
+    stand_in server([](tcp::socket& socket, int number) {
+        if(number == 0) { //answers once and closes the connection as if it was idle for too long
+            std::string buffer;
+            respond(socket, read_request(socket, buffer), true);
+            return;
+        }
+        echo(socket);
+    });
+    bot::http_pool pool;
+    check(pool.makeRequest(server.url("/first"), {}) == "/first", "first request failed");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    try {
+        check(pool.makeRequest(server.url("/second"), {}) == "/second", "retried request got a wrong response");
+    } catch(const std::exception& e) {
+        check(false, std::string("request over a connection closed by the server failed: ") + e.what());
+    }
+    check(server.accepted == 2, std::to_string(server.accepted) + " connections instead of 2");
+}
+
+void check_requeue() {
+    std::promise<void> release;
+    auto released = release.get_future().share();
+    stand_in server([released](tcp::socket& socket, int number) {
+        if(number == 0) { //answers the first request after the rest are queued, closes without reading them
+            std::string buffer;
+            auto path = read_request(socket, buffer);
+            released.wait();
+            respond(socket, path, false);
+            //unread bytes make close reset the connection, the response would be lost if it came first
+            boost::system::error_code ec;
+            socket.shutdown(tcp::socket::shutdown_send, ec);
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            return;
+        }
+        echo(socket);
+    });
+    bot::http_pool_config conf;
+    conf.connections = 1;
+    conf.pipeline    = 4;
+    bot::http_pool pool(conf);
+    auto request = [&](const std::string& path, std::size_t size) {
+        return std::async(std::launch::async, [&pool, &server, path, size] {
+            return pool.makeRequest(server.url(path), {TgBot::HttpReqArg("text", std::string(size, 'a'))});
+        });
+    };
+    auto first = request("/first", 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto big = request("/big", 32 << 20); //more than socket buffers take, so its write is pending
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    auto queued = request("/queued", 1); //waits behind the big one and is never sent
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    release.set_value();
+
+    check(first.get() == "/first", "first request got a wrong response");
+    try {
+        big.get();
+        check(false, "partly sent request succeeded on a closed connection");
+    } catch(const std::runtime_error&) {
+    }
+    try {
+        check(queued.get() == "/queued", "queued request got a wrong response");
+    } catch(const std::exception& e) {
+        check(false, std::string("request that was never sent failed: ") + e.what());
+    }
+    check(server.accepted == 2, std::to_string(server.accepted) + " connections instead of 2");
+}
+
+int main() {
+    auto lgr = initialization_logger(logger_config{});
+    lgr.set_level(logger::level::err);
+
+    check_reuse();
+    check_pipelining();
+    check_idle_retry();
+    check_requeue();
+
+    if(failures) {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    std::cout << "all checks passed\n";
+    return 0;
+}
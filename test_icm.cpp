@@ -0,0 +1,110 @@
+/**
+ * Checks ICM equity computed over subsets against enumeration of every finishing order. \n
+ * Exits with non-zero code if a check fails.
+ * */
+#include "poker/icm.h"
+
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if(!ok) {
+        std::cerr << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+/**
+ * Equity by definition: sums payouts over all n! finishing orders weighted by their probabilities.
+ * */
+auto enumerate(const std::vector<std::size_t>& stacks, const std::vector<double>& payouts) -> std::vector<double> {
+    auto n = stacks.size();
+    std::vector<double> result(n, 0);
+    std::vector<std::size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    do {
+        double p  = 1;
+        auto left = std::accumulate(stacks.begin(), stacks.end(), std::size_t {0});
+        for(std::size_t place = 0; place < n; place++) {
+            auto pl = order[place];
+            p *= left ? static_cast<double>(stacks[pl]) / left : 1.0 / (n - place);
+            left -= stacks[pl];
+        }
+        for(std::size_t place = 0; place < std::min(n, payouts.size()); place++) {
+            result[order[place]] += p * payouts[place];
+        }
+    } while(std::next_permutation(order.begin(), order.end()));
+    return result;
+}
+
+auto describe(const std::vector<std::size_t>& stacks, const std::vector<double>& payouts) -> std::string {
+    std::string result = "stacks";
+    for(auto s: stacks) {
+        result += " " + std::to_string(s);
+    }
+    result += " payouts";
+    for(auto p: payouts) {
+        result += " " + std::to_string(p);
+    }
+    return result;
+}
+
+void check_against_enumeration() {
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<std::size_t> chips(0, 1000);
+    std::uniform_real_distribution<double> payout(0, 100);
+    for(std::size_t n = 1; n <= 8; n++) {
+        for(std::size_t places: {std::size_t {1}, n / 2 + 1, n, n + 2}) {
+            for(int round = 0; round < 5; round++) {
+                std::vector<std::size_t> stacks(n);
+                for(auto& s: stacks) {
+                    s = round == 0 && n > 1 ? 0 : chips(gen); //some rounds have all stacks but one empty
+                }
+                if(round == 0 && n > 1) {
+                    stacks[0] = 100;
+                }
+                if(round == 1) {
+                    stacks.back() = 0;
+                }
+                std::vector<double> payouts(places);
+                for(auto& p: payouts) {
+                    p = payout(gen);
+                }
+                auto got  = poker::icm::exact(stacks, payouts);
+                auto want = enumerate(stacks, payouts);
+                for(std::size_t i = 0; i < n; i++) {
+                    check(std::abs(got[i] - want[i]) <= 1e-9 * (1 + std::abs(want[i])),
+                          describe(stacks, payouts) + ": player " + std::to_string(i) + " has " +
+                              std::to_string(got[i]) + " instead of " + std::to_string(want[i]));
+                }
+            }
+        }
+    }
+}
+
+void check_limit() {
+    std::vector<std::size_t> stacks(poker::icm::exact_limit + 1, 10);
+    try {
+        poker::icm::exact(stacks, {50, 30, 20});
+        check(false, "exact takes more than exact_limit players");
+    } catch(const std::runtime_error&) {
+    }
+}
+
+int main() {
+    check_against_enumeration();
+    check_limit();
+
+    if(failures) {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    std::cout << "all checks passed\n";
+    return 0;
+}
@@ -0,0 +1,84 @@
+/**
+ * Checks heap footprint of idle users sitting in the lobby and that disconnected users
+ * don't leave their handles behind in rooms. \n
+ * Usage: test_idle_users [users]. Exits with non-zero code if a check fails.
+ * */
+#include "components/logger.hpp"
+#include "poker/server.h"
+
+#include <iostream>
+#include <malloc.h>
+#include <string>
+
+const std::size_t max_bytes_per_user = 200; //117 measured with glibc on x86_64, containers growth included
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if(!ok) {
+        std::cerr << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+auto connect(poker::poker_server& s, std::int64_t id) -> bot::user_ptr {
+    auto user = bot::make_entity<bot::user>(id);
+    s.lobby()->add_user(user);
+    user->current_room() = s.lobby();
+    s.on_user_connect(user);
+    return user;
+}
+
+void check_footprint(std::size_t count) {
+    poker::poker_server s;
+
+    auto before = mallinfo2().uordblks;
+    for(std::size_t i = 0; i < count; i++) {
+        connect(s, static_cast<std::int64_t>(i + 1));
+    }
+    auto after    = mallinfo2().uordblks;
+    auto per_user = (after - before) / count;
+    std::cout << "idle user: " << per_user << " bytes over " << count << " users\n";
+    check(per_user <= max_bytes_per_user,
+          "idle user takes " + std::to_string(per_user) + " bytes, limit " + std::to_string(max_bytes_per_user));
+}
+
+void check_disconnect() {
+    poker::poker_server s;
+    auto owner = connect(s, 1);
+    auto guest = connect(s, 2);
+    auto room  = s.create_room(owner);
+
+    s.lobby()->del_user(guest);
+    room->add_user(guest);
+    guest->current_room() = room;
+    room->muted().emplace(guest);
+    room->unsubscribed().emplace(guest);
+    s.lobby()->banned().emplace(guest);
+
+    room->del_user(guest);
+    check(!room->contains_user(guest), "game room keeps a user after del_user");
+    check(!guest->current_room(), "user keeps a room after del_user");
+
+    s.on_user_disconnect(guest);
+    check(!guest, "handle of a disconnected user is alive");
+    check(room->muted().empty(), "room keeps a disconnected user muted");
+    check(room->unsubscribed().empty(), "room keeps a disconnected user unsubscribed");
+    check(s.lobby()->banned().empty(), "lobby keeps a disconnected user banned");
+}
+
+int main(int argc, char** argv) {
+    auto lgr = initialization_logger(logger_config{});
+    lgr.set_level(logger::level::warn);
+
+    std::size_t count = argc > 1 ? std::stoul(argv[1]) : 100000;
+    check_footprint(count);
+    check_disconnect();
+
+    if(failures) {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    std::cout << "all checks passed\n";
+    return 0;
+}
@@ -0,0 +1,122 @@
+/**
+ * Checks that players leaving during a hand don't stall or cut the street short: the street ends
+ * right after the last player who is still due to act, whoever leaves. \n
+ * Exits with non-zero code if a check fails.
+ * */
+#include "components/logger.hpp"
+#include "poker/game.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using poker::game_poker;
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if(!ok) {
+        std::cerr << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+/**
+ * Hand of four players A, B, C and D in seat order, A posts the big blind and B the small one, B acts first.
+ * */
+struct table {
+    std::vector<bot::user_ptr> users;
+    std::unique_ptr<game_poker> game;
+
+    table() {
+        for(std::int64_t id = 1; id <= 4; id++) {
+            users.emplace_back(bot::make_entity<bot::user>(id));
+        }
+        game = std::make_unique<game_poker>(users, 10);
+        game->init_game(poker::deck::seed_t {42});
+    }
+    ~table() {
+        game.reset();
+        for(auto& u: users) {
+            bot::destroy_entity(u);
+        }
+    }
+
+    auto player(std::size_t seat) -> game_poker::player_ptr { return game->players().at(seat); }
+    auto name() -> std::string {
+        auto cur = game->current_player();
+        return cur ? std::string(1, static_cast<char>('A' + cur->user()->id() - 1)) : "nobody";
+    }
+    /**
+     * Makes the current player call, the player has to be the expected one.
+     * */
+    void call(char expected) {
+        check(name() == std::string(1, expected), name() + " acts instead of " + expected);
+        if(auto cur = game->current_player()) {
+            game->handle_bet(cur->user(), game->to_call(cur));
+        }
+    }
+    void leave(std::size_t seat) { game->handle_exit(player(seat)); }
+    auto street() -> std::size_t { return game->table().size(); }
+};
+
+void check_due_leaver() {
+    table t;
+    auto flop = t.street();
+    t.call('B');
+    t.leave(3); //D still has to act
+    t.call('C');
+    t.call('A');
+    check(t.street() == flop + 1, "street isn't over after everyone due to act called");
+    check(t.name() == "B", "first to act after the street is " + t.name());
+}
+
+void check_last_due_leaver() {
+    table t;
+    auto flop = t.street();
+    t.call('B');
+    t.call('C');
+    t.leave(0); //A was the last one due to act after D
+    t.call('D');
+    check(t.street() == flop + 1, "street isn't over after the last one due to act left");
+}
+
+void check_acted_leaver() {
+    table t;
+    auto flop = t.street();
+    t.call('B');
+    t.call('C');
+    t.leave(1); //B already acted
+    t.call('D');
+    check(t.street() == flop, "street is over before everyone due to act called");
+    t.call('A');
+    check(t.street() == flop + 1, "street isn't over after everyone due to act called");
+}
+
+void check_current_leaver() {
+    table t;
+    auto flop = t.street();
+    t.call('B');
+    t.leave(2); //C's turn
+    check(t.name() == "D", "turn moved to " + t.name() + " instead of D");
+    t.call('D');
+    t.call('A');
+    check(t.street() == flop + 1, "street isn't over after everyone due to act called");
+}
+
+int main() {
+    auto lgr = initialization_logger(logger_config{});
+    lgr.set_level(logger::level::err);
+
+    check_due_leaver();
+    check_last_due_leaver();
+    check_acted_leaver();
+    check_current_leaver();
+
+    if(failures) {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    std::cout << "all checks passed\n";
+    return 0;
+}
@@ -0,0 +1,152 @@
+/**
+ * Checks that the outbox parks chats on 429 responses and sends their messages later in order,
+ * that broadcasts reuse the same bounded set of threads, and parsing of retry_after. \n
+ * Exits with non-zero code if a check fails.
+ * */
+#include "components/logger.hpp"
+#include "core/outbox.h"
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using outbox_clock = bot::outbox::clock;
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if(!ok) {
+        std::cerr << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+/**
+ * Stand-in for TG API: records delivered messages and answers 429 as many times as asked.
+ * */
+struct fake_api {
+    std::map<std::int64_t, std::vector<int>> delivered; /**< Messages by chat in delivery order */
+    std::map<std::int64_t, int> limited;                /**< 429 responses to give by chat */
+
+    auto sender(std::int64_t chat_id, int mes) {
+        return [this, chat_id, mes] {
+            if(limited[chat_id] > 0) {
+                limited[chat_id]--;
+                throw TgBot::TgException("Too Many Requests: retry after 2");
+            }
+            delivered[chat_id].emplace_back(mes);
+            return true;
+        };
+    }
+};
+
+void check_retry_after() {
+    using bot::outbox;
+    check(outbox::retry_after("Too Many Requests: retry after 35") == std::chrono::seconds(35),
+          "retry_after of a 429 response");
+    check(outbox::retry_after("Too Many Requests") == std::chrono::seconds(1), "retry_after without a number");
+    check(!outbox::retry_after("Bad Request: chat not found"), "retry_after of another error");
+    check(!outbox::retry_after(""), "retry_after of an empty description");
+}
+
+void check_parking() {
+    bot::outbox box(1000);
+    fake_api api;
+    api.limited[1] = 1;
+
+    check(!box.send(1, api.sender(1, 0)), "limited message isn't deferred");
+    check(!box.send(1, api.sender(1, 1)), "message to a parked chat isn't deferred");
+    check(!box.send(1, api.sender(1, 2)), "message to a parked chat isn't deferred");
+    check(box.send(2, api.sender(2, 0)), "other chat is held up by a parked one");
+    check(box.pending() == 3, "deferred messages aren't counted");
+    check(box.rate() < 1000, "rate isn't lowered on 429");
+
+    auto now = outbox_clock::now();
+    auto due = box.flush(now);
+    check(api.delivered[1].empty(), "parked chat is sent before retry_after");
+    check(due && *due > now + std::chrono::seconds(1), "flush isn't due when the chat is unparked");
+
+    api.limited[1] = 1; //limited again on the first retry
+    now += std::chrono::seconds(3);
+    box.flush(now);
+    check(api.delivered[1].empty(), "chat limited again kept sending");
+    check(box.pending() == 3, "message limited on retry is lost");
+
+    now += std::chrono::seconds(3);
+    check(!box.flush(now), "flush has work left after everything was sent");
+    check(api.delivered[1] == std::vector<int> {0, 1, 2}, "deferred messages are sent out of order");
+    check(api.delivered[2] == std::vector<int> {0}, "other chat got wrong messages");
+    check(box.pending() == 0, "sent messages are still pending");
+}
+
+void check_chat_limit() {
+    bot::outbox box(1000, 2);
+    fake_api api;
+    api.limited[1] = 1;
+    for(int i = 0; i < 4; i++) {
+        box.send(1, api.sender(1, i));
+    }
+    check(box.pending() == 2, "chat keeps more messages than its limit");
+    box.flush(outbox_clock::now() + std::chrono::seconds(3));
+    check(api.delivered[1] == std::vector<int> {2, 3}, "the oldest messages aren't the dropped ones");
+}
+
+void check_send_many() {
+    bot::outbox box(1000000);
+    std::mutex mutex;
+    std::map<std::int64_t, int> delivered;
+    std::set<std::thread::id> threads;
+    auto sender = [&](std::int64_t chat_id) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200)); //lets other threads take their share
+        std::lock_guard lock(mutex);
+        if(chat_id == 0 && !delivered.count(0)) {
+            delivered[0] = 0;
+            throw TgBot::TgException("Too Many Requests: retry after 1");
+        }
+        delivered[chat_id]++;
+        threads.insert(std::this_thread::get_id());
+    };
+    std::vector<std::int64_t> chats(200);
+    for(std::size_t i = 0; i < chats.size(); i++) {
+        chats[i] = static_cast<std::int64_t>(i);
+    }
+    std::size_t sent = 0;
+    for(int round = 0; round < 20; round++) {
+        sent += box.send_many(chats, sender, 4);
+    }
+    check(sent == 20 * (chats.size() - 1), std::to_string(sent) + " messages are sent now");
+    check(box.pending() == 20, "limited chat doesn't defer its messages");
+    check(threads.size() <= 4, std::to_string(threads.size()) + " threads sent a broadcast of 4");
+    check(threads.size() > 1, "broadcast is sent by one thread");
+    bool all = true;
+    for(std::size_t i = 1; i < chats.size(); i++) {
+        all = all && delivered[chats[i]] == 20;
+    }
+    check(all, "chats didn't get every message of a broadcast");
+
+    box.send_many({7}, sender, 4); //a single message goes from the calling thread
+    check(delivered[7] == 21, "broadcast to one chat isn't sent");
+    box.send_many({}, sender, 4);
+}
+
+int main() {
+    auto lgr = initialization_logger(logger_config{});
+    lgr.set_level(logger::level::err);
+
+    check_retry_after();
+    check_parking();
+    check_chat_limit();
+    check_send_many();
+
+    if(failures) {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    std::cout << "all checks passed\n";
+    return 0;
+}
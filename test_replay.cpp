@@ -0,0 +1,109 @@
+/**
+ * Checks that hands recorded by game_poker replay without divergence, hands where players left
+ * in and out of turn included, and that a replay stops at the first action the engine does differently. \n
+ * Exits with non-zero code if a check fails.
+ * */
+#include "components/logger.hpp"
+#include "poker/replay.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace hh = poker::hand_history;
+using poker::game_poker;
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if(!ok) {
+        std::cerr << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+/**
+ * Plays a hand of four players A, B, C and D in seat order, B acts first: B calls, D leaves while C is to act,
+ * C leaves in turn, then A and B check it down.
+ * @returns record of the hand.
+ * */
+auto play_with_leaves() -> hh::hand_record {
+    std::vector<bot::user_ptr> users;
+    for(std::int64_t id = 1; id <= 4; id++) {
+        users.emplace_back(bot::make_entity<bot::user>(id));
+    }
+    hh::hand_record result;
+    {
+        game_poker game(users, 10);
+        game.init_game(poker::deck::seed_t {7});
+        auto act = [&] {
+            auto cur = game.current_player();
+            game.handle_bet(cur->user(), game.to_call(cur));
+        };
+        act();
+        game.handle_exit(game.players().at(3));
+        game.handle_exit(game.current_player());
+        for(int guard = 0; game.current_player() && guard < 20; guard++) {
+            act();
+        }
+        if(auto hand = game.take_finished_hand()) {
+            result = *hand;
+        }
+    }
+    for(auto& u: users) {
+        bot::destroy_entity(u);
+    }
+    return result;
+}
+
+void check_leaves() {
+    auto hand = play_with_leaves();
+    std::size_t leaves = 0;
+    for(auto& a: hand.actions) {
+        leaves += a.type == hh::action_type::leave;
+    }
+    check(leaves == 2, std::to_string(leaves) + " leaves are recorded instead of 2");
+
+    bot::snapshot::encoder enc;
+    hh::encode(hand, 0, enc);
+    bot::snapshot::decoder dec(enc.data().data(), enc.data().size());
+    hh::hand_record decoded;
+    hh::decode(dec, 0, decoded);
+    check(decoded.actions.size() == hand.actions.size() && decoded.actions[3].type == hh::action_type::leave,
+          "leave doesn't survive encoding");
+
+    hh::replayer replayer;
+    auto result = replayer.replay(decoded);
+    check(result.ok(), "hand with leaves diverges: " + result.divergence);
+    check(result.applied == hand.actions.size(),
+          std::to_string(result.applied) + " of " + std::to_string(hand.actions.size()) + " actions are applied");
+
+    result = replayer.replay(decoded, 4); //right after D left out of turn
+    check(result.ok() && result.applied == 4, "partial replay diverges: " + result.divergence);
+    check(replayer.render().find("seat 3 user:4 left") != std::string::npos, "render doesn't show the leaver");
+}
+
+void check_divergence() {
+    auto hand = play_with_leaves();
+    hand.actions[3].type = hh::action_type::fold; //D can't fold out of turn
+    hh::replayer replayer;
+    auto result = replayer.replay(hand);
+    check(result.divergence == "action 3: seat 2 acts instead of 3", "out of turn fold is reported as \"" +
+                                                                           result.divergence + "\"");
+    check(result.applied == 3, "divergence is reported after " + std::to_string(result.applied) + " actions");
+}
+
+int main() {
+    auto lgr = initialization_logger(logger_config{});
+    lgr.set_level(logger::level::err);
+
+    check_leaves();
+    check_divergence();
+
+    if(failures) {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    std::cout << "all checks passed\n";
+    return 0;
+}
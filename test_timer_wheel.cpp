@@ -0,0 +1,106 @@
+/**
+ * Checks that timers of the timing wheel expire exactly at their ticks when they cascade
+ * across level boundaries, and that stale handles can't cancel anything. \n
+ * Exits with non-zero code if a check fails.
+ * */
+#include "core/timer_wheel.h"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using wheel_t = bot::timing_wheel<std::uint64_t>;
+
+const auto tick  = std::chrono::milliseconds(1);
+const auto start = wheel_t::clock::time_point {};
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if(!ok) {
+        std::cerr << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+auto at(std::uint64_t t) -> wheel_t::clock::time_point {
+    return start + t * tick;
+}
+
+/**
+ * Schedules timers around the boundary of every level, from tick 0 and from a tick that isn't aligned,
+ * then advances tick by tick. The value of a timer is the tick it must expire at.
+ * */
+void check_cascade() {
+    const std::uint64_t offset = 1000;
+    std::vector<std::uint64_t> deltas;
+    for(std::uint64_t boundary: {std::uint64_t {1} << 8, std::uint64_t {1} << 16, std::uint64_t {1} << 24}) {
+        for(auto d: {boundary - 1, boundary, boundary + 1, 2 * boundary + 3}) {
+            deltas.emplace_back(d);
+        }
+    }
+    deltas.emplace_back(1);
+
+    wheel_t wheel(tick, start);
+    std::size_t expected = 0;
+    for(auto d: deltas) {
+        wheel.schedule(at(d), d);
+        expected++;
+    }
+    std::size_t fired = 0;
+    std::uint64_t last = 0;
+    auto end           = offset + (std::uint64_t {2} << 24) + 4;
+    for(std::uint64_t t = 1; t <= end; t++) {
+        if(t == offset) {
+            for(auto d: deltas) {
+                wheel.schedule(at(offset + d), offset + d);
+                expected++;
+            }
+        }
+        wheel.advance(at(t), [&](std::uint64_t value) {
+            check(value == t, "timer of tick " + std::to_string(value) + " expired at " + std::to_string(t));
+            check(value >= last, "timer of tick " + std::to_string(value) + " expired after " + std::to_string(last));
+            last = value;
+            fired++;
+        });
+    }
+    check(fired == expected, std::to_string(fired) + " of " + std::to_string(expected) + " timers expired");
+    check(wheel.size() == 0, "timers are left in the wheel");
+}
+
+void check_cancel() {
+    wheel_t wheel(tick, start);
+    std::vector<std::uint64_t> fired;
+    auto collect = [&](std::uint64_t value) { fired.emplace_back(value); };
+
+    auto h = wheel.schedule(at(5), 5);
+    check(wheel.cancel(h), "pending timer isn't cancelled");
+    check(!wheel.cancel(h), "timer is cancelled twice");
+    wheel.advance(at(10), collect);
+    check(fired.empty(), "cancelled timer expired");
+
+    auto expired = wheel.schedule(at(15), 15);
+    wheel.advance(at(15), collect);
+    check(fired == std::vector<std::uint64_t> {15}, "timer didn't expire");
+    check(!wheel.cancel(expired), "expired timer is cancelled");
+
+    auto reused = wheel.schedule(at(20), 20); //takes the node of the expired one
+    check(reused.index == expired.index, "node isn't reused");
+    check(!wheel.cancel(expired), "stale handle cancels a new timer");
+    check(wheel.size() == 1, "new timer is gone");
+    wheel.advance(at(20), collect);
+    check(fired == std::vector<std::uint64_t> {15, 20}, "new timer didn't expire");
+}
+
+int main() {
+    check_cascade();
+    check_cancel();
+
+    if(failures) {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    std::cout << "all checks passed\n";
+    return 0;
+}
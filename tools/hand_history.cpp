@@ -0,0 +1,205 @@
+/**
+ * Hand history tool: reads files written by poker::hand_history::writer. \n
+ * Usage: hand_history <command> <files or directories>... \n
+ * dump prints every hand, blocks prints the block index of every file with sizes and compression ratios,
+ * replay re-runs every hand through the current engine and reports divergences, exiting with non-zero code
+ * if there are any; with --hand and --at it prints the state of one hand after an action instead.
+ * index builds side indexes of files, query prints hands that match --where criteria using the indexes
+ * and builds the missing or stale ones first.
+ * */
+#include "components/logger.hpp"
+#include "poker/hand_history.h"
+#include "poker/hand_index.h"
+#include "poker/replay.h"
+
+#include <algorithm>
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace po = boost::program_options;
+namespace hh = poker::hand_history;
+
+auto expand(const std::vector<std::string>& paths) -> std::vector<std::string> {
+    std::vector<std::string> result;
+    for(auto& path: paths) {
+        if(std::filesystem::is_directory(path)) {
+            auto files = hh::list_files(path);
+            result.insert(result.end(), files.begin(), files.end());
+        } else {
+            result.emplace_back(path);
+        }
+    }
+    return result;
+}
+
+void dump(const hh::reader& r, std::size_t& left) {
+    r.for_each([&](const hh::hand_record& hand) {
+        if(left) {
+            std::cout << hh::describe(hand) << "\n";
+            left--;
+        }
+    });
+}
+
+void blocks(const hh::reader& r, const std::string& path) {
+    std::size_t hands = 0, stored = 0, raw = 0;
+    std::cout << path << "\n";
+    for(auto& b: r.blocks()) {
+        std::cout << fmt::format("  offset:{} hands:{} stored:{} raw:{} codec:{} time:{}-{}\n", b.offset, b.hands,
+                                 b.stored, b.raw, static_cast<int>(b.codec), b.first_time, b.last_time);
+        hands += b.hands;
+        stored += b.stored + hh::block_info::header_size;
+        raw += b.raw;
+    }
+    if(hands) {
+        std::cout << fmt::format("  {} blocks, {} hands, {:.1f} bytes per hand stored, {:.1f} raw\n",
+                                 r.blocks().size(), hands, double(stored) / hands, double(raw) / hands);
+    }
+}
+
+/**
+ * Replays hands of a file, prints every divergence.
+ * @returns amount of divergent hands.
+ * */
+auto replay(const hh::reader& r, const std::string& path, std::size_t& hands) -> std::size_t {
+    hh::replayer replayer;
+    std::size_t diverged = 0;
+    r.for_each([&](const hh::hand_record& hand) {
+        auto result = replayer.replay(hand);
+        if(!result.ok()) {
+            std::cout << fmt::format("{} hand {}: {}\n{}\n", path, hands, result.divergence, hh::describe(hand));
+            diverged++;
+        }
+        hands++;
+    });
+    return diverged;
+}
+
+/**
+ * Prints state of a hand after an action.
+ * @returns false if the file has no such hand.
+ * */
+auto show(const hh::reader& r, std::size_t& index, std::size_t at) -> bool {
+    hh::replayer replayer;
+    auto found = false;
+    r.for_each([&](const hh::hand_record& hand) {
+        if(found || index--) {
+            return;
+        }
+        found       = true;
+        auto result = replayer.replay(hand, at);
+        std::cout << hh::describe(hand) << "\nafter " << result.applied << " actions:\n" << replayer.render() << "\n";
+        if(!result.ok()) {
+            std::cout << "divergence: " << result.divergence << "\n";
+        }
+    });
+    return found;
+}
+
+void build(const std::string& path) {
+    auto hands = hh::build_index(path);
+    hh::hand_index idx(hh::index_path(path));
+    std::cout << fmt::format("{}: {} hands, {} players, index of {} bytes\n", path, hands, idx.users(),
+                             std::filesystem::file_size(hh::index_path(path)));
+}
+
+/**
+ * Prints hands of files that match a query.
+ * @returns false if the query is malformed.
+ * */
+auto query(const std::vector<std::string>& files, const std::vector<std::string>& where, std::size_t limit) -> bool {
+    hh::hand_query q;
+    try {
+        q = hh::parse_query(where);
+    } catch(const std::invalid_argument& e) {
+        std::cerr << e.what() << "\n";
+        return false;
+    }
+    auto start  = std::chrono::steady_clock::now();
+    auto result = hh::search(files, q, limit);
+    std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+    for(auto& hand: result.found) {
+        std::cout << hh::describe(hand) << "\n";
+    }
+    std::cout << fmt::format("{} of {} hands match in {} files, {} indexed, {:.1f} ms\n", result.matched,
+                             result.hands, result.files, result.indexed, time.count());
+    return true;
+}
+
+int main(int argc, char** argv) {
+    po::options_description desc("Allowed options");
+    desc.add_options()("help", "produce help message");
+    desc.add_options()("command", po::value<std::string>(), "dump|blocks|replay|index|query");
+    desc.add_options()("paths", po::value<std::vector<std::string>>(), "history files or directories of them");
+    desc.add_options()("limit", po::value<std::size_t>()->default_value(-1), "most hands to dump or query");
+    desc.add_options()("hand", po::value<std::size_t>(), "replay only this hand, counting from 0 across all paths");
+    desc.add_options()("at", po::value<std::size_t>()->default_value(-1), "actions of --hand to replay");
+    desc.add_options()("where", po::value<std::vector<std::string>>()->default_value({}, ""),
+                       "criterion of query: user=<id>, pot=<least pot>, board=<textures>, from=<unix time> or "
+                       "to=<unix time>, textures are paired, trips, flush_possible, flush, straight_possible "
+                       "and river separated by commas");
+    po::positional_options_description positional;
+    positional.add("command", 1).add("paths", -1);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+    po::notify(vm);
+    if(vm.count("help") || !vm.count("command") || !vm.count("paths")) {
+        std::cout << "Usage: hand_history <command> <paths>...\n" << desc << "\n";
+        return vm.count("help") ? 0 : 1;
+    }
+    auto lgr = initialization_logger();
+    lgr.set_level(logger::level::warn);
+
+    auto command = vm["command"].as<std::string>();
+    auto left    = vm["limit"].as<std::size_t>();
+    if(command != "dump" && command != "blocks" && command != "replay" && command != "index" && command != "query") {
+        std::cerr << "unknown command " << command << "\n";
+        return 1;
+    }
+    std::size_t hands = 0, diverged = 0;
+    auto index        = vm.count("hand") ? std::optional(vm["hand"].as<std::size_t>()) : std::nullopt;
+    auto start        = std::chrono::steady_clock::now();
+    try {
+        if(command == "query") {
+            auto files = expand(vm["paths"].as<std::vector<std::string>>());
+            return query(files, vm["where"].as<std::vector<std::string>>(), left) ? 0 : 1;
+        }
+        for(auto& path: expand(vm["paths"].as<std::vector<std::string>>())) {
+            if(command == "index") {
+                build(path);
+                continue;
+            }
+            hh::reader r(path);
+            if(command == "dump") {
+                dump(r, left);
+            } else if(command == "blocks") {
+                blocks(r, path);
+            } else if(index) {
+                if(show(r, *index, vm["at"].as<std::size_t>())) {
+                    return 0;
+                }
+            } else {
+                diverged += replay(r, path, hands);
+            }
+        }
+    } catch(const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    if(command == "replay" && index) {
+        std::cerr << "no such hand\n";
+        return 1;
+    }
+    if(command == "replay") {
+        std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+        std::cout << fmt::format("replayed {} hands, {} diverged, {:.0f} hands/sec\n", hands, diverged,
+                                 hands / std::max(time.count(), 1e-9));
+    }
+    return diverged ? 1 : 0;
+}